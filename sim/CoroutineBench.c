@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////////////////////////////
+///
+/// @author            James Card
+/// @date              10.15.2026
+///
+/// @file              CoroutineBench.c
+///
+/// @brief             Host-side benchmark of a coroutine resume/yield round
+///                    trip.  Built once with the assembly context switch and
+///                    once with setjmp and longjmp so the two can be compared.
+///
+/// @copyright
+///                   Copyright (c) 2012-2025 James Card
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a
+/// copy of this software and associated documentation files (the "Software"),
+/// to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+/// and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included
+/// in all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+/// DEALINGS IN THE SOFTWARE.
+///
+///                                James Card
+///                         http://www.jamescard.org
+///
+///////////////////////////////////////////////////////////////////////////////
+
+// Standard C includes
+#include <stdio.h>
+#include <stdlib.h>
+#include </usr/include/time.h>
+
+// NanoOs includes
+#include "kernel/Coroutines.h"
+
+/// @def DEFAULT_NUM_ITERATIONS
+///
+/// @brief The number of resume/yield round trips to time if none is given on
+/// the command line.
+#define DEFAULT_NUM_ITERATIONS 1000000
+
+/// @def NUM_WARMUP_ITERATIONS
+///
+/// @brief The number of untimed round trips run before timing begins.
+#define NUM_WARMUP_ITERATIONS 1000
+
+/// @fn static int64_t nowNanoseconds(void)
+///
+/// @brief Get the current value of the host's monotonic clock.
+///
+/// @return Returns the current monotonic time in nanoseconds.
+static int64_t nowNanoseconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (((int64_t) now.tv_sec) * 1000000000LL) + now.tv_nsec;
+}
+
+/// @fn static void* pingPong(void *arg)
+///
+/// @brief Coroutine that yields back to its resumer forever.
+///
+/// @param arg The argument passed to the first resume.  Unused.
+///
+/// @return This function never returns.
+static void* pingPong(void *arg) {
+  while (1) {
+    arg = coroutineYield(arg, COROUTINE_STATE_BLOCKED);
+  }
+
+  return NULL;
+}
+
+/// @fn int main(int argc, char **argv)
+///
+/// @brief Entry point for the benchmark.
+///
+/// @param argc The number of command line arguments.
+/// @param argv The command line arguments.  The optional first argument is the
+///   number of round trips to time.
+///
+/// @return Returns 0 on success, 1 on failure.
+int main(int argc, char **argv) {
+  long numIterations = DEFAULT_NUM_ITERATIONS;
+  if (argc > 1) {
+    numIterations = strtol(argv[1], NULL, 10);
+    if (numIterations <= 0) {
+      fprintf(stderr, "Usage: %s [number of iterations]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  Coroutine mainCoroutine;
+  if (coroutineConfig(&mainCoroutine, NULL) != coroutineSuccess) {
+    fprintf(stderr, "ERROR: coroutineConfig failed.\n");
+    return 1;
+  }
+
+  Coroutine *coroutine = NULL;
+  if (coroutineCreate(&coroutine, pingPong, NULL) != coroutineSuccess) {
+    fprintf(stderr, "ERROR: Could not create coroutine.\n");
+    return 1;
+  }
+
+  for (int ii = 0; ii < NUM_WARMUP_ITERATIONS; ii++) {
+    coroutineResume(coroutine, NULL);
+  }
+
+  int64_t startTime = nowNanoseconds();
+  for (long ii = 0; ii < numIterations; ii++) {
+    coroutineResume(coroutine, NULL);
+  }
+  int64_t elapsed = nowNanoseconds() - startTime;
+
+#ifdef COROUTINE_CONTEXT_WORDS
+  const char *contextSwitch = "assembly";
+#else
+  const char *contextSwitch = "setjmp/longjmp";
+#endif // COROUTINE_CONTEXT_WORDS
+  double nsPerOp = ((double) elapsed) / ((double) numIterations);
+  printf("%-16s %ld resume/yield round trips: %.1f ns/op, %.0f ops/s\n",
+    contextSwitch, numIterations, nsPerOp, 1000000000.0 / nsPerOp);
+
+  return 0;
+}
+
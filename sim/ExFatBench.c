@@ -0,0 +1,1148 @@
+///////////////////////////////////////////////////////////////////////////////
+///
+/// @author            James Card
+/// @date              10.16.2026
+///
+/// @file              ExFatBench.c
+///
+/// @brief             Host-side benchmark of the exFAT driver.  Formats a
+///                    small exFAT volume in memory and counts the block
+///                    device transactions the driver makes to create, open,
+///                    read, and remove files.
+///
+/// @copyright
+///                   Copyright (c) 2012-2025 James Card
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a
+/// copy of this software and associated documentation files (the "Software"),
+/// to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+/// and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included
+/// in all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+/// DEALINGS IN THE SOFTWARE.
+///
+///                                James Card
+///                         http://www.jamescard.org
+///
+///////////////////////////////////////////////////////////////////////////////
+
+// Standard C includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// NanoOs includes
+#include "kernel/BlockCache.h"
+#include "kernel/ExFatFilesystem.h"
+#include "kernel/Filesystem.h"
+
+/// @def BLOCK_SIZE
+///
+/// @brief The size of the blocks on the simulated SD card.
+#define BLOCK_SIZE 512
+
+/// @def PARTITION_START
+///
+/// @brief The first block of the exFAT partition on the simulated card.
+#define PARTITION_START 64
+
+/// @def FAT_OFFSET
+///
+/// @brief The first block of the FAT, relative to the start of the partition.
+#define FAT_OFFSET 32
+
+/// @def FAT_LENGTH
+///
+/// @brief The number of blocks in the FAT.
+#define FAT_LENGTH 128
+
+/// @def CLUSTER_HEAP_OFFSET
+///
+/// @brief The first block of the cluster heap, relative to the start of the
+/// partition.
+#define CLUSTER_HEAP_OFFSET 192
+
+/// @def SECTORS_PER_CLUSTER_SHIFT
+///
+/// @brief log2 of the number of blocks in a cluster.  4 KB clusters.
+#define SECTORS_PER_CLUSTER_SHIFT 3
+
+/// @def CLUSTER_COUNT
+///
+/// @brief The number of clusters in the cluster heap.  64 MB of 4 KB
+/// clusters.
+#define CLUSTER_COUNT 16384
+
+/// @def PERCENT_FULL
+///
+/// @brief How much of the cluster heap is marked allocated when the volume is
+/// formatted, to simulate a card that is mostly full.
+#define PERCENT_FULL 90
+
+/// @def PREALLOCATED_CLUSTERS
+///
+/// @brief The number of clusters at the start of the cluster heap that are
+/// marked allocated when the volume is formatted.
+#define PREALLOCATED_CLUSTERS ((CLUSTER_COUNT * PERCENT_FULL) / 100)
+
+/// @def BITMAP_CLUSTER
+///
+/// @brief The cluster that holds the allocation bitmap.
+#define BITMAP_CLUSTER 2
+
+/// @def ROOT_DIRECTORY_CLUSTER
+///
+/// @brief The cluster that holds the root directory.
+#define ROOT_DIRECTORY_CLUSTER 3
+
+/// @def UPCASE_TABLE_CLUSTER
+///
+/// @brief The cluster reserved for the upcase table.
+#define UPCASE_TABLE_CLUSTER 4
+
+/// @def DISK_NUM_BLOCKS
+///
+/// @brief The total number of blocks on the simulated card.
+#define DISK_NUM_BLOCKS \
+  (PARTITION_START + CLUSTER_HEAP_OFFSET \
+    + (CLUSTER_COUNT << SECTORS_PER_CLUSTER_SHIFT))
+
+/// @def NUM_FILES
+///
+/// @brief The number of files created in the root directory.  Small enough
+/// that the directory fits in one cluster.
+#define NUM_FILES 24
+
+/// @def FILE_NAME_FORMAT
+///
+/// @brief The format of the names of the files in the root directory.  The
+/// driver doesn't split entry sets across sectors and treats the gap it leaves
+/// at the end of a sector as the end of the directory.  Names of 16 to 30
+/// characters take four entries, so the sets pack into the sectors exactly.
+#define FILE_NAME_FORMAT "benchfile-%02d.dat"
+
+/// @def SCRATCH_NAME_FORMAT
+///
+/// @brief The format of the names of the short-lived files.
+#define SCRATCH_NAME_FORMAT "scratchfile%04ld.tmp"
+
+/// @def FILE_SIZE
+///
+/// @brief The number of bytes written to each file.  Spans two clusters.
+#define FILE_SIZE 6000
+
+/// @def SCRATCH_SIZE
+///
+/// @brief The number of bytes written to each short-lived file.
+#define SCRATCH_SIZE 1000
+
+/// @def LOG_NAME_FORMAT
+///
+/// @brief The format of the names of the files written like logs.
+#define LOG_NAME_FORMAT "benchlogfile-%d.txt"
+
+/// @def LOG_SIZE
+///
+/// @brief The number of bytes appended to each log file.  64 clusters.
+#define LOG_SIZE (256 * 1024)
+
+/// @def LOG_WRITE_SIZE
+///
+/// @brief The number of bytes appended to a log file by each write.
+#define LOG_WRITE_SIZE 512
+
+/// @def INTERLEAVED_NAME_FORMAT
+///
+/// @brief The format of the names of the files grown in turn.
+#define INTERLEAVED_NAME_FORMAT "interleaved-%d.dat"
+
+/// @def INTERLEAVED_NUM_CLUSTERS
+///
+/// @brief The number of clusters written to each file grown in turn.
+#define INTERLEAVED_NUM_CLUSTERS 8
+
+/// @def SPARSE_NAME
+///
+/// @brief The name of the file that is written past its end.
+#define SPARSE_NAME "sparsefile-0.dat"
+
+/// @def SPARSE_GAP
+///
+/// @brief The number of bytes skipped before writing to the sparse file.
+#define SPARSE_GAP 10000
+
+/// @def TRUNCATED_NAME
+///
+/// @brief The name of the file that is rewritten with "w" over and over.
+#define TRUNCATED_NAME "truncatedfile-0.dat"
+
+/// @def SEEK_EXTENDED_NAME
+///
+/// @brief The name of the file that is extended by seeking past its end.
+#define SEEK_EXTENDED_NAME "seekextended-0.dat"
+
+/// @def SEEK_EXTENDED_SIZE
+///
+/// @brief The size that files are extended to by seeking.  Four clusters.
+#define SEEK_EXTENDED_SIZE (16 * 1024)
+
+/// @def FRAGMENTED_NAME_FORMAT
+///
+/// @brief The format of the names of the files that are seeked within.
+#define FRAGMENTED_NAME_FORMAT "fragmented-%d.dat"
+
+/// @def FRAGMENTED_NUM_CLUSTERS
+///
+/// @brief The number of clusters written to each file that is seeked within.
+#define FRAGMENTED_NUM_CLUSTERS 64
+
+/// @def SEEK_READ_SIZE
+///
+/// @brief The number of bytes read after each random seek.
+#define SEEK_READ_SIZE 64
+
+/// @def DEFAULT_NUM_ROUNDS
+///
+/// @brief The number of times each measured operation is repeated if no count
+/// is given on the command line.
+#define DEFAULT_NUM_ROUNDS 200
+
+/// @struct RamDisk
+///
+/// @brief A simulated SD card that counts the transactions made against it.
+///
+/// @param blocks The contents of the card.
+/// @param numReads The number of readBlocks calls made.
+/// @param numWrites The number of writeBlocks calls made.
+typedef struct RamDisk {
+  uint8_t *blocks;
+  long numReads;
+  long numWrites;
+} RamDisk;
+
+/// @struct PhaseResult
+///
+/// @brief The device transactions made by one measured operation.
+///
+/// @param name The name of the operation.
+/// @param numOps The number of times the operation was run.
+/// @param numReads The number of device reads the operations made.
+/// @param numWrites The number of device writes the operations made.
+typedef struct PhaseResult {
+  const char *name;
+  long numOps;
+  long numReads;
+  long numWrites;
+} PhaseResult;
+
+/// @var ramDisk
+///
+/// @brief The simulated SD card.
+static RamDisk ramDisk;
+
+/// @var randomState
+///
+/// @brief The state of the pseudorandom number generator.
+static uint32_t randomState = 0x4e616e6f;
+
+/// @fn static uint32_t randomBetween(uint32_t min, uint32_t max)
+///
+/// @brief Get a pseudorandom number from a xorshift generator.
+///
+/// @param min The smallest value to return.
+/// @param max The largest value to return.
+///
+/// @return Returns a value between min and max, inclusive.
+static uint32_t randomBetween(uint32_t min, uint32_t max) {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+
+  return min + (randomState % (max - min + 1));
+}
+
+// The driver's dependencies on the rest of the kernel.  Memory comes straight
+// from the host and errors go to stderr.
+
+int printString_(const char *string) {
+  return fputs(string, stderr);
+}
+
+int printInt_(long long int integer) {
+  return fprintf(stderr, "%lld", integer);
+}
+
+void* memoryManagerMalloc(size_t size) {
+  return malloc(size);
+}
+
+void* memoryManagerCalloc(size_t nmemb, size_t size) {
+  return calloc(nmemb, size);
+}
+
+void memoryManagerFree(void *ptr) {
+  free(ptr);
+}
+
+/// @fn static int ramDiskReadBlocks(void *context, uint32_t startBlock,
+///   uint32_t numBlocks, uint16_t blockSize, uint8_t *buffer)
+///
+/// @brief BlockStorageDevice readBlocks implementation for the RamDisk.
+///
+/// @return Returns 0 on success, -1 if the blocks are off the end of the disk.
+static int ramDiskReadBlocks(void *context, uint32_t startBlock,
+  uint32_t numBlocks, uint16_t blockSize, uint8_t *buffer
+) {
+  RamDisk *disk = (RamDisk*) context;
+  if ((blockSize != BLOCK_SIZE)
+    || (startBlock + numBlocks > DISK_NUM_BLOCKS)
+  ) {
+    return -1;
+  }
+
+  disk->numReads++;
+  memcpy(buffer, &disk->blocks[startBlock * BLOCK_SIZE],
+    numBlocks * BLOCK_SIZE);
+  return 0;
+}
+
+/// @fn static int ramDiskWriteBlocks(void *context, uint32_t startBlock,
+///   uint32_t numBlocks, uint16_t blockSize, const uint8_t *buffer)
+///
+/// @brief BlockStorageDevice writeBlocks implementation for the RamDisk.
+///
+/// @return Returns 0 on success, -1 if the blocks are off the end of the disk.
+static int ramDiskWriteBlocks(void *context, uint32_t startBlock,
+  uint32_t numBlocks, uint16_t blockSize, const uint8_t *buffer
+) {
+  RamDisk *disk = (RamDisk*) context;
+  if ((blockSize != BLOCK_SIZE)
+    || (startBlock + numBlocks > DISK_NUM_BLOCKS)
+  ) {
+    return -1;
+  }
+
+  disk->numWrites++;
+  memcpy(&disk->blocks[startBlock * BLOCK_SIZE], buffer,
+    numBlocks * BLOCK_SIZE);
+  return 0;
+}
+
+/// @fn static void formatRamDisk(RamDisk *disk)
+///
+/// @brief Lay down an exFAT volume with PREALLOCATED_CLUSTERS clusters in use.
+/// The root directory starts with the four entries a formatted card has, but
+/// the upcase table is empty because the driver doesn't use one.
+///
+/// @param disk The RamDisk to format.  Its blocks must be zeroed.
+///
+/// @return This function returns no value.
+static void formatRamDisk(RamDisk *disk) {
+  uint8_t *partition = &disk->blocks[PARTITION_START * BLOCK_SIZE];
+
+  ExFatBootSector *bootSector = (ExFatBootSector*) partition;
+  memcpy(bootSector->fileSystemName, "EXFAT   ", 8);
+  bootSector->partitionOffset = PARTITION_START;
+  bootSector->volumeLength = DISK_NUM_BLOCKS - PARTITION_START;
+  bootSector->fatOffset = FAT_OFFSET;
+  bootSector->fatLength = FAT_LENGTH;
+  bootSector->clusterHeapOffset = CLUSTER_HEAP_OFFSET;
+  bootSector->clusterCount = CLUSTER_COUNT;
+  bootSector->rootDirectoryCluster = ROOT_DIRECTORY_CLUSTER;
+  bootSector->fileSystemRevision = 0x0100;
+  bootSector->bytesPerSectorShift = 9;
+  bootSector->sectorsPerClusterShift = SECTORS_PER_CLUSTER_SHIFT;
+  bootSector->numberOfFats = 1;
+  bootSector->bootSignature = 0xAA55;
+
+  // The two reserved entries, then the bitmap and root directory clusters,
+  // each a chain of one.
+  uint32_t *fat = (uint32_t*) &partition[FAT_OFFSET * BLOCK_SIZE];
+  fat[0] = 0xFFFFFFF8;
+  fat[1] = 0xFFFFFFFF;
+  fat[BITMAP_CLUSTER] = 0xFFFFFFFF;
+  fat[ROOT_DIRECTORY_CLUSTER] = 0xFFFFFFFF;
+  fat[UPCASE_TABLE_CLUSTER] = 0xFFFFFFFF;
+
+  uint8_t *clusterHeap = &partition[CLUSTER_HEAP_OFFSET * BLOCK_SIZE];
+  uint32_t bytesPerCluster = BLOCK_SIZE << SECTORS_PER_CLUSTER_SHIFT;
+  uint8_t *bitmap = &clusterHeap[(BITMAP_CLUSTER - 2) * bytesPerCluster];
+  memset(bitmap, 0xFF, PREALLOCATED_CLUSTERS / 8);
+
+  uint8_t *rootDirectory
+    = &clusterHeap[(ROOT_DIRECTORY_CLUSTER - 2) * bytesPerCluster];
+  uint32_t bitmapCluster = BITMAP_CLUSTER;
+  uint64_t bitmapLength = CLUSTER_COUNT / 8;
+  uint32_t upcaseTableCluster = UPCASE_TABLE_CLUSTER;
+  rootDirectory[0 * EXFAT_DIRECTORY_ENTRY_SIZE] = EXFAT_ENTRY_VOLUME_LABEL;
+  rootDirectory[1 * EXFAT_DIRECTORY_ENTRY_SIZE] = EXFAT_ENTRY_ALLOCATION_BITMAP;
+  memcpy(&rootDirectory[1 * EXFAT_DIRECTORY_ENTRY_SIZE + 20],
+    &bitmapCluster, sizeof(bitmapCluster));
+  memcpy(&rootDirectory[1 * EXFAT_DIRECTORY_ENTRY_SIZE + 24],
+    &bitmapLength, sizeof(bitmapLength));
+  rootDirectory[2 * EXFAT_DIRECTORY_ENTRY_SIZE] = EXFAT_ENTRY_UPCASE_TABLE;
+  memcpy(&rootDirectory[2 * EXFAT_DIRECTORY_ENTRY_SIZE + 20],
+    &upcaseTableCluster, sizeof(upcaseTableCluster));
+  // Volume GUID entry
+  rootDirectory[3 * EXFAT_DIRECTORY_ENTRY_SIZE] = 0xA0;
+}
+
+/// @fn static int mountRamDisk(BlockStorageDevice *blockDevice,
+///   FilesystemState *fs, ExFatDriverState *driverState)
+///
+/// @brief Initialize the exFAT driver on top of a block device the way the
+/// filesystem task does.
+///
+/// @param blockDevice The BlockStorageDevice for the driver to use.
+/// @param fs The FilesystemState to initialize.
+/// @param driverState The ExFatDriverState to initialize.
+///
+/// @return Returns the value returned by exFatInitialize.
+static int mountRamDisk(BlockStorageDevice *blockDevice,
+  FilesystemState *fs, ExFatDriverState *driverState
+) {
+  memset(fs, 0, sizeof(*fs));
+  memset(driverState, 0, sizeof(*driverState));
+  fs->blockDevice = blockDevice;
+  fs->blockSize = blockDevice->blockSize;
+  fs->blockBuffer = (uint8_t*) malloc(fs->blockSize);
+  fs->startLba = PARTITION_START;
+  arenaInit(&driverState->arena, EXFAT_ARENA_SIZE);
+
+  return exFatInitialize(driverState, fs);
+}
+
+/// @fn static void flushDevice(BlockStorageDevice *blockDevice)
+///
+/// @brief Flush a block device the way the filesystem task does after closing
+/// or removing a file.
+///
+/// @param blockDevice The BlockStorageDevice to flush.
+///
+/// @return This function returns no value.
+static void flushDevice(BlockStorageDevice *blockDevice) {
+  if (blockDevice->flush != NULL) {
+    blockDevice->flush(blockDevice->context);
+  }
+}
+
+/// @fn static void fillPattern(uint8_t *buffer, uint32_t length, int fileIndex)
+///
+/// @brief Fill a buffer with data that identifies the file it belongs to.
+///
+/// @param buffer The buffer to fill.
+/// @param length The number of bytes in the buffer.
+/// @param fileIndex The index of the file the data is for.
+///
+/// @return This function returns no value.
+static void fillPattern(uint8_t *buffer, uint32_t length, int fileIndex) {
+  for (uint32_t ii = 0; ii < length; ii++) {
+    buffer[ii] = (uint8_t) ((ii * 7) + (fileIndex * 13));
+  }
+}
+
+/// @fn static int verifyFiles(ExFatDriverState *driverState)
+///
+/// @brief Read every file back and check its contents.
+///
+/// @param driverState The mounted ExFatDriverState to read from.
+///
+/// @return Returns the number of files that could not be read back intact.
+static int verifyFiles(ExFatDriverState *driverState) {
+  static uint8_t expected[FILE_SIZE];
+  static uint8_t actual[FILE_SIZE];
+  char fileName[32];
+  int numBad = 0;
+
+  for (int ii = 0; ii < NUM_FILES; ii++) {
+    snprintf(fileName, sizeof(fileName), FILE_NAME_FORMAT, ii);
+    ExFatFileHandle *file = exFatOpenFile(driverState, fileName, "r");
+    if (file == NULL) {
+      numBad++;
+      continue;
+    }
+    fillPattern(expected, FILE_SIZE, ii);
+    if ((exFatRead(driverState, actual, FILE_SIZE, file) != FILE_SIZE)
+      || (memcmp(expected, actual, FILE_SIZE) != 0)
+    ) {
+      numBad++;
+    }
+    exFatFclose(driverState, file);
+    arenaReset(&driverState->arena);
+  }
+
+  return numBad;
+}
+
+/// @fn static uint32_t numFreeClusters(const ExFatDriverState *driverState)
+///
+/// @brief Get the number of free clusters a mounted driver knows about.
+///
+/// @param driverState The mounted ExFatDriverState.
+///
+/// @return Returns the sum of the driver's per-sector free counts.
+static uint32_t numFreeClusters(const ExFatDriverState *driverState) {
+  uint32_t numFree = 0;
+  for (uint32_t ii = 0; ii < driverState->bitmapSectors; ii++) {
+    numFree += driverState->bitmapFreeCounts[ii];
+  }
+
+  return numFree;
+}
+
+/// @fn static int writeLogFile(ExFatDriverState *driverState,
+///   BlockStorageDevice *blockDevice, int logIndex, bool preallocate,
+///   PhaseResult *phase)
+///
+/// @brief Create a file and append LOG_SIZE bytes to it LOG_WRITE_SIZE bytes
+/// at a time, the way a task writing a log would.
+///
+/// @param driverState The mounted ExFatDriverState to write to.
+/// @param blockDevice The BlockStorageDevice the driver is using.
+/// @param logIndex The index of the log file.
+/// @param preallocate Whether to preallocate the whole file before writing.
+/// @param phase The PhaseResult to add the device transactions to.
+///
+/// @return Returns 0 on success, -1 on failure.
+static int writeLogFile(ExFatDriverState *driverState,
+  BlockStorageDevice *blockDevice, int logIndex, bool preallocate,
+  PhaseResult *phase
+) {
+  static uint8_t logData[LOG_SIZE];
+  char fileName[32];
+  snprintf(fileName, sizeof(fileName), LOG_NAME_FORMAT, logIndex);
+  fillPattern(logData, LOG_SIZE, NUM_FILES + 1 + logIndex);
+
+  long numReads = ramDisk.numReads;
+  long numWrites = ramDisk.numWrites;
+  ExFatFileHandle *file = exFatOpenFile(driverState, fileName, "w");
+  if (file == NULL) {
+    return -1;
+  }
+  if (preallocate && (exFatFallocate(driverState, file, 0, LOG_SIZE) != 0)) {
+    exFatFclose(driverState, file);
+    return -1;
+  }
+  for (uint32_t offset = 0; offset < LOG_SIZE; offset += LOG_WRITE_SIZE) {
+    if (exFatWrite(driverState, &logData[offset], LOG_WRITE_SIZE, file)
+      != LOG_WRITE_SIZE
+    ) {
+      exFatFclose(driverState, file);
+      return -1;
+    }
+  }
+  exFatFclose(driverState, file);
+  flushDevice(blockDevice);
+  arenaReset(&driverState->arena);
+
+  phase->numOps += LOG_SIZE / LOG_WRITE_SIZE;
+  phase->numReads += ramDisk.numReads - numReads;
+  phase->numWrites += ramDisk.numWrites - numWrites;
+  return 0;
+}
+
+/// @fn static int checkLogFile(ExFatDriverState *driverState, int logIndex)
+///
+/// @brief Read a log file back and check its contents and that its clusters
+/// are contiguous.
+///
+/// @param driverState The mounted ExFatDriverState to read from.
+/// @param logIndex The index of the log file.
+///
+/// @return Returns 0 on success, -1 on failure.
+static int checkLogFile(ExFatDriverState *driverState, int logIndex) {
+  static uint8_t expected[LOG_SIZE];
+  static uint8_t actual[LOG_SIZE];
+  char fileName[32];
+  snprintf(fileName, sizeof(fileName), LOG_NAME_FORMAT, logIndex);
+  fillPattern(expected, LOG_SIZE, NUM_FILES + 1 + logIndex);
+
+  int returnValue = 0;
+  ExFatFileHandle *file = exFatOpenFile(driverState, fileName, "r");
+  if (file == NULL) {
+    return -1;
+  }
+  if ((!file->noFatChain)
+    || (exFatRead(driverState, actual, LOG_SIZE, file) != LOG_SIZE)
+    || (memcmp(expected, actual, LOG_SIZE) != 0)
+  ) {
+    returnValue = -1;
+  }
+  exFatFclose(driverState, file);
+  arenaReset(&driverState->arena);
+
+  return returnValue;
+}
+
+/// @fn static int checkInterleavedFiles(ExFatDriverState *driverState)
+///
+/// @brief Grow two files a cluster at a time in turn so that neither one can
+/// stay contiguous, then read them back and remove them.  Files are removed
+/// newest first because the driver marks removed entries as the end of the
+/// directory.
+///
+/// @param driverState The mounted ExFatDriverState to use.
+///
+/// @return Returns 0 on success, -1 on failure.
+static int checkInterleavedFiles(ExFatDriverState *driverState) {
+  const uint32_t bytesPerCluster = BLOCK_SIZE << SECTORS_PER_CLUSTER_SHIFT;
+  const uint32_t fileSize = INTERLEAVED_NUM_CLUSTERS * bytesPerCluster;
+  uint8_t *expected = (uint8_t*) malloc(fileSize);
+  uint8_t *actual = (uint8_t*) malloc(fileSize);
+  ExFatFileHandle *files[2] = { NULL, NULL };
+  char fileName[32];
+  int returnValue = 0;
+
+  for (int ii = 0; ii < 2; ii++) {
+    snprintf(fileName, sizeof(fileName), INTERLEAVED_NAME_FORMAT, ii);
+    files[ii] = exFatOpenFile(driverState, fileName, "w");
+    if (files[ii] == NULL) {
+      returnValue = -1;
+    }
+  }
+  for (uint32_t cluster = 0;
+    (returnValue == 0) && (cluster < INTERLEAVED_NUM_CLUSTERS);
+    cluster++
+  ) {
+    for (int ii = 0; ii < 2; ii++) {
+      fillPattern(expected, fileSize, 2 * NUM_FILES + ii);
+      if (exFatWrite(driverState, &expected[cluster * bytesPerCluster],
+        bytesPerCluster, files[ii]) != (int32_t) bytesPerCluster
+      ) {
+        returnValue = -1;
+      }
+    }
+  }
+  for (int ii = 0; ii < 2; ii++) {
+    if (files[ii] != NULL) {
+      exFatFclose(driverState, files[ii]);
+    }
+  }
+  arenaReset(&driverState->arena);
+
+  for (int ii = 0; (returnValue == 0) && (ii < 2); ii++) {
+    snprintf(fileName, sizeof(fileName), INTERLEAVED_NAME_FORMAT, ii);
+    fillPattern(expected, fileSize, 2 * NUM_FILES + ii);
+    ExFatFileHandle *file = exFatOpenFile(driverState, fileName, "r");
+    if ((file == NULL)
+      || (exFatRead(driverState, actual, fileSize, file)
+        != (int32_t) fileSize)
+      || (memcmp(expected, actual, fileSize) != 0)
+    ) {
+      returnValue = -1;
+    }
+    if (file != NULL) {
+      exFatFclose(driverState, file);
+    }
+    arenaReset(&driverState->arena);
+  }
+
+  for (int ii = 1; ii >= 0; ii--) {
+    snprintf(fileName, sizeof(fileName), INTERLEAVED_NAME_FORMAT, ii);
+    exFatRemove(driverState, fileName);
+    arenaReset(&driverState->arena);
+  }
+
+  free(actual);
+  free(expected);
+  return returnValue;
+}
+
+/// @fn static int checkSparseFile(ExFatDriverState *driverState)
+///
+/// @brief Write to a file past its end and check that the gap reads back as
+/// zeros, then remove it.
+///
+/// @param driverState The mounted ExFatDriverState to use.
+///
+/// @return Returns 0 on success, -1 on failure.
+static int checkSparseFile(ExFatDriverState *driverState) {
+  static uint8_t expected[SPARSE_GAP + SCRATCH_SIZE];
+  static uint8_t actual[SPARSE_GAP + SCRATCH_SIZE];
+  int returnValue = 0;
+
+  memset(expected, 0, SPARSE_GAP);
+  fillPattern(&expected[SPARSE_GAP], SCRATCH_SIZE, 3 * NUM_FILES);
+  ExFatFileHandle *file = exFatOpenFile(driverState, SPARSE_NAME, "w+");
+  if ((file == NULL)
+    || (exFatSeek(driverState, file, SPARSE_GAP, SEEK_SET) != 0)
+    || (exFatWrite(driverState, &expected[SPARSE_GAP], SCRATCH_SIZE, file)
+      != SCRATCH_SIZE)
+    || (exFatSeek(driverState, file, 0, SEEK_SET) != 0)
+    || (exFatRead(driverState, actual, sizeof(actual), file)
+      != sizeof(actual))
+    || (memcmp(expected, actual, sizeof(actual)) != 0)
+  ) {
+    returnValue = -1;
+  }
+  if (file != NULL) {
+    exFatFclose(driverState, file);
+  }
+  arenaReset(&driverState->arena);
+
+  exFatRemove(driverState, SPARSE_NAME);
+  arenaReset(&driverState->arena);
+  return returnValue;
+}
+
+/// @fn static int seekFragmentedFile(ExFatDriverState *driverState,
+///   BlockStorageDevice *blockDevice, long numRounds, PhaseResult *phase)
+///
+/// @brief Grow two files a cluster at a time in turn so that their FAT chains
+/// are as long as they can be, then seek to random places in one of them and
+/// read a few bytes from each.  Only the seeks and reads are measured.
+///
+/// @param driverState The mounted ExFatDriverState to use.
+/// @param blockDevice The BlockStorageDevice the driver is using.
+/// @param numRounds The number of seeks to make.
+/// @param phase The PhaseResult to add the device transactions to.
+///
+/// @return Returns 0 on success, -1 on failure.
+static int seekFragmentedFile(ExFatDriverState *driverState,
+  BlockStorageDevice *blockDevice, long numRounds, PhaseResult *phase
+) {
+  const uint32_t bytesPerCluster = BLOCK_SIZE << SECTORS_PER_CLUSTER_SHIFT;
+  const uint32_t fileSize = FRAGMENTED_NUM_CLUSTERS * bytesPerCluster;
+  uint8_t *expected[2] = { (uint8_t*) malloc(fileSize), NULL };
+  expected[1] = (uint8_t*) malloc(fileSize);
+  ExFatFileHandle *files[2] = { NULL, NULL };
+  char fileName[32];
+  int returnValue = 0;
+
+  for (int ii = 0; ii < 2; ii++) {
+    fillPattern(expected[ii], fileSize, 4 * NUM_FILES + ii);
+    snprintf(fileName, sizeof(fileName), FRAGMENTED_NAME_FORMAT, ii);
+    files[ii] = exFatOpenFile(driverState, fileName, "w");
+    if (files[ii] == NULL) {
+      returnValue = -1;
+    }
+  }
+  for (uint32_t cluster = 0;
+    (returnValue == 0) && (cluster < FRAGMENTED_NUM_CLUSTERS);
+    cluster++
+  ) {
+    for (int ii = 0; ii < 2; ii++) {
+      if (exFatWrite(driverState, &expected[ii][cluster * bytesPerCluster],
+        bytesPerCluster, files[ii]) != (int32_t) bytesPerCluster
+      ) {
+        returnValue = -1;
+      }
+    }
+  }
+  for (int ii = 0; ii < 2; ii++) {
+    if (files[ii] != NULL) {
+      exFatFclose(driverState, files[ii]);
+    }
+  }
+  flushDevice(blockDevice);
+  arenaReset(&driverState->arena);
+
+  snprintf(fileName, sizeof(fileName), FRAGMENTED_NAME_FORMAT, 0);
+  ExFatFileHandle *file = NULL;
+  if (returnValue == 0) {
+    file = exFatOpenFile(driverState, fileName, "r");
+    if ((file == NULL) || file->noFatChain) {
+      returnValue = -1;
+    }
+  }
+
+  long numReads = ramDisk.numReads;
+  long numWrites = ramDisk.numWrites;
+  uint8_t actual[SEEK_READ_SIZE];
+  for (long round = 0; (returnValue == 0) && (round < numRounds); round++) {
+    uint32_t offset = randomBetween(0, fileSize - SEEK_READ_SIZE);
+    if ((exFatSeek(driverState, file, offset, SEEK_SET) != 0)
+      || (exFatRead(driverState, actual, SEEK_READ_SIZE, file)
+        != SEEK_READ_SIZE)
+      || (memcmp(&expected[0][offset], actual, SEEK_READ_SIZE) != 0)
+    ) {
+      returnValue = -1;
+    }
+  }
+  phase->numOps += numRounds;
+  phase->numReads += ramDisk.numReads - numReads;
+  phase->numWrites += ramDisk.numWrites - numWrites;
+
+  if (file != NULL) {
+    exFatFclose(driverState, file);
+  }
+  arenaReset(&driverState->arena);
+  free(expected[1]);
+  free(expected[0]);
+  return returnValue;
+}
+
+/// @fn static int rewriteTruncatedFile(ExFatDriverState *driverState,
+///   BlockStorageDevice *blockDevice, long numRounds, PhaseResult *phase)
+///
+/// @brief Open the same file with "w" over and over, writing a long and a
+/// short version of it in turn, then check that only the last version is
+/// there.  Truncating a file has to free its clusters for the short versions
+/// not to leak the long versions' second cluster.
+///
+/// @param driverState The mounted ExFatDriverState to use.
+/// @param blockDevice The BlockStorageDevice the driver is using.
+/// @param numRounds The number of times to rewrite the file.
+/// @param phase The PhaseResult to add the device transactions to.
+///
+/// @return Returns 0 on success, -1 on failure.
+static int rewriteTruncatedFile(ExFatDriverState *driverState,
+  BlockStorageDevice *blockDevice, long numRounds, PhaseResult *phase
+) {
+  static uint8_t expected[FILE_SIZE];
+  static uint8_t actual[FILE_SIZE];
+  uint32_t size = 0;
+  int returnValue = 0;
+
+  long numReads = ramDisk.numReads;
+  long numWrites = ramDisk.numWrites;
+  for (long round = 0; (returnValue == 0) && (round < numRounds); round++) {
+    size = ((round & 1) == 0) ? FILE_SIZE : SCRATCH_SIZE;
+    fillPattern(expected, size, 5 * NUM_FILES + (int) round);
+    ExFatFileHandle *file = exFatOpenFile(driverState, TRUNCATED_NAME, "w");
+    if ((file == NULL)
+      || (exFatWrite(driverState, expected, size, file) != (int32_t) size)
+    ) {
+      returnValue = -1;
+    }
+    if (file != NULL) {
+      exFatFclose(driverState, file);
+    }
+    flushDevice(blockDevice);
+    arenaReset(&driverState->arena);
+  }
+  phase->numOps += numRounds;
+  phase->numReads += ramDisk.numReads - numReads;
+  phase->numWrites += ramDisk.numWrites - numWrites;
+
+  ExFatFileHandle *file = NULL;
+  if (returnValue == 0) {
+    file = exFatOpenFile(driverState, TRUNCATED_NAME, "r");
+  }
+  if ((file == NULL) || (file->fileSize != size)
+    || (exFatRead(driverState, actual, sizeof(actual), file) != (int32_t) size)
+    || (memcmp(expected, actual, size) != 0)
+  ) {
+    returnValue = -1;
+  }
+  if (file != NULL) {
+    exFatFclose(driverState, file);
+  }
+  arenaReset(&driverState->arena);
+
+  exFatRemove(driverState, TRUNCATED_NAME);
+  arenaReset(&driverState->arena);
+  return returnValue;
+}
+
+/// @fn static int extendFileBySeeking(ExFatDriverState *driverState,
+///   BlockStorageDevice *blockDevice, long numRounds, PhaseResult *phase)
+///
+/// @brief Create files and grow them by seeking past their ends without
+/// writing anything, then check that the last one reads back as zeros.  Only
+/// the creates, seeks, and closes are measured.
+///
+/// @param driverState The mounted ExFatDriverState to use.
+/// @param blockDevice The BlockStorageDevice the driver is using.
+/// @param numRounds The number of files to extend.
+/// @param phase The PhaseResult to add the device transactions to.
+///
+/// @return Returns 0 on success, -1 on failure.
+static int extendFileBySeeking(ExFatDriverState *driverState,
+  BlockStorageDevice *blockDevice, long numRounds, PhaseResult *phase
+) {
+  static const uint8_t expected[SEEK_EXTENDED_SIZE] = { 0 };
+  static uint8_t actual[SEEK_EXTENDED_SIZE];
+  int returnValue = 0;
+
+  for (long round = 0; (returnValue == 0) && (round < numRounds); round++) {
+    if (round > 0) {
+      exFatRemove(driverState, SEEK_EXTENDED_NAME);
+      flushDevice(blockDevice);
+      arenaReset(&driverState->arena);
+    }
+
+    long numReads = ramDisk.numReads;
+    long numWrites = ramDisk.numWrites;
+    ExFatFileHandle *file
+      = exFatOpenFile(driverState, SEEK_EXTENDED_NAME, "w");
+    if ((file == NULL)
+      || (exFatSeek(driverState, file, SEEK_EXTENDED_SIZE, SEEK_SET) != 0)
+    ) {
+      returnValue = -1;
+    }
+    if (file != NULL) {
+      exFatFclose(driverState, file);
+    }
+    flushDevice(blockDevice);
+    arenaReset(&driverState->arena);
+    phase->numReads += ramDisk.numReads - numReads;
+    phase->numWrites += ramDisk.numWrites - numWrites;
+  }
+  phase->numOps += numRounds;
+
+  ExFatFileHandle *file = NULL;
+  if (returnValue == 0) {
+    file = exFatOpenFile(driverState, SEEK_EXTENDED_NAME, "r");
+  }
+  if ((file == NULL) || (file->fileSize != SEEK_EXTENDED_SIZE)
+    || (exFatRead(driverState, actual, sizeof(actual), file)
+      != SEEK_EXTENDED_SIZE)
+    || (memcmp(expected, actual, sizeof(actual)) != 0)
+  ) {
+    returnValue = -1;
+  }
+  if (file != NULL) {
+    exFatFclose(driverState, file);
+  }
+  arenaReset(&driverState->arena);
+
+  exFatRemove(driverState, SEEK_EXTENDED_NAME);
+  arenaReset(&driverState->arena);
+  return returnValue;
+}
+
+/// @fn static void printPhase(const PhaseResult *phase)
+///
+/// @brief Print the device transactions per operation for a phase.
+///
+/// @param phase The PhaseResult to print.
+///
+/// @return This function returns no value.
+static void printPhase(const PhaseResult *phase) {
+  printf("%-16s %6ld ops  %8.1f reads/op  %8.1f writes/op\n",
+    phase->name, phase->numOps,
+    ((double) phase->numReads) / ((double) phase->numOps),
+    ((double) phase->numWrites) / ((double) phase->numOps));
+}
+
+int main(int argc, char **argv) {
+  long numRounds = DEFAULT_NUM_ROUNDS;
+  if (argc > 1) {
+    numRounds = strtol(argv[1], NULL, 10);
+    if (numRounds < 1) {
+      fprintf(stderr, "Usage: %s [number of rounds >= 1]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  ramDisk.blocks = (uint8_t*) calloc(DISK_NUM_BLOCKS, BLOCK_SIZE);
+  formatRamDisk(&ramDisk);
+  BlockStorageDevice ramDevice = {
+    .context = &ramDisk,
+    .readBlocks = ramDiskReadBlocks,
+    .writeBlocks = ramDiskWriteBlocks,
+    .blockSize = BLOCK_SIZE,
+    .blockBitShift = 0,
+    .partitionNumber = 1,
+  };
+
+  BlockStorageDevice *blockDevice = &ramDevice;
+  BlockCache *blockCache = NULL;
+#if BLOCK_CACHE_NUM_BLOCKS > 0
+  blockCache = blockCacheCreate(&ramDevice, BLOCK_CACHE_NUM_BLOCKS);
+  blockDevice = &blockCache->device;
+#endif // BLOCK_CACHE_NUM_BLOCKS
+
+  FilesystemState fs;
+  ExFatDriverState driverState;
+  if (mountRamDisk(blockDevice, &fs, &driverState) != EXFAT_SUCCESS) {
+    fprintf(stderr, "ERROR: Could not mount the formatted volume.\n");
+    return 1;
+  }
+
+  static uint8_t buffer[FILE_SIZE];
+  char fileName[32];
+  PhaseResult phases[] = {
+    { .name = "create + write" },
+    { .name = "open" },
+    { .name = "read + close" },
+    { .name = "create + remove" },
+    { .name = "log append" },
+    { .name = "fallocate + log" },
+    { .name = "random seek" },
+    { .name = "truncate + write" },
+    { .name = "seek past end" },
+  };
+
+  // Phase 0: Populate the root directory.
+  long numReads = ramDisk.numReads;
+  long numWrites = ramDisk.numWrites;
+  for (int ii = 0; ii < NUM_FILES; ii++) {
+    snprintf(fileName, sizeof(fileName), FILE_NAME_FORMAT, ii);
+    ExFatFileHandle *file = exFatOpenFile(&driverState, fileName, "w");
+    if (file == NULL) {
+      fprintf(stderr, "ERROR: Could not create %s.\n", fileName);
+      return 1;
+    }
+    fillPattern(buffer, FILE_SIZE, ii);
+    if (exFatWrite(&driverState, buffer, FILE_SIZE, file) != FILE_SIZE) {
+      fprintf(stderr, "ERROR: Could not write %s.\n", fileName);
+      return 1;
+    }
+    exFatFclose(&driverState, file);
+    flushDevice(blockDevice);
+    arenaReset(&driverState.arena);
+  }
+  phases[0].numOps = NUM_FILES;
+  phases[0].numReads = ramDisk.numReads - numReads;
+  phases[0].numWrites = ramDisk.numWrites - numWrites;
+
+  // Phases 1 and 2: Open random files, then read and close them.
+  for (long round = 0; round < numRounds; round++) {
+    int fileIndex = (int) randomBetween(0, NUM_FILES - 1);
+    snprintf(fileName, sizeof(fileName), FILE_NAME_FORMAT, fileIndex);
+
+    numReads = ramDisk.numReads;
+    numWrites = ramDisk.numWrites;
+    ExFatFileHandle *file = exFatOpenFile(&driverState, fileName, "r");
+    phases[1].numReads += ramDisk.numReads - numReads;
+    phases[1].numWrites += ramDisk.numWrites - numWrites;
+    if (file == NULL) {
+      fprintf(stderr, "ERROR: Could not open %s.\n", fileName);
+      return 1;
+    }
+
+    numReads = ramDisk.numReads;
+    numWrites = ramDisk.numWrites;
+    exFatRead(&driverState, buffer, FILE_SIZE, file);
+    exFatFclose(&driverState, file);
+    flushDevice(blockDevice);
+    phases[2].numReads += ramDisk.numReads - numReads;
+    phases[2].numWrites += ramDisk.numWrites - numWrites;
+    arenaReset(&driverState.arena);
+  }
+  phases[1].numOps = numRounds;
+  phases[2].numOps = numRounds;
+
+  // Phase 3: Create, write, and remove short-lived files.
+  numReads = ramDisk.numReads;
+  numWrites = ramDisk.numWrites;
+  fillPattern(buffer, SCRATCH_SIZE, NUM_FILES);
+  for (long round = 0; round < numRounds; round++) {
+    snprintf(fileName, sizeof(fileName), SCRATCH_NAME_FORMAT, round % 10000);
+    ExFatFileHandle *file = exFatOpenFile(&driverState, fileName, "w");
+    if (file == NULL) {
+      fprintf(stderr, "ERROR: Could not create %s.\n", fileName);
+      return 1;
+    }
+    exFatWrite(&driverState, buffer, SCRATCH_SIZE, file);
+    exFatFclose(&driverState, file);
+    flushDevice(blockDevice);
+    arenaReset(&driverState.arena);
+    if (exFatRemove(&driverState, fileName) != EXFAT_SUCCESS) {
+      fprintf(stderr, "ERROR: Could not remove %s.\n", fileName);
+      return 1;
+    }
+    flushDevice(blockDevice);
+    arenaReset(&driverState.arena);
+  }
+  phases[3].numOps = numRounds;
+  phases[3].numReads = ramDisk.numReads - numReads;
+  phases[3].numWrites = ramDisk.numWrites - numWrites;
+
+  // Phases 4 and 5: Write log files with and without preallocating them.
+  uint32_t numFreeBefore = numFreeClusters(&driverState);
+  if ((writeLogFile(&driverState, blockDevice, 0, false, &phases[4]) != 0)
+    || (writeLogFile(&driverState, blockDevice, 1, true, &phases[5]) != 0)
+  ) {
+    fprintf(stderr, "ERROR: Could not write the log files.\n");
+    return 1;
+  }
+
+  // Phase 6: Seek around in a file whose clusters are all in a FAT chain.
+  if (seekFragmentedFile(&driverState, blockDevice, numRounds, &phases[6])
+    != 0
+  ) {
+    fprintf(stderr, "ERROR: Seeks did not read back intact.\n");
+    return 1;
+  }
+
+  // Phases 7 and 8: Rewrite a file with "w" and extend files by seeking.
+  if (rewriteTruncatedFile(&driverState, blockDevice, numRounds, &phases[7])
+    != 0
+  ) {
+    fprintf(stderr, "ERROR: Truncated file did not read back intact.\n");
+    return 1;
+  }
+  if (extendFileBySeeking(&driverState, blockDevice, numRounds, &phases[8])
+    != 0
+  ) {
+    fprintf(stderr, "ERROR: Seeking past the end did not read as zeros.\n");
+    return 1;
+  }
+
+  printf("BLOCK_CACHE_NUM_BLOCKS = %d, EXFAT_ARENA_SIZE = %d, "
+    "%d files of %d bytes, %d-byte clusters, %d%% full\n",
+    BLOCK_CACHE_NUM_BLOCKS, EXFAT_ARENA_SIZE, NUM_FILES, FILE_SIZE,
+    BLOCK_SIZE << SECTORS_PER_CLUSTER_SHIFT, PERCENT_FULL);
+  for (size_t ii = 0; ii < sizeof(phases) / sizeof(phases[0]); ii++) {
+    printPhase(&phases[ii]);
+  }
+  if (blockCache != NULL) {
+    printf("block cache: %lu hits, %lu misses, %lu write-backs, "
+      "%.1f%% hit rate\n", (unsigned long) blockCache->numHits,
+      (unsigned long) blockCache->numMisses,
+      (unsigned long) blockCache->numWriteBacks,
+      (100.0 * blockCache->numHits)
+        / (blockCache->numHits + blockCache->numMisses));
+  }
+
+  // Check the other ways files can be laid out, then make sure everything
+  // that was removed was given back.
+  if ((checkLogFile(&driverState, 0) != 0)
+    || (checkLogFile(&driverState, 1) != 0)
+  ) {
+    fprintf(stderr, "ERROR: Files did not read back intact.\n");
+    return 1;
+  }
+  for (int ii = 1; ii >= 0; ii--) {
+    snprintf(fileName, sizeof(fileName), FRAGMENTED_NAME_FORMAT, ii);
+    exFatRemove(&driverState, fileName);
+    arenaReset(&driverState.arena);
+  }
+  for (int ii = 1; ii >= 0; ii--) {
+    snprintf(fileName, sizeof(fileName), LOG_NAME_FORMAT, ii);
+    exFatRemove(&driverState, fileName);
+    arenaReset(&driverState.arena);
+  }
+  if ((checkInterleavedFiles(&driverState) != 0)
+    || (checkSparseFile(&driverState) != 0)
+  ) {
+    fprintf(stderr, "ERROR: Files did not read back intact.\n");
+    return 1;
+  }
+  flushDevice(blockDevice);
+  if (numFreeClusters(&driverState) != numFreeBefore) {
+    fprintf(stderr, "ERROR: %ld clusters leaked.\n",
+      (long) numFreeBefore - (long) numFreeClusters(&driverState));
+    return 1;
+  }
+
+  // Everything must be on the disk itself now.  Check it without the cache.
+  FilesystemState verifyFs;
+  ExFatDriverState verifyDriverState;
+  if ((mountRamDisk(&ramDevice, &verifyFs, &verifyDriverState)
+      != EXFAT_SUCCESS)
+    || (verifyFiles(&verifyDriverState) != 0)
+  ) {
+    fprintf(stderr, "ERROR: Files did not read back intact.\n");
+    return 1;
+  }
+  if (numFreeClusters(&verifyDriverState) != numFreeBefore) {
+    fprintf(stderr, "ERROR: The bitmap on the disk doesn't match.\n");
+    return 1;
+  }
+
+  return 0;
+}
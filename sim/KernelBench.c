@@ -0,0 +1,743 @@
+///////////////////////////////////////////////////////////////////////////////
+///
+/// @author            James Card
+/// @date              10.15.2026
+///
+/// @file              KernelBench.c
+///
+/// @brief             Host-side microbenchmarks of the coroutine, coroutine
+///                    synchronization, and messaging primitives that the
+///                    kernel is built on.
+///
+/// @copyright
+///                   Copyright (c) 2012-2025 James Card
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a
+/// copy of this software and associated documentation files (the "Software"),
+/// to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+/// and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included
+/// in all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+/// DEALINGS IN THE SOFTWARE.
+///
+///                                James Card
+///                         http://www.jamescard.org
+///
+///////////////////////////////////////////////////////////////////////////////
+
+// Standard C includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include </usr/include/time.h>
+
+// NanoOs includes
+#include "kernel/Coroutines.h"
+
+/// @def DEFAULT_NUM_ITERATIONS
+///
+/// @brief The number of operations to time in each benchmark if none is given
+/// on the command line.
+#define DEFAULT_NUM_ITERATIONS 200000
+
+/// @def NUM_CONTENDERS
+///
+/// @brief The number of coroutines competing for the mutex in the contention
+/// benchmark.
+#define NUM_CONTENDERS 4
+
+/// @def QUEUE_BATCH_SIZE
+///
+/// @brief The number of messages pushed onto a queue before they're all
+/// popped in the queue throughput benchmark.
+#define QUEUE_BATCH_SIZE 16
+
+/// @def BACKLOG_DEPTH
+///
+/// @brief The number of unrelated messages queued ahead of the one that's
+/// popped by type in the backlog benchmark.
+#define BACKLOG_DEPTH 64
+
+/// @def NUM_BACKLOG_TYPES
+///
+/// @brief The number of different message types in the backlog.  The message
+/// that's popped by type has type NUM_BACKLOG_TYPES + 1.
+#define NUM_BACKLOG_TYPES 7
+
+/// @def NUM_RPC_CLIENTS
+///
+/// @brief The number of coroutines sending requests to the same server at once
+/// in the concurrent RPC benchmark.
+#define NUM_RPC_CLIENTS 4
+
+/// @enum HandoffPolicy
+///
+/// @brief How the concurrent RPC benchmark's stand-in for the scheduler picks
+/// the coroutine to hand the CPU to when a condition is signalled.
+typedef enum HandoffPolicy {
+  HANDOFF_NONE,         ///< Never hand off.  Other benchmarks use this.
+  HANDOFF_FIRST_WAITER, ///< Hand off to the first coroutine signalled.
+  HANDOFF_SENDER,       ///< Hand off to the sender of a message marked done.
+} HandoffPolicy;
+
+/// @struct BenchState
+///
+/// @brief State shared between the main coroutine and the coroutines of a
+/// benchmark.
+///
+/// @param numIterations The number of operations each coroutine performs.
+/// @param mutex The mutex used by the synchronization benchmarks.
+/// @param condition The condition used by the signal benchmark.
+/// @param numPending The number of signals sent but not yet consumed.
+/// @param numDone The number of signals consumed.
+/// @param server The coroutine that serves requests in the RPC benchmark.
+/// @param reply The message the server replies with in the RPC benchmark.
+///   This can't live on the server's stack because the client releases the
+///   last reply after the server has returned.
+/// @param replies The message the server replies to each client with in the
+///   concurrent RPC benchmark.
+/// @param numClients The number of clients that have started in the
+///   concurrent RPC benchmark.
+/// @param numResumes The number of coroutine resumes made by runWithHandoffs.
+/// @param doneResume The value of numResumes when each client's last request
+///   was marked done.
+/// @param numWaitResumes The total number of resumes from a request being
+///   marked done until the client that sent it runs.
+typedef struct BenchState {
+  long numIterations;
+  Comutex mutex;
+  Cocondition condition;
+  long numPending;
+  long numDone;
+  Coroutine *server;
+  msg_t reply;
+  msg_t replies[NUM_RPC_CLIENTS];
+  int numClients;
+  long numResumes;
+  long doneResume[NUM_RPC_CLIENTS];
+  long numWaitResumes;
+} BenchState;
+
+/// @var handoffPolicy
+///
+/// @brief The HandoffPolicy of the benchmark that's running.
+static HandoffPolicy handoffPolicy = HANDOFF_NONE;
+
+/// @var handoff
+///
+/// @brief The coroutine that runWithHandoffs resumes next, NULL if there's no
+/// pending handoff.
+static Coroutine *handoff = NULL;
+
+/// @fn static int64_t nowNanoseconds(void)
+///
+/// @brief Get the current value of the host's monotonic clock.
+///
+/// @return Returns the current monotonic time in nanoseconds.
+static int64_t nowNanoseconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (((int64_t) now.tv_sec) * 1000000000LL) + now.tv_nsec;
+}
+
+/// @fn static void reportResult(
+///   const char *name, long numOperations, int64_t elapsed)
+///
+/// @brief Print the result of one benchmark.
+///
+/// @param name The name of the benchmark.
+/// @param numOperations The number of operations that were timed.
+/// @param elapsed The number of nanoseconds the operations took.
+///
+/// @return This function returns no value.
+static void reportResult(
+  const char *name, long numOperations, int64_t elapsed
+) {
+  double nsPerOp = ((double) elapsed) / ((double) numOperations);
+  printf("%-24s %10ld ops %10.1f ns/op %12.0f ops/s\n",
+    name, numOperations, nsPerOp, 1000000000.0 / nsPerOp);
+}
+
+/// @fn static void runToCompletion(Coroutine **coroutines, int numCoroutines)
+///
+/// @brief Resume a set of coroutines round-robin until all of them have
+/// returned.  This stands in for the scheduler.
+///
+/// @param coroutines The array of coroutines to run.
+/// @param numCoroutines The number of elements in the coroutines array.
+///
+/// @return This function returns no value.
+static void runToCompletion(Coroutine **coroutines, int numCoroutines) {
+  int numRunning = numCoroutines;
+  while (numRunning > 0) {
+    numRunning = 0;
+    for (int ii = 0; ii < numCoroutines; ii++) {
+      if (!coroutineFinished(coroutines[ii])) {
+        coroutineResume(coroutines[ii], NULL);
+        numRunning++;
+      }
+    }
+  }
+}
+
+/// @fn static void signalCallback(void *stateData, Cocondition *cocondition)
+///
+/// @brief Record a handoff when a condition is signalled, the same way the
+/// scheduler's coconditionSignalCallback does under handoffPolicy.
+///
+/// @param stateData Unused.
+/// @param cocondition A pointer to the Cocondition that has been signalled.
+///
+/// @return This function returns no value.
+static void signalCallback(void *stateData, Cocondition *cocondition) {
+  (void) stateData;
+  if ((cocondition->head == NULL) || (cocondition->numSignals == 0)) {
+    return;
+  }
+
+  if ((handoffPolicy == HANDOFF_FIRST_WAITER)
+    || ((handoffPolicy == HANDOFF_SENDER) && (cocondition->numSignals == 1))
+  ) {
+    handoff = cocondition->head;
+  }
+}
+
+/// @fn static void messageEventCallback(
+///   msg_t *msg, msg_q_t *queue, msg_event_t event)
+///
+/// @brief Record a handoff to the waiting sender of a message that's marked
+/// done, the same way the scheduler's schedulerMessageDone does under
+/// HANDOFF_SENDER.
+///
+/// @param msg A pointer to the message the event is about.
+/// @param queue Unused.
+/// @param event The msg_event_t that occurred.
+///
+/// @return This function returns no value.
+static void messageEventCallback(
+  msg_t *msg, msg_q_t *queue, msg_event_t event
+) {
+  (void) queue;
+  if ((handoffPolicy == HANDOFF_SENDER) && (event == MSG_EVENT_DONE)
+    && (msg_waiting(msg))
+  ) {
+    handoff = msg_from(msg).coro;
+  }
+}
+
+/// @fn static void runWithHandoffs(BenchState *benchState,
+///   Coroutine **coroutines, int numCoroutines)
+///
+/// @brief Resume a set of coroutines until all of them have returned, the way
+/// runToCompletion does, except that a pending handoff is resumed first.
+///
+/// @param benchState A pointer to the BenchState for the benchmark.  Each
+///   resume is counted in its numResumes.
+/// @param coroutines The array of coroutines to run.
+/// @param numCoroutines The number of elements in the coroutines array.
+///
+/// @return This function returns no value.
+static void runWithHandoffs(BenchState *benchState,
+  Coroutine **coroutines, int numCoroutines
+) {
+  int next = 0;
+  int numRunning = numCoroutines;
+  while (numRunning > 0) {
+    Coroutine *coroutine = handoff;
+    handoff = NULL;
+    if ((coroutine == NULL) || (coroutineFinished(coroutine))) {
+      numRunning = 0;
+      for (int ii = 0; ii < numCoroutines; ii++) {
+        if (!coroutineFinished(coroutines[ii])) {
+          numRunning++;
+        }
+      }
+      if (numRunning == 0) {
+        break;
+      }
+      while (coroutineFinished(coroutines[next])) {
+        next = (next + 1) % numCoroutines;
+      }
+      coroutine = coroutines[next];
+      next = (next + 1) % numCoroutines;
+    }
+    benchState->numResumes++;
+    coroutineResume(coroutine, NULL);
+  }
+}
+
+/// @fn static void* resumeYieldWorker(void *arg)
+///
+/// @brief Coroutine that does nothing but yield back to its resumer.
+///
+/// @param arg A pointer to the BenchState for the benchmark.
+///
+/// @return This function always returns NULL.
+static void* resumeYieldWorker(void *arg) {
+  BenchState *benchState = (BenchState*) arg;
+  for (long ii = 0; ii < benchState->numIterations; ii++) {
+    coroutineYield(NULL, COROUTINE_STATE_BLOCKED);
+  }
+
+  return NULL;
+}
+
+/// @fn static void* mutexWorker(void *arg)
+///
+/// @brief Coroutine that repeatedly locks the shared mutex, yields while
+/// holding it so that the other workers contend for it, and unlocks it.
+///
+/// @param arg A pointer to the BenchState for the benchmark.
+///
+/// @return This function always returns NULL.
+static void* mutexWorker(void *arg) {
+  BenchState *benchState = (BenchState*) arg;
+  for (long ii = 0; ii < benchState->numIterations; ii++) {
+    comutexLock(&benchState->mutex);
+    coroutineYield(NULL, COROUTINE_STATE_BLOCKED);
+    comutexUnlock(&benchState->mutex);
+  }
+
+  return NULL;
+}
+
+/// @fn static void* conditionWaiter(void *arg)
+///
+/// @brief Coroutine that waits on the shared condition until it has consumed
+/// every signal sent by conditionSignaller.
+///
+/// @param arg A pointer to the BenchState for the benchmark.
+///
+/// @return This function always returns NULL.
+static void* conditionWaiter(void *arg) {
+  BenchState *benchState = (BenchState*) arg;
+  comutexLock(&benchState->mutex);
+  while (benchState->numDone < benchState->numIterations) {
+    while (benchState->numPending == 0) {
+      coconditionWait(&benchState->condition, &benchState->mutex);
+    }
+    benchState->numPending--;
+    benchState->numDone++;
+  }
+  comutexUnlock(&benchState->mutex);
+
+  return NULL;
+}
+
+/// @fn static void* conditionSignaller(void *arg)
+///
+/// @brief Coroutine that signals the shared condition once per iteration and
+/// yields so that conditionWaiter can wake up.
+///
+/// @param arg A pointer to the BenchState for the benchmark.
+///
+/// @return This function always returns NULL.
+static void* conditionSignaller(void *arg) {
+  BenchState *benchState = (BenchState*) arg;
+  for (long ii = 0; ii < benchState->numIterations; ii++) {
+    comutexLock(&benchState->mutex);
+    benchState->numPending++;
+    coconditionSignal(&benchState->condition);
+    comutexUnlock(&benchState->mutex);
+    coroutineYield(NULL, COROUTINE_STATE_BLOCKED);
+  }
+
+  return NULL;
+}
+
+/// @fn static void* rpcServer(void *arg)
+///
+/// @brief Coroutine that answers each request in its message queue with a
+/// reply message, the same way the kernel tasks do.
+///
+/// @param arg A pointer to the BenchState for the benchmark.
+///
+/// @return This function always returns NULL.
+static void* rpcServer(void *arg) {
+  BenchState *benchState = (BenchState*) arg;
+  msg_t *reply = &benchState->reply;
+  for (long ii = 0; ii < benchState->numIterations; ii++) {
+    msg_t *request = comessageQueueWait(NULL);
+    msg_set_done(request);
+    msg_init(reply, MSG_CORO_SAFE, msg_type(request), NULL, 0, false);
+    comessageQueuePush(request->from.coro, reply);
+  }
+
+  return NULL;
+}
+
+/// @fn static void* rpcClient(void *arg)
+///
+/// @brief Coroutine that sends requests to rpcServer and waits for each reply.
+///
+/// @param arg A pointer to the BenchState for the benchmark.
+///
+/// @return This function always returns NULL.
+static void* rpcClient(void *arg) {
+  BenchState *benchState = (BenchState*) arg;
+  msg_t request;
+  memset(&request, 0, sizeof(request));
+  for (long ii = 0; ii < benchState->numIterations; ii++) {
+    msg_init(&request, MSG_CORO_SAFE, 1, NULL, 0, true);
+    comessageQueuePush(benchState->server, &request);
+    msg_t *reply = msg_wait_for_reply(&request, true, NULL);
+    msg_release(reply);
+  }
+
+  return NULL;
+}
+
+/// @fn static void* concurrentRpcServer(void *arg)
+///
+/// @brief Coroutine that answers the requests of all the concurrent RPC
+/// clients, the same way rpcServer does.  Each request carries the message to
+/// reply with.  The server yields once while handling each request, the way a
+/// kernel task waits on a device, so that the other clients' requests queue
+/// up behind it.
+///
+/// @param arg A pointer to the BenchState for the benchmark.
+///
+/// @return This function always returns NULL.
+static void* concurrentRpcServer(void *arg) {
+  BenchState *benchState = (BenchState*) arg;
+  for (long ii = 0; ii < benchState->numIterations * NUM_RPC_CLIENTS; ii++) {
+    msg_t *request = comessageQueueWait(NULL);
+    msg_t *reply = (msg_t*) msg_data(request);
+    coroutineYield(NULL, COROUTINE_STATE_BLOCKED);
+    benchState->doneResume[reply - benchState->replies]
+      = benchState->numResumes;
+    msg_set_done(request);
+    msg_init(reply, MSG_CORO_SAFE, msg_type(request), NULL, 0, false);
+    comessageQueuePush(request->from.coro, reply);
+  }
+
+  return NULL;
+}
+
+/// @fn static void* concurrentRpcClient(void *arg)
+///
+/// @brief Coroutine that sends requests to concurrentRpcServer and waits for
+/// each reply while the other clients do the same.
+///
+/// @param arg A pointer to the BenchState for the benchmark.
+///
+/// @return This function always returns NULL.
+static void* concurrentRpcClient(void *arg) {
+  BenchState *benchState = (BenchState*) arg;
+  int index = benchState->numClients++;
+  msg_t *reply = &benchState->replies[index];
+  msg_t request;
+  memset(&request, 0, sizeof(request));
+  for (long ii = 0; ii < benchState->numIterations; ii++) {
+    msg_init(&request, MSG_CORO_SAFE, 1, reply, 0, true);
+    comessageQueuePush(benchState->server, &request);
+    msg_wait_for_done(&request, NULL);
+    benchState->numWaitResumes
+      += benchState->numResumes - benchState->doneResume[index];
+    msg_release(msg_wait_for_reply(&request, true, NULL));
+  }
+
+  return NULL;
+}
+
+/// @fn static void benchResumeYield(BenchState *benchState)
+///
+/// @brief Time coroutineResume/coroutineYield round trips.
+///
+/// @param benchState A pointer to the BenchState for the benchmark.
+///
+/// @return This function returns no value.
+static void benchResumeYield(BenchState *benchState) {
+  Coroutine *coroutine = NULL;
+  coroutineCreate(&coroutine, resumeYieldWorker, benchState);
+
+  int64_t startTime = nowNanoseconds();
+  runToCompletion(&coroutine, 1);
+  reportResult("resume/yield", benchState->numIterations,
+    nowNanoseconds() - startTime);
+}
+
+/// @fn static void benchMutexContention(BenchState *benchState)
+///
+/// @brief Time comutexLock/comutexUnlock pairs with NUM_CONTENDERS coroutines
+/// competing for the same mutex.
+///
+/// @param benchState A pointer to the BenchState for the benchmark.
+///
+/// @return This function returns no value.
+static void benchMutexContention(BenchState *benchState) {
+  Coroutine *coroutines[NUM_CONTENDERS] = {0};
+  comutexInit(&benchState->mutex, comutexPlain);
+  for (int ii = 0; ii < NUM_CONTENDERS; ii++) {
+    coroutineCreate(&coroutines[ii], mutexWorker, benchState);
+  }
+
+  int64_t startTime = nowNanoseconds();
+  runToCompletion(coroutines, NUM_CONTENDERS);
+  reportResult("comutex lock/unlock",
+    benchState->numIterations * NUM_CONTENDERS,
+    nowNanoseconds() - startTime);
+  comutexDestroy(&benchState->mutex);
+}
+
+/// @fn static void benchConditionSignal(BenchState *benchState)
+///
+/// @brief Time coconditionSignal wakeups of a waiting coroutine.
+///
+/// @param benchState A pointer to the BenchState for the benchmark.
+///
+/// @return This function returns no value.
+static void benchConditionSignal(BenchState *benchState) {
+  Coroutine *coroutines[2] = {0};
+  comutexInit(&benchState->mutex, comutexPlain);
+  coconditionInit(&benchState->condition);
+  benchState->numPending = 0;
+  benchState->numDone = 0;
+  coroutineCreate(&coroutines[0], conditionWaiter, benchState);
+  coroutineCreate(&coroutines[1], conditionSignaller, benchState);
+
+  int64_t startTime = nowNanoseconds();
+  runToCompletion(coroutines, 2);
+  reportResult("cocondition signal", benchState->numIterations,
+    nowNanoseconds() - startTime);
+  coconditionDestroy(&benchState->condition);
+  comutexDestroy(&benchState->mutex);
+}
+
+/// @fn static void benchQueuePushPop(BenchState *benchState)
+///
+/// @brief Time msg_q_push/msg_q_pop pairs on a queue with no waiters.
+///
+/// @param benchState A pointer to the BenchState for the benchmark.
+///
+/// @return This function returns no value.
+static void benchQueuePushPop(BenchState *benchState) {
+  msg_q_t queue;
+  msg_t messages[QUEUE_BATCH_SIZE];
+  memset(&queue, 0, sizeof(queue));
+  memset(messages, 0, sizeof(messages));
+  msg_q_create(&queue, MSG_CORO_SAFE);
+  for (int ii = 0; ii < QUEUE_BATCH_SIZE; ii++) {
+    msg_init(&messages[ii], MSG_CORO_SAFE, ii, NULL, 0, false);
+  }
+
+  long numBatches = benchState->numIterations / QUEUE_BATCH_SIZE;
+  int64_t startTime = nowNanoseconds();
+  for (long ii = 0; ii < numBatches; ii++) {
+    for (int jj = 0; jj < QUEUE_BATCH_SIZE; jj++) {
+      msg_q_push(&queue, NULL, &messages[jj]);
+    }
+    for (int jj = 0; jj < QUEUE_BATCH_SIZE; jj++) {
+      msg_q_pop(&queue);
+    }
+  }
+  reportResult("msg_q_push/msg_q_pop", numBatches * QUEUE_BATCH_SIZE,
+    nowNanoseconds() - startTime);
+
+  for (int ii = 0; ii < QUEUE_BATCH_SIZE; ii++) {
+    msg_release(&messages[ii]);
+  }
+  msg_q_destroy(&queue);
+}
+
+/// @fn static void benchQueueBatch(BenchState *benchState)
+///
+/// @brief Time the same traffic as benchQueuePushPop, but with each batch
+/// pushed by one msg_q_push_batch call and drained by one msg_q_pop_batch
+/// call.
+///
+/// @param benchState A pointer to the BenchState for the benchmark.
+///
+/// @return This function returns no value.
+static void benchQueueBatch(BenchState *benchState) {
+  msg_q_t queue;
+  msg_t messages[QUEUE_BATCH_SIZE];
+  msg_t *batch[QUEUE_BATCH_SIZE];
+  memset(&queue, 0, sizeof(queue));
+  memset(messages, 0, sizeof(messages));
+  msg_q_create(&queue, MSG_CORO_SAFE);
+  for (int ii = 0; ii < QUEUE_BATCH_SIZE; ii++) {
+    msg_init(&messages[ii], MSG_CORO_SAFE, ii, NULL, 0, false);
+  }
+
+  long numBatches = benchState->numIterations / QUEUE_BATCH_SIZE;
+  int64_t startTime = nowNanoseconds();
+  for (long ii = 0; ii < numBatches; ii++) {
+    for (int jj = 0; jj < QUEUE_BATCH_SIZE; jj++) {
+      batch[jj] = &messages[jj];
+    }
+    msg_q_push_batch(&queue, NULL, batch, QUEUE_BATCH_SIZE);
+    msg_q_pop_batch(&queue, batch, QUEUE_BATCH_SIZE);
+  }
+  reportResult("msg_q_push/pop_batch", numBatches * QUEUE_BATCH_SIZE,
+    nowNanoseconds() - startTime);
+
+  for (int ii = 0; ii < QUEUE_BATCH_SIZE; ii++) {
+    msg_release(&messages[ii]);
+  }
+  msg_q_destroy(&queue);
+}
+
+/// @fn static void benchQueueBacklog(BenchState *benchState)
+///
+/// @brief Time msg_q_pop_type of a message that's queued behind a deep backlog
+/// of messages of other types, the way a reply sits behind the pending
+/// requests of a busy kernel task.  The message is pushed back onto the tail
+/// after each pop so that the backlog stays ahead of it.
+///
+/// @param benchState A pointer to the BenchState for the benchmark.
+///
+/// @return This function returns no value.
+static void benchQueueBacklog(BenchState *benchState) {
+  msg_q_t queue;
+  msg_t backlog[BACKLOG_DEPTH];
+  msg_t target;
+  memset(&queue, 0, sizeof(queue));
+  memset(backlog, 0, sizeof(backlog));
+  memset(&target, 0, sizeof(target));
+  msg_q_create(&queue, MSG_CORO_SAFE);
+  for (int ii = 0; ii < BACKLOG_DEPTH; ii++) {
+    msg_init(&backlog[ii], MSG_CORO_SAFE,
+      1 + (ii % NUM_BACKLOG_TYPES), NULL, 0, false);
+    msg_q_push(&queue, NULL, &backlog[ii]);
+  }
+  msg_init(&target, MSG_CORO_SAFE, NUM_BACKLOG_TYPES + 1, NULL, 0, false);
+  msg_q_push(&queue, NULL, &target);
+
+  int64_t startTime = nowNanoseconds();
+  for (long ii = 0; ii < benchState->numIterations; ii++) {
+    msg_t *msg = msg_q_pop_type(&queue, NUM_BACKLOG_TYPES + 1);
+    msg_q_push(&queue, NULL, msg);
+  }
+  reportResult("msg_q_pop_type backlog", benchState->numIterations,
+    nowNanoseconds() - startTime);
+
+  msg_q_pop_type(&queue, NUM_BACKLOG_TYPES + 1);
+  for (int ii = 0; ii < BACKLOG_DEPTH; ii++) {
+    msg_q_pop(&queue);
+    msg_release(&backlog[ii]);
+  }
+  msg_release(&target);
+  msg_q_destroy(&queue);
+}
+
+/// @fn static void benchWaitForReply(BenchState *benchState)
+///
+/// @brief Time request/reply round trips between two coroutines using
+/// msg_wait_for_reply.
+///
+/// @param benchState A pointer to the BenchState for the benchmark.
+///
+/// @return This function returns no value.
+static void benchWaitForReply(BenchState *benchState) {
+  Coroutine *coroutines[2] = {0};
+  coroutineCreate(&coroutines[0], rpcServer, benchState);
+  benchState->server = coroutines[0];
+  coroutineCreate(&coroutines[1], rpcClient, benchState);
+
+  int64_t startTime = nowNanoseconds();
+  runToCompletion(coroutines, 2);
+  reportResult("msg_wait_for_reply", benchState->numIterations,
+    nowNanoseconds() - startTime);
+}
+
+/// @fn static void benchConcurrentRpc(
+///   BenchState *benchState, HandoffPolicy policy, const char *name)
+///
+/// @brief Time request/reply round trips of NUM_RPC_CLIENTS clients of the same
+/// server, with the CPU handed off the way policy says.  All of the clients
+/// wait on the condition that's shared by every message's done flag, so
+/// marking one request done wakes all of them.  The number of resumes until
+/// the client whose request is done runs is reported as well.  1 means that it
+/// always runs next.
+///
+/// @param benchState A pointer to the BenchState for the benchmark.
+/// @param policy The HandoffPolicy to run the coroutines with.
+/// @param name The name to report the result under.
+///
+/// @return This function returns no value.
+static void benchConcurrentRpc(
+  BenchState *benchState, HandoffPolicy policy, const char *name
+) {
+  Coroutine *coroutines[NUM_RPC_CLIENTS + 1] = {0};
+  coroutineCreate(&coroutines[0], concurrentRpcServer, benchState);
+  benchState->server = coroutines[0];
+  benchState->numClients = 0;
+  benchState->numResumes = 0;
+  benchState->numWaitResumes = 0;
+  for (int ii = 1; ii <= NUM_RPC_CLIENTS; ii++) {
+    coroutineCreate(&coroutines[ii], concurrentRpcClient, benchState);
+  }
+  handoffPolicy = policy;
+  handoff = NULL;
+
+  long numOperations = benchState->numIterations * NUM_RPC_CLIENTS;
+  int64_t startTime = nowNanoseconds();
+  runWithHandoffs(benchState, coroutines, NUM_RPC_CLIENTS + 1);
+  int64_t elapsed = nowNanoseconds() - startTime;
+  handoffPolicy = HANDOFF_NONE;
+
+  reportResult(name, numOperations, elapsed);
+  printf("%-24s %10.2f resumes per round trip, %.2f from done to sender\n",
+    "", ((double) benchState->numResumes) / ((double) numOperations),
+    ((double) benchState->numWaitResumes) / ((double) numOperations));
+}
+
+/// @fn int main(int argc, char **argv)
+///
+/// @brief Entry point for the benchmarks.
+///
+/// @param argc The number of command line arguments.
+/// @param argv The command line arguments.  The optional first argument is the
+///   number of operations to time in each benchmark.
+///
+/// @return Returns 0 on success, 1 on failure.
+int main(int argc, char **argv) {
+  BenchState benchState;
+  memset(&benchState, 0, sizeof(benchState));
+  benchState.numIterations = DEFAULT_NUM_ITERATIONS;
+  if (argc > 1) {
+    benchState.numIterations = strtol(argv[1], NULL, 10);
+    if (benchState.numIterations < QUEUE_BATCH_SIZE) {
+      fprintf(stderr, "Usage: %s [number of iterations >= %d]\n",
+        argv[0], QUEUE_BATCH_SIZE);
+      return 1;
+    }
+  }
+
+  Coroutine mainCoroutine;
+  CoroutineConfigOptions options;
+  memset(&options, 0, sizeof(options));
+  options.coconditionSignalCallback = signalCallback;
+  if (coroutineConfig(&mainCoroutine, &options) != coroutineSuccess) {
+    fprintf(stderr, "ERROR: coroutineConfig failed.\n");
+    return 1;
+  }
+
+  printf("MSG_Q_TYPE_INDEX_SIZE = %d\n", MSG_Q_TYPE_INDEX_SIZE);
+  benchResumeYield(&benchState);
+  benchMutexContention(&benchState);
+  benchConditionSignal(&benchState);
+  benchQueuePushPop(&benchState);
+  benchQueueBatch(&benchState);
+  benchQueueBacklog(&benchState);
+  benchWaitForReply(&benchState);
+  msg_set_event_callback(messageEventCallback);
+  benchConcurrentRpc(&benchState, HANDOFF_FIRST_WAITER, "rpc x4, first waiter");
+  benchConcurrentRpc(&benchState, HANDOFF_SENDER, "rpc x4, sender");
+  msg_set_event_callback(NULL);
+
+  return 0;
+}
+
@@ -0,0 +1,546 @@
+///////////////////////////////////////////////////////////////////////////////
+///
+/// @author            James Card
+/// @date              10.16.2026
+///
+/// @file              MemoryBench.c
+///
+/// @brief             Host-side fragmentation benchmark of the memory
+///                    manager's heap allocator.  Replays synthetic traces of
+///                    the kinds of allocations the kernel and shells make
+///                    against a heap the size of the one on the Nano 33 IoT.
+///
+/// @copyright
+///                   Copyright (c) 2012-2025 James Card
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a
+/// copy of this software and associated documentation files (the "Software"),
+/// to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+/// and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included
+/// in all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+/// DEALINGS IN THE SOFTWARE.
+///
+///                                James Card
+///                         http://www.jamescard.org
+///
+///////////////////////////////////////////////////////////////////////////////
+
+// Standard C includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include </usr/include/time.h>
+
+// NanoOs includes
+#include "kernel/MemoryAllocator.h"
+#include "kernel/Tasks.h"
+
+/// @def HEAP_SIZE
+///
+/// @brief The number of bytes in the heap that the traces are replayed against.
+#define HEAP_SIZE 7168
+
+/// @def DEFAULT_NUM_COMMANDS
+///
+/// @brief The number of shell commands to replay in each trace if none is given
+/// on the command line.
+#define DEFAULT_NUM_COMMANDS 20000
+
+/// @def MAX_TEMPORARIES
+///
+/// @brief The maximum number of allocations a single command holds at once.
+#define MAX_TEMPORARIES 8
+
+/// @def MAX_LONG_LIVED
+///
+/// @brief The maximum number of allocations that outlive the command that made
+/// them at any one time.
+#define MAX_LONG_LIVED 32
+
+/// @def EXFAT_NAME_SIZE
+///
+/// @brief The size of the UTF-16 name buffers the exFAT driver allocates for a
+/// directory search.
+#define EXFAT_NAME_SIZE (255 * 2)
+
+/// @def BENCH_PID
+///
+/// @brief The task ID that owns every allocation in the traces.
+#define BENCH_PID 2
+
+/// @def NUM_CHECK_TASKS
+///
+/// @brief The number of tasks whose allocations are interleaved by the
+/// ownership check.
+#define NUM_CHECK_TASKS 4
+
+/// @def NUM_CHECK_ALLOCATIONS
+///
+/// @brief The number of allocations each task holds at once in the ownership
+/// check.
+#define NUM_CHECK_ALLOCATIONS 24
+
+/// @def NUM_CHECK_ROUNDS
+///
+/// @brief The number of times the ownership check frees one task's memory and
+/// lets it allocate again.
+#define NUM_CHECK_ROUNDS 200
+
+/// @def HEAP_GUARD_SIZE
+///
+/// @brief The number of bytes at the bottom of heapStorage that the ownership
+/// check leaves out of the heap.  The allocator must never write to them.
+#define HEAP_GUARD_SIZE 64
+
+/// @def HEAP_GUARD_BYTE
+///
+/// @brief The value the ownership check fills the guard bytes with.
+#define HEAP_GUARD_BYTE 0x5a
+
+/// @struct TraceConfig
+///
+/// @brief The parameters of one synthetic allocation trace.
+///
+/// @param name The name of the trace.
+/// @param longLivedOdds One in this many commands leaves a small allocation
+///   behind.
+/// @param maxLifetime The maximum number of commands that an allocation left
+///   behind lives for.
+typedef struct TraceConfig {
+  const char *name;
+  uint32_t longLivedOdds;
+  uint32_t maxLifetime;
+} TraceConfig;
+
+/// @struct LongLived
+///
+/// @brief An allocation that outlives the command that made it.
+///
+/// @param ptr The allocated memory, NULL if the slot is unused.
+/// @param expires The number of the command after which the memory is freed.
+typedef struct LongLived {
+  void *ptr;
+  long expires;
+} LongLived;
+
+/// @struct TraceResult
+///
+/// @brief The outcome of replaying one trace.
+///
+/// @param numAllocations The number of allocations and reallocations made.
+/// @param numFailures The number of allocations and reallocations that failed.
+/// @param firstFailure The number of the command that saw the first failure,
+///   -1 if there were none.
+/// @param peakHeapUsed The largest number of bytes between the top of the heap
+///   and the lowest allocated block.
+/// @param fragmentation The percentage of free memory that was not in the
+///   largest free extent at the end of the trace.
+/// @param elapsed The number of nanoseconds the trace took.
+typedef struct TraceResult {
+  long numAllocations;
+  long numFailures;
+  long firstFailure;
+  uintptr_t peakHeapUsed;
+  int fragmentation;
+  int64_t elapsed;
+} TraceResult;
+
+/// @var heapStorage
+///
+/// @brief The memory the heap is carved from.  Declared as 64-bit values so
+/// that it's 8-byte aligned.
+static uint64_t heapStorage[HEAP_SIZE / sizeof(uint64_t)];
+
+/// @var heap
+///
+/// @brief The allocator state for heapStorage.
+static MemoryManagerState heap;
+
+/// @var randomState
+///
+/// @brief The state of the pseudorandom number generator.  Every trace starts
+/// from the same seed so that every allocator sees the same requests.
+static uint32_t randomState;
+
+/// @fn static uint32_t randomBetween(uint32_t min, uint32_t max)
+///
+/// @brief Get a pseudorandom number from a xorshift generator.
+///
+/// @param min The smallest value to return.
+/// @param max The largest value to return.
+///
+/// @return Returns a value between min and max, inclusive.
+static uint32_t randomBetween(uint32_t min, uint32_t max) {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+
+  return min + (randomState % (max - min + 1));
+}
+
+/// @fn static int64_t nowNanoseconds(void)
+///
+/// @brief Get the current value of the host's monotonic clock.
+///
+/// @return Returns the current monotonic time in nanoseconds.
+static int64_t nowNanoseconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (((int64_t) now.tv_sec) * 1000000000LL) + now.tv_nsec;
+}
+
+/// @fn static void* benchRealloc(TraceResult *result, long command,
+///   void *ptr, size_t size)
+///
+/// @brief Make one allocation or reallocation from the heap and record the
+/// outcome.
+///
+/// @param result The TraceResult of the trace being replayed.
+/// @param command The number of the command making the request.
+/// @param ptr The memory to reallocate, NULL to allocate new memory.
+/// @param size The number of bytes requested.
+///
+/// @return Returns the value returned by localRealloc.
+static void* benchRealloc(TraceResult *result, long command,
+  void *ptr, size_t size
+) {
+  result->numAllocations++;
+  void *newPtr = localRealloc(&heap, ptr, size, BENCH_PID);
+  if (newPtr == NULL) {
+    result->numFailures++;
+    if (result->firstFailure < 0) {
+      result->firstFailure = command;
+    }
+  }
+
+  uintptr_t used = heap.mallocStart - ((uintptr_t) heap.mallocNext);
+  if (used > result->peakHeapUsed) {
+    result->peakHeapUsed = used;
+  }
+
+  return newPtr;
+}
+
+/// @fn static int heapFragmentation(void)
+///
+/// @brief Measure how fragmented the free memory in the heap is.
+///
+/// @return Returns the percentage of free memory that is not in the largest
+/// free extent.
+static int heapFragmentation(void) {
+  size_t freeMemory = localGetFreeMemory(&heap);
+  size_t largest = ((uintptr_t) heap.mallocNext) - heap.mallocEnd;
+  for (MemNode *cur = memNode(heap.mallocNext); cur->prev != NULL;
+    cur = cur->prev
+  ) {
+    if ((cur->owner == TASK_ID_NOT_SET) && (cur->size > largest)) {
+      largest = cur->size;
+    }
+  }
+
+  return (freeMemory > 0) ? (int) (100 - ((largest * 100) / freeMemory)) : 0;
+}
+
+/// @fn static void replayTrace(const TraceConfig *traceConfig,
+///   long numCommands, TraceResult *result)
+///
+/// @brief Replay a synthetic trace of shell commands.  Each command parses its
+/// arguments, resolves a path, searches a directory the way the exFAT driver
+/// does, and sometimes builds up an output string with realloc.  Its
+/// temporaries are freed in a random order, and some commands leave a small
+/// allocation behind for a while.
+///
+/// @param traceConfig The parameters of the trace.
+/// @param numCommands The number of commands to replay.
+/// @param result The TraceResult to fill in.
+///
+/// @return This function returns no value.
+static void replayTrace(const TraceConfig *traceConfig,
+  long numCommands, TraceResult *result
+) {
+  LongLived longLived[MAX_LONG_LIVED];
+  memset(longLived, 0, sizeof(longLived));
+  memset(result, 0, sizeof(*result));
+  result->firstFailure = -1;
+  randomState = 0x4e616e6f;
+  localInitializeHeap(&heap,
+    ((char*) heapStorage) + sizeof(heapStorage), sizeof(heapStorage));
+
+  int64_t startTime = nowNanoseconds();
+  for (long command = 0; command < numCommands; command++) {
+    for (int ii = 0; ii < MAX_LONG_LIVED; ii++) {
+      if ((longLived[ii].ptr != NULL) && (longLived[ii].expires <= command)) {
+        localFree(&heap, longLived[ii].ptr);
+        longLived[ii].ptr = NULL;
+      }
+    }
+
+    void *temporaries[MAX_TEMPORARIES];
+    int numTemporaries = 0;
+    uint32_t argc = randomBetween(1, 6);
+    temporaries[numTemporaries++] = benchRealloc(result, command,
+      NULL, (argc + 1) * sizeof(uint32_t));
+    temporaries[numTemporaries++] = benchRealloc(result, command,
+      NULL, randomBetween(8, 96));
+    temporaries[numTemporaries++] = benchRealloc(result, command,
+      NULL, randomBetween(16, 64));
+    temporaries[numTemporaries++] = benchRealloc(result, command,
+      NULL, EXFAT_NAME_SIZE);
+    temporaries[numTemporaries++] = benchRealloc(result, command,
+      NULL, EXFAT_NAME_SIZE);
+    temporaries[numTemporaries++] = benchRealloc(result, command,
+      NULL, 32);
+    if (randomBetween(0, 3) == 0) {
+      void *output = NULL;
+      for (size_t size = 16; size <= 256; size += 16) {
+        void *grown = benchRealloc(result, command, output, size);
+        if (grown == NULL) {
+          break;
+        }
+        output = grown;
+      }
+      temporaries[numTemporaries++] = output;
+    }
+
+    // Shuffle the temporaries so that they're not freed in LIFO order.
+    for (int ii = numTemporaries - 1; ii > 0; ii--) {
+      int jj = (int) randomBetween(0, ii);
+      void *swap = temporaries[ii];
+      temporaries[ii] = temporaries[jj];
+      temporaries[jj] = swap;
+    }
+
+    // Some commands leave something behind, like an environment variable, a
+    // history entry, or an open file.  It's allocated while the temporaries
+    // are still live, so it lands below them.
+    if (randomBetween(1, traceConfig->longLivedOdds) == 1) {
+      for (int ii = 0; ii < MAX_LONG_LIVED; ii++) {
+        if (longLived[ii].ptr == NULL) {
+          longLived[ii].ptr = benchRealloc(result, command,
+            NULL, randomBetween(16, 128));
+          longLived[ii].expires
+            = command + randomBetween(1, traceConfig->maxLifetime);
+          break;
+        }
+      }
+    }
+
+    for (int ii = 0; ii < numTemporaries; ii++) {
+      localFree(&heap, temporaries[ii]);
+    }
+  }
+  result->elapsed = nowNanoseconds() - startTime;
+  result->fragmentation = heapFragmentation();
+
+  for (int ii = 0; ii < MAX_LONG_LIVED; ii++) {
+    localFree(&heap, longLived[ii].ptr);
+  }
+}
+
+/// @fn static void fillAllocation(void *ptr, size_t size, TaskId pid)
+///
+/// @brief Fill an allocation with a pattern that identifies the task that owns
+/// it.
+///
+/// @param ptr The allocated memory.
+/// @param size The number of bytes to fill.
+/// @param pid The ID of the task that owns the memory.
+///
+/// @return This function returns no value.
+static void fillAllocation(void *ptr, size_t size, TaskId pid) {
+  memset(ptr, 0xa0 + pid, size);
+}
+
+/// @fn static bool allocationIntact(void *ptr, size_t size, TaskId pid)
+///
+/// @brief Check that an allocation still holds the pattern from
+/// fillAllocation.
+///
+/// @param ptr The allocated memory.
+/// @param size The number of bytes to check.
+/// @param pid The ID of the task that owns the memory.
+///
+/// @return Returns true if every byte still holds the pattern, false if not.
+static bool allocationIntact(void *ptr, size_t size, TaskId pid) {
+  for (size_t ii = 0; ii < size; ii++) {
+    if (((unsigned char*) ptr)[ii] != (unsigned char) (0xa0 + pid)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// @fn static int checkTaskMemory(void)
+///
+/// @brief Interleave the allocations of several tasks, hand some of them to
+/// another task the way the scheduler does, and repeatedly free everything a
+/// task owns the way the memory manager does when a task exits.  Every other
+/// task's memory must be left alone each time, and the heap must be empty
+/// once every task has exited.
+///
+/// @return Returns 0 on success, 1 on failure.
+static int checkTaskMemory(void) {
+  void *ptrs[NUM_CHECK_TASKS][NUM_CHECK_ALLOCATIONS];
+  size_t sizes[NUM_CHECK_TASKS][NUM_CHECK_ALLOCATIONS];
+  TaskId owners[NUM_CHECK_TASKS][NUM_CHECK_ALLOCATIONS];
+  memset(ptrs, 0, sizeof(ptrs));
+  randomState = 0x4e616e6f;
+  memset(heapStorage, HEAP_GUARD_BYTE, HEAP_GUARD_SIZE);
+  localInitializeHeap(&heap, ((char*) heapStorage) + sizeof(heapStorage),
+    sizeof(heapStorage) - HEAP_GUARD_SIZE);
+
+  for (int round = 0; round < NUM_CHECK_ROUNDS; round++) {
+    // Interleave the allocations so that every task's blocks end up next to
+    // everyone else's.
+    for (int ii = 0; ii < NUM_CHECK_ALLOCATIONS; ii++) {
+      for (int task = 0; task < NUM_CHECK_TASKS; task++) {
+        if (ptrs[task][ii] != NULL) {
+          continue;
+        }
+        TaskId pid = (TaskId) (BENCH_PID + task);
+        size_t size = (randomBetween(0, 3) == 0)
+          ? randomBetween(65, 160) : randomBetween(1, 64);
+        void *ptr = localRealloc(&heap, NULL, size, pid);
+        if (ptr == NULL) {
+          continue;
+        }
+        if (sizeOfMemory(ptr) < size) {
+          fprintf(stderr, "ERROR: %lu-byte allocation is only %lu bytes.\n",
+            (unsigned long) size, (unsigned long) sizeOfMemory(ptr));
+          return 1;
+        }
+        if (randomBetween(0, 7) == 0) {
+          // Give it to the next task the way the scheduler hands a message
+          // to its recipient.
+          pid = (TaskId) (BENCH_PID + ((task + 1) % NUM_CHECK_TASKS));
+          memNode(ptr)->owner = pid;
+        }
+        fillAllocation(ptr, size, pid);
+        ptrs[task][ii] = ptr;
+        sizes[task][ii] = size;
+        owners[task][ii] = pid;
+      }
+    }
+
+    // Grow a few allocations by less than a MemNode, which may extend them
+    // in place.
+    for (int task = 0; task < NUM_CHECK_TASKS; task++) {
+      int ii = (int) randomBetween(0, NUM_CHECK_ALLOCATIONS - 1);
+      if (ptrs[task][ii] == NULL) {
+        continue;
+      }
+      size_t size = sizes[task][ii] + randomBetween(1, sizeof(MemNode) - 1);
+      void *ptr = localRealloc(&heap, ptrs[task][ii], size, owners[task][ii]);
+      if (ptr != NULL) {
+        fillAllocation(ptr, size, owners[task][ii]);
+        ptrs[task][ii] = ptr;
+        sizes[task][ii] = size;
+      }
+    }
+
+    // Free a few allocations the normal way.
+    for (int task = 0; task < NUM_CHECK_TASKS; task++) {
+      int ii = (int) randomBetween(0, NUM_CHECK_ALLOCATIONS - 1);
+      localFree(&heap, ptrs[task][ii]);
+      ptrs[task][ii] = NULL;
+    }
+
+    // One task exits.
+    TaskId exiting = (TaskId) (BENCH_PID + (round % NUM_CHECK_TASKS));
+    localFreeTaskMemory(&heap, exiting);
+    for (int task = 0; task < NUM_CHECK_TASKS; task++) {
+      for (int ii = 0; ii < NUM_CHECK_ALLOCATIONS; ii++) {
+        if (ptrs[task][ii] == NULL) {
+          continue;
+        } else if (owners[task][ii] == exiting) {
+          ptrs[task][ii] = NULL;
+        } else if (!allocationIntact(
+          ptrs[task][ii], sizes[task][ii], owners[task][ii])
+        ) {
+          fprintf(stderr, "ERROR: Freeing the memory of task %d in round "
+            "%d overwrote memory owned by task %d.\n",
+            exiting, round, owners[task][ii]);
+          return 1;
+        }
+      }
+    }
+
+    for (int ii = 0; ii < HEAP_GUARD_SIZE; ii++) {
+      if (((unsigned char*) heapStorage)[ii] != HEAP_GUARD_BYTE) {
+        fprintf(stderr, "ERROR: Allocator wrote below the heap in round "
+          "%d.\n", round);
+        return 1;
+      }
+    }
+  }
+
+  for (int task = 0; task < NUM_CHECK_TASKS; task++) {
+    localFreeTaskMemory(&heap, (TaskId) (BENCH_PID + task));
+  }
+  if ((heap.mallocNext != (char*) heap.mallocStart)
+    || (heap.numFreeBlocks != 0)
+  ) {
+    fprintf(stderr, "ERROR: Heap not empty after every task exited.\n");
+    return 1;
+  }
+  printf("%-20s %d tasks, %d rounds of freeing an exiting task's memory\n",
+    "task ownership", NUM_CHECK_TASKS, NUM_CHECK_ROUNDS);
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  long numCommands = DEFAULT_NUM_COMMANDS;
+  if (argc > 1) {
+    numCommands = strtol(argv[1], NULL, 10);
+    if (numCommands < 1) {
+      fprintf(stderr, "Usage: %s [number of commands >= 1]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  static const TraceConfig traceConfigs[] = {
+    { .name = "interactive shell", .longLivedOdds = 16, .maxLifetime = 64 },
+    { .name = "long-running shell", .longLivedOdds = 4, .maxLifetime = 1000 },
+  };
+
+  printf("MEMORY_MANAGER_FIRST_FIT = %d, heap = %d bytes, "
+    "sizeof(MemNode) = %d\n", MEMORY_MANAGER_FIRST_FIT, HEAP_SIZE,
+    (int) sizeof(MemNode));
+  for (size_t ii = 0; ii < sizeof(traceConfigs) / sizeof(traceConfigs[0]);
+    ii++
+  ) {
+    TraceResult result;
+    replayTrace(&traceConfigs[ii], numCommands, &result);
+    printf("%-20s %8ld allocs %8ld failed  first failure at %6ld  "
+      "peak %5lu bytes  frag %3d%%  %6.1f ns/alloc\n",
+      traceConfigs[ii].name, result.numAllocations, result.numFailures,
+      result.firstFailure, (unsigned long) result.peakHeapUsed,
+      result.fragmentation,
+      ((double) result.elapsed) / ((double) result.numAllocations));
+
+    // Everything has been freed, so the heap should be back to empty.
+    if ((heap.mallocNext != (char*) heap.mallocStart)
+      || (heap.numFreeBlocks != 0)
+    ) {
+      fprintf(stderr, "ERROR: Heap not empty after the %s trace.\n",
+        traceConfigs[ii].name);
+      return 1;
+    }
+  }
+
+  return checkTaskMemory();
+}
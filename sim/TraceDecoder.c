@@ -0,0 +1,339 @@
+///////////////////////////////////////////////////////////////////////////////
+///
+/// @author            James Card
+/// @date              10.15.2026
+///
+/// @file              TraceDecoder.c
+///
+/// @brief             Host-side tool that converts a scheduler trace written
+///                    by the simulator into Chrome trace / Perfetto JSON.
+///
+/// @copyright
+///                   Copyright (c) 2012-2025 James Card
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a
+/// copy of this software and associated documentation files (the "Software"),
+/// to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+/// and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included
+/// in all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+/// DEALINGS IN THE SOFTWARE.
+///
+///                                James Card
+///                         http://www.jamescard.org
+///
+///////////////////////////////////////////////////////////////////////////////
+
+// Standard C includes
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// NanoOs includes
+#include "SchedulerTrace.h"
+
+/// @def MAX_PENDING_MESSAGES
+///
+/// @brief The maximum number of pushed-but-not-yet-popped messages that are
+/// tracked for drawing flow arrows.  Pushes beyond this are still shown, just
+/// without an arrow to their pop.
+#define MAX_PENDING_MESSAGES 256
+
+/// @struct PendingMessage
+///
+/// @brief A message push that hasn't been matched to a pop yet.
+///
+/// @param flowId The ID of the flow event emitted for the push.
+/// @param to The ID of the destination task.
+/// @param type The type of the message.
+typedef struct PendingMessage {
+  uint32_t flowId;
+  uint8_t  to;
+  uint16_t type;
+} PendingMessage;
+
+/// @var endReasons
+///
+/// @brief The reason strings for the events that end a run slice, indexed by
+/// TraceEventType.  NULL for events that don't end a slice.
+static const char *endReasons[NUM_TRACE_EVENT_TYPES] = {
+  [TRACE_TASK_YIELD] = "yield",
+  [TRACE_TASK_PREEMPT] = "preempt",
+  [TRACE_TASK_BLOCK_COMUTEX] = "block on comutex",
+  [TRACE_TASK_BLOCK_COCONDITION] = "block on cocondition",
+  [TRACE_TASK_EXIT] = "exit",
+};
+
+/// @var firstEvent
+///
+/// @brief Whether or not the next JSON event written is the first one.  Used
+/// to get the commas right.
+static bool firstEvent = true;
+
+/// @fn static void beginEvent(FILE *output)
+///
+/// @brief Start a new element of the traceEvents array.
+///
+/// @param output The stream the JSON is being written to.
+///
+/// @return This function returns no value.
+static void beginEvent(FILE *output) {
+  fputs(firstEvent ? "\n  " : ",\n  ", output);
+  firstEvent = false;
+}
+
+/// @fn static void writeJsonString(FILE *output, const char *string)
+///
+/// @brief Write a string as a quoted JSON string, escaping anything that needs
+/// it.
+///
+/// @param output The stream the JSON is being written to.
+/// @param string The string to write.
+///
+/// @return This function returns no value.
+static void writeJsonString(FILE *output, const char *string) {
+  fputc('"', output);
+  for (; *string != '\0'; string++) {
+    if ((*string == '"') || (*string == '\\')) {
+      fputc('\\', output);
+      fputc(*string, output);
+    } else if ((unsigned char) *string < 0x20) {
+      fprintf(output, "\\u%04x", (unsigned char) *string);
+    } else {
+      fputc(*string, output);
+    }
+  }
+  fputc('"', output);
+}
+
+/// @fn static void usage(const char *argv0)
+///
+/// @brief Print the usage message for the program.
+///
+/// @param argv0 The name the program was invoked as.
+///
+/// @return This function returns no value.
+static void usage(const char *argv0) {
+  const char *programName = strrchr(argv0, '/');
+  if (programName != NULL) {
+    programName++;
+  } else {
+    programName = argv0;
+  }
+
+  fprintf(stderr, "Usage: %s <trace file> [<output JSON file>]\n",
+    programName);
+}
+
+int main(int argc, char **argv) {
+  if ((argc < 2) || (argc > 3)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  FILE *input = fopen(argv[1], "rb");
+  if (input == NULL) {
+    fprintf(stderr, "ERROR: Could not open \"%s\" for reading.\n", argv[1]);
+    return 1;
+  }
+
+  TraceFileHeader header;
+  if ((fread(&header, sizeof(header), 1, input) != 1)
+    || (memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic)) != 0)
+  ) {
+    fprintf(stderr, "ERROR: \"%s\" is not a NanoOs trace file.\n", argv[1]);
+    fclose(input);
+    return 1;
+  } else if (header.version != TRACE_FILE_VERSION) {
+    fprintf(stderr, "ERROR: Unsupported trace file version %u.\n",
+      (unsigned int) header.version);
+    fclose(input);
+    return 1;
+  }
+
+  // Task IDs are uint8_t values, so 256 entries covers everything.
+  char taskNames[256][TRACE_TASK_NAME_LENGTH] = {{0}};
+  for (uint32_t ii = 0; ii < header.numTasks; ii++) {
+    TraceTaskName taskName;
+    if (fread(&taskName, sizeof(taskName), 1, input) != 1) {
+      fprintf(stderr, "ERROR: Truncated task name table.\n");
+      fclose(input);
+      return 1;
+    }
+    taskName.name[TRACE_TASK_NAME_LENGTH - 1] = '\0';
+    memcpy(taskNames[taskName.taskId], taskName.name, TRACE_TASK_NAME_LENGTH);
+  }
+
+  TraceEvent *events = NULL;
+  if (header.numEvents > 0) {
+    events = (TraceEvent*) malloc(header.numEvents * sizeof(TraceEvent));
+    if (events == NULL) {
+      fprintf(stderr, "ERROR: Could not allocate memory for %u events.\n",
+        (unsigned int) header.numEvents);
+      fclose(input);
+      return 1;
+    }
+    if (fread(events, sizeof(TraceEvent), header.numEvents, input)
+      != header.numEvents
+    ) {
+      fprintf(stderr, "ERROR: Truncated event list.\n");
+      free(events);
+      fclose(input);
+      return 1;
+    }
+  }
+  fclose(input);
+
+  FILE *output = stdout;
+  if (argc == 3) {
+    output = fopen(argv[2], "w");
+    if (output == NULL) {
+      fprintf(stderr, "ERROR: Could not open \"%s\" for writing.\n", argv[2]);
+      free(events);
+      return 1;
+    }
+  }
+
+  fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", output);
+
+  beginEvent(output);
+  fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+    "\"args\":{\"name\":\"NanoOs\"}}", output);
+  for (int ii = 1; ii < 256; ii++) {
+    if (taskNames[ii][0] == '\0') {
+      continue;
+    }
+    char threadName[TRACE_TASK_NAME_LENGTH + 8];
+    snprintf(threadName, sizeof(threadName), "%d %s", ii, taskNames[ii]);
+    beginEvent(output);
+    fprintf(output, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+      "\"tid\":%d,\"args\":{\"name\":", ii);
+    writeJsonString(output, threadName);
+    fputs("}}", output);
+  }
+
+  bool running[256] = {false};
+  PendingMessage pending[MAX_PENDING_MESSAGES];
+  int numPending = 0;
+  uint32_t nextFlowId = 1;
+  int64_t baseTime = (header.numEvents > 0) ? events[0].timestamp : 0;
+  double lastTs = 0.0;
+
+  for (uint32_t ii = 0; ii < header.numEvents; ii++) {
+    TraceEvent *event = &events[ii];
+    int tid = event->taskId;
+    // Chrome trace timestamps are in microseconds.
+    double ts = ((double) (event->timestamp - baseTime)) / 1000.0;
+    lastTs = ts;
+
+    switch (event->type) {
+      case TRACE_TASK_RESUME:
+        beginEvent(output);
+        fprintf(output, "{\"name\":\"run\",\"ph\":\"B\",\"pid\":1,"
+          "\"tid\":%d,\"ts\":%.3f}", tid, ts);
+        running[tid] = true;
+        break;
+
+      case TRACE_TASK_YIELD:
+      case TRACE_TASK_PREEMPT:
+      case TRACE_TASK_BLOCK_COMUTEX:
+      case TRACE_TASK_BLOCK_COCONDITION:
+      case TRACE_TASK_EXIT:
+        if (running[tid] == false) {
+          // The matching resume was overwritten in the ring buffer.
+          break;
+        }
+        beginEvent(output);
+        fprintf(output, "{\"ph\":\"E\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+          "\"args\":{\"reason\":\"%s\"}}", tid, ts, endReasons[event->type]);
+        running[tid] = false;
+        break;
+
+      case TRACE_MESSAGE_PUSH:
+        beginEvent(output);
+        fprintf(output, "{\"name\":\"push %u\",\"ph\":\"i\",\"s\":\"t\","
+          "\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+          "\"args\":{\"type\":%u,\"to\":%u}}",
+          event->arg, tid, ts, event->arg, event->peerId);
+        if (numPending < MAX_PENDING_MESSAGES) {
+          pending[numPending].flowId = nextFlowId;
+          pending[numPending].to = event->peerId;
+          pending[numPending].type = event->arg;
+          numPending++;
+          beginEvent(output);
+          fprintf(output, "{\"name\":\"message\",\"cat\":\"message\","
+            "\"ph\":\"s\",\"id\":%u,\"pid\":1,\"tid\":%d,\"ts\":%.3f}",
+            (unsigned int) nextFlowId, tid, ts);
+          nextFlowId++;
+        }
+        break;
+
+      case TRACE_MESSAGE_POP:
+        beginEvent(output);
+        fprintf(output, "{\"name\":\"pop %u\",\"ph\":\"i\",\"s\":\"t\","
+          "\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"type\":%u}}",
+          event->arg, tid, ts, event->arg);
+        // Match the oldest outstanding push of this type to this task.
+        for (int jj = 0; jj < numPending; jj++) {
+          if ((pending[jj].to == tid) && (pending[jj].type == event->arg)) {
+            beginEvent(output);
+            fprintf(output, "{\"name\":\"message\",\"cat\":\"message\","
+              "\"ph\":\"f\",\"bp\":\"e\",\"id\":%u,\"pid\":1,\"tid\":%d,"
+              "\"ts\":%.3f}", (unsigned int) pending[jj].flowId, tid, ts);
+            numPending--;
+            memmove(&pending[jj], &pending[jj + 1],
+              (numPending - jj) * sizeof(PendingMessage));
+            break;
+          }
+        }
+        break;
+
+      case TRACE_TASK_CREATE:
+        beginEvent(output);
+        fprintf(output, "{\"name\":\"create\",\"ph\":\"i\",\"s\":\"t\","
+          "\"pid\":1,\"tid\":%d,\"ts\":%.3f}", tid, ts);
+        break;
+
+      default:
+        fprintf(stderr, "WARNING: Skipping unknown event type %u.\n",
+          event->type);
+        break;
+    }
+  }
+
+  // Close out anything that was still running when the trace was written.
+  for (int ii = 0; ii < 256; ii++) {
+    if (running[ii]) {
+      beginEvent(output);
+      fprintf(output, "{\"ph\":\"E\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}",
+        ii, lastTs);
+    }
+  }
+
+  fputs("\n]}\n", output);
+
+  if (header.numDropped > 0) {
+    fprintf(stderr, "%u older events were overwritten before the trace was "
+      "written.\n", (unsigned int) header.numDropped);
+  }
+
+  if (output != stdout) {
+    fclose(output);
+  }
+  free(events);
+
+  return 0;
+}
+
@@ -872,6 +872,20 @@ int arduinoNano33IotCancelAndGetTimer(int timer,
   return 0;
 }
 
+int arduinoNano33IotWaitForEvent(int64_t nanoseconds) {
+  // SysTick fires every millisecond, so we will never sleep longer than that.
+  // The scheduler will call us again if there's still nothing to do, so
+  // there's no need to configure a wakeup for the deadline.
+  (void) nanoseconds;
+  
+  // Regular (not deep) sleep so that the serial port can wake us.
+  SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+  
+  __DSB(); // Data Synchronization Barrier
+  __WFI(); // Wait For Interrupt
+  return 0;
+}
+
 /// @fn void arduinoNano33IotTimerInterruptHandler(int timer)
 ///
 /// @brief Base implementation for the Timer/Counter interrupt handlers.
@@ -990,6 +1004,9 @@ static Hal arduinoNano33IotHal = {
   .remainingTimerNanoseconds = arduinoNano33IotRemainingTimerNanoseconds,
   .cancelTimer = arduinoNano33IotCancelTimer,
   .cancelAndGetTimer = arduinoNano33IotCancelAndGetTimer,
+  
+  // Power management.
+  .waitForEvent = arduinoNano33IotWaitForEvent,
 };
 
 const Hal* halArduinoNano33IotInit(void) {
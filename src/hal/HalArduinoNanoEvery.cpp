@@ -508,6 +508,12 @@ int arduinoNanoEveryCancelAndGetTimer(int timer,
   return -ENOTSUP;
 }
 
+int arduinoNanoEveryWaitForEvent(int64_t nanoseconds) {
+  (void) nanoseconds;
+  
+  return -ENOTSUP;
+}
+
 /// @var arduinoNanoEveryHal
 ///
 /// @brief The implementation of the Hal interface for the Arduino Nano Every.
@@ -561,6 +567,9 @@ static Hal arduinoNanoEveryHal = {
   .remainingTimerNanoseconds = arduinoNanoEveryRemainingTimerNanoseconds,
   .cancelTimer = arduinoNanoEveryCancelTimer,
   .cancelAndGetTimer = arduinoNanoEveryCancelAndGetTimer,
+  
+  // Power management.
+  .waitForEvent = arduinoNanoEveryWaitForEvent,
 };
 
 const Hal* halArduinoNanoEveryInit(void) {
@@ -40,6 +40,7 @@
 #include <signal.h>
 #include <stdio.h>
 #include <sys/mman.h>
+#include <sys/select.h>
 #include </usr/include/time.h>
 #include <termios.h>
 #include <unistd.h>
@@ -49,8 +50,12 @@
 #include "kernel/ExFatTask.h"
 #include "kernel/MemoryManager.h"
 #include "kernel/NanoOs.h"
+#include "kernel/Scheduler.h"
 #include "kernel/Tasks.h"
 
+// Scheduler.h redefines FILE for the kernel.  We need the host's.
+#undef FILE
+
 /// @def PROCESS_STACK_SIZE
 ///
 /// @brief The size, in bytes, of a regular process's stack.
@@ -163,6 +168,10 @@ int posixInitSerialPort(int port, int32_t baud) {
     return -errno;
   }
   
+  // stdin must also be unbuffered.  posixWaitForEvent waits on the file
+  // descriptor, so it can't see any bytes that are sitting in stdio's buffer.
+  setvbuf(stdin, NULL, _IONBF, 0);
+  
   // We manage all the prints to screen ourselves, so disable stdin echoing
   // as well.
   struct termios oldFlags = {0};
@@ -309,7 +318,109 @@ int posixReset(void) {
   return 0;
 }
 
+#if SCHEDULER_TRACE_NUM_EVENTS > 0
+
+/// @var _traceFilePath
+///
+/// @brief Path of the file the scheduler trace is written to.  Taken from the
+/// NANO_OS_TRACE_FILE environment variable at startup if it's set.
+static const char *_traceFilePath = "nano-os-trace.bin";
+
+/// @fn static void posixWriteTrace(void)
+///
+/// @brief Write the scheduler's trace buffer to _traceFilePath in the format
+/// described in SchedulerTrace.h.  Only async-signal-safe calls are used so
+/// that this can be called from a signal handler.  The scheduler is not
+/// stopped while the file is written, so the most recent event may be torn if
+/// this interrupts it mid-record.
+///
+/// @return This function returns no value.
+static void posixWriteTrace(void) {
+  static const char writtenMessage[] = "Scheduler trace written.\n";
+  const TraceBuffer *trace = schedulerGetTrace();
+  if (trace == NULL) {
+    // Scheduler hasn't started yet.  Nothing to write.
+    return;
+  }
+
+  int fd = open(_traceFilePath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return;
+  }
+
+  uint32_t numEvents = trace->numEvents;
+  uint32_t numKept = (numEvents < SCHEDULER_TRACE_NUM_EVENTS)
+    ? numEvents : SCHEDULER_TRACE_NUM_EVENTS;
+  TraceFileHeader header = {
+    .version = TRACE_FILE_VERSION,
+    .numTasks = NANO_OS_NUM_TASKS,
+    .numEvents = numKept,
+    .numDropped = numEvents - numKept,
+  };
+  memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+  if (write(fd, &header, sizeof(header)) != sizeof(header)) {
+    goto exit;
+  }
+
+  for (TaskId ii = 1; ii <= NANO_OS_NUM_TASKS; ii++) {
+    TraceTaskName taskName = { .taskId = ii };
+    const char *name = schedulerGetTaskByPid(ii)->name;
+    for (int jj = 0;
+      (name != NULL) && (name[jj] != '\0')
+        && (jj < (TRACE_TASK_NAME_LENGTH - 1));
+      jj++
+    ) {
+      taskName.name[jj] = name[jj];
+    }
+    if (write(fd, &taskName, sizeof(taskName)) != sizeof(taskName)) {
+      goto exit;
+    }
+  }
+
+  // The oldest event is the one that will be overwritten next.  Write from
+  // there to the end of the array and then wrap around to the beginning.
+  uint32_t start = (numEvents - numKept) & (SCHEDULER_TRACE_NUM_EVENTS - 1);
+  uint32_t firstChunk = SCHEDULER_TRACE_NUM_EVENTS - start;
+  if (firstChunk > numKept) {
+    firstChunk = numKept;
+  }
+  ssize_t size = firstChunk * sizeof(TraceEvent);
+  if (write(fd, &trace->events[start], size) != size) {
+    goto exit;
+  }
+  size = (numKept - firstChunk) * sizeof(TraceEvent);
+  if (write(fd, &trace->events[0], size) != size) {
+    goto exit;
+  }
+
+  if (write(STDERR_FILENO, writtenMessage, sizeof(writtenMessage) - 1) < 0) {
+    // Nothing else we can do.
+  }
+
+exit:
+  close(fd);
+}
+
+/// @fn void traceSignalHandler(int signal)
+///
+/// @brief signal-compliant function that writes out the scheduler trace on
+/// demand.
+///
+/// @param signal Integer value of the signal being raised.  Always SIGQUIT in
+///   this case.  The parameter is ignored by this function.
+///
+/// @return This function returns no value.
+void traceSignalHandler(int signal) {
+  (void) signal; // We know this is SIGQUIT, so no need to check it.
+  posixWriteTrace();
+}
+
+#endif // SCHEDULER_TRACE_NUM_EVENTS
+
 int posixShutdown(void) {
+#if SCHEDULER_TRACE_NUM_EVENTS > 0
+  posixWriteTrace();
+#endif // SCHEDULER_TRACE_NUM_EVENTS
   exit(0);
   return 0;
 }
@@ -368,8 +479,6 @@ static pthread_t _mainThreadId = 0;
 ///
 /// @brief Collection of variables needed to manage a software timer.
 ///
-/// @param timerThread The pthread_t of the thread that is serving as the timer
-///   if the timer is active.
 /// @param signal The signal number that is to be sent to the main thread when
 ///   the timer expires.
 /// @param signalHandler Function pointer to the signal handler function that
@@ -379,8 +488,12 @@ static pthread_t _mainThreadId = 0;
 /// @param active Whether or not the timer is currently active.
 /// @param startTime The time, in nanoseconds, when the timer was configured.
 /// @param deadline The time, in nanoseconds, when the timer expires.
+/// @param generation Counter that is incremented every time the timer is
+///   configured or cancelled.  Used to discard expirations that were already
+///   in flight when the timer was re-armed or cancelled.
+/// @param firedGeneration The value of generation at the time the timer
+///   service thread last expired the timer.
 typedef struct SoftwareTimer {
-  pthread_t timerThread;
   int signal;
   void (*signalHandler)(int);
   bool initialized;
@@ -388,35 +501,115 @@ typedef struct SoftwareTimer {
   bool active;
   int64_t startTime;
   int64_t deadline;
+  volatile uint32_t generation;
+  volatile uint32_t firedGeneration;
 } SoftwareTimer;
 
+/// @def NUM_SOFTWARE_TIMERS
+///
+/// @brief The number of SoftwareTimer objects in the softwareTimers array.
+#define NUM_SOFTWARE_TIMERS 2
+
 /// Forward declaration
-extern SoftwareTimer softwareTimers[];
+extern SoftwareTimer softwareTimers[NUM_SOFTWARE_TIMERS];
+
+/// @var _timerMutex
+///
+/// @brief Mutex that guards the active and deadline members of the
+/// softwareTimers array and the _timerWakeTime variable.
+static pthread_mutex_t _timerMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/// @var _timerCondition
+///
+/// @brief Condition used to wake the timer service thread when a timer is
+/// armed with a deadline earlier than the one the thread is sleeping on.
+static pthread_cond_t _timerCondition = PTHREAD_COND_INITIALIZER;
+
+/// @var _timerThread
+///
+/// @brief The pthread_t of the single, long-lived timer service thread.
+static pthread_t _timerThread;
+
+/// @var _timerThreadStarted
+///
+/// @brief Whether or not the timer service thread has been started yet.
+static bool _timerThreadStarted = false;
+
+/// @var _timerWakeTime
+///
+/// @brief The time, in nanoseconds, that the timer service thread will next
+/// wake up on its own.  INT64_MAX if it is waiting indefinitely.
+static int64_t _timerWakeTime = INT64_MAX;
 
 /// @fn void* timerThreadFunction(void *arg)
 ///
-/// @brief pthread-compatible function to wait for a specified amount of time
-/// before sending a signal to the main thread.  This function runs on its own
-/// thread.
+/// @brief pthread-compatible function that services all of the software
+/// timers.  It sleeps until the earliest active deadline, sends the timer's
+/// signal to the main thread for every timer that has expired, and goes back
+/// to sleep.  This function runs on its own thread for the life of the
+/// program.
 ///
-/// @param arg The index of the timer to use for configuration, cast to a
-///   void*.
+/// @param arg Unused.
 ///
-/// @return This function always succeeds if it completes and always returns
-/// NULL.
+/// @return This function never returns.
 void* timerThreadFunction(void *arg) {
-  intptr_t timer = (intptr_t) arg;
-  
-  SoftwareTimer *swTimer = &softwareTimers[timer];
-  int64_t delay = swTimer->deadline - swTimer->startTime;
-  struct timespec ts = {
-    .tv_sec = delay / ((int64_t) 1000000000),
-    .tv_nsec = delay % ((int64_t) 1000000000),
-  };
-  nanosleep(&ts, NULL);
-  if (swTimer->active) {
-    // Send the specified signal to the main thread.
-    pthread_kill(_mainThreadId, swTimer->signal);
+  (void) arg;
+  int numTimers = NUM_SOFTWARE_TIMERS;
+  
+  // The timer and trace signals are only meant for the main thread.
+  sigset_t signalMask;
+  sigemptyset(&signalMask);
+  for (int ii = 0; ii < numTimers; ii++) {
+    sigaddset(&signalMask, softwareTimers[ii].signal);
+  }
+#if SCHEDULER_TRACE_NUM_EVENTS > 0
+  sigaddset(&signalMask, SIGQUIT);
+#endif // SCHEDULER_TRACE_NUM_EVENTS
+  pthread_sigmask(SIG_BLOCK, &signalMask, NULL);
+  
+  pthread_mutex_lock(&_timerMutex);
+  while (1) {
+    int64_t now = posixGetElapsedNanoseconds(0);
+    int64_t wakeTime = INT64_MAX;
+    int expiredSignals[numTimers];
+    int numExpired = 0;
+    
+    for (int ii = 0; ii < numTimers; ii++) {
+      SoftwareTimer *swTimer = &softwareTimers[ii];
+      if (!swTimer->active) {
+        continue;
+      }
+      
+      if (swTimer->deadline <= now) {
+        swTimer->active = false;
+        swTimer->firedGeneration = swTimer->generation;
+        expiredSignals[numExpired++] = swTimer->signal;
+      } else if (swTimer->deadline < wakeTime) {
+        wakeTime = swTimer->deadline;
+      }
+    }
+    
+    if (numExpired > 0) {
+      // Don't hold the lock while we interrupt the main thread.  It may be in
+      // the middle of configuring a timer.
+      pthread_mutex_unlock(&_timerMutex);
+      for (int ii = 0; ii < numExpired; ii++) {
+        pthread_kill(_mainThreadId, expiredSignals[ii]);
+      }
+      pthread_mutex_lock(&_timerMutex);
+      continue;
+    }
+    
+    _timerWakeTime = wakeTime;
+    if (wakeTime == INT64_MAX) {
+      pthread_cond_wait(&_timerCondition, &_timerMutex);
+    } else {
+      struct timespec ts = {
+        .tv_sec = wakeTime / ((int64_t) 1000000000),
+        .tv_nsec = wakeTime % ((int64_t) 1000000000),
+      };
+      pthread_cond_timedwait(&_timerCondition, &_timerMutex, &ts);
+    }
   }
   
   return NULL;
@@ -433,10 +626,11 @@ void* timerThreadFunction(void *arg) {
 void timerSignalHandler(int timer) {
   SoftwareTimer *swTimer = &softwareTimers[timer];
   
-  swTimer->active = false;
-  swTimer->timerThread = 0;
-  swTimer->startTime = 0;
-  swTimer->deadline = 0;
+  if (swTimer->firedGeneration != swTimer->generation) {
+    // The timer was re-armed or cancelled after the service thread expired it
+    // but before the signal was delivered.  This expiration is stale.
+    return;
+  }
   
   // Call callback if set
   if (swTimer->callback) {
@@ -477,9 +671,8 @@ void timer1SignalHandler(int signal) {
 /// @var softwareTimers
 ///
 /// @brief Array of SoftwareTimer objects managed by the HAL.
-SoftwareTimer softwareTimers[] = {
+SoftwareTimer softwareTimers[NUM_SOFTWARE_TIMERS] = {
   {
-    .timerThread = 0,
     .signal = SIGUSR1,
     .signalHandler = timer0SignalHandler,
     .initialized = false,
@@ -487,9 +680,10 @@ SoftwareTimer softwareTimers[] = {
     .active = false,
     .startTime = 0,
     .deadline = 0,
+    .generation = 0,
+    .firedGeneration = 0,
   },
   {
-    .timerThread = 1,
     .signal = SIGUSR2,
     .signalHandler = timer1SignalHandler,
     .initialized = false,
@@ -497,6 +691,8 @@ SoftwareTimer softwareTimers[] = {
     .active = false,
     .startTime = 0,
     .deadline = 0,
+    .generation = 0,
+    .firedGeneration = 0,
   },
 };
 
@@ -539,6 +735,15 @@ int posixInitTimer(int timer) {
   signal(swTimer->signal, swTimer->signalHandler);
   swTimer->initialized = true;
   
+  if (!_timerThreadStarted) {
+    if (pthread_create(&_timerThread, NULL, timerThreadFunction, NULL) != 0) {
+      swTimer->initialized = false;
+      return -EAGAIN;
+    }
+    pthread_detach(_timerThread);
+    _timerThreadStarted = true;
+  }
+  
   return 0;
 }
 
@@ -554,15 +759,24 @@ int posixConfigOneShotTimer(int timer,
     return -EINVAL;
   }
   
+  int64_t now = posixGetElapsedNanoseconds(0);
+  
+  pthread_mutex_lock(&_timerMutex);
+  swTimer->generation++;
   swTimer->callback = callback;
   swTimer->active = true;
-  swTimer->startTime = posixGetElapsedNanoseconds(0);
-  swTimer->deadline = swTimer->startTime + nanoseconds;
-  pthread_create(&swTimer->timerThread, NULL,
-    timerThreadFunction, (void*) ((intptr_t) timer));
-  pthread_detach(swTimer->timerThread);
+  swTimer->startTime = now;
+  swTimer->deadline = now + nanoseconds;
+  if (swTimer->deadline < _timerWakeTime) {
+    // The service thread is sleeping past our deadline.  Wake it up so that it
+    // can recompute.  Otherwise, it will see our deadline on its next pass and
+    // there's no need to make the system call.
+    _timerWakeTime = swTimer->deadline;
+    pthread_cond_signal(&_timerCondition);
+  }
+  pthread_mutex_unlock(&_timerMutex);
   
-  return -ENOTSUP;
+  return 0;
 }
 
 uint64_t posixConfiguredTimerNanoseconds(int timer) {
@@ -606,17 +820,15 @@ int posixCancelTimer(int timer) {
     return -EINVAL;
   }
   
-  bool active = swTimer->active;
+  // There's no need to wake the service thread.  If it's sleeping on our
+  // deadline, it will wake up, find nothing to do, and go back to sleep.
+  pthread_mutex_lock(&_timerMutex);
+  swTimer->generation++;
   swTimer->active = false;
-  
-  if (active) {
-    pthread_cancel(swTimer->timerThread);
-  }
-  
-  swTimer->timerThread = 0;
   swTimer->startTime = 0;
   swTimer->deadline = 0;
   swTimer->callback = NULL;
+  pthread_mutex_unlock(&_timerMutex);
   
   return 0;
 }
@@ -645,13 +857,10 @@ int posixCancelAndGetTimer(int timer,
   // function is in the critical path.  Time is of the essence, so inline the
   // logic.
   
-  bool active = swTimer->active;
+  pthread_mutex_lock(&_timerMutex);
+  swTimer->generation++;
   swTimer->active = false;
   
-  if (active) {
-    pthread_cancel(swTimer->timerThread);
-  }
-  
   if (configuredNanoseconds != NULL) {
     if (swTimer->deadline > swTimer->startTime) {
       *configuredNanoseconds = swTimer->deadline - swTimer->startTime;
@@ -672,10 +881,34 @@ int posixCancelAndGetTimer(int timer,
     *callback = swTimer->callback;
   }
   
-  swTimer->active = false;
   swTimer->startTime = 0;
   swTimer->deadline = 0;
   swTimer->callback = NULL;
+  pthread_mutex_unlock(&_timerMutex);
+  
+  return 0;
+}
+
+int posixWaitForEvent(int64_t nanoseconds) {
+  fd_set readFds;
+  FD_ZERO(&readFds);
+  FD_SET(0, &readFds);
+  
+  struct timespec ts;
+  struct timespec *timeout = NULL;
+  if (nanoseconds >= 0) {
+    ts.tv_sec = nanoseconds / ((int64_t) 1000000000);
+    ts.tv_nsec = nanoseconds % ((int64_t) 1000000000);
+    timeout = &ts;
+  }
+  
+  // Serial input makes stdin readable and the timers interrupt us with their
+  // signals, so either one will wake us up.
+  if ((pselect(1, &readFds, NULL, NULL, timeout, NULL) < 0)
+    && (errno != EINTR)
+  ) {
+    return -errno;
+  }
   
   return 0;
 }
@@ -733,6 +966,9 @@ static Hal posixHal = {
   .remainingTimerNanoseconds = posixRemainingTimerNanoseconds,
   .cancelTimer = posixCancelTimer,
   .cancelAndGetTimer = posixCancelAndGetTimer,
+  
+  // Power management.
+  .waitForEvent = posixWaitForEvent,
 };
 
 const Hal* halPosixInit(jmp_buf resetBuffer, const char *sdCardDevicePath) {
@@ -781,6 +1017,16 @@ const Hal* halPosixInit(jmp_buf resetBuffer, const char *sdCardDevicePath) {
   
   _mainThreadId = pthread_self();
   
+#if SCHEDULER_TRACE_NUM_EVENTS > 0
+  // Write the scheduler trace on SIGQUIT (Ctrl-\ from the console) as well as
+  // at shutdown.
+  const char *traceFilePath = getenv("NANO_OS_TRACE_FILE");
+  if ((traceFilePath != NULL) && (*traceFilePath != '\0')) {
+    _traceFilePath = traceFilePath;
+  }
+  signal(SIGQUIT, traceSignalHandler);
+#endif // SCHEDULER_TRACE_NUM_EVENTS
+  
   return &posixHal;
 }
 
@@ -0,0 +1,163 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                     Copyright (c) 2012-2025 James Card                     //
+//                                                                            //
+// Permission is hereby granted, free of charge, to any person obtaining a    //
+// copy of this software and associated documentation files (the "Software"), //
+// to deal in the Software without restriction, including without limitation  //
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,   //
+// and/or sell copies of the Software, and to permit persons to whom the      //
+// Software is furnished to do so, subject to the following conditions:       //
+//                                                                            //
+// The above copyright notice and this permission notice shall be included    //
+// in all copies or substantial portions of the Software.                     //
+//                                                                            //
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR //
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   //
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    //
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER //
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING    //
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER        //
+// DEALINGS IN THE SOFTWARE.                                                  //
+//                                                                            //
+//                                 James Card                                 //
+//                          http://www.jamescard.org                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Doxygen marker
+/// @file
+
+// NanoOs includes
+#include "Arena.h"
+#include "MemoryManager.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// @def ARENA_OVERFLOW_HEADER_SIZE
+///
+/// @brief The number of bytes in front of an allocation borrowed from the heap.
+/// Rounded up so that the allocation is 8-byte aligned.
+#define ARENA_OVERFLOW_HEADER_SIZE \
+  ((sizeof(ArenaOverflow) + 7) & ~((size_t) 7))
+
+/// @fn int arenaInit(Arena *arena, size_t size)
+///
+/// @brief Reserve the region of memory for an arena.  This is the only
+/// allocation the arena makes from the heap unless the region fills up.
+///
+/// @param arena A pointer to the Arena to initialize.
+/// @param size The number of bytes to reserve.  May be 0, in which case every
+///   allocation is borrowed from the heap.
+///
+/// @return Returns 0 on success, -1 if the memory could not be reserved.  The
+/// arena is still safe to use on failure.  Every allocation from it is
+/// borrowed from the heap.
+int arenaInit(Arena *arena, size_t size) {
+  arena->used = 0;
+  arena->overflow = NULL;
+  arena->size = 0;
+  arena->buffer = NULL;
+  if (size == 0) {
+    return 0;
+  }
+  
+  arena->buffer = (char*) malloc(size);
+  if (arena->buffer == NULL) {
+    return -1;
+  }
+  arena->size = size;
+  
+  return 0;
+}
+
+/// @fn size_t arenaBegin(Arena *arena)
+///
+/// @brief Start a scope of allocations.  Scopes nest, so a function that uses
+/// the arena may call other functions that do too.
+///
+/// @param arena A pointer to the Arena to allocate from.
+///
+/// @return Returns a mark to pass to arenaEnd to release everything allocated
+/// in the scope.
+size_t arenaBegin(Arena *arena) {
+  return arena->used;
+}
+
+/// @fn void* arenaAlloc(Arena *arena, size_t size)
+///
+/// @brief Allocate memory from an arena.  The memory is not initialized.
+///
+/// @param arena A pointer to the Arena to allocate from.
+/// @param size The number of bytes to allocate.
+///
+/// @return Returns a pointer to 8-byte aligned memory on success, NULL if
+/// size is 0 or the memory could not be borrowed from the heap.
+void* arenaAlloc(Arena *arena, size_t size) {
+  size = (size + 7) & ~((size_t) 7);
+  if (size == 0) {
+    return NULL;
+  }
+  
+  if ((arena->used <= arena->size) && (size <= arena->size - arena->used)) {
+    void *returnValue = &arena->buffer[arena->used];
+    arena->used += size;
+    return returnValue;
+  }
+  
+  // Doesn't fit.  Borrow it from the heap.  used still advances past size so
+  // that the marks of everything allocated after this stay in order.
+  ArenaOverflow *overflow
+    = (ArenaOverflow*) malloc(ARENA_OVERFLOW_HEADER_SIZE + size);
+  if (overflow == NULL) {
+    return NULL;
+  }
+  overflow->mark = arena->used;
+  overflow->next = arena->overflow;
+  arena->overflow = overflow;
+  arena->used += size;
+  
+  return ((char*) overflow) + ARENA_OVERFLOW_HEADER_SIZE;
+}
+
+/// @fn void arenaEnd(Arena *arena, size_t mark)
+///
+/// @brief End a scope of allocations, releasing everything that was allocated
+/// since the arenaBegin call that returned the mark.
+///
+/// @param arena A pointer to the Arena to release memory in.
+/// @param mark The value returned by arenaBegin.
+///
+/// @return This function always succeeds and returns no value.
+void arenaEnd(Arena *arena, size_t mark) {
+  while ((arena->overflow != NULL) && (arena->overflow->mark >= mark)) {
+    ArenaOverflow *overflow = arena->overflow;
+    arena->overflow = overflow->next;
+    free(overflow);
+  }
+  
+  if (mark < arena->used) {
+    arena->used = mark;
+  }
+}
+
+/// @fn void arenaReset(Arena *arena)
+///
+/// @brief Release everything allocated from an arena.  Meant to be called when
+/// the task is done with a request, regardless of how the request's handlers
+/// exited.
+///
+/// @param arena A pointer to the Arena to reset.
+///
+/// @return This function always succeeds and returns no value.
+void arenaReset(Arena *arena) {
+  arenaEnd(arena, 0);
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////////
+///
+/// @author            James Card
+/// @date              10.16.2026
+///
+/// @file              Arena.h
+///
+/// @brief             Scoped bump-pointer allocation for kernel tasks.
+///
+/// @copyright
+///                   Copyright (c) 2012-2025 James Card
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a
+/// copy of this software and associated documentation files (the "Software"),
+/// to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+/// and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included
+/// in all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+/// DEALINGS IN THE SOFTWARE.
+///
+///                                James Card
+///                         http://www.jamescard.org
+///
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef ARENA_H
+#define ARENA_H
+
+// Standard C includes
+#include "stddef.h"
+#include "stdint.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// @struct ArenaOverflow
+///
+/// @brief Metadata in front of an allocation that didn't fit in an arena's
+/// reserved region and was borrowed from the heap instead.
+///
+/// @param next A pointer to the next most recent overflow allocation.
+/// @param mark The value of the arena's used count when the allocation was
+///   made.
+typedef struct ArenaOverflow {
+  struct ArenaOverflow *next;
+  size_t                mark;
+} ArenaOverflow;
+
+/// @struct Arena
+///
+/// @brief A region of memory reserved by a kernel task that temporaries are
+/// carved out of with a bump pointer.  Nothing is freed individually.
+/// Everything allocated since a call to arenaBegin is released at once by the
+/// matching call to arenaEnd, and everything is released by arenaReset.
+/// Allocations that don't fit in the region are borrowed from the heap and
+/// released the same way.
+///
+/// @param buffer The reserved region.  NULL if nothing was reserved.
+/// @param size The number of bytes in the buffer.
+/// @param used The number of bytes allocated, including the ones borrowed
+///   from the heap.  Everything past size was borrowed.
+/// @param overflow The most recent allocation borrowed from the heap.
+typedef struct Arena {
+  char          *buffer;
+  size_t         size;
+  size_t         used;
+  ArenaOverflow *overflow;
+} Arena;
+
+// Function prototypes
+int arenaInit(Arena *arena, size_t size);
+size_t arenaBegin(Arena *arena);
+void* arenaAlloc(Arena *arena, size_t size);
+void arenaEnd(Arena *arena, size_t mark);
+void arenaReset(Arena *arena);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // ARENA_H
@@ -0,0 +1,374 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                     Copyright (c) 2012-2025 James Card                     //
+//                                                                            //
+// Permission is hereby granted, free of charge, to any person obtaining a    //
+// copy of this software and associated documentation files (the "Software"), //
+// to deal in the Software without restriction, including without limitation  //
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,   //
+// and/or sell copies of the Software, and to permit persons to whom the      //
+// Software is furnished to do so, subject to the following conditions:       //
+//                                                                            //
+// The above copyright notice and this permission notice shall be included    //
+// in all copies or substantial portions of the Software.                     //
+//                                                                            //
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR //
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   //
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    //
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER //
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING    //
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER        //
+// DEALINGS IN THE SOFTWARE.                                                  //
+//                                                                            //
+//                                 James Card                                 //
+//                          http://www.jamescard.org                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Doxygen marker
+/// @file
+
+// Standard C includes
+#include "string.h"
+
+// NanoOs includes
+#include "BlockCache.h"
+#include "MemoryManager.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// @fn static BlockCacheEntry* blockCacheFind(
+///   BlockCache *blockCache, uint32_t block)
+///
+/// @brief Find the entry that holds a block, if any.
+///
+/// @param blockCache A pointer to the BlockCache to search.
+/// @param block The number of the block to look for.
+///
+/// @return Returns a pointer to the BlockCacheEntry on success, NULL if the
+/// block is not cached.
+static BlockCacheEntry* blockCacheFind(BlockCache *blockCache, uint32_t block) {
+  for (uint8_t ii = 0; ii < blockCache->numBlocks; ii++) {
+    BlockCacheEntry *entry = &blockCache->entries[ii];
+    if ((entry->lastUsed != 0) && (entry->block == block)) {
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+/// @fn static uint8_t* blockCacheData(
+///   BlockCache *blockCache, BlockCacheEntry *entry)
+///
+/// @brief Get the storage for a cache entry's block.
+///
+/// @param blockCache A pointer to the BlockCache that owns the entry.
+/// @param entry A pointer to one of the cache's entries.
+///
+/// @return Returns a pointer to the first byte of the cached block.
+static uint8_t* blockCacheData(BlockCache *blockCache, BlockCacheEntry *entry) {
+  return &blockCache->data[
+    (uint32_t) (entry - blockCache->entries) * blockCache->device.blockSize];
+}
+
+/// @fn static int blockCacheWriteBack(
+///   BlockCache *blockCache, BlockCacheEntry *entry)
+///
+/// @brief Write a cache entry's block to the backing device if it's dirty.
+///
+/// @param blockCache A pointer to the BlockCache that owns the entry.
+/// @param entry A pointer to one of the cache's entries.
+///
+/// @return Returns 0 on success, the backing device's error on failure.  The
+/// entry stays dirty on failure.
+static int blockCacheWriteBack(BlockCache *blockCache, BlockCacheEntry *entry) {
+  if (!entry->dirty) {
+    return 0;
+  }
+
+  BlockStorageDevice *backingDevice = blockCache->backingDevice;
+  int returnValue = backingDevice->writeBlocks(backingDevice->context,
+    entry->block, 1, blockCache->device.blockSize,
+    blockCacheData(blockCache, entry));
+  if (returnValue == 0) {
+    entry->dirty = false;
+    blockCache->numWriteBacks++;
+  }
+
+  return returnValue;
+}
+
+/// @fn static BlockCacheEntry* blockCacheEvict(
+///   BlockCache *blockCache, int *status)
+///
+/// @brief Free up an entry for a new block.  An empty entry is used if there
+/// is one, otherwise the least recently used entry is written back and reused.
+///
+/// @param blockCache A pointer to the BlockCache to evict from.
+/// @param status A pointer to an int that is set to the backing device's error
+///   if writing back the evicted block fails.
+///
+/// @return Returns a pointer to an empty BlockCacheEntry on success, NULL on
+/// failure.
+static BlockCacheEntry* blockCacheEvict(BlockCache *blockCache, int *status) {
+  BlockCacheEntry *victim = &blockCache->entries[0];
+  for (uint8_t ii = 1; ii < blockCache->numBlocks; ii++) {
+    if (blockCache->entries[ii].lastUsed < victim->lastUsed) {
+      victim = &blockCache->entries[ii];
+    }
+  }
+
+  *status = blockCacheWriteBack(blockCache, victim);
+  if (*status != 0) {
+    return NULL;
+  }
+  victim->lastUsed = 0;
+
+  return victim;
+}
+
+/// @fn BlockCache* blockCacheCreate(
+///   BlockStorageDevice *backingDevice, uint8_t numBlocks)
+///
+/// @brief Create a cache in front of a block storage device.  Filesystems
+/// must use the cache's device member instead of the backing device from then
+/// on.
+///
+/// @param backingDevice A pointer to the BlockStorageDevice to cache.
+/// @param numBlocks The number of blocks to cache.
+///
+/// @return Returns a pointer to a new BlockCache on success, NULL on failure.
+BlockCache* blockCacheCreate(
+  BlockStorageDevice *backingDevice, uint8_t numBlocks
+) {
+  if ((backingDevice == NULL) || (numBlocks == 0)) {
+    return NULL;
+  }
+
+  BlockCache *blockCache = (BlockCache*) calloc(1, sizeof(BlockCache));
+  if (blockCache == NULL) {
+    return NULL;
+  }
+  blockCache->entries
+    = (BlockCacheEntry*) calloc(numBlocks, sizeof(BlockCacheEntry));
+  blockCache->data
+    = (uint8_t*) malloc(((uint32_t) numBlocks) * backingDevice->blockSize);
+  if ((blockCache->entries == NULL) || (blockCache->data == NULL)) {
+    free(blockCache->data);
+    free(blockCache->entries);
+    free(blockCache);
+    return NULL;
+  }
+
+  blockCache->device = *backingDevice;
+  blockCache->device.context = blockCache;
+  blockCache->device.readBlocks = blockCacheReadBlocks;
+  blockCache->device.writeBlocks = blockCacheWriteBlocks;
+  blockCache->device.flush = blockCacheFlush;
+  blockCache->backingDevice = backingDevice;
+  blockCache->numBlocks = numBlocks;
+
+  return blockCache;
+}
+
+/// @fn void blockCacheDestroy(BlockCache *blockCache)
+///
+/// @brief Flush a cache and release its memory.
+///
+/// @param blockCache A pointer to the BlockCache to destroy.
+///
+/// @return This function returns no value.
+void blockCacheDestroy(BlockCache *blockCache) {
+  if (blockCache == NULL) {
+    return;
+  }
+
+  blockCacheFlush(blockCache);
+  free(blockCache->data);
+  free(blockCache->entries);
+  free(blockCache);
+}
+
+/// @fn int blockCacheReadBlocks(void *context, uint32_t startBlock,
+///   uint32_t numBlocks, uint16_t blockSize, uint8_t *buffer)
+///
+/// @brief BlockStorageDevice readBlocks implementation for a BlockCache.
+/// Single-block reads go through the cache.  Larger reads go straight to the
+/// backing device and then have any dirty cached blocks copied over them.
+///
+/// @param context A pointer to the BlockCache cast to a void*.
+/// @param startBlock The number of the first block to read.
+/// @param numBlocks The number of blocks to read.
+/// @param blockSize The size of the blocks in bytes.
+/// @param buffer The memory to read the blocks into.
+///
+/// @return Returns 0 on success, the backing device's error on failure.
+int blockCacheReadBlocks(void *context, uint32_t startBlock,
+  uint32_t numBlocks, uint16_t blockSize, uint8_t *buffer
+) {
+  BlockCache *blockCache = (BlockCache*) context;
+  BlockStorageDevice *backingDevice = blockCache->backingDevice;
+  int returnValue = 0;
+
+  if (blockSize != blockCache->device.blockSize) {
+    // Not something we can cache.  Make sure the device is current and pass
+    // the request through.
+    returnValue = blockCacheFlush(blockCache);
+    if (returnValue == 0) {
+      returnValue = backingDevice->readBlocks(backingDevice->context,
+        startBlock, numBlocks, blockSize, buffer);
+    }
+    return returnValue;
+  }
+
+  if (numBlocks != 1) {
+    returnValue = backingDevice->readBlocks(backingDevice->context,
+      startBlock, numBlocks, blockSize, buffer);
+    if (returnValue != 0) {
+      return returnValue;
+    }
+    blockCache->numMisses += numBlocks;
+
+    for (uint8_t ii = 0; ii < blockCache->numBlocks; ii++) {
+      BlockCacheEntry *entry = &blockCache->entries[ii];
+      if ((entry->lastUsed != 0) && (entry->dirty)
+        && (entry->block - startBlock < numBlocks)
+      ) {
+        memcpy(&buffer[(entry->block - startBlock) * blockSize],
+          blockCacheData(blockCache, entry), blockSize);
+      }
+    }
+
+    return 0;
+  }
+
+  BlockCacheEntry *entry = blockCacheFind(blockCache, startBlock);
+  if (entry != NULL) {
+    blockCache->numHits++;
+  } else {
+    entry = blockCacheEvict(blockCache, &returnValue);
+    if (entry == NULL) {
+      return returnValue;
+    }
+    returnValue = backingDevice->readBlocks(backingDevice->context,
+      startBlock, 1, blockSize, blockCacheData(blockCache, entry));
+    if (returnValue != 0) {
+      return returnValue;
+    }
+    blockCache->numMisses++;
+    entry->block = startBlock;
+  }
+
+  entry->lastUsed = ++blockCache->useCounter;
+  memcpy(buffer, blockCacheData(blockCache, entry), blockSize);
+
+  return 0;
+}
+
+/// @fn int blockCacheWriteBlocks(void *context, uint32_t startBlock,
+///   uint32_t numBlocks, uint16_t blockSize, const uint8_t *buffer)
+///
+/// @brief BlockStorageDevice writeBlocks implementation for a BlockCache.
+/// Single-block writes only update the cache and are written to the backing
+/// device on eviction or flush.  Larger writes go straight to the backing
+/// device and refresh any copies of the blocks in the cache.
+///
+/// @param context A pointer to the BlockCache cast to a void*.
+/// @param startBlock The number of the first block to write.
+/// @param numBlocks The number of blocks to write.
+/// @param blockSize The size of the blocks in bytes.
+/// @param buffer The data to write.
+///
+/// @return Returns 0 on success, the backing device's error on failure.
+int blockCacheWriteBlocks(void *context, uint32_t startBlock,
+  uint32_t numBlocks, uint16_t blockSize, const uint8_t *buffer
+) {
+  BlockCache *blockCache = (BlockCache*) context;
+  BlockStorageDevice *backingDevice = blockCache->backingDevice;
+  int returnValue = 0;
+
+  if (blockSize != blockCache->device.blockSize) {
+    // Not something we can cache.  Write everything we have first so that
+    // the device sees the writes in order.
+    returnValue = blockCacheFlush(blockCache);
+    if (returnValue == 0) {
+      returnValue = backingDevice->writeBlocks(backingDevice->context,
+        startBlock, numBlocks, blockSize, buffer);
+    }
+    return returnValue;
+  }
+
+  if (numBlocks != 1) {
+    returnValue = backingDevice->writeBlocks(backingDevice->context,
+      startBlock, numBlocks, blockSize, buffer);
+    if (returnValue != 0) {
+      return returnValue;
+    }
+
+    for (uint8_t ii = 0; ii < blockCache->numBlocks; ii++) {
+      BlockCacheEntry *entry = &blockCache->entries[ii];
+      if ((entry->lastUsed != 0)
+        && (entry->block - startBlock < numBlocks)
+      ) {
+        memcpy(blockCacheData(blockCache, entry),
+          &buffer[(entry->block - startBlock) * blockSize], blockSize);
+        entry->dirty = false;
+      }
+    }
+
+    return 0;
+  }
+
+  BlockCacheEntry *entry = blockCacheFind(blockCache, startBlock);
+  if (entry != NULL) {
+    blockCache->numHits++;
+  } else {
+    entry = blockCacheEvict(blockCache, &returnValue);
+    if (entry == NULL) {
+      return returnValue;
+    }
+    entry->block = startBlock;
+  }
+
+  memcpy(blockCacheData(blockCache, entry), buffer, blockSize);
+  entry->dirty = true;
+  entry->lastUsed = ++blockCache->useCounter;
+
+  return 0;
+}
+
+/// @fn int blockCacheFlush(void *context)
+///
+/// @brief BlockStorageDevice flush implementation for a BlockCache.  Writes
+/// every dirty block to the backing device.  The blocks stay cached.
+///
+/// @param context A pointer to the BlockCache cast to a void*.
+///
+/// @return Returns 0 on success, the first error returned by the backing
+/// device on failure.  Blocks that could not be written stay dirty.
+int blockCacheFlush(void *context) {
+  BlockCache *blockCache = (BlockCache*) context;
+  int returnValue = 0;
+
+  for (uint8_t ii = 0; ii < blockCache->numBlocks; ii++) {
+    int status = blockCacheWriteBack(blockCache, &blockCache->entries[ii]);
+    if ((status != 0) && (returnValue == 0)) {
+      returnValue = status;
+    }
+  }
+
+  BlockStorageDevice *backingDevice = blockCache->backingDevice;
+  if ((returnValue == 0) && (backingDevice->flush != NULL)) {
+    returnValue = backingDevice->flush(backingDevice->context);
+  }
+
+  return returnValue;
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
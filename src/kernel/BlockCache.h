@@ -0,0 +1,128 @@
+///////////////////////////////////////////////////////////////////////////////
+///
+/// @author            James Card
+/// @date              10.16.2026
+///
+/// @file              BlockCache.h
+///
+/// @brief             Write-back cache in front of a block storage device.
+///
+/// @copyright
+///                   Copyright (c) 2012-2025 James Card
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a
+/// copy of this software and associated documentation files (the "Software"),
+/// to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+/// and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included
+/// in all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+/// DEALINGS IN THE SOFTWARE.
+///
+///                                James Card
+///                         http://www.jamescard.org
+///
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+// Standard C includes
+#include "stdbool.h"
+#include "stdint.h"
+
+// NanoOs includes
+#include "NanoOsTypes.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// @def BLOCK_CACHE_NUM_BLOCKS
+///
+/// @brief The number of blocks a filesystem task keeps cached in front of its
+/// block storage device.  0 disables the cache.  Each block costs a full block
+/// of RAM.  Builds that run as an application within another OS cache enough
+/// to hold the hot metadata of a small volume.  The SAMD21 keeps two blocks,
+/// enough for the FAT or bitmap block and the directory block an append
+/// alternates between.  AVR boards don't have the RAM to spare.
+#ifndef BLOCK_CACHE_NUM_BLOCKS
+#if defined(__linux__) || defined(__linux) || defined(_WIN32)
+#define BLOCK_CACHE_NUM_BLOCKS 16
+#elif defined(__AVR__)
+#define BLOCK_CACHE_NUM_BLOCKS 0
+#else
+#define BLOCK_CACHE_NUM_BLOCKS 2
+#endif
+#endif // BLOCK_CACHE_NUM_BLOCKS
+
+/// @struct BlockCacheEntry
+///
+/// @brief Bookkeeping for one cached block.
+///
+/// @param block The number of the block held in the entry.
+/// @param lastUsed The value of the cache's useCounter the last time the entry
+///   was read or written.  0 if the entry holds no block.
+/// @param dirty Whether or not the entry holds data that has not been written
+///   to the backing device yet.
+typedef struct BlockCacheEntry {
+  uint32_t block;
+  uint32_t lastUsed;
+  bool     dirty;
+} BlockCacheEntry;
+
+/// @struct BlockCache
+///
+/// @brief A least-recently-used, write-back cache of single blocks that wraps
+/// another BlockStorageDevice.
+///
+/// @param device The BlockStorageDevice that filesystems use in place of the
+///   backing device.  Its context is the BlockCache itself.
+/// @param backingDevice The device that actually stores the blocks.
+/// @param entries The array of numBlocks BlockCacheEntry objects.
+/// @param data The storage for the cached blocks, numBlocks * blockSize bytes.
+/// @param numBlocks The number of blocks the cache can hold.
+/// @param useCounter Monotonic counter used to order the entries by use.
+/// @param numHits The number of single-block reads and writes that were
+///   satisfied without going to the backing device.
+/// @param numMisses The number of blocks that had to be read from the backing
+///   device.
+/// @param numWriteBacks The number of dirty blocks that were written to the
+///   backing device on eviction or flush.
+typedef struct BlockCache {
+  BlockStorageDevice  device;
+  BlockStorageDevice *backingDevice;
+  BlockCacheEntry    *entries;
+  uint8_t            *data;
+  uint8_t             numBlocks;
+  uint32_t            useCounter;
+  uint32_t            numHits;
+  uint32_t            numMisses;
+  uint32_t            numWriteBacks;
+} BlockCache;
+
+// Function prototypes
+BlockCache* blockCacheCreate(
+  BlockStorageDevice *backingDevice, uint8_t numBlocks);
+void blockCacheDestroy(BlockCache *blockCache);
+int blockCacheReadBlocks(void *context, uint32_t startBlock,
+  uint32_t numBlocks, uint16_t blockSize, uint8_t *buffer);
+int blockCacheWriteBlocks(void *context, uint32_t startBlock,
+  uint32_t numBlocks, uint16_t blockSize, const uint8_t *buffer);
+int blockCacheFlush(void *context);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // BLOCK_CACHE_H
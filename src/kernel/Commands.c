@@ -109,6 +109,40 @@ int killCommandHandler(int argc, char **argv) {
   return returnValue;
 }
 
+/// @fn int niceCommandHandler(int argc, char **argv);
+///
+/// @brief Set the scheduling priority of a running process identified by its
+/// process ID.
+///
+/// @param argc The number or arguments parsed from the command line, including
+///   the name of the command.
+/// @param argv The array of arguments parsed from the command line with one
+///   argument per array element.
+///
+/// @return Returns 0 on success, 1 on failure.
+int niceCommandHandler(int argc, char **argv) {
+  if (argc < 3) {
+    printf("Usage:\n");
+    printf("  nice <process ID> <priority>\n");
+    printf("\n");
+    printf("Priorities range from 0 (highest) to %d (lowest).\n",
+      SCHEDULER_NUM_USER_PRIORITIES - 1);
+    printf("\n");
+    return 1;
+  }
+  TaskId processId = (TaskId) strtol(argv[1], NULL, 10);
+  int priority = (int) strtol(argv[2], NULL, 10);
+
+  int returnValue = schedulerSetTaskPriority(processId, priority);
+  if (returnValue != 0) {
+    printf("Setting priority returned status \"%s\".\n",
+      strerror(returnValue));
+    return 1;
+  }
+
+  return 0;
+}
+
 /// @fn int echoCommandHandler(int argc, char **argv);
 ///
 /// @brief Echo a string from the user back to the console output.
@@ -228,6 +262,38 @@ int helpCommandHandler(int argc, char **argv) {
   return 0;
 }
 
+/// @fn int cachestatCommandHandler(int argc, char **argv);
+///
+/// @brief Run the "cachestat" command from the filesystem.
+///
+/// @param argc The number or arguments parsed from the command line, including
+///   the name of the command.
+/// @param argv The array of arguments parsed from the command line with one
+///   argument per array element.
+///
+/// @return Returns 0 on success, 1 on failure.
+int cachestatCommandHandler(int argc, char **argv) {
+  char commandPath[26] = "/usr/bin/";
+  strcat(commandPath, "cachestat");
+  return runOverlayCommand(commandPath, argc, argv, NULL);
+}
+
+/// @fn int ipcstatCommandHandler(int argc, char **argv);
+///
+/// @brief Run the "ipcstat" command from the filesystem.
+///
+/// @param argc The number or arguments parsed from the command line, including
+///   the name of the command.
+/// @param argv The array of arguments parsed from the command line with one
+///   argument per array element.
+///
+/// @return Returns 0 on success, 1 on failure.
+int ipcstatCommandHandler(int argc, char **argv) {
+  char commandPath[26] = "/usr/bin/";
+  strcat(commandPath, "ipcstat");
+  return runOverlayCommand(commandPath, argc, argv, NULL);
+}
+
 /// @fn int logoutCommandHandler(int argc, char **argv)
 ///
 /// @brief Logout of a running shell.
@@ -325,6 +391,22 @@ int tightLoopCommandHandler(int argc, char **argv) {
   return 0;
 }
 
+/// @fn int topCommandHandler(int argc, char **argv);
+///
+/// @brief Run the "top" command from the filesystem.
+///
+/// @param argc The number or arguments parsed from the command line, including
+///   the name of the command.
+/// @param argv The array of arguments parsed from the command line with one
+///   argument per array element.
+///
+/// @return Returns 0 on success, 1 on failure.
+int topCommandHandler(int argc, char **argv) {
+  char commandPath[26] = "/usr/bin/";
+  strcat(commandPath, "top");
+  return runOverlayCommand(commandPath, argc, argv, NULL);
+}
+
 /// @fn const CommandEntry* getCommandEntryFromInput(char *consoleInput)
 ///
 /// @brief Get the command specified by consoleInput.
@@ -473,6 +555,11 @@ void* runShell(void *args) {
 /// REMINDER:  These commands have to be in alphabetical order so that the
 ///            binary search will work:
 const CommandEntry commands[] = {
+  {
+    .name = "cachestat",
+    .func = cachestatCommandHandler,
+    .help = "Show the filesystem block cache hit rate."
+  },
   {
     .name = "echo",
     .func = echoCommandHandler,
@@ -503,6 +590,11 @@ const CommandEntry commands[] = {
     .func = helpCommandHandler,
     .help = "Print this help message."
   },
+  {
+    .name = "ipcstat",
+    .func = ipcstatCommandHandler,
+    .help = "Show message counts and latencies between processes."
+  },
   {
     .name = "kill",
     .func = killCommandHandler,
@@ -518,6 +610,11 @@ const CommandEntry commands[] = {
     .func = looseLoopCommandHandler,
     .help = "Run a process in a loop that does yield."
   },
+  {
+    .name = "nice",
+    .func = niceCommandHandler,
+    .help = "Set the priority of a running process."
+  },
   {
     .name = "ps",
     .func = psCommandHandler,
@@ -538,6 +635,11 @@ const CommandEntry commands[] = {
     .func = tightLoopCommandHandler,
     .help = "Run a process in a loop that does not yield."
   },
+  {
+    .name = "top",
+    .func = topCommandHandler,
+    .help = "Show CPU usage of the running processes."
+  },
 };
 
 /// @var NUM_COMMANDS
@@ -48,6 +48,23 @@ extern "C"
 /// support.
 #define SINGLE_CORE_COROUTINES
 
+/// @def COROUTINE_ASM_CONTEXT_SWITCH
+///
+/// @brief When non-zero, the Coroutines library switches contexts with its own
+/// assembly routines on targets that have them (x86-64 System V and ARMv6-M)
+/// instead of setjmp and longjmp.  The assembly routines save only the
+/// callee-saved registers and the stack pointer.  Targets without them always
+/// use setjmp and longjmp.  Only the x86-64 simulator, where the routines are
+/// exercised by the benchmarks, enables them by default.  Boards opt in by
+/// defining this to 1.
+#ifndef COROUTINE_ASM_CONTEXT_SWITCH
+#if defined(__x86_64__)
+#define COROUTINE_ASM_CONTEXT_SWITCH 1
+#else
+#define COROUTINE_ASM_CONTEXT_SWITCH 0
+#endif
+#endif // COROUTINE_ASM_CONTEXT_SWITCH
+
 void msleep(int durationMs);
 
 #ifdef __cplusplus
@@ -81,7 +81,10 @@
  *
  * coroutineInit, coroutineMain, coroutineResume, and coroutineYield make use
  * of an internal function called coroutinePass and/or raw setjmp and longjmp
- * function calls.  coroutinePass also makes use of setjmp and longjmp.
+ * function calls.  coroutinePass also makes use of setjmp and longjmp.  (On
+ * targets where COROUTINE_ASM_CONTEXT_SWITCH selects them, coroutineSetjmp and
+ * coroutineLongjmp are hand-written equivalents that save only the
+ * callee-saved registers.)
  * coroutinePass takes as parameters a pointer to the Coroutine making the call
  * and the value that is to be passed to the Coroutine whose execution is
  * resumed.  Execution will be passed to the Coroutine that is at the top of the
@@ -584,6 +587,109 @@ Coroutine* getRunningCoroutine(void) {
   return coroutine;
 }
 
+#if defined(COROUTINE_CONTEXT_WORDS) && defined(__x86_64__)
+
+// int coroutineSaveContext(CoroutineContext context)
+// void coroutineRestoreContext(CoroutineContext context, int value)
+//
+// System V x86-64 versions of setjmp and longjmp.  Only the registers that the
+// ABI requires a callee to preserve are saved:  rbx, rbp, r12-r15, the stack
+// pointer as it will be after coroutineSaveContext returns, and the return
+// address.  Unlike libc, there's no signal mask, pointer mangling, or shadow
+// stack handling.
+__asm__(
+  "  .text\n"
+  "  .globl coroutineSaveContext\n"
+  "  .type coroutineSaveContext, @function\n"
+  "coroutineSaveContext:\n"
+  "  movq (%rsp), %rdx\n"
+  "  leaq 8(%rsp), %rcx\n"
+  "  movq %rbx, 0(%rdi)\n"
+  "  movq %rbp, 8(%rdi)\n"
+  "  movq %r12, 16(%rdi)\n"
+  "  movq %r13, 24(%rdi)\n"
+  "  movq %r14, 32(%rdi)\n"
+  "  movq %r15, 40(%rdi)\n"
+  "  movq %rcx, 48(%rdi)\n"
+  "  movq %rdx, 56(%rdi)\n"
+  "  xorl %eax, %eax\n"
+  "  ret\n"
+  "  .size coroutineSaveContext, .-coroutineSaveContext\n"
+  "\n"
+  "  .globl coroutineRestoreContext\n"
+  "  .type coroutineRestoreContext, @function\n"
+  "coroutineRestoreContext:\n"
+  "  movq 0(%rdi), %rbx\n"
+  "  movq 8(%rdi), %rbp\n"
+  "  movq 16(%rdi), %r12\n"
+  "  movq 24(%rdi), %r13\n"
+  "  movq 32(%rdi), %r14\n"
+  "  movq 40(%rdi), %r15\n"
+  "  movq 48(%rdi), %rsp\n"
+  "  movl %esi, %eax\n"
+  "  testl %eax, %eax\n"
+  "  jnz 1f\n"
+  "  movl $1, %eax\n"
+  "1:\n"
+  "  jmpq *56(%rdi)\n"
+  "  .size coroutineRestoreContext, .-coroutineRestoreContext\n"
+);
+
+#elif defined(COROUTINE_CONTEXT_WORDS) && defined(__ARM_ARCH_6M__)
+
+// int coroutineSaveContext(CoroutineContext context)
+// void coroutineRestoreContext(CoroutineContext context, int value)
+//
+// ARMv6-M (Cortex-M0) versions of setjmp and longjmp.  Only the registers
+// that the AAPCS requires a callee to preserve are saved:  r4-r11, the stack
+// pointer, and the link register.  Thumb-1 can only load and store multiple
+// low registers, so r8-r11 and sp go through r1-r4.
+__asm__(
+  "  .text\n"
+  "  .syntax unified\n"
+  "  .thumb\n"
+  "  .globl coroutineSaveContext\n"
+  "  .type coroutineSaveContext, %function\n"
+  "  .thumb_func\n"
+  "coroutineSaveContext:\n"
+  "  stmia r0!, {r4-r7}\n"
+  "  mov r1, r8\n"
+  "  mov r2, r9\n"
+  "  mov r3, r10\n"
+  "  stmia r0!, {r1-r3}\n"
+  "  mov r1, r11\n"
+  "  mov r2, sp\n"
+  "  mov r3, lr\n"
+  "  stmia r0!, {r1-r3}\n"
+  "  movs r0, #0\n"
+  "  bx lr\n"
+  "  .size coroutineSaveContext, .-coroutineSaveContext\n"
+  "\n"
+  "  .globl coroutineRestoreContext\n"
+  "  .type coroutineRestoreContext, %function\n"
+  "  .thumb_func\n"
+  "coroutineRestoreContext:\n"
+  "  adds r0, #16\n"
+  "  ldmia r0!, {r2-r4}\n"
+  "  mov r8, r2\n"
+  "  mov r9, r3\n"
+  "  mov r10, r4\n"
+  "  ldmia r0!, {r2-r4}\n"
+  "  mov r11, r2\n"
+  "  mov sp, r3\n"
+  "  mov lr, r4\n"
+  "  subs r0, #40\n"
+  "  ldmia r0!, {r4-r7}\n"
+  "  movs r0, r1\n"
+  "  bne 1f\n"
+  "  movs r0, #1\n"
+  "1:\n"
+  "  bx lr\n"
+  "  .size coroutineRestoreContext, .-coroutineRestoreContext\n"
+);
+
+#endif // COROUTINE_CONTEXT_WORDS
+
 /// @fn void* coroutinePass(Coroutine currentCoroutine, CoroutineFuncData arg)
 ///
 /// @brief Pass a value and control from one coroutine to another.  The target
@@ -597,7 +703,7 @@ CoroutineFuncData coroutinePass(Coroutine *currentCoroutine, CoroutineFuncData a
   ZEROINIT(CoroutineFuncData returnValue);
   
   if (currentCoroutine != NULL) {
-    if (!setjmp(currentCoroutine->context)) {
+    if (!coroutineSetjmp(currentCoroutine->context)) {
       Coroutine* targetCoroutine = getRunningCoroutine();
 
       if (targetCoroutine != NULL) {
@@ -612,7 +718,7 @@ CoroutineFuncData coroutinePass(Coroutine *currentCoroutine, CoroutineFuncData a
         context->Frame = 0;
 #endif // _MSC_VER
         targetCoroutine->passed = arg;
-        longjmp(targetCoroutine->context, 1);
+        coroutineLongjmp(targetCoroutine->context, 1);
       }
     }
   } else {
@@ -810,7 +916,7 @@ Coroutine* coroutineInit(Coroutine *userCoroutine,
   }
 
   // The current coroutine is at the head of the running list.
-  if ((idle == NULL) && (!setjmp(running->context))) {
+  if ((idle == NULL) && (!coroutineSetjmp(running->context))) {
     // We've just been called from the calling function and need to create a
     // new Coroutine instance, including its stack.
     coroutineAllocateStack(stackSize);
@@ -987,11 +1093,11 @@ void coroutineMain(void *stack) {
     stackSize = (int) ((intptr_t) tss_get(_tssStackSize));
   }
 #endif
-  if (!setjmp(running->context)) {
+  if (!coroutineSetjmp(running->context)) {
     coroutineAllocateStack(stackSize);
   }
 
-  if (setjmp(running->resetContext)) {
+  if (coroutineSetjmp(running->resetContext)) {
     // When a coroutine is killed, its normal context is set to this position
     // so that it can be restarted properly from the constructor.  We'll have to
     // manually pull the data that was provided from coroutinePass since the
@@ -1207,7 +1313,7 @@ int coroutineTerminate(Coroutine *targetCoroutine, Comutex **mutexes) {
   targetCoroutine->priv = NULL;
   targetCoroutine->state = COROUTINE_STATE_NOT_RUNNING;
   memcpy(&targetCoroutine->context,
-    &targetCoroutine->resetContext, sizeof(jmp_buf));
+    &targetCoroutine->resetContext, sizeof(CoroutineContext));
   coroutinePushIdle(targetCoroutine);
 
   // Unlock any mutexes the coroutine had locked.
@@ -1961,6 +2067,34 @@ int coconditionSignal(Cocondition *cond) {
   return returnValue;
 }
 
+/// @fn static bool coconditionSignalled(
+///   Cocondition *cond, Coroutine *coroutine)
+///
+/// @brief Determine whether a coroutine that's waiting on a condition has been
+/// signalled.  The first cond->numSignals waiters have been, and any of them
+/// may take its signal first.  This lets the scheduler hand the CPU to the
+/// waiter that a broadcast was meant for without the ones ahead of it having
+/// to run first.
+///
+/// @param cond A pointer to the condition being waited on.
+/// @param coroutine A pointer to the waiting coroutine.
+///
+/// @return Returns true if the coroutine has been signalled, false if not.
+static bool coconditionSignalled(Cocondition *cond, Coroutine *coroutine) {
+  int position = 0;
+  for (Coroutine *cur = cond->head;
+    (cur != NULL) && (position < cond->numSignals);
+    cur = cur->nextToSignal
+  ) {
+    if (cur == coroutine) {
+      return true;
+    }
+    position++;
+  }
+
+  return false;
+}
+
 /// @fn int coconditionTimedWait(Cocondition* cond, Comutex* mtx, const struct timespec* ts)
 ///
 /// @brief Wait for a condition to be signalled or until a specified time,
@@ -2019,10 +2153,10 @@ int coconditionTimedWait(Cocondition *cond, Comutex *mtx,
 
   int returnValue = coroutineSuccess;
   running->blockingCocondition = cond;
-  while ((cond->numSignals == 0) || (cond->head != running)) {
+  while (!coconditionSignalled(cond, running)) {
     cond->lastYieldValue = coroutineYield(NULL, COROUTINE_STATE_TIMEDWAIT);
 
-    if (((cond->numSignals == 0) || (cond->head != running))
+    if ((!coconditionSignalled(cond, running))
       && (coroutineGetNanoseconds(NULL) > cond->timeoutTime)
     ) {
       returnValue = coroutineTimedout;
@@ -2032,10 +2166,12 @@ int coconditionTimedWait(Cocondition *cond, Comutex *mtx,
   cond->timeoutTime = 0;
   running->blockingCocondition = NULL;
   if ((returnValue == coroutineSuccess) && (cond->numSignals > 0)) {
-    // We are at the head of the queue.
+    // We are one of the signalled waiters at the front of the queue.
     cond->numSignals--;
     cond->numWaiters--;
-    cond->head = running->nextToSignal;
+    if (cond->head == running) {
+      cond->head = running->nextToSignal;
+    }
     if (running->prevToSignal != NULL) {
       running->prevToSignal->nextToSignal = running->nextToSignal;
     }
@@ -2125,14 +2261,16 @@ int coconditionWait(Cocondition *cond, Comutex *mtx) {
 
   int returnValue = coroutineSuccess;
   running->blockingCocondition = cond;
-  while ((cond->numSignals == 0) || (cond->head != running)) {
+  while (!coconditionSignalled(cond, running)) {
     cond->lastYieldValue = coroutineYield(NULL, COROUTINE_STATE_WAIT);
   }
   running->blockingCocondition = NULL;
   if (cond->numSignals > 0) {
     cond->numSignals--;
     cond->numWaiters--;
-    cond->head = running->nextToSignal;
+    if (cond->head == running) {
+      cond->head = running->nextToSignal;
+    }
     if (running->prevToSignal != NULL) {
       running->prevToSignal->nextToSignal = running->nextToSignal;
     }
@@ -2274,6 +2412,27 @@ msg_t* comessageQueuePop(void) {
   return head;
 }
 
+/// @fn int comessageQueuePopBatch(msg_t **comessages, int maxComessages)
+///
+/// @brief Remove up to maxComessages messages from the head of the running
+/// coroutine's message queue in one operation.
+///
+/// @param comessages The array to store the popped messages in.
+/// @param maxComessages The maximum number of messages to pop.
+///
+/// @return Returns the number of messages popped, which may be 0.
+int comessageQueuePopBatch(msg_t **comessages, int maxComessages) {
+  int returnValue = 0;
+
+  Coroutine *coroutine = getRunningCoroutine();
+  if ((coroutine != NULL) && (maxComessages > 0)) {
+    returnValue = (int) msg_q_pop_batch(&coroutine->messageQueue,
+      comessages, (size_t) maxComessages);
+  }
+
+  return returnValue;
+}
+
 /// @fn msg_t* comessageQueuePopType(int type)
 ///
 /// @brief Get the first message of the specified type from the running
@@ -2376,3 +2535,42 @@ int comessageQueuePush(Coroutine *coroutine, msg_t *msg) {
   return msg_q_push(&coroutine->messageQueue, replyTo, msg);
 }
 
+/// @fn int comessageQueuePushBatch(Coroutine *coroutine,
+///   msg_t **comessages, int numComessages)
+///
+/// @brief Push several messages onto a coroutine's message queue in one
+/// operation so that the queue is locked and its waiters are woken only once.
+///
+/// @param coroutine A pointer to the Coroutine with the message queue to add
+///   to.
+/// @param comessages The array of messages to push, in order.
+/// @param numComessages The number of messages in the comessages array.
+///
+/// @return Returns coroutineSuccess, coroutineError on failure.
+int comessageQueuePushBatch(Coroutine *coroutine,
+  msg_t **comessages, int numComessages
+) {
+  int returnValue = coroutineError;
+
+  if ((coroutine == NULL) || (comessages == NULL) || (numComessages < 0)) {
+    // This is invalid.
+    return returnValue; // coroutineError
+  }
+
+  Coroutine *running = getRunningCoroutine();
+  msg_q_t *replyTo = NULL;
+  if (running != NULL) {
+    replyTo = &running->messageQueue;
+  }
+  for (int ii = 0; ii < numComessages; ii++) {
+    if (comessages[ii] == NULL) {
+      return returnValue; // coroutineError
+    }
+    comessages[ii]->from.coro = running;
+    comessages[ii]->to.coro = coroutine;
+  }
+
+  return msg_q_push_batch(&coroutine->messageQueue, replyTo,
+    comessages, (size_t) numComessages);
+}
+
@@ -63,6 +63,58 @@ extern "C"
 {
 #endif
 
+// Context switching.
+
+/// @def COROUTINE_CONTEXT_WORDS
+///
+/// @brief The number of machine words saved by the assembly context switch
+/// for the target, if there is one.  Only defined for ELF targets since the
+/// assembly uses ELF symbol directives.  x86-64 saves rbx, rbp, r12-r15, the
+/// stack pointer, and the return address.  ARMv6-M saves r4-r11, the stack
+/// pointer, and the link register.
+#if COROUTINE_ASM_CONTEXT_SWITCH
+#if defined(__x86_64__) && defined(__ELF__)
+#define COROUTINE_CONTEXT_WORDS 8
+#elif defined(__ARM_ARCH_6M__)
+#define COROUTINE_CONTEXT_WORDS 10
+#endif // architecture
+#endif // COROUTINE_ASM_CONTEXT_SWITCH
+
+#ifdef COROUTINE_CONTEXT_WORDS
+
+/// @typedef CoroutineContext
+///
+/// @brief The saved register state of a suspended coroutine.
+typedef void *CoroutineContext[COROUTINE_CONTEXT_WORDS];
+
+int coroutineSaveContext(CoroutineContext context)
+  __attribute__((returns_twice));
+void coroutineRestoreContext(CoroutineContext context, int value)
+  __attribute__((noreturn));
+
+/// @def coroutineSetjmp
+///
+/// @brief Save the current context.  Returns 0 when called directly and the
+/// value passed to coroutineLongjmp when the context is restored.
+#define coroutineSetjmp(context) coroutineSaveContext(context)
+
+/// @def coroutineLongjmp
+///
+/// @brief Restore a context saved with coroutineSetjmp.  Does not return.
+#define coroutineLongjmp(context, value) coroutineRestoreContext(context, value)
+
+#else // COROUTINE_CONTEXT_WORDS not defined
+
+/// @typedef CoroutineContext
+///
+/// @brief The saved register state of a suspended coroutine.
+typedef jmp_buf CoroutineContext;
+
+#define coroutineSetjmp(context) setjmp(context)
+#define coroutineLongjmp(context, value) longjmp(context, value)
+
+#endif // COROUTINE_CONTEXT_WORDS
+
 // Base coroutine support.
 
 // Coroutine status values.
@@ -159,7 +211,7 @@ typedef union CoroutineFuncData {
 /// @param guard1 A well-known value to check for state corruption (stack
 ///   overflow).
 /// @param nextInList Pointer to the next Coroutine in the list.
-/// @param context The jmp_buf to hold the context of the coroutine.
+/// @param context The CoroutineContext to hold the context of the coroutine.
 /// @param priv Any private context for the Coroutine.
 /// @param state The state of the coroutine.  (See enum above.)
 /// @param nextToLock The next coroutine to allow to lock a mutex.
@@ -167,8 +219,9 @@ typedef union CoroutineFuncData {
 /// @param nextToSignal The next coroutine to signal when waiting on a signal.
 /// @param prevToSignal The previous coroutine to signal when waiting on a
 ///   signal.
-/// @param resetContext The jmp_buf that holds the place on stack to jump to
-///   after a coroutine has been terminated and the value of context is reset.
+/// @param resetContext The CoroutineContext that holds the place on stack to
+///   jump to after a coroutine has been terminated and the value of context is
+///   reset.
 /// @param passed The CoroutineFuncData that's passed between contexts by the
 ///   coroutinePass function (on a yield or resume call).
 /// @param messageQueue A msg_q_t that holds the messages sent to this
@@ -182,14 +235,14 @@ typedef union CoroutineFuncData {
 typedef struct Coroutine {
   uint32_t guard1;
   struct Coroutine *nextInList;
-  jmp_buf context;
+  CoroutineContext context;
   void *priv;
   CoroutineState state;
   struct Coroutine *nextToLock;
   struct Coroutine *prevToLock;
   struct Coroutine *nextToSignal;
   struct Coroutine *prevToSignal;
-  jmp_buf resetContext;
+  CoroutineContext resetContext;
   CoroutineFuncData passed;
   msg_q_t messageQueue;
   Comutex *blockingComutex;
@@ -307,10 +360,13 @@ bool coroutineDeadlocked(Coroutine *coroutine);
 // Message queue functions
 msg_t* comessageQueuePeek(void);
 msg_t* comessageQueuePop(void);
+int comessageQueuePopBatch(msg_t **comessages, int maxComessages);
 msg_t* comessageQueuePopType(int type);
 msg_t* comessageQueueWait(const struct timespec *ts);
 msg_t* comessageQueueWaitForType(int64_t type, const struct timespec *ts);
 int comessageQueuePush(Coroutine *coroutine, msg_t *comessage);
+int comessageQueuePushBatch(Coroutine *coroutine,
+  msg_t **comessages, int numComessages);
 
 
 #ifdef __cplusplus
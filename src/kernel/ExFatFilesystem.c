@@ -33,6 +33,7 @@
 ///
 ///////////////////////////////////////////////////////////////////////////////
 
+#include "Arena.h"
 #include "ExFatFilesystem.h"
 #include "NanoOs.h"
 #include "NanoOsTypes.h"
@@ -97,6 +98,56 @@ static int writeSector(
   return (result == 0) ? EXFAT_SUCCESS : EXFAT_ERROR;
 }
 
+/// @brief Read consecutive sectors from the storage device in one request
+///
+/// @param driverState Pointer to driver state
+/// @param sectorNumber First sector number to read
+/// @param numSectors Number of sectors to read
+/// @param buffer Buffer to read into, numSectors sectors long
+///
+/// @return EXFAT_SUCCESS on success, EXFAT_ERROR on failure
+static int readSectors(
+  ExFatDriverState* driverState, uint32_t sectorNumber, uint32_t numSectors,
+  uint8_t* buffer
+) {
+  FilesystemState* filesystemState = driverState->filesystemState;
+  int result = filesystemState->blockDevice->readBlocks(
+    filesystemState->blockDevice->context,
+    filesystemState->startLba + sectorNumber,
+    numSectors,
+    filesystemState->blockSize,
+    buffer
+  );
+
+  return (result == 0) ? EXFAT_SUCCESS : EXFAT_ERROR;
+}
+
+/// @brief Write consecutive sectors to the storage device in one request
+///
+/// @param driverState Pointer to driver state
+/// @param sectorNumber First sector number to write
+/// @param numSectors Number of sectors to write
+/// @param buffer Buffer to write from, numSectors sectors long
+///
+/// @return EXFAT_SUCCESS on success, EXFAT_ERROR on failure
+static int writeSectors(
+  ExFatDriverState* driverState, uint32_t sectorNumber, uint32_t numSectors,
+  const uint8_t* buffer
+) {
+  FilesystemState* filesystemState = driverState->filesystemState;
+  int result = filesystemState->blockDevice->writeBlocks(
+    filesystemState->blockDevice->context,
+    filesystemState->startLba + sectorNumber,
+    numSectors,
+    filesystemState->blockSize,
+    buffer
+  );
+
+  return (result == 0) ? EXFAT_SUCCESS : EXFAT_ERROR;
+}
+
+static int loadAllocationBitmap(ExFatDriverState* driverState);
+
 ///////////////////////////////////////////////////////////////////////////////
 /// @brief Initialize an exFAT driver state
 ///
@@ -191,6 +242,10 @@ int exFatInitialize(
   driverState->clusterCount = clusterCount;
   driverState->driverStateValid = true;
 
+  // Reading files works without the allocation bitmap, so a volume without
+  // one is still mounted.  Allocation will fail on it.
+  loadAllocationBitmap(driverState);
+
   return EXFAT_SUCCESS;
 }
 
@@ -290,60 +345,73 @@ static int writeFatEntry(
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-/// @struct NoFatChainRange
+/// @brief Get the sector that holds part of the allocation bitmap
 ///
-/// @brief Represents a range of clusters used by a NoFatChain file
+/// Formatters lay the allocation bitmap out contiguously, so the sectors can
+/// be computed without following its FAT chain.
 ///
-/// @param startCluster First cluster in the range
-/// @param endCluster Last cluster in the range (inclusive)
-typedef struct NoFatChainRange {
-  uint32_t startCluster;
-  uint32_t endCluster;
-} NoFatChainRange;
+/// @param driverState Pointer to the exFAT driver state
+/// @param sectorIndex Index of the sector within the bitmap
+///
+/// @return The sector number of the requested part of the bitmap
+///////////////////////////////////////////////////////////////////////////////
+static uint32_t bitmapSectorToSector(
+  ExFatDriverState* driverState, uint32_t sectorIndex
+) {
+  return clusterToSector(driverState, driverState->bitmapCluster) +
+    sectorIndex;
+}
 
 ///////////////////////////////////////////////////////////////////////////////
-/// @brief Check if a cluster is in any NoFatChain range
+/// @brief Count the free clusters tracked by one sector of the allocation
+/// bitmap
 ///
-/// @param cluster Cluster to check
-/// @param ranges Array of NoFatChain ranges
-/// @param numRanges Number of ranges in the array
+/// @param driverState Pointer to the exFAT driver state
+/// @param sectorIndex Index of the sector within the bitmap
+/// @param buffer Contents of the bitmap sector
 ///
-/// @return true if cluster is in a NoFatChain range, false otherwise
+/// @return The number of clear bits that correspond to clusters on the volume
 ///////////////////////////////////////////////////////////////////////////////
-static bool isClusterInNoFatChainRange(
-  uint32_t cluster, NoFatChainRange* ranges, uint8_t numRanges
+static uint16_t countFreeClustersInBitmapSector(
+  ExFatDriverState* driverState, uint32_t sectorIndex, const uint8_t* buffer
 ) {
-  for (uint8_t ii = 0; ii < numRanges; ii++) {
-    if (cluster >= ranges[ii].startCluster &&
-        cluster <= ranges[ii].endCluster) {
-      return true;
-    }
+  uint32_t clustersPerSector = driverState->bytesPerSector * 8;
+  uint32_t numClusters =
+    driverState->clusterCount - (sectorIndex * clustersPerSector);
+  if (numClusters > clustersPerSector) {
+    numClusters = clustersPerSector;
   }
-  return false;
+
+  uint32_t numAllocated = 0;
+  for (uint32_t ii = 0; ii < numClusters / 8; ii++) {
+    numAllocated += __builtin_popcount(buffer[ii]);
+  }
+  for (uint32_t ii = numClusters & ~((uint32_t) 7); ii < numClusters; ii++) {
+    numAllocated += (buffer[ii / 8] >> (ii % 8)) & 1;
+  }
+
+  return (uint16_t) (numClusters - numAllocated);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-/// @brief Collect NoFatChain cluster ranges from directory
+/// @brief Find the allocation bitmap location
 ///
 /// @param driverState Pointer to the exFAT driver state
-/// @param ranges Pointer to array to store ranges
-/// @param maxRanges Maximum number of ranges that can be stored
-/// @param numRanges Pointer to store actual number of ranges found
+/// @param bitmapCluster Pointer to store first cluster of bitmap
 ///
 /// @return EXFAT_SUCCESS on success, error code on failure
 ///////////////////////////////////////////////////////////////////////////////
-static int collectNoFatChainRanges(
-  ExFatDriverState* driverState, NoFatChainRange* ranges,
-  uint8_t maxRanges, uint8_t* numRanges
+static int findAllocationBitmap(
+  ExFatDriverState* driverState, uint32_t* bitmapCluster
 ) {
-  if (driverState == NULL || ranges == NULL || numRanges == NULL) {
+  if (driverState == NULL || bitmapCluster == NULL) {
     return EXFAT_INVALID_PARAMETER;
   }
 
-  *numRanges = 0;
   FilesystemState* filesystemState = driverState->filesystemState;
   uint8_t* buffer = filesystemState->blockBuffer;
 
+  // Scan root directory for bitmap entry (0x81)
   uint32_t currentCluster = driverState->rootDirectoryCluster;
 
   while (currentCluster != 0xFFFFFFFF && currentCluster >= 2) {
@@ -362,54 +430,15 @@ static int collectNoFatChainRanges(
         uint8_t entryType = buffer[ii];
 
         if (entryType == EXFAT_ENTRY_END_OF_DIR) {
-          return EXFAT_SUCCESS;
+          printString("  ERROR: Bitmap entry not found!\n");
+          return EXFAT_ERROR;
         }
 
-        if (entryType == EXFAT_ENTRY_FILE) {
-          if (ii + EXFAT_DIRECTORY_ENTRY_SIZE >=
-              driverState->bytesPerSector) {
-            continue;
-          }
-
-          uint8_t streamType = buffer[ii + EXFAT_DIRECTORY_ENTRY_SIZE];
-          if (streamType == EXFAT_ENTRY_STREAM) {
-            uint8_t flags = buffer[ii + EXFAT_DIRECTORY_ENTRY_SIZE + 1];
-            
-            // Check NoFatChain bit (bit 1)
-            if ((flags & 0x02) != 0) {
-              if (*numRanges >= maxRanges) {
-                printString("  WARNING: Too many NoFatChain files, ");
-                printString("some may not be tracked!\n");
-                return EXFAT_SUCCESS;
-              }
-
-              uint32_t firstCluster = 0;
-              readBytes(
-                &firstCluster,
-                &buffer[ii + EXFAT_DIRECTORY_ENTRY_SIZE + 20]
-              );
-
-              uint64_t dataLength = 0;
-              readBytes(
-                &dataLength,
-                &buffer[ii + EXFAT_DIRECTORY_ENTRY_SIZE + 24]
-              );
-
-              uint32_t clustersNeeded = 0;
-              if (dataLength > 0) {
-                clustersNeeded = 
-                  ((uint32_t) dataLength + driverState->bytesPerCluster - 1) /
-                  driverState->bytesPerCluster;
-              } else {
-                clustersNeeded = 1;
-              }
-
-              ranges[*numRanges].startCluster = firstCluster;
-              ranges[*numRanges].endCluster = firstCluster + clustersNeeded - 1;
-              
-              (*numRanges)++;
-            }
-          }
+        if (entryType == EXFAT_ENTRY_ALLOCATION_BITMAP) {
+          // Found it! Read the first cluster
+          readBytes(bitmapCluster, &buffer[ii + 20]);
+          
+          return EXFAT_SUCCESS;
         }
       }
     }
@@ -422,317 +451,613 @@ static int collectNoFatChainRanges(
     currentCluster = nextCluster;
   }
 
+  return EXFAT_ERROR;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief Locate the allocation bitmap and count the free clusters in each of
+/// its sectors
+///
+/// Called once at mount.  The counts let allocation skip over full parts of
+/// the disk without reading them.  Allocation still works without them, it
+/// just has to read every bitmap sector it passes.
+///
+/// @param driverState Pointer to the exFAT driver state
+///
+/// @return EXFAT_SUCCESS on success, error code on failure
+///////////////////////////////////////////////////////////////////////////////
+static int loadAllocationBitmap(ExFatDriverState* driverState) {
+  int result = findAllocationBitmap(driverState, &driverState->bitmapCluster);
+  if (result != EXFAT_SUCCESS) {
+    driverState->bitmapCluster = 0;
+    return result;
+  }
+
+  uint32_t clustersPerSector = driverState->bytesPerSector * 8;
+  driverState->bitmapSectors =
+    (driverState->clusterCount + clustersPerSector - 1) / clustersPerSector;
+  driverState->nextFreeCluster = 2;
+
+  driverState->bitmapFreeCounts = (uint16_t*) malloc(
+    driverState->bitmapSectors * sizeof(uint16_t)
+  );
+  if (driverState->bitmapFreeCounts == NULL) {
+    return EXFAT_NO_MEMORY;
+  }
+
+  uint8_t* buffer = driverState->filesystemState->blockBuffer;
+  for (uint32_t ii = 0; ii < driverState->bitmapSectors; ii++) {
+    result = readSector(driverState, bitmapSectorToSector(driverState, ii),
+      buffer);
+    if (result != EXFAT_SUCCESS) {
+      free(driverState->bitmapFreeCounts);
+      driverState->bitmapFreeCounts = NULL;
+      return result;
+    }
+
+    driverState->bitmapFreeCounts[ii] =
+      countFreeClustersInBitmapSector(driverState, ii, buffer);
+  }
+
   return EXFAT_SUCCESS;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-/// @brief Check if cluster is free in allocation bitmap
+/// @brief Find a free cluster (checks bitmap and FAT)
+///
+/// The search starts at the cluster after the last one allocated and wraps
+/// around the end of the disk.  Bitmap sectors with no free clusters are
+/// skipped without being read and fully allocated words are skipped a word at
+/// a time.
 ///
 /// @param driverState Pointer to the exFAT driver state
-/// @param bitmapCluster First cluster of allocation bitmap
-/// @param cluster Cluster to check
-/// @param isFree Pointer to store result (true if free)
+/// @param freeCluster Pointer to store the free cluster number
 ///
 /// @return EXFAT_SUCCESS on success, error code on failure
 ///////////////////////////////////////////////////////////////////////////////
-static int isClusterFreeInBitmap(
-  ExFatDriverState* driverState, uint32_t bitmapCluster,
-  uint32_t cluster, bool* isFree
+static int findFreeCluster(
+  ExFatDriverState* driverState, uint32_t* freeCluster
 ) {
-  if (driverState == NULL || isFree == NULL) {
+  if (driverState == NULL || freeCluster == NULL) {
     return EXFAT_INVALID_PARAMETER;
   }
 
+  if (driverState->bitmapCluster == 0) {
+    printString("  ERROR: Cannot find allocation bitmap\n");
+    return EXFAT_ERROR;
+  }
+
+  int result = EXFAT_SUCCESS;
   FilesystemState* filesystemState = driverState->filesystemState;
   uint8_t* buffer = filesystemState->blockBuffer;
+  uint32_t clustersPerSector = driverState->bytesPerSector * 8;
+  uint32_t hint = driverState->nextFreeCluster - 2;
+  if (hint >= driverState->clusterCount) {
+    hint = 0;
+  }
+  uint32_t hintSector = hint / clustersPerSector;
+
+  // Visit every bitmap sector starting with the one the hint is in.  The
+  // extra pass at the end covers the part of that sector before the hint.
+  for (uint32_t ii = 0; ii <= driverState->bitmapSectors; ii++) {
+    uint32_t sectorIndex = (hintSector + ii) % driverState->bitmapSectors;
+    if ((driverState->bitmapFreeCounts != NULL)
+      && (driverState->bitmapFreeCounts[sectorIndex] == 0)
+    ) {
+      continue;
+    }
 
-  // Calculate bit position (cluster 2 = bit 0)
-  uint32_t bitPosition = cluster - 2;
-  uint32_t byteOffset = bitPosition / 8;
-  uint8_t bitOffset = bitPosition % 8;
+    uint32_t firstBit = sectorIndex * clustersPerSector;
+    uint32_t startBit = 0;
+    uint32_t endBit = driverState->clusterCount - firstBit;
+    if (endBit > clustersPerSector) {
+      endBit = clustersPerSector;
+    }
+    if (ii == 0) {
+      startBit = hint - firstBit;
+    }
+    if (ii == driverState->bitmapSectors) {
+      endBit = hint - firstBit;
+    }
 
-  // Calculate sector containing this byte
-  uint32_t bytesPerCluster = driverState->bytesPerCluster;
-  uint32_t clusterOffset = byteOffset / bytesPerCluster;
-  uint32_t byteInCluster = byteOffset % bytesPerCluster;
-  uint32_t sectorInCluster = byteInCluster / driverState->bytesPerSector;
-  uint32_t byteInSector = byteInCluster % driverState->bytesPerSector;
+    uint32_t sector = bitmapSectorToSector(driverState, sectorIndex);
+    result = readSector(driverState, sector, buffer);
+    if (result != EXFAT_SUCCESS) {
+      return result;
+    }
 
-  // For now, assume bitmap fits in one cluster
-  // TODO: Handle multi-cluster bitmaps
-  if (clusterOffset > 0) {
-    printString("    WARNING: Bitmap cluster offset > 0\n");
-  }
+    uint32_t bit = startBit;
+    while (bit < endBit) {
+      if (((bit % 32) == 0) && (bit + 32 <= endBit)) {
+        uint32_t word = 0;
+        readBytes(&word, &buffer[bit / 8]);
+        if (word == 0xFFFFFFFF) {
+          bit += 32;
+          continue;
+        }
+      }
 
-  uint32_t bitmapSector = clusterToSector(driverState, bitmapCluster) +
-    sectorInCluster;
+      if ((buffer[bit / 8] & (1 << (bit % 8))) != 0) {
+        bit++;
+        continue;
+      }
 
-  // Read bitmap sector
-  int result = readSector(driverState, bitmapSector, buffer);
-  if (result != EXFAT_SUCCESS) {
-    return result;
+      uint32_t cluster = firstBit + bit + 2;
+      bit++;
+
+      // Double check the FAT in case the bitmap is out of step with it.
+      // NoFatChain files are marked in the bitmap like any other, so the
+      // bitmap alone covers them.
+      uint32_t fatValue = 0;
+      result = readFatEntry(driverState, cluster, &fatValue);
+      if (result != EXFAT_SUCCESS) {
+        return result;
+      }
+
+      if (fatValue == 0) {
+        // Found a truly free cluster!
+        *freeCluster = cluster;
+        return EXFAT_SUCCESS;
+      }
+
+      // Reading the FAT replaced the bitmap sector in the buffer.
+      result = readSector(driverState, sector, buffer);
+      if (result != EXFAT_SUCCESS) {
+        return result;
+      }
+    }
   }
 
-  // Check the bit
-  uint8_t byteValue = buffer[byteInSector];
-  bool bitSet = (byteValue & (1 << bitOffset)) != 0;
-  
-  *isFree = !bitSet;  // Bit set = allocated, bit clear = free
-  return EXFAT_SUCCESS;
+  // No free clusters
+  printString("  ERROR: No free clusters available\n");
+  return EXFAT_DISK_FULL;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-/// @brief Find the allocation bitmap location
+/// @brief Update the allocation bitmap for a run of clusters
+///
+/// Each bitmap sector the run touches is read and written once.  Also keeps
+/// the per-sector free counts current and moves the next-free hint past newly
+/// allocated clusters.
 ///
 /// @param driverState Pointer to the exFAT driver state
-/// @param bitmapCluster Pointer to store first cluster of bitmap
+/// @param firstCluster First cluster to mark as allocated/free
+/// @param numClusters Number of consecutive clusters to mark
+/// @param allocated true to mark as allocated, false for free
 ///
 /// @return EXFAT_SUCCESS on success, error code on failure
 ///////////////////////////////////////////////////////////////////////////////
-static int findAllocationBitmap(
-  ExFatDriverState* driverState, uint32_t* bitmapCluster
+static int updateAllocationBitmap(
+  ExFatDriverState* driverState, uint32_t firstCluster, uint32_t numClusters,
+  bool allocated
 ) {
-  if (driverState == NULL || bitmapCluster == NULL) {
+  if (driverState == NULL) {
     return EXFAT_INVALID_PARAMETER;
   }
 
+  if (driverState->bitmapCluster == 0) {
+    return EXFAT_ERROR;
+  }
+
   FilesystemState* filesystemState = driverState->filesystemState;
   uint8_t* buffer = filesystemState->blockBuffer;
 
-  // Scan root directory for bitmap entry (0x81)
-  uint32_t currentCluster = driverState->rootDirectoryCluster;
+  // Bitmap starts at cluster 2, so cluster N is at bit (N-2)
+  uint32_t clustersPerSector = driverState->bytesPerSector * 8;
+  uint32_t bitPosition = firstCluster - 2;
+  uint32_t endBitPosition = bitPosition + numClusters;
 
-  while (currentCluster != 0xFFFFFFFF && currentCluster >= 2) {
-    for (uint32_t ss = 0; ss < driverState->sectorsPerCluster; ss++) {
-      uint32_t sector = clusterToSector(driverState, currentCluster) + ss;
-      int result = readSector(driverState, sector, buffer);
+  while (bitPosition < endBitPosition) {
+    uint32_t sectorIndex = bitPosition / clustersPerSector;
+    uint32_t sectorEndBitPosition = (sectorIndex + 1) * clustersPerSector;
+    if (sectorEndBitPosition > endBitPosition) {
+      sectorEndBitPosition = endBitPosition;
+    }
+    uint32_t bitmapSector = bitmapSectorToSector(driverState, sectorIndex);
+
+    // Read bitmap sector
+    int result = readSector(driverState, bitmapSector, buffer);
+    if (result != EXFAT_SUCCESS) {
+      printString("  ERROR: Failed to read bitmap sector\n");
+      return result;
+    }
+
+    // Update the bits that need to change
+    uint16_t numChanged = 0;
+    for (; bitPosition < sectorEndBitPosition; bitPosition++) {
+      uint32_t bitInSector = bitPosition % clustersPerSector;
+      uint8_t mask = 1 << (bitInSector % 8);
+      bool wasAllocated = (buffer[bitInSector / 8] & mask) != 0;
+      if (wasAllocated != allocated) {
+        buffer[bitInSector / 8] ^= mask;
+        numChanged++;
+      }
+    }
+
+    if (numChanged > 0) {
+      // Write bitmap sector back
+      result = writeSector(driverState, bitmapSector, buffer);
       if (result != EXFAT_SUCCESS) {
+        printString("  ERROR: Failed to write bitmap sector\n");
         return result;
       }
 
-      for (
-        uint32_t ii = 0;
-        ii < driverState->bytesPerSector;
-        ii += EXFAT_DIRECTORY_ENTRY_SIZE
-      ) {
-        uint8_t entryType = buffer[ii];
-
-        if (entryType == EXFAT_ENTRY_END_OF_DIR) {
-          printString("  ERROR: Bitmap entry not found!\n");
-          return EXFAT_ERROR;
-        }
-
-        if (entryType == EXFAT_ENTRY_ALLOCATION_BITMAP) {
-          // Found it! Read the first cluster
-          readBytes(bitmapCluster, &buffer[ii + 20]);
-          
-          return EXFAT_SUCCESS;
+      if (driverState->bitmapFreeCounts != NULL) {
+        if (allocated) {
+          driverState->bitmapFreeCounts[sectorIndex] -= numChanged;
+        } else {
+          driverState->bitmapFreeCounts[sectorIndex] += numChanged;
         }
       }
     }
+  }
 
-    uint32_t nextCluster = 0;
-    int result = readFatEntry(driverState, currentCluster, &nextCluster);
-    if (result != EXFAT_SUCCESS) {
-      return result;
-    }
-    currentCluster = nextCluster;
+  if (allocated) {
+    driverState->nextFreeCluster = firstCluster + numClusters;
   }
 
-  return EXFAT_ERROR;
+  return EXFAT_SUCCESS;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-/// @brief Find a free cluster (checks bitmap, FAT, and NoFatChain)
+/// @brief Count the free clusters on the volume
 ///
 /// @param driverState Pointer to the exFAT driver state
-/// @param freeCluster Pointer to store the free cluster number
 ///
-/// @return EXFAT_SUCCESS on success, error code on failure
+/// @return The number of free clusters, or UINT32_MAX if the per-sector free
+/// counts could not be loaded at mount
 ///////////////////////////////////////////////////////////////////////////////
-static int findFreeCluster(
-  ExFatDriverState* driverState, uint32_t* freeCluster
-) {
-  if (driverState == NULL || freeCluster == NULL) {
-    return EXFAT_INVALID_PARAMETER;
+static uint32_t countFreeClusters(ExFatDriverState* driverState) {
+  if (driverState->bitmapFreeCounts == NULL) {
+    return UINT32_MAX;
   }
 
-  // Find bitmap location
-  uint32_t bitmapCluster = 0;
-  int result = findAllocationBitmap(driverState, &bitmapCluster);
-  if (result != EXFAT_SUCCESS) {
-    printString("  ERROR: Cannot find allocation bitmap\n");
-    return result;
+  uint32_t numFree = 0;
+  for (uint32_t ii = 0; ii < driverState->bitmapSectors; ii++) {
+    numFree += driverState->bitmapFreeCounts[ii];
   }
 
-  // Collect NoFatChain ranges (small memory footprint)
-  const uint8_t maxRanges = 16;
-  NoFatChainRange* ranges = (NoFatChainRange*) malloc(
-    maxRanges * sizeof(NoFatChainRange)
-  );
-  if (ranges == NULL) {
-    printString("  ERROR: Cannot allocate range array\n");
-    return EXFAT_NO_MEMORY;
-  }
+  return numFree;
+}
 
-  uint8_t numRanges = 0;
-  result = collectNoFatChainRanges(driverState, ranges, maxRanges, &numRanges);
-  if (result != EXFAT_SUCCESS) {
-    free(ranges);
-    return result;
+///////////////////////////////////////////////////////////////////////////////
+/// @brief Measure the run of free clusters that starts at a given cluster
+///
+/// Only the allocation bitmap is consulted.  findFreeCluster has already
+/// cross-checked the first cluster of any run the driver allocates, and the
+/// bitmap is authoritative for the rest.
+///
+/// @param driverState Pointer to the exFAT driver state
+/// @param firstCluster First cluster of the run
+/// @param maxLength The largest number of clusters the caller wants
+/// @param runLength Pointer to store the number of consecutive free clusters
+///   starting at firstCluster, at most maxLength
+///
+/// @return EXFAT_SUCCESS on success, error code on failure
+///////////////////////////////////////////////////////////////////////////////
+static int measureFreeRun(
+  ExFatDriverState* driverState, uint32_t firstCluster, uint32_t maxLength,
+  uint32_t* runLength
+) {
+  *runLength = 0;
+  if ((firstCluster < 2) || (firstCluster - 2 >= driverState->clusterCount)) {
+    return EXFAT_SUCCESS;
+  }
+  if (maxLength > driverState->clusterCount - (firstCluster - 2)) {
+    maxLength = driverState->clusterCount - (firstCluster - 2);
   }
 
-  for (uint32_t cluster = 2;
-    cluster < driverState->clusterCount + 2;
-    cluster++
-  ) {
-    // Check 1: NoFatChain ranges
-    if (isClusterInNoFatChainRange(cluster, ranges, numRanges)) {
+  FilesystemState* filesystemState = driverState->filesystemState;
+  uint8_t* buffer = filesystemState->blockBuffer;
+  uint32_t clustersPerSector = driverState->bytesPerSector * 8;
+  uint32_t loadedSectorIndex = UINT32_MAX;
+
+  while (*runLength < maxLength) {
+    uint32_t bitPosition = firstCluster - 2 + *runLength;
+    uint32_t sectorIndex = bitPosition / clustersPerSector;
+    if (sectorIndex != loadedSectorIndex) {
+      int result = readSector(driverState,
+        bitmapSectorToSector(driverState, sectorIndex), buffer);
+      if (result != EXFAT_SUCCESS) {
+        return result;
+      }
+      loadedSectorIndex = sectorIndex;
+    }
+
+    uint32_t bitInSector = bitPosition % clustersPerSector;
+    if (((bitInSector % 8) == 0) && (buffer[bitInSector / 8] == 0)
+      && (*runLength + 8 <= maxLength)
+    ) {
+      *runLength += 8;
       continue;
     }
 
-    // Check 2: Allocation bitmap
-    bool bitmapFree = false;
-    result = isClusterFreeInBitmap(
-      driverState, bitmapCluster, cluster, &bitmapFree
-    );
+    if ((buffer[bitInSector / 8] & (1 << (bitInSector % 8))) != 0) {
+      break;
+    }
+    (*runLength)++;
+  }
+
+  return EXFAT_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief Chain a run of consecutive clusters together in the FAT
+///
+/// Each cluster in the run points to the one after it and the last one is
+/// marked as the end of the chain.  Each FAT sector the run touches is read
+/// and written once.
+///
+/// @param driverState Pointer to the exFAT driver state
+/// @param firstCluster First cluster of the run
+/// @param numClusters Number of clusters in the run
+///
+/// @return EXFAT_SUCCESS on success, error code on failure
+///////////////////////////////////////////////////////////////////////////////
+static int writeFatChain(
+  ExFatDriverState* driverState, uint32_t firstCluster, uint32_t numClusters
+) {
+  FilesystemState* filesystemState = driverState->filesystemState;
+  uint8_t* buffer = filesystemState->blockBuffer;
+  uint32_t entriesPerSector = driverState->bytesPerSector / 4;
+  uint32_t cluster = firstCluster;
+  uint32_t endCluster = firstCluster + numClusters;
+
+  while (cluster < endCluster) {
+    uint32_t fatSectorIndex = cluster / entriesPerSector;
+    uint32_t fatSector = driverState->fatStartSector + fatSectorIndex;
+    uint32_t sectorEndCluster = (fatSectorIndex + 1) * entriesPerSector;
+    if (sectorEndCluster > endCluster) {
+      sectorEndCluster = endCluster;
+    }
+
+    int result = readSector(driverState, fatSector, buffer);
     if (result != EXFAT_SUCCESS) {
-      free(ranges);
+      printString("ERROR: Failed to read FAT sector!\n");
       return result;
     }
-    
-    if (!bitmapFree) {
-      continue;  // Bitmap says it's allocated
+
+    for (; cluster < sectorEndCluster; cluster++) {
+      uint32_t value = 0xFFFFFFFF;
+      if (cluster + 1 < endCluster) {
+        value = cluster + 1;
+      }
+      writeBytes(&buffer[(cluster % entriesPerSector) * 4], &value);
     }
 
-    // Check 3: FAT
-    uint32_t fatValue = 0;
-    result = readFatEntry(driverState, cluster, &fatValue);
+    result = writeSector(driverState, fatSector, buffer);
     if (result != EXFAT_SUCCESS) {
-      free(ranges);
+      printString("ERROR: Failed to write FAT sector!\n");
       return result;
     }
+  }
+
+  return EXFAT_SUCCESS;
+}
 
-    if (fatValue == 0) {
-      // Found a truly free cluster!
-      *freeCluster = cluster;
-      free(ranges);
-      return EXFAT_SUCCESS;
+///////////////////////////////////////////////////////////////////////////////
+/// @brief Add the clusters of a run to an open file's cluster index
+///
+/// The index holds the cluster at every Nth position of the file, from the
+/// start of the file up to as far as it has been walked.  When it fills up,
+/// every other entry is dropped and N is doubled, so it always covers
+/// everything that has been walked.
+///
+/// @param file Pointer to the file handle
+/// @param fileCluster Index within the file of the first cluster in the run
+/// @param firstCluster First cluster of the run
+/// @param numClusters Number of consecutive clusters in the run
+///////////////////////////////////////////////////////////////////////////////
+static void indexClusterRun(
+  ExFatFileHandle* file, uint32_t fileCluster, uint32_t firstCluster,
+  uint32_t numClusters
+) {
+  while (true) {
+    uint32_t nextIndexed
+      = ((uint32_t) file->numIndexed) << file->clusterIndexShift;
+    if ((nextIndexed < fileCluster)
+      || (nextIndexed - fileCluster >= numClusters)
+    ) {
+      return;
     }
-  }
 
-  // No free clusters
-  printString("  ERROR: No free clusters available\n");
-  free(ranges);
-  return EXFAT_DISK_FULL;
+    if (file->numIndexed == EXFAT_CLUSTER_INDEX_SIZE) {
+      for (uint8_t ii = 0; ii < EXFAT_CLUSTER_INDEX_SIZE / 2; ii++) {
+        file->clusterIndex[ii] = file->clusterIndex[ii * 2];
+      }
+      file->numIndexed = EXFAT_CLUSTER_INDEX_SIZE / 2;
+      file->clusterIndexShift++;
+      continue;
+    }
+
+    file->clusterIndex[file->numIndexed]
+      = firstCluster + (nextIndexed - fileCluster);
+    file->numIndexed++;
+  }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-/// @brief Update allocation bitmap for a cluster
+/// @brief Move an open file's current cluster to one of its clusters
+///
+/// Clusters of NoFatChain files are found directly.  FAT chains are walked
+/// from the closest known cluster before the one requested, which is either
+/// the current cluster or an entry in the file's cluster index.  The walk
+/// only reads a FAT sector when the chain leaves the one it already has.
 ///
 /// @param driverState Pointer to the exFAT driver state
-/// @param cluster Cluster to mark as allocated/free
-/// @param allocated true to mark as allocated, false for free
+/// @param file Pointer to the file handle
+/// @param clusterIndex Index of the cluster within the file
 ///
 /// @return EXFAT_SUCCESS on success, error code on failure
 ///////////////////////////////////////////////////////////////////////////////
-static int updateAllocationBitmap(
-  ExFatDriverState* driverState, uint32_t cluster, bool allocated
+static int seekToClusterIndex(
+  ExFatDriverState* driverState, ExFatFileHandle* file, uint32_t clusterIndex
 ) {
-  if (driverState == NULL) {
-    return EXFAT_INVALID_PARAMETER;
+  if (clusterIndex >= file->numClusters) {
+    return EXFAT_ERROR;
   }
 
-  FilesystemState* filesystemState = driverState->filesystemState;
-  uint8_t* buffer = filesystemState->blockBuffer;
-
-  // Find bitmap location
-  uint32_t bitmapCluster = 0;
-  int result = findAllocationBitmap(driverState, &bitmapCluster);
-  if (result != EXFAT_SUCCESS) {
-    return result;
+  if (file->noFatChain) {
+    file->currentCluster = file->firstCluster + clusterIndex;
+    file->currentClusterIndex = clusterIndex;
+    return EXFAT_SUCCESS;
   }
 
-  // Calculate which byte and bit in the bitmap
-  // Bitmap starts at cluster 2, so cluster N is at bit (N-2)
-  uint32_t bitPosition = cluster - 2;
-  uint32_t byteOffset = bitPosition / 8;
-  uint8_t bitOffset = bitPosition % 8;
-
-  // Calculate which sector of the bitmap contains this byte
-  uint32_t bytesPerCluster = driverState->bytesPerCluster;
-  uint32_t clusterOffset = byteOffset / bytesPerCluster;
-  uint32_t byteInCluster = byteOffset % bytesPerCluster;
-  uint32_t sectorInCluster = byteInCluster / driverState->bytesPerSector;
-  uint32_t byteInSector = byteInCluster % driverState->bytesPerSector;
-
-  // Calculate the actual bitmap cluster
-  // For simplicity, assume bitmap is in a single cluster for now
-  // TODO: Handle bitmaps that span multiple clusters
-  if (clusterOffset > 0) {
-    printString("  WARNING: Bitmap spans multiple clusters!\n");
-    // Would need to follow FAT chain here
-  }
-
-  uint32_t bitmapSector = clusterToSector(driverState, bitmapCluster) +
-    sectorInCluster;
-
-  // Read bitmap sector
-  result = readSector(driverState, bitmapSector, buffer);
-  if (result != EXFAT_SUCCESS) {
-    printString("  ERROR: Failed to read bitmap sector\n");
-    return result;
+  if (file->numIndexed == 0) {
+    indexClusterRun(file, 0, file->firstCluster, 1);
   }
+  uint32_t entry = clusterIndex >> file->clusterIndexShift;
+  if (entry >= file->numIndexed) {
+    entry = file->numIndexed - 1;
+  }
+  uint32_t entryClusterIndex = entry << file->clusterIndexShift;
 
-  // Update the bit
-  if (allocated) {
-    buffer[byteInSector] |= (1 << bitOffset);
-  } else {
-    buffer[byteInSector] &= ~(1 << bitOffset);
+  if ((file->currentCluster < 2)
+    || (clusterIndex < file->currentClusterIndex)
+    || (file->currentClusterIndex < entryClusterIndex)
+  ) {
+    file->currentCluster = file->clusterIndex[entry];
+    file->currentClusterIndex = entryClusterIndex;
   }
 
-  // Write bitmap sector back
-  result = writeSector(driverState, bitmapSector, buffer);
-  if (result != EXFAT_SUCCESS) {
-    printString("  ERROR: Failed to write bitmap sector\n");
-    return result;
+  FilesystemState* filesystemState = driverState->filesystemState;
+  uint8_t* buffer = filesystemState->blockBuffer;
+  uint32_t entriesPerSector = driverState->bytesPerSector / 4;
+  uint32_t loadedFatSector = 0;
+
+  while (file->currentClusterIndex < clusterIndex) {
+    uint32_t fatSector = driverState->fatStartSector
+      + (file->currentCluster / entriesPerSector);
+    if (fatSector != loadedFatSector) {
+      int result = readSector(driverState, fatSector, buffer);
+      if (result != EXFAT_SUCCESS) {
+        return result;
+      }
+      loadedFatSector = fatSector;
+    }
+
+    uint32_t nextCluster = 0;
+    readBytes(&nextCluster,
+      &buffer[(file->currentCluster % entriesPerSector) * 4]);
+    if ((nextCluster < 2) || (nextCluster - 2 >= driverState->clusterCount)) {
+      printString("ERROR: Invalid cluster in FAT chain\n");
+      return EXFAT_ERROR;
+    }
+
+    file->currentCluster = nextCluster;
+    file->currentClusterIndex++;
+    indexClusterRun(file, file->currentClusterIndex, nextCluster, 1);
   }
 
   return EXFAT_SUCCESS;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-/// @brief Allocate a new cluster (FIXED with bitmap support)
+/// @brief Allocate more clusters at the end of an open file
+///
+/// Clusters are allocated in runs of consecutive free clusters, preferring the
+/// ones right after the end of the file.  A file whose clusters are all
+/// consecutive is kept as a NoFatChain file and never touches the FAT.  It is
+/// given a FAT chain the first time it can't be extended in place.
 ///
 /// @param driverState Pointer to the exFAT driver state
-/// @param newCluster Pointer to store the allocated cluster number
+/// @param file Pointer to the file handle
+/// @param numNewClusters Number of clusters to add to the file
 ///
-/// @return EXFAT_SUCCESS on success, error code on failure
+/// @return EXFAT_SUCCESS on success, error code on failure.  EXFAT_DISK_FULL is
+/// returned without allocating anything if there aren't enough free clusters.
+/// Runs allocated before any other error remain part of the file.
 ///////////////////////////////////////////////////////////////////////////////
-static int allocateCluster(
-  ExFatDriverState* driverState, uint32_t* newCluster
+static int extendFile(
+  ExFatDriverState* driverState, ExFatFileHandle* file,
+  uint32_t numNewClusters
 ) {
-  if (driverState == NULL || newCluster == NULL) {
-    return EXFAT_INVALID_PARAMETER;
+  if (numNewClusters > countFreeClusters(driverState)) {
+    printString("  ERROR: No free clusters available\n");
+    return EXFAT_DISK_FULL;
   }
 
-  int result = findFreeCluster(driverState, newCluster);
-  if (result != EXFAT_SUCCESS) {
-    return result;
-  }
+  while (numNewClusters > 0) {
+    int result = EXFAT_SUCCESS;
+    uint32_t lastCluster = 0;
+    if (file->numClusters > 0) {
+      result = seekToClusterIndex(driverState, file, file->numClusters - 1);
+      if (result != EXFAT_SUCCESS) {
+        return result;
+      }
+      lastCluster = file->currentCluster;
+    }
 
-  // Update FAT
-  result = writeFatEntry(driverState, *newCluster, 0xFFFFFFFF);
-  if (result != EXFAT_SUCCESS) {
-    printString("  ERROR: Failed to write FAT entry\n");
-    return result;
-  }
+    // Grow in place if the clusters after the end of the file are free.
+    uint32_t runStart = lastCluster + 1;
+    uint32_t runLength = 0;
+    result = measureFreeRun(driverState, runStart, numNewClusters, &runLength);
+    if (result != EXFAT_SUCCESS) {
+      return result;
+    }
 
-  // Update allocation bitmap
-  result = updateAllocationBitmap(driverState, *newCluster, true);
-  if (result != EXFAT_SUCCESS) {
-    printString("  ERROR: Failed to update allocation bitmap\n");
-    return result;
+    if (runLength == 0) {
+      result = findFreeCluster(driverState, &runStart);
+      if (result != EXFAT_SUCCESS) {
+        return result;
+      }
+
+      result = measureFreeRun(
+        driverState, runStart, numNewClusters, &runLength);
+      if (result != EXFAT_SUCCESS) {
+        return result;
+      }
+      if (runLength == 0) {
+        // findFreeCluster only returns clusters that are free in the bitmap.
+        runLength = 1;
+      }
+    }
+
+    bool contiguous = (file->numClusters > 0) && (runStart == lastCluster + 1);
+    if ((file->numClusters > 0) && (!contiguous) && (file->noFatChain)) {
+      // The file can't stay contiguous, so its existing clusters need a FAT
+      // chain before the new run can be linked to them.
+      result = writeFatChain(
+        driverState, file->firstCluster, file->numClusters);
+      if (result != EXFAT_SUCCESS) {
+        return result;
+      }
+      file->noFatChain = false;
+      indexClusterRun(file, 0, file->firstCluster, file->numClusters);
+    }
+
+    result = updateAllocationBitmap(driverState, runStart, runLength, true);
+    if (result != EXFAT_SUCCESS) {
+      printString("  ERROR: Failed to update allocation bitmap\n");
+      return result;
+    }
+
+    if (file->numClusters == 0) {
+      file->firstCluster = runStart;
+      file->currentCluster = runStart;
+      file->currentClusterIndex = 0;
+      file->numIndexed = 0;
+      file->clusterIndexShift = 0;
+      file->noFatChain = true;
+    } else if (!file->noFatChain) {
+      if (contiguous) {
+        // Chaining from the old last cluster links the run in the same pass.
+        result = writeFatChain(driverState, lastCluster, runLength + 1);
+      } else {
+        result = writeFatChain(driverState, runStart, runLength);
+        if (result == EXFAT_SUCCESS) {
+          result = writeFatEntry(driverState, lastCluster, runStart);
+        }
+      }
+      if (result != EXFAT_SUCCESS) {
+        printString("  ERROR: Failed to write FAT entry\n");
+        return result;
+      }
+    }
+
+    indexClusterRun(file, file->numClusters, runStart, runLength);
+    file->numClusters += runLength;
+    numNewClusters -= runLength;
   }
 
   return EXFAT_SUCCESS;
@@ -922,11 +1247,14 @@ static int createFileEntry(
   FilesystemState* filesystemState = driverState->filesystemState;
   uint8_t* buffer = filesystemState->blockBuffer;
 
-  // Allocate UTF-16 name buffer
-  uint16_t* utf16Name = (uint16_t*) malloc(
+  // Allocate UTF-16 name buffer.  It and the entry set buffer come from the
+  // driver's arena and are released together at cleanup.
+  size_t arenaMark = arenaBegin(&driverState->arena);
+  uint16_t* utf16Name = (uint16_t*) arenaAlloc(&driverState->arena,
     EXFAT_MAX_FILENAME_LENGTH * sizeof(uint16_t)
   );
   if (utf16Name == NULL) {
+    arenaEnd(&driverState->arena, arenaMark);
     return EXFAT_NO_MEMORY;
   }
 
@@ -1030,7 +1358,7 @@ static int createFileEntry(
   }
 
   // Allocate a temporary buffer for building the entry set
-  uint8_t* entrySetBuffer = (uint8_t*) malloc(
+  uint8_t* entrySetBuffer = (uint8_t*) arenaAlloc(&driverState->arena,
     totalEntries * EXFAT_DIRECTORY_ENTRY_SIZE
   );
   if (entrySetBuffer == NULL) {
@@ -1130,7 +1458,6 @@ static int createFileEntry(
   // Read the target sector
   int result = readSector(driverState, targetSector, buffer);
   if (result != EXFAT_SUCCESS) {
-    free(entrySetBuffer);
     returnValue = result;
     goto cleanup;
   }
@@ -1142,7 +1469,6 @@ static int createFileEntry(
 
   // Write the sector back to disk
   result = writeSector(driverState, targetSector, buffer);
-  free(entrySetBuffer);
   
   if (result != EXFAT_SUCCESS) {
     returnValue = result;
@@ -1171,7 +1497,7 @@ static int createFileEntry(
   }
 
 cleanup:
-  free(utf16Name);
+  arenaEnd(&driverState->arena, arenaMark);
   return returnValue;
 }
 
@@ -1208,50 +1534,23 @@ static int searchDirectory(
   FilesystemState* filesystemState = driverState->filesystemState;
   uint8_t* buffer = filesystemState->blockBuffer;
 
-  // Allocate search name buffer
-  uint16_t* searchName = (uint16_t*) malloc(
-    EXFAT_MAX_FILENAME_LENGTH * sizeof(uint16_t)
-  );
-  if (searchName == NULL) {
-    return EXFAT_NO_MEMORY;
-  }
-
-  // Allocate full name buffer
-  uint16_t* fullName = (uint16_t*) malloc(
-    EXFAT_MAX_FILENAME_LENGTH * sizeof(uint16_t)
-  );
-  if (fullName == NULL) {
-    free(searchName);
-    return EXFAT_NO_MEMORY;
-  }
-
-  // Allocate temporary file entry
-  ExFatFileDirectoryEntry* tempFileEntry =
-    (ExFatFileDirectoryEntry*) malloc(sizeof(ExFatFileDirectoryEntry));
-  if (tempFileEntry == NULL) {
-    free(fullName);
-    free(searchName);
-    return EXFAT_NO_MEMORY;
-  }
-
-  // Allocate temporary stream entry
-  ExFatStreamExtensionEntry* tempStreamEntry =
-    (ExFatStreamExtensionEntry*) malloc(sizeof(ExFatStreamExtensionEntry));
-  if (tempStreamEntry == NULL) {
-    free(tempFileEntry);
-    free(fullName);
-    free(searchName);
-    return EXFAT_NO_MEMORY;
-  }
-
-  // Allocate temporary name entry
-  ExFatFileNameEntry* nameEntry =
-    (ExFatFileNameEntry*) malloc(sizeof(ExFatFileNameEntry));
-  if (nameEntry == NULL) {
-    free(tempStreamEntry);
-    free(tempFileEntry);
-    free(fullName);
-    free(searchName);
+  // The temporaries all come from the driver's arena and are released
+  // together at cleanup.
+  size_t arenaMark = arenaBegin(&driverState->arena);
+  uint16_t* searchName = (uint16_t*) arenaAlloc(&driverState->arena,
+    EXFAT_MAX_FILENAME_LENGTH * sizeof(uint16_t));
+  uint16_t* fullName = (uint16_t*) arenaAlloc(&driverState->arena,
+    EXFAT_MAX_FILENAME_LENGTH * sizeof(uint16_t));
+  ExFatFileDirectoryEntry* tempFileEntry = (ExFatFileDirectoryEntry*)
+    arenaAlloc(&driverState->arena, sizeof(ExFatFileDirectoryEntry));
+  ExFatStreamExtensionEntry* tempStreamEntry = (ExFatStreamExtensionEntry*)
+    arenaAlloc(&driverState->arena, sizeof(ExFatStreamExtensionEntry));
+  ExFatFileNameEntry* nameEntry = (ExFatFileNameEntry*)
+    arenaAlloc(&driverState->arena, sizeof(ExFatFileNameEntry));
+  if ((searchName == NULL) || (fullName == NULL) || (tempFileEntry == NULL)
+    || (tempStreamEntry == NULL) || (nameEntry == NULL)
+  ) {
+    arenaEnd(&driverState->arena, arenaMark);
     return EXFAT_NO_MEMORY;
   }
 
@@ -1448,11 +1747,7 @@ static int searchDirectory(
   }
 
 cleanup:
-  free(nameEntry);
-  free(tempStreamEntry);
-  free(tempFileEntry);
-  free(fullName);
-  free(searchName);
+  arenaEnd(&driverState->arena, arenaMark);
   return returnValue;
 }
 
@@ -1476,26 +1771,17 @@ static int navigateToDirectory(
     return EXFAT_INVALID_PARAMETER;
   }
 
-  // Allocate component buffer
-  char* component = (char*) malloc(EXFAT_MAX_FILENAME_LENGTH + 1);
-  if (component == NULL) {
-    return EXFAT_NO_MEMORY;
-  }
-
-  // Allocate directory entry
-  ExFatFileDirectoryEntry* dirEntry =
-    (ExFatFileDirectoryEntry*) malloc(sizeof(ExFatFileDirectoryEntry));
-  if (dirEntry == NULL) {
-    free(component);
-    return EXFAT_NO_MEMORY;
-  }
-
-  // Allocate stream entry
-  ExFatStreamExtensionEntry* streamEntry =
-    (ExFatStreamExtensionEntry*) malloc(sizeof(ExFatStreamExtensionEntry));
-  if (streamEntry == NULL) {
-    free(dirEntry);
-    free(component);
+  // The temporaries all come from the driver's arena and are released
+  // together at cleanup.
+  size_t arenaMark = arenaBegin(&driverState->arena);
+  char* component
+    = (char*) arenaAlloc(&driverState->arena, EXFAT_MAX_FILENAME_LENGTH + 1);
+  ExFatFileDirectoryEntry* dirEntry = (ExFatFileDirectoryEntry*)
+    arenaAlloc(&driverState->arena, sizeof(ExFatFileDirectoryEntry));
+  ExFatStreamExtensionEntry* streamEntry = (ExFatStreamExtensionEntry*)
+    arenaAlloc(&driverState->arena, sizeof(ExFatStreamExtensionEntry));
+  if ((component == NULL) || (dirEntry == NULL) || (streamEntry == NULL)) {
+    arenaEnd(&driverState->arena, arenaMark);
     return EXFAT_NO_MEMORY;
   }
 
@@ -1571,12 +1857,17 @@ static int navigateToDirectory(
   fileNameBuffer[0] = '\0';
 
 cleanup:
-  free(streamEntry);
-  free(dirEntry);
-  free(component);
+  arenaEnd(&driverState->arena, arenaMark);
   return returnValue;
 }
 
+// Defined below with the rest of the write and remove support.
+static int updateDirectoryEntry(
+  ExFatDriverState* driverState, ExFatFileHandle* file);
+static int freeFileClusters(
+  ExFatDriverState* driverState, uint32_t firstCluster, uint32_t numClusters,
+  bool noFatChain);
+
 ///////////////////////////////////////////////////////////////////////////////
 /// @brief Open or create an exFAT file
 ///
@@ -1635,28 +1926,17 @@ ExFatFileHandle* exFatOpenFile(
     return NULL;
   }
 
-  // Allocate filename buffer
-  char* fileName = (char*) malloc(EXFAT_MAX_FILENAME_LENGTH + 1);
-  if (fileName == NULL) {
-    free(handle);
-    return NULL;
-  }
-
-  // Allocate file entry
-  ExFatFileDirectoryEntry* fileEntry =
-    (ExFatFileDirectoryEntry*) malloc(sizeof(ExFatFileDirectoryEntry));
-  if (fileEntry == NULL) {
-    free(fileName);
-    free(handle);
-    return NULL;
-  }
-
-  // Allocate stream entry
-  ExFatStreamExtensionEntry* streamEntry =
-    (ExFatStreamExtensionEntry*) malloc(sizeof(ExFatStreamExtensionEntry));
-  if (streamEntry == NULL) {
-    free(fileEntry);
-    free(fileName);
+  // The temporaries all come from the driver's arena and are released
+  // together before returning.
+  size_t arenaMark = arenaBegin(&driverState->arena);
+  char* fileName
+    = (char*) arenaAlloc(&driverState->arena, EXFAT_MAX_FILENAME_LENGTH + 1);
+  ExFatFileDirectoryEntry* fileEntry = (ExFatFileDirectoryEntry*)
+    arenaAlloc(&driverState->arena, sizeof(ExFatFileDirectoryEntry));
+  ExFatStreamExtensionEntry* streamEntry = (ExFatStreamExtensionEntry*)
+    arenaAlloc(&driverState->arena, sizeof(ExFatStreamExtensionEntry));
+  if ((fileName == NULL) || (fileEntry == NULL) || (streamEntry == NULL)) {
+    arenaEnd(&driverState->arena, arenaMark);
     free(handle);
     return NULL;
   }
@@ -1669,9 +1949,7 @@ ExFatFileHandle* exFatOpenFile(
   );
 
   if (result != EXFAT_SUCCESS) {
-    free(streamEntry);
-    free(fileEntry);
-    free(fileName);
+    arenaEnd(&driverState->arena, arenaMark);
     free(handle);
     return NULL;
   }
@@ -1687,9 +1965,7 @@ ExFatFileHandle* exFatOpenFile(
 
   if (result == EXFAT_FILE_NOT_FOUND) {
     if (mustExist) {
-      free(streamEntry);
-      free(fileEntry);
-      free(fileName);
+      arenaEnd(&driverState->arena, arenaMark);
       free(handle);
       return NULL;
     }
@@ -1700,16 +1976,12 @@ ExFatFileHandle* exFatOpenFile(
       &dirCluster, &dirOffset
     );
     if (result != EXFAT_SUCCESS) {
-      free(streamEntry);
-      free(fileEntry);
-      free(fileName);
+      arenaEnd(&driverState->arena, arenaMark);
       free(handle);
       return NULL;
     }
   } else if (result != EXFAT_SUCCESS) {
-    free(streamEntry);
-    free(fileEntry);
-    free(fileName);
+    arenaEnd(&driverState->arena, arenaMark);
     free(handle);
     return NULL;
   }
@@ -1719,9 +1991,7 @@ ExFatFileHandle* exFatOpenFile(
   readBytes(&fileAttributes, &fileEntry->fileAttributes);
   if ((write || append) &&
       ((fileAttributes & EXFAT_ATTR_READ_ONLY) != 0)) {
-    free(streamEntry);
-    free(fileEntry);
-    free(fileName);
+    arenaEnd(&driverState->arena, arenaMark);
     free(handle);
     return NULL;  // Cannot open read-only file for writing
   }
@@ -1731,11 +2001,33 @@ ExFatFileHandle* exFatOpenFile(
   readBytes(&firstCluster, &streamEntry->firstCluster);
   handle->firstCluster = firstCluster;
   handle->currentCluster = firstCluster;
+  handle->currentClusterIndex = 0;
+  handle->numIndexed = 0;
+  handle->clusterIndexShift = 0;
 
   uint64_t fileSize = 0;
   readBytes(&fileSize, &streamEntry->dataLength);
   handle->fileSize = fileSize;
 
+  uint64_t validDataLength = 0;
+  readBytes(&validDataLength, &streamEntry->validDataLength);
+  if (validDataLength > fileSize) {
+    validDataLength = fileSize;
+  }
+  handle->validDataLength = validDataLength;
+
+  uint8_t streamFlags = 0;
+  readBytes(&streamFlags, &streamEntry->generalSecondaryFlags);
+  handle->noFatChain = ((streamFlags & EXFAT_FLAG_NO_FAT_CHAIN) != 0)
+    && (firstCluster >= 2);
+  handle->numClusters = (uint32_t) (
+    (fileSize + driverState->bytesPerCluster - 1)
+    / driverState->bytesPerCluster);
+  if ((handle->numClusters == 0) && (firstCluster >= 2)) {
+    // Empty, but a cluster was allocated anyway.
+    handle->numClusters = 1;
+  }
+
   uint16_t attributes = 0;
   readBytes(&attributes, &fileEntry->fileAttributes);
   handle->attributes = attributes;
@@ -1756,50 +2048,108 @@ ExFatFileHandle* exFatOpenFile(
   printDebugString(handle->fileName);
   printDebugString("\"\n");
 
-  // Set position based on mode
+  // Set position based on mode.  The current cluster catches up with the
+  // position on the next read or write.
   if (append) {
     handle->currentPosition = (uint32_t) handle->fileSize;
-    // Navigate to last cluster
-    uint32_t cluster = handle->firstCluster;
-    uint32_t position = 0;
-    while (position + driverState->bytesPerCluster < handle->fileSize) {
-      uint32_t nextCluster = 0;
-      if (readFatEntry(driverState, cluster, &nextCluster) !=
-          EXFAT_SUCCESS) {
-        free(streamEntry);
-        free(fileEntry);
-        free(fileName);
-        free(handle);
-        return NULL;
-      }
-      if (nextCluster == 0xFFFFFFFF) {
-        break;
-      }
-      cluster = nextCluster;
-      position += driverState->bytesPerCluster;
-    }
-    handle->currentCluster = cluster;
   } else {
     handle->currentPosition = 0;
   }
 
   // Truncate if needed
-  if (truncate && handle->fileSize > 0) {
-    handle->fileSize = 0;
+  if (truncate && (handle->firstCluster >= 2)) {
+    uint32_t oldFirstCluster = handle->firstCluster;
+    uint32_t oldNumClusters = handle->numClusters;
+    bool oldNoFatChain = handle->noFatChain;
+
+    handle->firstCluster = 0;
+    handle->currentCluster = 0;
+    handle->currentClusterIndex = 0;
+    handle->numIndexed = 0;
+    handle->clusterIndexShift = 0;
     handle->currentPosition = 0;
-    // TODO: Free all clusters and update directory entry
-    // This requires implementing cluster freeing logic
+    handle->fileSize = 0;
+    handle->validDataLength = 0;
+    handle->numClusters = 0;
+    handle->noFatChain = false;
+
+    // Detach the clusters from the directory entry before freeing them so
+    // that a failure can only leak them, never leave them shared.
+    if (updateDirectoryEntry(driverState, handle) != EXFAT_SUCCESS) {
+      arenaEnd(&driverState->arena, arenaMark);
+      free(handle);
+      return NULL;
+    }
+    if (freeFileClusters(driverState, oldFirstCluster, oldNumClusters,
+      oldNoFatChain) != EXFAT_SUCCESS
+    ) {
+      printString("WARNING: Failed to free truncated clusters\n");
+    }
   }
 
-  free(streamEntry);
-  free(fileEntry);
-  free(fileName);
+  arenaEnd(&driverState->arena, arenaMark);
   return handle;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// @brief Find the run of sectors that are consecutive both in an open file
+/// and on the disk, starting at a sector-aligned position in the file
+///
+/// The run continues into following clusters for as long as each one comes
+/// right after the last on the disk.  Leaves the file's current cluster at or
+/// just past the end of the run.
+///
+/// @param driverState Pointer to the exFAT driver state
+/// @param file Pointer to the file handle
+/// @param position Sector-aligned position in the file where the run starts
+/// @param maxSectors Maximum number of sectors to include in the run
+/// @param firstSector Where to store the first sector of the run
+/// @param numSectors Where to store the number of sectors in the run
+///
+/// @return EXFAT_SUCCESS on success, error code on failure
+///////////////////////////////////////////////////////////////////////////////
+static int findSectorRun(
+  ExFatDriverState* driverState, ExFatFileHandle* file, uint32_t position,
+  uint32_t maxSectors, uint32_t* firstSector, uint32_t* numSectors
+) {
+  uint32_t clusterIndex = position / driverState->bytesPerCluster;
+  int result = seekToClusterIndex(driverState, file, clusterIndex);
+  if (result != EXFAT_SUCCESS) {
+    return result;
+  }
+
+  uint32_t sectorInCluster = (position % driverState->bytesPerCluster)
+    / driverState->bytesPerSector;
+  *firstSector = clusterToSector(driverState, file->currentCluster)
+    + sectorInCluster;
+  uint32_t runLength = driverState->sectorsPerCluster - sectorInCluster;
+
+  while ((runLength < maxSectors)
+    && (clusterIndex + 1 < file->numClusters)
+  ) {
+    uint32_t lastCluster = file->currentCluster;
+    clusterIndex++;
+    result = seekToClusterIndex(driverState, file, clusterIndex);
+    if (result != EXFAT_SUCCESS) {
+      return result;
+    }
+    if (file->currentCluster != lastCluster + 1) {
+      break;
+    }
+    runLength += driverState->sectorsPerCluster;
+  }
+
+  *numSectors = (runLength < maxSectors) ? runLength : maxSectors;
+  return EXFAT_SUCCESS;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /// @brief Read data from an exFAT file
 ///
+/// Whole sectors are read straight into the caller's buffer, as many
+/// consecutive ones at a time as the file's layout allows.  Only partial
+/// sectors at the start and end go through the block buffer.
+///
 /// @param driverState Pointer to the exFAT driver state
 /// @param ptr Pointer to buffer to store read data
 /// @param length Maximum number of bytes to read
@@ -1846,7 +2196,7 @@ int32_t exFatRead(
   }
 
   // Check if file has valid cluster
-  if (file->currentCluster < 2) {
+  if (file->firstCluster < 2) {
     return -EIO; // File has no data clusters
   }
 
@@ -1856,6 +2206,18 @@ int32_t exFatRead(
   uint32_t bytesRead = 0;
 
   while (bytesRead < length) {
+    // Nothing has been written past the valid data length, so the rest of
+    // the file reads as zeros without touching the disk.
+    if (file->currentPosition >= file->validDataLength) {
+      uint32_t bytesToZero = length - bytesRead;
+      for (uint32_t ii = 0; ii < bytesToZero; ii++) {
+        destPtr[bytesRead + ii] = 0;
+      }
+      bytesRead += bytesToZero;
+      file->currentPosition += bytesToZero;
+      break;
+    }
+
     // Calculate position within current cluster
     uint32_t positionInCluster = file->currentPosition %
       driverState->bytesPerCluster;
@@ -1874,13 +2236,57 @@ int32_t exFatRead(
     if (bytesToRead > bytesInSector) {
       bytesToRead = bytesInSector;
     }
+    if (bytesToRead > file->validDataLength - file->currentPosition) {
+      bytesToRead = (uint32_t) (file->validDataLength - file->currentPosition);
+    }
+
+    // Whole sectors don't need the block buffer.
+    uint32_t maxSectors = 0;
+    if (offsetInSector == 0) {
+      uint64_t bytesAvailable = file->validDataLength - file->currentPosition;
+      if (bytesAvailable > length - bytesRead) {
+        bytesAvailable = length - bytesRead;
+      }
+      maxSectors = (uint32_t) (bytesAvailable / driverState->bytesPerSector);
+    }
+    if (maxSectors > 0) {
+      uint32_t firstSector = 0;
+      uint32_t numSectors = 0;
+      int result = findSectorRun(driverState, file, file->currentPosition,
+        maxSectors, &firstSector, &numSectors);
+      if (result == EXFAT_SUCCESS) {
+        result = readSectors(driverState, firstSector, numSectors,
+          &destPtr[bytesRead]);
+      }
+      if (result != EXFAT_SUCCESS) {
+        if (bytesRead > 0) {
+          return bytesRead; // Return what we've read so far
+        }
+        return -EIO;
+      }
+
+      bytesToRead = numSectors * driverState->bytesPerSector;
+      bytesRead += bytesToRead;
+      file->currentPosition += bytesToRead;
+      continue;
+    }
+
+    // Find the cluster that holds the current position
+    int result = seekToClusterIndex(driverState, file,
+      file->currentPosition / driverState->bytesPerCluster);
+    if (result != EXFAT_SUCCESS) {
+      if (bytesRead > 0) {
+        return bytesRead; // Return what we've read so far
+      }
+      return -EIO;
+    }
 
     // Calculate the actual sector number
     uint32_t sector = clusterToSector(driverState, file->currentCluster) +
       sectorInCluster;
 
     // Read the sector
-    int result = readSector(driverState, sector, buffer);
+    result = readSector(driverState, sector, buffer);
     if (result != EXFAT_SUCCESS) {
       printDebugString(__func__);
       printDebugString(": readSector failed\n");
@@ -1904,34 +2310,6 @@ int32_t exFatRead(
 
     bytesRead += bytesToRead;
     file->currentPosition += bytesToRead;
-
-    // Check if we've finished reading
-    if (bytesRead >= length) {
-      break;
-    }
-
-    // Check if we need to move to next cluster
-    uint32_t newPositionInCluster = file->currentPosition %
-      driverState->bytesPerCluster;
-    
-    if (newPositionInCluster == 0) {
-      // We've exhausted the current cluster, get next cluster from FAT
-      uint32_t nextCluster = 0;
-      result = readFatEntry(driverState, file->currentCluster, &nextCluster);
-      if (result != EXFAT_SUCCESS) {
-        if (bytesRead > 0) {
-          return bytesRead; // Return what we've read so far
-        }
-        return -EIO;
-      }
-
-      if (nextCluster == 0xFFFFFFFF) {
-        // End of file chain - shouldn't happen if fileSize is correct
-        break;
-      }
-
-      file->currentCluster = nextCluster;
-    }
   }
 
   printDebugString(__func__);
@@ -1980,10 +2358,14 @@ static int updateDirectoryEntry(
     return result;
   }
 
-  // Allocate temporary file entry
-  ExFatFileDirectoryEntry* fileEntry =
-    (ExFatFileDirectoryEntry*) malloc(sizeof(ExFatFileDirectoryEntry));
-  if (fileEntry == NULL) {
+  // Allocate temporary file and stream entries from the driver's arena
+  size_t arenaMark = arenaBegin(&driverState->arena);
+  ExFatFileDirectoryEntry* fileEntry = (ExFatFileDirectoryEntry*)
+    arenaAlloc(&driverState->arena, sizeof(ExFatFileDirectoryEntry));
+  ExFatStreamExtensionEntry* streamEntry = (ExFatStreamExtensionEntry*)
+    arenaAlloc(&driverState->arena, sizeof(ExFatStreamExtensionEntry));
+  if ((fileEntry == NULL) || (streamEntry == NULL)) {
+    arenaEnd(&driverState->arena, arenaMark);
     return EXFAT_NO_MEMORY;
   }
 
@@ -1994,7 +2376,7 @@ static int updateDirectoryEntry(
   readBytes(&secondaryCount, &fileEntry->secondaryCount);
 
   if (secondaryCount < 2) {
-    free(fileEntry);
+    arenaEnd(&driverState->arena, arenaMark);
     printString("  ERROR: Invalid secondary count\n");
     return EXFAT_ERROR;
   }
@@ -2019,7 +2401,7 @@ static int updateDirectoryEntry(
     // Write file entry sector first
     result = writeSector(driverState, sector, buffer);
     if (result != EXFAT_SUCCESS) {
-      free(fileEntry);
+      arenaEnd(&driverState->arena, arenaMark);
       printString("  ERROR: Failed to write file entry sector\n");
       return result;
     }
@@ -2027,26 +2409,23 @@ static int updateDirectoryEntry(
     // Read stream entry sector
     result = readSector(driverState, streamSector, buffer);
     if (result != EXFAT_SUCCESS) {
-      free(fileEntry);
+      arenaEnd(&driverState->arena, arenaMark);
       printString("  ERROR: Failed to read stream entry sector\n");
       return result;
     }
   }
 
-  // Allocate temporary stream entry
-  ExFatStreamExtensionEntry* streamEntry =
-    (ExFatStreamExtensionEntry*) malloc(sizeof(ExFatStreamExtensionEntry));
-  if (streamEntry == NULL) {
-    free(fileEntry);
-    return EXFAT_NO_MEMORY;
-  }
-
   // Read stream entry from buffer
   readBytes(streamEntry, &buffer[streamEntryOffsetInSector]);
 
   // Update stream entry with new size and cluster info
+  uint8_t streamFlags = EXFAT_FLAG_ALLOCATION_POSSIBLE;
+  if (file->noFatChain) {
+    streamFlags |= EXFAT_FLAG_NO_FAT_CHAIN;
+  }
+  writeBytes(&streamEntry->generalSecondaryFlags, &streamFlags);
   writeBytes(&streamEntry->dataLength, &file->fileSize);
-  writeBytes(&streamEntry->validDataLength, &file->fileSize);
+  writeBytes(&streamEntry->validDataLength, &file->validDataLength);
   writeBytes(&streamEntry->firstCluster, &file->firstCluster);
 
   // Write updated stream entry back to buffer
@@ -2055,8 +2434,7 @@ static int updateDirectoryEntry(
   // Write the sector back to disk
   result = writeSector(driverState, streamSector, buffer);
 
-  free(streamEntry);
-  free(fileEntry);
+  arenaEnd(&driverState->arena, arenaMark);
 
   if (result != EXFAT_SUCCESS) {
     printString("  ERROR: Failed to write stream entry sector\n");
@@ -2066,9 +2444,72 @@ static int updateDirectoryEntry(
   return EXFAT_SUCCESS;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// @brief Write zeros to part of an open file
+///
+/// Used to fill the gap between the valid data length and a write that starts
+/// past it.  The clusters must already be allocated.
+///
+/// @param driverState Pointer to the exFAT driver state
+/// @param file Pointer to the file handle
+/// @param startPosition Position of the first byte to zero
+/// @param endPosition Position one past the last byte to zero
+///
+/// @return EXFAT_SUCCESS on success, error code on failure
+///////////////////////////////////////////////////////////////////////////////
+static int zeroFileRange(
+  ExFatDriverState* driverState, ExFatFileHandle* file,
+  uint32_t startPosition, uint32_t endPosition
+) {
+  FilesystemState* filesystemState = driverState->filesystemState;
+  uint8_t* buffer = filesystemState->blockBuffer;
+  uint32_t position = startPosition;
+
+  while (position < endPosition) {
+    uint32_t positionInCluster = position % driverState->bytesPerCluster;
+    uint32_t offsetInSector = positionInCluster % driverState->bytesPerSector;
+    uint32_t bytesToZero = driverState->bytesPerSector - offsetInSector;
+    if (bytesToZero > endPosition - position) {
+      bytesToZero = endPosition - position;
+    }
+
+    int result = seekToClusterIndex(driverState, file,
+      position / driverState->bytesPerCluster);
+    if (result != EXFAT_SUCCESS) {
+      return result;
+    }
+
+    uint32_t sector = clusterToSector(driverState, file->currentCluster) +
+      (positionInCluster / driverState->bytesPerSector);
+    if (bytesToZero < driverState->bytesPerSector) {
+      result = readSector(driverState, sector, buffer);
+      if (result != EXFAT_SUCCESS) {
+        return result;
+      }
+    }
+
+    for (uint32_t ii = 0; ii < bytesToZero; ii++) {
+      buffer[offsetInSector + ii] = 0;
+    }
+
+    result = writeSector(driverState, sector, buffer);
+    if (result != EXFAT_SUCCESS) {
+      return result;
+    }
+
+    position += bytesToZero;
+  }
+
+  return EXFAT_SUCCESS;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /// @brief Write data to an exFAT file
 ///
+/// Whole sectors are written straight from the caller's buffer, as many
+/// consecutive ones at a time as the file's layout allows.  Only partial
+/// sectors at the start and end go through the block buffer.
+///
 /// @param driverState Pointer to the exFAT driver state
 /// @param ptr Pointer to buffer containing data to write
 /// @param length Number of bytes to write
@@ -2101,16 +2542,50 @@ int32_t exFatWrite(
   uint8_t* srcPtr = (uint8_t*) ptr;
   uint32_t bytesWritten = 0;
 
-  // If file has no clusters yet, allocate the first one
-  if (file->firstCluster == 0 || file->firstCluster < 2) {
-    uint32_t newCluster = 0;
-    int result = allocateCluster(driverState, &newCluster);
+  // Allocate everything the write needs up front so that the clusters come
+  // from as few runs as possible.
+  uint64_t endPosition = (uint64_t) file->currentPosition + length;
+  uint32_t clustersNeeded = (uint32_t) (
+    (endPosition + driverState->bytesPerCluster - 1)
+    / driverState->bytesPerCluster);
+  if (clustersNeeded > file->numClusters) {
+    uint32_t numNewClusters = clustersNeeded - file->numClusters;
+    uint32_t numFreeClusters = countFreeClusters(driverState);
+    if (numNewClusters > numFreeClusters) {
+      // Write as much as will fit.
+      numNewClusters = numFreeClusters;
+    }
+
+    int result = EXFAT_DISK_FULL;
+    if (numNewClusters > 0) {
+      result = extendFile(driverState, file, numNewClusters);
+    }
+
+    uint64_t allocatedBytes
+      = (uint64_t) file->numClusters * driverState->bytesPerCluster;
+    if (allocatedBytes <= file->currentPosition) {
+      printString("  ERROR: Failed to allocate new cluster\n");
+      if ((result == EXFAT_SUCCESS) || (result == EXFAT_DISK_FULL)) {
+        return -ENOSPC;
+      }
+      return -EIO;
+    }
+    if (endPosition > allocatedBytes) {
+      length = (uint32_t) (allocatedBytes - file->currentPosition);
+    }
+  }
+
+  // Nothing has been written between the valid data length and the current
+  // position, so that gap has to be zeroed before the valid data length can
+  // move past it.
+  if (file->currentPosition > file->validDataLength) {
+    int result = zeroFileRange(driverState, file,
+      (uint32_t) file->validDataLength, file->currentPosition);
     if (result != EXFAT_SUCCESS) {
-      printString("  ERROR: Failed to allocate first cluster\n");
-      return -ENOSPC;
+      printString("  ERROR: Failed to zero skipped bytes\n");
+      return -EIO;
     }
-    file->firstCluster = newCluster;
-    file->currentCluster = newCluster;
+    file->validDataLength = file->currentPosition;
   }
 
   // Main write loop
@@ -2119,51 +2594,15 @@ int32_t exFatWrite(
     uint32_t positionInCluster = file->currentPosition %
       driverState->bytesPerCluster;
 
-    // Check if we need to move to or allocate a new cluster
-    if (positionInCluster == 0 && file->currentPosition > 0) {
-      // Try to get next cluster from FAT
-      uint32_t nextCluster = 0;
-      int result = readFatEntry(
-        driverState, file->currentCluster, &nextCluster
-      );
-      if (result != EXFAT_SUCCESS) {
-        if (bytesWritten > 0) {
-          break;
-        }
-        printString("  ERROR: Failed to read FAT entry\n");
-        return -EIO;
-      }
-
-      if (nextCluster == 0xFFFFFFFF) {
-        // At end of chain, need to allocate new cluster
-        uint32_t allocatedCluster = 0;
-        result = allocateCluster(driverState, &allocatedCluster);
-        if (result != EXFAT_SUCCESS) {
-          // Out of space - return what we've written so far
-          if (bytesWritten > 0) {
-            break;
-          }
-          printString("  ERROR: Failed to allocate new cluster\n");
-          return -ENOSPC;
-        }
-
-        // Link new cluster to chain
-        result = writeFatEntry(
-          driverState, file->currentCluster, allocatedCluster
-        );
-        if (result != EXFAT_SUCCESS) {
-          if (bytesWritten > 0) {
-            break;
-          }
-          printString("  ERROR: Failed to update FAT chain\n");
-          return -EIO;
-        }
-
-        nextCluster = allocatedCluster;
+    // Find the cluster that holds the current position
+    int result = seekToClusterIndex(driverState, file,
+      file->currentPosition / driverState->bytesPerCluster);
+    if (result != EXFAT_SUCCESS) {
+      if (bytesWritten > 0) {
+        break;
       }
-
-      file->currentCluster = nextCluster;
-      positionInCluster = 0;
+      printString("  ERROR: Failed to find cluster\n");
+      return -EIO;
     }
 
     // Calculate sector and offset within sector
@@ -2179,15 +2618,33 @@ int32_t exFatWrite(
       bytesToWrite = bytesInSector;
     }
 
-    // Calculate the actual sector number
-    uint32_t sector = clusterToSector(driverState, file->currentCluster) +
-      sectorInCluster;
-
-    // If we're not writing a full sector or not starting at offset 0,
-    // we need to read-modify-write
-    if (offsetInSector != 0 ||
-        bytesToWrite < driverState->bytesPerSector) {
-      int result = readSector(driverState, sector, buffer);
+    // Whole sectors don't need the block buffer.
+    uint32_t maxSectors = 0;
+    if (offsetInSector == 0) {
+      maxSectors = (length - bytesWritten) / driverState->bytesPerSector;
+    }
+    if (maxSectors > 0) {
+      uint32_t firstSector = 0;
+      uint32_t numSectors = 0;
+      result = findSectorRun(driverState, file, file->currentPosition,
+        maxSectors, &firstSector, &numSectors);
+      if (result == EXFAT_SUCCESS) {
+        result = writeSectors(driverState, firstSector, numSectors,
+          &srcPtr[bytesWritten]);
+      }
+      if (result != EXFAT_SUCCESS) {
+        if (bytesWritten > 0) {
+          break;
+        }
+        printString("  ERROR: Failed to write sectors\n");
+        return -EIO;
+      }
+      bytesToWrite = numSectors * driverState->bytesPerSector;
+    } else {
+      // Partial sector, so read-modify-write it through the block buffer
+      uint32_t sector = clusterToSector(driverState, file->currentCluster) +
+        sectorInCluster;
+      result = readSector(driverState, sector, buffer);
       if (result != EXFAT_SUCCESS) {
         if (bytesWritten > 0) {
           break;
@@ -2195,26 +2652,29 @@ int32_t exFatWrite(
         printString("  ERROR: Failed to read sector for RMW\n");
         return -EIO;
       }
-    }
 
-    // Copy data from source to buffer
-    for (uint32_t ii = 0; ii < bytesToWrite; ii++) {
-      buffer[offsetInSector + ii] = srcPtr[bytesWritten + ii];
-    }
+      // Copy data from source to buffer
+      for (uint32_t ii = 0; ii < bytesToWrite; ii++) {
+        buffer[offsetInSector + ii] = srcPtr[bytesWritten + ii];
+      }
 
-    // Write the sector back to disk
-    int result = writeSector(driverState, sector, buffer);
-    if (result != EXFAT_SUCCESS) {
-      if (bytesWritten > 0) {
-        break;
+      // Write the sector back to disk
+      result = writeSector(driverState, sector, buffer);
+      if (result != EXFAT_SUCCESS) {
+        if (bytesWritten > 0) {
+          break;
+        }
+        printString("  ERROR: Failed to write sector\n");
+        return -EIO;
       }
-      printString("  ERROR: Failed to write sector\n");
-      return -EIO;
     }
 
     // Update counters and position
     bytesWritten += bytesToWrite;
     file->currentPosition += bytesToWrite;
+    if (file->currentPosition > file->validDataLength) {
+      file->validDataLength = file->currentPosition;
+    }
 
     // Update file size if we've grown the file
     if (file->currentPosition > file->fileSize) {
@@ -2421,7 +2881,7 @@ static int freeClusterChain(
     }
     
     // Update allocation bitmap (mark as free)
-    result = updateAllocationBitmap(driverState, currentCluster, false);
+    result = updateAllocationBitmap(driverState, currentCluster, 1, false);
     if (result != EXFAT_SUCCESS) {
       printString("  ERROR: Failed to update bitmap for cluster ");
       printInt(currentCluster);
@@ -2435,6 +2895,33 @@ static int freeClusterChain(
   return EXFAT_SUCCESS;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// @brief Free the clusters allocated to a file or directory
+///
+/// @param driverState Pointer to the exFAT driver state
+/// @param firstCluster First cluster allocated to the file
+/// @param numClusters Number of clusters allocated to the file.  Only used for
+///   NoFatChain files.
+/// @param noFatChain Whether the clusters are contiguous and not in the FAT
+///
+/// @return EXFAT_SUCCESS on success, error code on failure
+///////////////////////////////////////////////////////////////////////////////
+static int freeFileClusters(
+  ExFatDriverState* driverState, uint32_t firstCluster, uint32_t numClusters,
+  bool noFatChain
+) {
+  if (firstCluster < 2) {
+    return EXFAT_SUCCESS;
+  }
+
+  if (noFatChain) {
+    return updateAllocationBitmap(
+      driverState, firstCluster, numClusters, false);
+  }
+
+  return freeClusterChain(driverState, firstCluster);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /// @brief Check if a directory is empty
 ///
@@ -2530,26 +3017,17 @@ int exFatRemove(ExFatDriverState* driverState, const char* pathname) {
     return -EBUSY;
   }
   
-  // Allocate filename buffer
-  char* fileName = (char*) malloc(EXFAT_MAX_FILENAME_LENGTH + 1);
-  if (fileName == NULL) {
-    return -ENOMEM;
-  }
-  
-  // Allocate file entry
-  ExFatFileDirectoryEntry* fileEntry =
-    (ExFatFileDirectoryEntry*) malloc(sizeof(ExFatFileDirectoryEntry));
-  if (fileEntry == NULL) {
-    free(fileName);
-    return -ENOMEM;
-  }
-  
-  // Allocate stream entry
-  ExFatStreamExtensionEntry* streamEntry =
-    (ExFatStreamExtensionEntry*) malloc(sizeof(ExFatStreamExtensionEntry));
-  if (streamEntry == NULL) {
-    free(fileEntry);
-    free(fileName);
+  // The temporaries all come from the driver's arena and are released
+  // together before returning.
+  size_t arenaMark = arenaBegin(&driverState->arena);
+  char* fileName
+    = (char*) arenaAlloc(&driverState->arena, EXFAT_MAX_FILENAME_LENGTH + 1);
+  ExFatFileDirectoryEntry* fileEntry = (ExFatFileDirectoryEntry*)
+    arenaAlloc(&driverState->arena, sizeof(ExFatFileDirectoryEntry));
+  ExFatStreamExtensionEntry* streamEntry = (ExFatStreamExtensionEntry*)
+    arenaAlloc(&driverState->arena, sizeof(ExFatStreamExtensionEntry));
+  if ((fileName == NULL) || (fileEntry == NULL) || (streamEntry == NULL)) {
+    arenaEnd(&driverState->arena, arenaMark);
     return -ENOMEM;
   }
   
@@ -2560,9 +3038,7 @@ int exFatRemove(ExFatDriverState* driverState, const char* pathname) {
   );
   
   if (result != EXFAT_SUCCESS) {
-    free(streamEntry);
-    free(fileEntry);
-    free(fileName);
+    arenaEnd(&driverState->arena, arenaMark);
     if (result == EXFAT_FILE_NOT_FOUND) {
       return -ENOENT;
     }
@@ -2579,9 +3055,7 @@ int exFatRemove(ExFatDriverState* driverState, const char* pathname) {
   );
   
   if (result != EXFAT_SUCCESS) {
-    free(streamEntry);
-    free(fileEntry);
-    free(fileName);
+    arenaEnd(&driverState->arena, arenaMark);
     if (result == EXFAT_FILE_NOT_FOUND) {
       return -ENOENT;
     }
@@ -2600,29 +3074,36 @@ int exFatRemove(ExFatDriverState* driverState, const char* pathname) {
   uint8_t secondaryCount = 0;
   readBytes(&secondaryCount, &fileEntry->secondaryCount);
   uint8_t totalEntries = secondaryCount + 1;
+
+  uint8_t streamFlags = 0;
+  readBytes(&streamFlags, &streamEntry->generalSecondaryFlags);
+  uint64_t dataLength = 0;
+  readBytes(&dataLength, &streamEntry->dataLength);
+  uint32_t numClusters = (uint32_t) ((dataLength
+    + driverState->bytesPerCluster - 1) / driverState->bytesPerCluster);
+  if (numClusters == 0) {
+    numClusters = 1;
+  }
   
   // If it's a directory, check if it's empty
   if (isDirectory) {
     bool isEmpty = false;
     result = isDirectoryEmpty(driverState, firstCluster, &isEmpty);
     if (result != EXFAT_SUCCESS) {
-      free(streamEntry);
-      free(fileEntry);
-      free(fileName);
+      arenaEnd(&driverState->arena, arenaMark);
       return -EIO;
     }
     
     if (!isEmpty) {
-      free(streamEntry);
-      free(fileEntry);
-      free(fileName);
+      arenaEnd(&driverState->arena, arenaMark);
       return -ENOTEMPTY;
     }
   }
   
-  // Free the cluster chain
+  // Free the clusters
   if (firstCluster >= 2) {
-    result = freeClusterChain(driverState, firstCluster);
+    result = freeFileClusters(driverState, firstCluster, numClusters,
+      (streamFlags & EXFAT_FLAG_NO_FAT_CHAIN) != 0);
     if (result != EXFAT_SUCCESS) {
       printString("WARNING: Failed to free cluster chain\n");
       // Continue anyway to at least mark directory entries as unused
@@ -2635,15 +3116,11 @@ int exFatRemove(ExFatDriverState* driverState, const char* pathname) {
   );
   
   if (result != EXFAT_SUCCESS) {
-    free(streamEntry);
-    free(fileEntry);
-    free(fileName);
+    arenaEnd(&driverState->arena, arenaMark);
     return -EIO;
   }
   
-  free(streamEntry);
-  free(fileEntry);
-  free(fileName);
+  arenaEnd(&driverState->arena, arenaMark);
   
   return 0;
 }
@@ -2655,9 +3132,9 @@ int exFatRemove(ExFatDriverState* driverState, const char* pathname) {
 /// position is calculated based on the whence parameter: SEEK_SET positions
 /// relative to the beginning of the file, SEEK_CUR positions relative to the
 /// current position, and SEEK_END positions relative to the end of the file.
-/// The function traverses the FAT chain as needed to find the correct cluster
-/// for the new position. When seeking beyond allocated clusters in write mode,
-/// it allocates and links all necessary clusters to reach the target position.
+/// Seeking beyond the end of a file opened for writing extends the file.  The
+/// clusters are allocated here but nothing is written to them; the bytes past
+/// the valid data length read as zeros.
 ///
 /// @param driverState Pointer to the initialized exFAT driver state
 /// @param file Pointer to the file handle to seek within
@@ -2718,176 +3195,103 @@ int exFatSeek(
     return 0;
   }
 
-  // Handle special case of seeking to position 0
-  if (newPosition == 0) {
-    file->currentPosition = 0;
-    file->currentCluster = file->firstCluster;
-    if (file->currentCluster == 0 && file->canWrite && file->fileSize == 0) {
-      // Empty file opened for writing, cluster will be allocated on write
-      return 0;
-    }
-    return 0;
-  }
-
-  // If file has no clusters yet and we're seeking beyond 0
-  if ((file->firstCluster == 0 || file->firstCluster < 2) && 
-      file->canWrite) {
-    // Allocate the first cluster
-    uint32_t firstCluster = 0;
-    int result = allocateCluster(driverState, &firstCluster);
-    if (result != EXFAT_SUCCESS) {
-      printString("ERROR: Failed to allocate first cluster\n");
-      return -ENOSPC;
-    }
-    file->firstCluster = firstCluster;
-    file->currentCluster = firstCluster;
-    
-    // Clear the first cluster (write zeros)
-    FilesystemState* filesystemState = driverState->filesystemState;
-    uint8_t* buffer = filesystemState->blockBuffer;
-    
-    // Zero out the buffer
-    for (uint32_t ii = 0; ii < driverState->bytesPerSector; ii++) {
-      buffer[ii] = 0;
-    }
-    
-    // Write zeros to all sectors in the first cluster
-    for (uint32_t ss = 0; ss < driverState->sectorsPerCluster; ss++) {
-      uint32_t sector = clusterToSector(driverState, firstCluster) + ss;
-      result = writeSector(driverState, sector, buffer);
+  // Seeking past the end of the file extends it.  The new clusters are only
+  // allocated.  They're past the valid data length, so they read as zeros
+  // without having to be written.
+  if (newPosition > file->fileSize) {
+    uint32_t clustersNeeded = (uint32_t) (
+      ((uint64_t) newPosition + driverState->bytesPerCluster - 1)
+      / driverState->bytesPerCluster);
+    if (clustersNeeded > file->numClusters) {
+      int result = extendFile(
+        driverState, file, clustersNeeded - file->numClusters);
       if (result != EXFAT_SUCCESS) {
-        printString("ERROR: Failed to clear first cluster\n");
+        printString("ERROR: Failed to allocate clusters\n");
+        if (result == EXFAT_DISK_FULL) {
+          return -ENOSPC;
+        }
         return -EIO;
       }
     }
-  } else if (file->firstCluster == 0 || file->firstCluster < 2) {
-    // Empty file not opened for writing
-    return -EINVAL;
+
+    file->fileSize = newPosition;
+    // Note: Directory entry will be updated on close or flush
   }
 
-  // Calculate cluster indices
-  uint32_t targetClusterIndex = newPosition / driverState->bytesPerCluster;
-  
-  // Find the current allocated extent by traversing from the beginning
-  uint32_t lastAllocatedCluster = file->firstCluster;
-  uint32_t lastAllocatedIndex = 0;
-  uint32_t traversalCluster = file->firstCluster;
+  // The current cluster catches up with the position on the next read or
+  // write.
+  file->currentPosition = newPosition;
   
-  // First, find the last allocated cluster
-  while (true) {
-    uint32_t nextCluster = 0;
-    int result = readFatEntry(
-      driverState, traversalCluster, &nextCluster
-    );
-    
-    if (result != EXFAT_SUCCESS) {
-      printString("ERROR: Failed to read FAT entry\n");
-      return -EIO;
-    }
-    
-    if (nextCluster == 0xFFFFFFFF) {
-      // End of chain
-      lastAllocatedCluster = traversalCluster;
-      break;
-    }
-    
-    if (nextCluster < 2 || nextCluster >= driverState->clusterCount + 2) {
-      printString("ERROR: Invalid cluster in FAT chain\n");
-      return -EIO;
-    }
-    
-    traversalCluster = nextCluster;
-    lastAllocatedIndex++;
-    
-    if (lastAllocatedIndex >= targetClusterIndex) {
-      // We have enough clusters already
-      break;
-    }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// @brief Preallocate space for part of an exFAT file
+///
+/// Works like posix_fallocate.  After a successful call, writes anywhere from
+/// offset up to offset + length won't fail for lack of space.  Clusters are
+/// allocated in as few contiguous runs as the free space allows, and the file
+/// grows if the range extends past its end.  Nothing is written to the new
+/// clusters.  They are past the valid data length, so they read as zeros.
+///
+/// @param driverState Pointer to the initialized exFAT driver state
+/// @param file Pointer to the file handle to preallocate space for
+/// @param offset Position of the first byte of the range
+/// @param length Number of bytes in the range
+///
+/// @return 0 on success, negative errno on failure (-EINVAL for invalid
+///         parameters, -EBADF if the file is not open for writing,
+///         -EOVERFLOW if the range ends past the largest supported position,
+///         -ENOSPC if out of disk space, -EIO for I/O errors)
+///////////////////////////////////////////////////////////////////////////////
+int exFatFallocate(
+  ExFatDriverState* driverState, ExFatFileHandle* file, uint32_t offset,
+  uint32_t length
+) {
+  if (driverState == NULL || file == NULL || length == 0) {
+    return -EINVAL;
   }
-  
-  // If we need more clusters and file is open for writing, allocate them
-  if (lastAllocatedIndex < targetClusterIndex && file->canWrite) {
-    FilesystemState* filesystemState = driverState->filesystemState;
-    uint8_t* buffer = filesystemState->blockBuffer;
-    
-    // Zero out the buffer for clearing new clusters
-    for (uint32_t ii = 0; ii < driverState->bytesPerSector; ii++) {
-      buffer[ii] = 0;
-    }
-    
-    uint32_t currentChainEnd = lastAllocatedCluster;
-    
-    // Allocate and link clusters to reach the target
-    for (uint32_t ii = lastAllocatedIndex; ii < targetClusterIndex; ii++) {
-      uint32_t newCluster = 0;
-      int result = allocateCluster(driverState, &newCluster);
-      if (result != EXFAT_SUCCESS) {
-        printString("ERROR: Failed to allocate cluster ");
-        printInt(ii);
-        printString("\n");
-        return -ENOSPC;
-      }
-      
-      // Link the new cluster to the chain
-      result = writeFatEntry(driverState, currentChainEnd, newCluster);
-      if (result != EXFAT_SUCCESS) {
-        printString("ERROR: Failed to link cluster to chain\n");
-        return -EIO;
-      }
-      
-      // Clear the new cluster (write zeros to all sectors)
-      for (uint32_t ss = 0; ss < driverState->sectorsPerCluster; ss++) {
-        uint32_t sector = clusterToSector(driverState, newCluster) + ss;
-        result = writeSector(driverState, sector, buffer);
-        if (result != EXFAT_SUCCESS) {
-          printString("ERROR: Failed to clear cluster\n");
-          return -EIO;
-        }
-      }
-      
-      currentChainEnd = newCluster;
-    }
-  } else if (lastAllocatedIndex < targetClusterIndex) {
-    // Need more clusters but file is not open for writing
-    printString("ERROR: Cannot seek beyond allocated clusters in read mode\n");
+
+  if (!driverState->driverStateValid) {
     return -EINVAL;
   }
-  
-  // Now traverse to the target cluster
-  traversalCluster = file->firstCluster;
-  uint32_t traversalIndex = 0;
-  
-  while (traversalIndex < targetClusterIndex) {
-    uint32_t nextCluster = 0;
-    int result = readFatEntry(
-      driverState, traversalCluster, &nextCluster
-    );
-    
+
+  if (!file->canWrite) {
+    return -EBADF;
+  }
+
+  uint64_t endPosition = (uint64_t) offset + length;
+  if (endPosition > UINT32_MAX) {
+    return -EOVERFLOW;
+  }
+
+  bool changed = false;
+  uint32_t clustersNeeded = (uint32_t) (
+    (endPosition + driverState->bytesPerCluster - 1)
+    / driverState->bytesPerCluster);
+  if (clustersNeeded > file->numClusters) {
+    int result = extendFile(
+      driverState, file, clustersNeeded - file->numClusters);
     if (result != EXFAT_SUCCESS) {
-      printString("ERROR: Failed to read FAT during final traversal\n");
-      return -EIO;
-    }
-    
-    if (nextCluster == 0xFFFFFFFF) {
-      // This shouldn't happen after allocation
-      printString("ERROR: Unexpected end of chain after allocation\n");
+      if (result == EXFAT_DISK_FULL) {
+        return -ENOSPC;
+      }
       return -EIO;
     }
-    
-    traversalCluster = nextCluster;
-    traversalIndex++;
+    changed = true;
   }
-  
-  // Update the file handle with the new position
-  file->currentPosition = newPosition;
-  file->currentCluster = traversalCluster;
-  
-  // Update file size if we've extended it
-  if (newPosition > file->fileSize) {
-    file->fileSize = newPosition;
-    // Note: Directory entry will be updated on close or flush
+
+  if (endPosition > file->fileSize) {
+    file->fileSize = endPosition;
+    changed = true;
   }
-  
+
+  // Record the allocation right away rather than waiting for the file to be
+  // closed.
+  if (changed && (updateDirectoryEntry(driverState, file) != EXFAT_SUCCESS)) {
+    return -EIO;
+  }
+
   return 0;
 }
 
@@ -44,6 +44,8 @@
 
 #define FILE NanoOsFile
 
+#include "Arena.h"
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -64,6 +66,41 @@ typedef struct FilesystemState FilesystemState;
 #define EXFAT_DIRECTORY_ENTRY_SIZE   32
 #define EXFAT_MAX_OPEN_FILES         8
 
+/// @def EXFAT_ARENA_SIZE
+///
+/// @brief The number of bytes the driver reserves for the temporaries it needs
+/// while handling a request.  The deepest nesting, opening or removing a file
+/// in a subdirectory, needs about 1.75 KB.  Temporaries that don't fit are
+/// allocated from the heap for the duration of the request, so boards don't
+/// reserve anything.
+#ifndef EXFAT_ARENA_SIZE
+#if defined(__linux__) || defined(__linux) || defined(_WIN32)
+#define EXFAT_ARENA_SIZE             2048
+#else
+#define EXFAT_ARENA_SIZE             0
+#endif
+#endif // EXFAT_ARENA_SIZE
+
+/// @def EXFAT_CLUSTER_INDEX_SIZE
+///
+/// @brief The number of clusters each open file remembers so that seeks don't
+/// have to walk the FAT chain from the start of the file.  Must be a power of
+/// two.  The entries are spread evenly over the part of the file that has been
+/// walked, so a seek walks at most file clusters / EXFAT_CLUSTER_INDEX_SIZE
+/// links.
+#ifndef EXFAT_CLUSTER_INDEX_SIZE
+#if defined(__linux__) || defined(__linux) || defined(_WIN32)
+#define EXFAT_CLUSTER_INDEX_SIZE     16
+#else
+#define EXFAT_CLUSTER_INDEX_SIZE     8
+#endif
+#endif // EXFAT_CLUSTER_INDEX_SIZE
+
+#if (EXFAT_CLUSTER_INDEX_SIZE < 2) \
+  || ((EXFAT_CLUSTER_INDEX_SIZE & (EXFAT_CLUSTER_INDEX_SIZE - 1)) != 0)
+#error "EXFAT_CLUSTER_INDEX_SIZE must be a power of two of at least 2"
+#endif
+
 // Directory entry types
 #define EXFAT_ENTRY_UNUSED            0x00
 #define EXFAT_ENTRY_END_OF_DIR        0x00
@@ -74,6 +111,10 @@ typedef struct FilesystemState FilesystemState;
 #define EXFAT_ENTRY_UPCASE_TABLE      0x82
 #define EXFAT_ENTRY_VOLUME_LABEL      0x83
 
+// Stream extension general secondary flags
+#define EXFAT_FLAG_ALLOCATION_POSSIBLE 0x01
+#define EXFAT_FLAG_NO_FAT_CHAIN        0x02
+
 // File attributes
 #define EXFAT_ATTR_READ_ONLY         0x01
 #define EXFAT_ATTR_HIDDEN            0x02
@@ -125,7 +166,11 @@ typedef struct __attribute__((packed)) ExFatFileDirectoryEntry {
   uint8_t   entryType;             // Entry type (0x85)
   uint8_t   secondaryCount;        // Number of secondary entries
   uint16_t  setChecksum;           // Set checksum
-  uint16_t  fileAttributes;        // File attributes
+  uint16_t  fileAttributes;        // Stream extension general secondary flags
+#define EXFAT_FLAG_ALLOCATION_POSSIBLE 0x01
+#define EXFAT_FLAG_NO_FAT_CHAIN        0x02
+
+// File attributes
   uint16_t  reserved1;             // Reserved
   uint32_t  createTimestamp;       // Create timestamp
   uint32_t  lastModifiedTimestamp; // Last modified timestamp
@@ -169,9 +214,20 @@ typedef struct __attribute__((packed)) ExFatFileNameEntry {
 typedef struct ExFatFileHandle {
   uint32_t  firstCluster;          // First cluster of file
   uint32_t  currentCluster;        // Current cluster
+  uint32_t  currentClusterIndex;   // Index of currentCluster in the file
   uint32_t  currentPosition;       // Current position in file
   uint64_t  fileSize;              // File size in bytes
-  uint16_t  attributes;            // File attributes
+  uint64_t  validDataLength;       // Bytes actually written; rest reads as 0
+  uint32_t  numClusters;           // Number of clusters allocated to file
+  bool      noFatChain;            // Clusters are contiguous, FAT not used
+  uint32_t  clusterIndex[EXFAT_CLUSTER_INDEX_SIZE]; // Every Nth cluster
+  uint8_t   clusterIndexShift;     // log2 of N for clusterIndex
+  uint8_t   numIndexed;            // Valid entries in clusterIndex
+  uint16_t  attributes;            // Stream extension general secondary flags
+#define EXFAT_FLAG_ALLOCATION_POSSIBLE 0x01
+#define EXFAT_FLAG_NO_FAT_CHAIN        0x02
+
+// File attributes
   char      fileName[EXFAT_MAX_FILENAME_LENGTH + 1]; // File name
   uint32_t  directoryCluster;      // Directory containing this file
   uint32_t  directoryOffset;       // Offset in directory
@@ -192,7 +248,12 @@ typedef struct ExFatDriverState {
   uint32_t          clusterHeapStartSector; // Cluster heap start sector
   uint32_t          rootDirectoryCluster;   // Root directory cluster
   uint32_t          clusterCount;           // Number of clusters
+  uint32_t          bitmapCluster;          // Allocation bitmap first cluster
+  uint32_t          bitmapSectors;          // Sectors in allocation bitmap
+  uint16_t*         bitmapFreeCounts;       // Free clusters per bitmap sector
+  uint32_t          nextFreeCluster;        // Where to start the next search
   bool              driverStateValid;       // Whether or not state is valid
+  Arena             arena;                  // Per-request temporaries
 } ExFatDriverState;
 
 // Function declarations
@@ -212,6 +273,9 @@ int exFatRemove(ExFatDriverState* driverState, const char* pathname);
 int exFatSeek(
   ExFatDriverState* driverState, ExFatFileHandle* file, long offset,
   int whence);
+int exFatFallocate(
+  ExFatDriverState* driverState, ExFatFileHandle* file, uint32_t offset,
+  uint32_t length);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -33,10 +33,12 @@
 ///
 ///////////////////////////////////////////////////////////////////////////////
 
+#include "BlockCache.h"
 #include "ExFatTask.h"
 #include "ExFatFilesystem.h"
 #include "NanoOs.h"
 #include "Tasks.h"
+#include "../user/NanoOsLibC.h"
 
 // Must come last
 #include "../user/NanoOsStdio.h"
@@ -47,6 +49,25 @@
 /// @brief Definition of a filesystem command handler function.
 typedef int (*ExFatCommandHandler)(ExFatDriverState*, TaskMessage*);
 
+/// @fn static int exFatFlush(ExFatDriverState *driverState)
+///
+/// @brief Write any blocks the block device is holding in memory out to the
+/// storage.  Called when a command leaves the filesystem in a state that must
+/// survive losing power.
+///
+/// @param driverState A pointer to the ExFatDriverState object maintained by
+///   the filesystem task.
+///
+/// @return Returns 0 on success, the block device's error on failure.
+static int exFatFlush(ExFatDriverState *driverState) {
+  BlockStorageDevice *blockDevice = driverState->filesystemState->blockDevice;
+  if (blockDevice->flush == NULL) {
+    return 0;
+  }
+
+  return blockDevice->flush(blockDevice->context);
+}
+
 /// @fn int exFatTaskOpenFileCommandHandler(
 ///   ExFatDriverState *driverState, TaskMessage *taskMessage)
 ///
@@ -111,6 +132,11 @@ int exFatTaskCloseFileCommandHandler(
   free(fcloseParameters->stream);
   if (driverState->driverStateValid) {
     fcloseParameters->returnValue = exFatFclose(driverState, exFatFile);
+    if ((exFatFlush(driverState) != 0)
+      && (fcloseParameters->returnValue == 0)
+    ) {
+      fcloseParameters->returnValue = -EIO;
+    }
     if (driverState->filesystemState->numOpenFiles > 0) {
       driverState->filesystemState->numOpenFiles--;
     }
@@ -229,6 +255,9 @@ int exFatTaskRemoveFileCommandHandler(
   int returnValue = 0;
   if (driverState->driverStateValid) {
     returnValue = exFatRemove(driverState, pathname);
+    if ((exFatFlush(driverState) != 0) && (returnValue == 0)) {
+      returnValue = -EIO;
+    }
   }
 
   NanoOsMessage *nanoOsMessage
@@ -271,16 +300,84 @@ int exFatTaskSeekFileCommandHandler(
   return 0;
 }
 
+/// @fn int exFatTaskFallocateFileCommandHandler(
+///   ExFatDriverState *driverState, TaskMessage *taskMessage)
+///
+/// @brief Command handler for FILESYSTEM_FALLOCATE_FILE command.
+///
+/// @param driverState A pointer to the FilesystemState object maintained
+///   by the filesystem task.
+/// @param taskMessage A pointer to the TaskMessage that was received by
+///   the filesystem task.
+///
+/// @return Returns 0 on success, a standard POSIX error code on failure.
+int exFatTaskFallocateFileCommandHandler(
+  ExFatDriverState *driverState, TaskMessage *taskMessage
+) {
+  FilesystemFallocateParameters *filesystemFallocateParameters
+    = nanoOsMessageDataPointer(taskMessage, FilesystemFallocateParameters*);
+  int returnValue = -EINVAL;
+  if (driverState->driverStateValid) {
+    NanoOsFile *nanoOsFile = filesystemFallocateParameters->stream;
+    ExFatFileHandle *exFatFile = (ExFatFileHandle*) nanoOsFile->file;
+    returnValue = exFatFallocate(driverState, exFatFile,
+      filesystemFallocateParameters->offset,
+      filesystemFallocateParameters->length);
+    if ((exFatFlush(driverState) != 0) && (returnValue == 0)) {
+      returnValue = -EIO;
+    }
+  }
+
+  filesystemFallocateParameters->returnValue = returnValue;
+  taskMessageSetDone(taskMessage);
+  return 0;
+}
+
+/// @fn int exFatTaskGetCacheStatsCommandHandler(
+///   ExFatDriverState *driverState, TaskMessage *taskMessage)
+///
+/// @brief Command handler for FILESYSTEM_GET_CACHE_STATS command.
+///
+/// @param driverState A pointer to the FilesystemState object maintained
+///   by the filesystem task.
+/// @param taskMessage A pointer to the TaskMessage that was received by
+///   the filesystem task.
+///
+/// @return Returns 0 on success, a standard POSIX error code on failure.
+int exFatTaskGetCacheStatsCommandHandler(
+  ExFatDriverState *driverState, TaskMessage *taskMessage
+) {
+  BlockCacheStatsInfo *blockCacheStatsInfo
+    = nanoOsMessageDataPointer(taskMessage, BlockCacheStatsInfo*);
+  int returnValue = -ENOTSUP;
+  BlockCache *blockCache = driverState->filesystemState->blockCache;
+  if (blockCache != NULL) {
+    blockCacheStatsInfo->numHits = blockCache->numHits;
+    blockCacheStatsInfo->numMisses = blockCache->numMisses;
+    blockCacheStatsInfo->numWriteBacks = blockCache->numWriteBacks;
+    blockCacheStatsInfo->numBlocks = blockCache->numBlocks;
+    returnValue = 0;
+  }
+
+  NanoOsMessage *nanoOsMessage
+    = (NanoOsMessage*) taskMessageData(taskMessage);
+  nanoOsMessage->data = (intptr_t) returnValue;
+  taskMessageSetDone(taskMessage);
+  return 0;
+}
+
 /// @var filesystemCommandHandlers
 ///
 /// @brief Array of ExFatCommandHandler function pointers.
 const ExFatCommandHandler filesystemCommandHandlers[] = {
-  exFatTaskOpenFileCommandHandler,   // FILESYSTEM_OPEN_FILE
-  exFatTaskCloseFileCommandHandler,  // FILESYSTEM_CLOSE_FILE
-  exFatTaskReadFileCommandHandler,   // FILESYSTEM_READ_FILE
-  exFatTaskWriteFileCommandHandler,  // FILESYSTEM_WRITE_FILE
-  exFatTaskRemoveFileCommandHandler, // FILESYSTEM_REMOVE_FILE
-  exFatTaskSeekFileCommandHandler,   // FILESYSTEM_SEEK_FILE
+  exFatTaskOpenFileCommandHandler,      // FILESYSTEM_OPEN_FILE
+  exFatTaskCloseFileCommandHandler,     // FILESYSTEM_CLOSE_FILE
+  exFatTaskReadFileCommandHandler,      // FILESYSTEM_READ_FILE
+  exFatTaskWriteFileCommandHandler,     // FILESYSTEM_WRITE_FILE
+  exFatTaskRemoveFileCommandHandler,    // FILESYSTEM_REMOVE_FILE
+  exFatTaskSeekFileCommandHandler,      // FILESYSTEM_SEEK_FILE
+  exFatTaskFallocateFileCommandHandler, // FILESYSTEM_FALLOCATE_FILE
+  exFatTaskGetCacheStatsCommandHandler, // FILESYSTEM_GET_CACHE_STATS
 };
 
 
@@ -303,6 +400,7 @@ static void exFatHandleFilesystemMessages(ExFatDriverState *driverState) {
       printDebugInt(type);
       printDebugString("\n");
       filesystemCommandHandlers[type](driverState, msg);
+      arenaReset(&driverState->arena);
     } else {
       printString("ERROR! Received unknown filesystem message type ");
       printInt(type);
@@ -328,12 +426,26 @@ void* runExFatFilesystem(void *args) {
   ExFatDriverState *driverState
     = (ExFatDriverState*) calloc(1, sizeof(ExFatDriverState));
   fs->blockDevice = (BlockStorageDevice*) args;
+#if BLOCK_CACHE_NUM_BLOCKS > 0
+  printDebugString("runExFatFilesystem: Creating the block cache\n");
+  BlockCache *blockCache
+    = blockCacheCreate(fs->blockDevice, BLOCK_CACHE_NUM_BLOCKS);
+  if (blockCache != NULL) {
+    fs->blockDevice = &blockCache->device;
+    fs->blockCache = blockCache;
+  }
+#endif // BLOCK_CACHE_NUM_BLOCKS
   fs->blockSize = fs->blockDevice->blockSize;
   
   printDebugString("runExFatFilesystem: Allocating fs->blockSize\n");
   fs->blockBuffer = (uint8_t*) malloc(fs->blockSize);
   printDebugString("runExFatFilesystem: Getting partition info\n");
   getPartitionInfo(fs);
+  printDebugString("runExFatFilesystem: Reserving the request arena\n");
+  if (arenaInit(&driverState->arena, EXFAT_ARENA_SIZE) != 0) {
+    printString("WARNING: Could not reserve the exFAT request arena.  ");
+    printString("Allocating temporaries from the heap instead.\n");
+  }
   printDebugString("runExFatFilesystem: Initiallizing driverState\n");
   exFatInitialize(driverState, fs);
   printDebugString("runExFatFilesystem: Initialization complete\n");
@@ -346,6 +458,7 @@ void* runExFatFilesystem(void *args) {
         (FilesystemCommandResponse) taskMessageType(msg);
       if (type < NUM_FILESYSTEM_COMMANDS) {
         filesystemCommandHandlers[type](driverState, msg);
+        arenaReset(&driverState->arena);
       }
     } else {
       exFatHandleFilesystemMessages(driverState);
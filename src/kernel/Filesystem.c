@@ -196,6 +196,74 @@ int filesystemFSeek(FILE *stream, long offset, int whence) {
   return returnValue;
 }
 
+/// @fn int filesystemFAllocate(FILE *stream, long offset, long length)
+///
+/// @brief Implementation of posix_fallocate for a FILE.  Makes sure that
+/// space is allocated for the given range of the file, growing the file if
+/// the range extends past its end.  The new space reads as zeros.
+///
+/// @param stream A pointer to a previously-opened FILE object.
+/// @param offset The position of the first byte of the range to allocate.
+/// @param length The number of bytes in the range to allocate.
+///
+/// @return Returns 0 on success, an error number on failure.  Like
+/// posix_fallocate, errno is not set.
+int filesystemFAllocate(FILE *stream, long offset, long length) {
+  if (stream == NULL) {
+    return EBADF;
+  }
+
+  if ((offset < 0) || (length <= 0)) {
+    return EINVAL;
+  }
+  if (((uint64_t) offset + (uint64_t) length) > UINT32_MAX) {
+    return EOVERFLOW;
+  }
+
+  FilesystemFallocateParameters filesystemFallocateParameters = {
+    .stream = stream,
+    .offset = (uint32_t) offset,
+    .length = (uint32_t) length,
+    .returnValue = 0,
+  };
+  TaskMessage *msg = sendNanoOsMessageToPid(
+    NANO_OS_FILESYSTEM_TASK_ID, FILESYSTEM_FALLOCATE_FILE,
+    /* func= */ 0, (intptr_t) &filesystemFallocateParameters, true);
+  taskMessageWaitForDone(msg, NULL);
+  taskMessageRelease(msg);
+  return -filesystemFallocateParameters.returnValue;
+}
+
+/// @fn int filesystemGetBlockCacheStats(
+///   BlockCacheStatsInfo *blockCacheStatsInfo)
+///
+/// @brief Get the counters of the block cache in front of the filesystem's
+/// storage device.
+///
+/// @param blockCacheStatsInfo A pointer to the BlockCacheStatsInfo to fill in.
+///
+/// @return Returns 0 on success, -1 and sets the value of errno on failure.
+/// errno is ENOTSUP if the filesystem has no block cache.
+int filesystemGetBlockCacheStats(BlockCacheStatsInfo *blockCacheStatsInfo) {
+  if (blockCacheStatsInfo == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  TaskMessage *msg = sendNanoOsMessageToPid(
+    NANO_OS_FILESYSTEM_TASK_ID, FILESYSTEM_GET_CACHE_STATS,
+    /* func= */ 0, (intptr_t) blockCacheStatsInfo, true);
+  taskMessageWaitForDone(msg, NULL);
+  int returnValue = nanoOsMessageDataValue(msg, int);
+  if (returnValue != 0) {
+    // returnValue holds a negative errno.
+    errno = -returnValue;
+    returnValue = -1;
+  }
+  taskMessageRelease(msg);
+  return returnValue;
+}
+
 /// @fn size_t filesystemFRead(
 ///   void *ptr, size_t size, size_t nmemb, FILE *stream)
 ///
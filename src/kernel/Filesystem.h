@@ -38,8 +38,10 @@
 
 #include "stddef.h"
 #include "stdint.h"
+#include "NanoOsStats.h"
 
 typedef struct BlockStorageDevice BlockStorageDevice;
+typedef struct BlockCache BlockCache;
 typedef struct NanoOsFile FILE;
 typedef struct msg_t TaskMessage;
 
@@ -72,6 +74,8 @@ extern "C"
 /// @param endLba The address of the last block of the filesystem.
 /// @param numOpenFiles The number of files currently open by the filesystem.
 ///   If this number is zero then the blockBuffer pointer may be NULL.
+/// @param blockCache A pointer to the BlockCache that blockDevice belongs to
+///   or NULL if the filesystem accesses its device directly.
 typedef struct FilesystemState {
   BlockStorageDevice *blockDevice;
   uint16_t blockSize;
@@ -79,6 +83,7 @@ typedef struct FilesystemState {
   uint32_t startLba;
   uint32_t endLba;
   uint8_t  numOpenFiles;
+  BlockCache *blockCache;
 } FilesystemState;
 
 /// @struct FilesystemIoCommandParameters
@@ -125,6 +130,23 @@ typedef struct FilesystemFcloseParameters {
   int returnValue;
 } FilesystemFcloseParameters;
 
+/// @struct FilesystemFallocateParameters
+///
+/// @brief Function parameters and return value for a filesystemFAllocate
+/// call.
+///
+/// @param stream A pointer to the FILE to allocate space for.
+/// @param offset The position of the first byte of the range to allocate.
+/// @param length The number of bytes in the range to allocate.
+/// @param returnValue The return value of the operation that will be passed
+///   back to the caller.  0 on success, a negative errno on failure.
+typedef struct FilesystemFallocateParameters {
+  FILE *stream;
+  uint32_t offset;
+  uint32_t length;
+  int returnValue;
+} FilesystemFallocateParameters;
+
 /// @typedef FilesystemCommandHandler
 ///
 /// @brief Definition of a filesystem command handler function.
@@ -142,6 +164,8 @@ typedef enum FilesystemCommandResponse {
   FILESYSTEM_WRITE_FILE,
   FILESYSTEM_REMOVE_FILE,
   FILESYSTEM_SEEK_FILE,
+  FILESYSTEM_FALLOCATE_FILE,
+  FILESYSTEM_GET_CACHE_STATS,
   NUM_FILESYSTEM_COMMANDS,
   // Responses:
 } FilesystemCommandResponse;
@@ -173,6 +197,9 @@ int filesystemFSeek(FILE *stream, long offset, int whence);
 #endif // fseek
 #define fseek filesystemFSeek
 
+int filesystemFAllocate(FILE *stream, long offset, long length);
+int filesystemGetBlockCacheStats(BlockCacheStatsInfo *blockCacheStatsInfo);
+
 size_t filesystemFRead(void *ptr, size_t size, size_t nmemb, FILE *stream);
 #ifdef fread
 #undef fread
@@ -431,6 +431,21 @@ typedef struct Hal {
   int (*cancelAndGetTimer)(int timer,
     uint64_t *configuredNanoseconds, uint64_t *remainingNanoseconds,
     void (**callback)(void));
+
+  // Power management.
+
+  /// @fn int waitForEvent(int64_t nanoseconds)
+  ///
+  /// @brief Put the hardware into a low-power state until something happens
+  /// that the OS may need to respond to (serial input, a timer firing, etc.)
+  /// or until a specified amount of time has elapsed, whichever comes first.
+  /// Spurious early returns are permitted.
+  ///
+  /// @param nanoseconds The maximum number of nanoseconds to wait.  A negative
+  ///   value means there is no deadline.
+  ///
+  /// @return Returns 0 on success, -errno on failure.
+  int (*waitForEvent)(int64_t nanoseconds);
 } Hal;
 
 extern const Hal *HAL;
@@ -0,0 +1,517 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                     Copyright (c) 2012-2025 James Card                     //
+//                                                                            //
+// Permission is hereby granted, free of charge, to any person obtaining a    //
+// copy of this software and associated documentation files (the "Software"), //
+// to deal in the Software without restriction, including without limitation  //
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,   //
+// and/or sell copies of the Software, and to permit persons to whom the      //
+// Software is furnished to do so, subject to the following conditions:       //
+//                                                                            //
+// The above copyright notice and this permission notice shall be included    //
+// in all copies or substantial portions of the Software.                     //
+//                                                                            //
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR //
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   //
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    //
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER //
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING    //
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER        //
+// DEALINGS IN THE SOFTWARE.                                                  //
+//                                                                            //
+//                                 James Card                                 //
+//                          http://www.jamescard.org                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Doxygen marker
+/// @file
+
+// Standard C includes
+#include "string.h"
+
+// NanoOs includes
+#include "MemoryAllocator.h"
+#include "Tasks.h"
+
+/// @def isDynamicPointer
+///
+/// @brief Determine whether or not a pointer was allocated from the allocators
+/// in this library.
+#define isDynamicPointer(ptr) \
+  ((((uintptr_t) (ptr)) <= memoryManagerState->mallocStart) \
+    && (((uintptr_t) (ptr)) >= memoryManagerState->mallocEnd))
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// @fn void localInitializeHeap(MemoryManagerState *memoryManagerState,
+///   char *mallocStart, uintptr_t memorySize)
+///
+/// @brief Set up an empty heap in a region of memory.
+///
+/// @param memoryManagerState A pointer to the MemoryManagerState
+///   structure that holds the values used for memory allocation and
+///   deallocation.
+/// @param mallocStart The address just past the top of the region.  The heap
+///   grows down from here.
+/// @param memorySize The size of the region in bytes.  Must be a multiple of 8.
+///
+/// @return This function always succeeds and returns no value.
+void localInitializeHeap(MemoryManagerState *memoryManagerState,
+  char *mallocStart, uintptr_t memorySize
+) {
+  memoryManagerState->mallocNext = mallocStart;
+  memNode(memoryManagerState->mallocNext)->prev = NULL;
+  memoryManagerState->mallocStart
+    = (uintptr_t) memoryManagerState->mallocNext;
+  
+  // The value at memNode(memoryManagerState->mallocNext)->size needs to be
+  // non-zero in order for the memory compaction algorithm in localFree to work
+  // properly.
+  memoryManagerState->mallocEnd
+    = ((uintptr_t) memoryManagerState->mallocStart) - memorySize;
+  memNode(memoryManagerState->mallocNext)->size = memorySize;
+  memNode(memoryManagerState->mallocNext)->owner = TASK_ID_NOT_SET;
+  memoryManagerState->numFreeBlocks = 0;
+}
+
+#if MEMORY_MANAGER_FIRST_FIT
+
+/// @def memNodeIsFree
+///
+/// @brief Determine whether or not a MemNode describes a free block in the
+/// middle of the heap.  The node at the top of the heap has no owner but is
+/// never free.
+#define memNodeIsFree(node) \
+  (((node)->owner == TASK_ID_NOT_SET) && ((node)->prev != NULL))
+
+/// @fn static void localMergeFreeBlocks(
+///   MemoryManagerState *memoryManagerState, MemNode *node)
+///
+/// @brief Merge all the free blocks directly above a block into it.
+///
+/// @param memoryManagerState A pointer to the MemoryManagerState
+///   structure that holds the values used for memory allocation and
+///   deallocation.
+/// @param node A pointer to the MemNode of a free block.
+///
+/// @return This function always succeeds and returns no value.
+static void localMergeFreeBlocks(
+  MemoryManagerState *memoryManagerState, MemNode *node
+) {
+  while (memNodeIsFree(node->prev)) {
+    MemNode *above = node->prev;
+    node->size += sizeof(MemNode) + above->size;
+    node->prev = above->prev;
+    memoryManagerState->numFreeBlocks--;
+  }
+}
+
+/// @fn static void localSplitBlock(MemoryManagerState *memoryManagerState,
+///   MemNode *node, size_t size)
+///
+/// @brief Shrink an allocated block to a given size and turn the rest of it
+/// into a free block if the rest is big enough to hold one.
+///
+/// @param memoryManagerState A pointer to the MemoryManagerState
+///   structure that holds the values used for memory allocation and
+///   deallocation.
+/// @param node A pointer to the MemNode of the allocated block.
+/// @param size The number of bytes to keep in the block.  Must be a multiple
+///   of 8 and no larger than the block.
+///
+/// @return This function always succeeds and returns no value.
+static void localSplitBlock(MemoryManagerState *memoryManagerState,
+  MemNode *node, size_t size
+) {
+  if (node->size < size + sizeof(MemNode) + 8) {
+    // Not enough left over to be worth tracking.  Leave it in the block.
+    return;
+  }
+  
+  MemNode *remainder = (MemNode*) (((char*) &node[1]) + size);
+  remainder->prev = node->prev;
+  remainder->size = node->size - size - sizeof(MemNode);
+  remainder->owner = TASK_ID_NOT_SET;
+  node->prev = remainder;
+  node->size = size;
+  memoryManagerState->numFreeBlocks++;
+  localMergeFreeBlocks(memoryManagerState, remainder);
+}
+
+/// @fn static void* localFirstFit(MemoryManagerState *memoryManagerState,
+///   size_t size, TaskId pid)
+///
+/// @brief Allocate memory from the lowest free block in the middle of the heap
+/// that's large enough.  Adjacent free blocks are merged as they're walked.
+///
+/// @param memoryManagerState A pointer to the MemoryManagerState
+///   structure that holds the values used for memory allocation and
+///   deallocation.
+/// @param size The number of bytes to allocate.  Must be a multiple of 8.
+/// @param pid The ID of the task that will own the memory.
+///
+/// @return Returns a pointer to the allocated memory on success, NULL if no
+/// free block was large enough.
+static void* localFirstFit(MemoryManagerState *memoryManagerState,
+  size_t size, TaskId pid
+) {
+  if (memoryManagerState->numFreeBlocks == 0) {
+    return NULL;
+  }
+  
+  for (MemNode *cur = memNode(memoryManagerState->mallocNext);
+    cur->prev != NULL;
+    cur = cur->prev
+  ) {
+    if (!memNodeIsFree(cur)) {
+      continue;
+    }
+    
+    localMergeFreeBlocks(memoryManagerState, cur);
+    if (cur->size >= size) {
+      cur->owner = pid;
+      memoryManagerState->numFreeBlocks--;
+      localSplitBlock(memoryManagerState, cur, size);
+      return &cur[1];
+    }
+  }
+  
+  return NULL;
+}
+
+/// @fn static bool localGrowInPlace(MemoryManagerState *memoryManagerState,
+///   MemNode *node, size_t size)
+///
+/// @brief Grow an allocated block into the free blocks directly above it, if
+/// there are enough of them.
+///
+/// @param memoryManagerState A pointer to the MemoryManagerState
+///   structure that holds the values used for memory allocation and
+///   deallocation.
+/// @param node A pointer to the MemNode of the allocated block.
+/// @param size The number of bytes the block needs.  Must be a multiple of 8.
+///
+/// @return Returns true if the block was grown, false if there wasn't enough
+/// free memory directly above it.
+static bool localGrowInPlace(MemoryManagerState *memoryManagerState,
+  MemNode *node, size_t size
+) {
+  size_t available = node->size;
+  for (MemNode *above = node->prev;
+    (available < size) && memNodeIsFree(above);
+    above = above->prev
+  ) {
+    available += sizeof(MemNode) + above->size;
+  }
+  if (available < size) {
+    return false;
+  }
+  
+  while (node->size < size) {
+    MemNode *above = node->prev;
+    node->size += sizeof(MemNode) + above->size;
+    node->prev = above->prev;
+    memoryManagerState->numFreeBlocks--;
+  }
+  localSplitBlock(memoryManagerState, node, size);
+  
+  return true;
+}
+
+/// @fn void localFree(MemoryManagerState *memoryManagerState, void *ptr)
+///
+/// @brief Free a previously-allocated block of memory.  The block is merged
+/// with any free blocks directly above it.  If it's the lowest block in the
+/// heap, it's returned to the unallocated space instead.
+///
+/// @param memoryManagerState A pointer to the MemoryManagerState
+///   structure that holds the values used for memory allocation and
+///   deallocation.
+/// @param ptr A pointer to the block of memory to free.
+///
+/// @return This function always succeeds and returns no value.
+void localFree(MemoryManagerState *memoryManagerState, void *ptr) {
+  if ((!isDynamicPointer(ptr))
+    || (((char*) ptr) < memoryManagerState->mallocNext)
+  ) {
+    // This is not something we can free.  Ignore it.
+    return;
+  }
+  
+  // Check the owner in case someone tries to free the same pointer more than
+  // once.  This also protects the node at the top of the heap.
+  MemNode *node = memNode(ptr);
+  if (node->owner == TASK_ID_NOT_SET) {
+    return;
+  }
+  
+  node->owner = TASK_ID_NOT_SET;
+  memoryManagerState->numFreeBlocks++;
+  localMergeFreeBlocks(memoryManagerState, node);
+  
+  if (((char*) ptr) == memoryManagerState->mallocNext) {
+    // Special case.  The value being freed is the last one that was
+    // allocated.  Everything above it up to node->prev is free now, so give
+    // it all back to the unallocated space.
+    memoryManagerState->mallocNext = (char*) &node->prev[1];
+    memoryManagerState->numFreeBlocks--;
+  }
+  
+  return;
+}
+
+/// @fn void localFreeTaskMemory(
+///   MemoryManagerState *memoryManagerState, TaskId pid)
+///
+/// @brief Free *ALL* the memory owned by a task given its task ID.
+///
+/// @param memoryManagerState A pointer to the MemoryManagerState
+///   structure that holds the values used for memory allocation and
+///   deallocation.
+/// @param pid The ID of the task to free the memory of.
+///
+/// @return This function always succeeds and returns no value.
+void localFreeTaskMemory(
+  MemoryManagerState *memoryManagerState, TaskId pid
+) {
+  // Freeing a block only ever merges it with the blocks above it, so the
+  // block's prev pointer is still the next block to look at afterward.
+  for (MemNode *cur = memNode(memoryManagerState->mallocNext);
+    cur->prev != NULL;
+    cur = cur->prev
+  ) {
+    if (cur->owner == pid) {
+      localFree(memoryManagerState, &cur[1]);
+    }
+  }
+  
+  return;
+}
+
+#else // MEMORY_MANAGER_FIRST_FIT == 0
+
+/// @fn void localFree(MemoryManagerState *memoryManagerState, void *ptr)
+///
+/// @brief Free a previously-allocated block of memory.
+///
+/// @param memoryManagerState A pointer to the MemoryManagerState
+///   structure that holds the values used for memory allocation and
+///   deallocation.
+/// @param ptr A pointer to the block of memory to free.
+///
+/// @return This function always succeeds and returns no value.
+void localFree(MemoryManagerState *memoryManagerState, void *ptr) {
+  char *charPointer = (char*) ptr;
+  
+  if (isDynamicPointer(ptr)) {
+    // This is memory that was previously allocated from one of our allocators.
+    
+    // Check the size of the memory in case someone tries to free the same
+    // pointer more than once.
+    if (sizeOfMemory(ptr) > 0) {
+      // Clear out the size and owner.
+      memNode(charPointer)->size = 0;
+      memNode(charPointer)->owner = TASK_ID_NOT_SET;
+      
+      if (charPointer == memoryManagerState->mallocNext) {
+        // Special case.  The value being freed is the last one that was
+        // allocated.  Do memory compaction.
+        for (MemNode *cur = memNode(ptr);
+          (cur != NULL) && (cur->size == 0);
+          cur = cur->prev
+        ) {
+          memoryManagerState->mallocNext = (char*) &cur->prev[1];
+        }
+      }
+    }
+  } // else this is not something we can free.  Ignore it.
+  
+  return;
+}
+
+/// @fn void localFreeTaskMemory(
+///   MemoryManagerState *memoryManagerState, TaskId pid)
+///
+/// @brief Free *ALL* the memory owned by a task given its task ID.
+///
+/// @param memoryManagerState A pointer to the MemoryManagerState
+///   structure that holds the values used for memory allocation and
+///   deallocation.
+/// @param pid The ID of the task to free the memory of.
+///
+/// @return This function always succeeds and returns no value.
+void localFreeTaskMemory(
+  MemoryManagerState *memoryManagerState, TaskId pid
+) {
+  void *ptr = memoryManagerState->mallocNext;
+  
+  // We have to do two passes.  First pass:  Set the size of all the pointers
+  // allocated by the task to zero and the pid to TASK_ID_NOT_SET.
+  for (MemNode *cur = memNode(ptr); cur != NULL; cur = cur->prev) {
+    if (cur->owner == pid) {
+      localFree(memoryManagerState, &cur[1]);
+    }
+  }
+  
+  // Second pass, move memoryManagerState->mallocNext back until we hit
+  // something that's allocated.
+  for (MemNode *cur = memNode(ptr); cur != NULL; cur = cur->prev) {
+    if (cur->size != 0) {
+      break;
+    }
+    memoryManagerState->mallocNext = (char*) &cur->prev[1];
+  }
+  
+  return;
+}
+
+#endif // MEMORY_MANAGER_FIRST_FIT
+
+/// @fn void* localRealloc(MemoryManagerState *memoryManagerState,
+///   void *ptr, size_t size, TaskId pid)
+///
+/// @brief Reallocate a provided pointer to a new size.
+///
+/// @param memoryManagerState A pointer to the MemoryManagerState
+///   structure that holds the values used for memory allocation and
+///   deallocation.
+/// @param ptr A pointer to the original block of dynamic memory.  If this value
+///   is NULL, new memory will be allocated.
+/// @param size The new size desired for the memory block at ptr.  If this value
+///   is 0, the provided pointer will be freed.
+/// @param pid The ID of the task making the request.
+///
+/// @return Returns a pointer to size-adjusted memory on success, NULL on
+/// failure or on free.
+void* localRealloc(MemoryManagerState *memoryManagerState,
+  void *ptr, size_t size, TaskId pid
+) {
+  size += 7;
+  size &= ~((size_t) 7);
+  char *charPointer = (char*) ptr;
+  char *returnValue = NULL;
+  
+  if (size == 0) {
+    // In this case, there's no point in going through any path below.  Just
+    // free it, return NULL, and be done with it.
+    localFree(memoryManagerState, ptr);
+    return NULL;
+  }
+  
+  if (isDynamicPointer(ptr)) {
+    // This pointer was allocated from our allocators.
+    if (size <= sizeOfMemory(ptr)) {
+      // We're fitting into a block that's larger than or equal to the size
+      // being requested.  *DO NOT* update the size in this case.  Just
+      // return the current pointer.
+      return ptr;
+#if MEMORY_MANAGER_FIRST_FIT
+    } else if (localGrowInPlace(memoryManagerState, memNode(ptr), size)) {
+      // There was enough free memory right above the block to extend it
+      // without moving anything.
+      return ptr;
+#endif // MEMORY_MANAGER_FIRST_FIT
+    } else if (charPointer == memoryManagerState->mallocNext) {
+      // The pointer we're reallocating is the last one allocated.  We have
+      // an opportunity to just extend the existing block of memory instead
+      // of allocating an entirely new block.
+      if ((uintptr_t) (charPointer - size - sizeof(MemNode)
+          + memNode(charPointer)->size)
+        >= memoryManagerState->mallocEnd
+      ) {
+        // The new MemNode overlaps the old one if the block grows by less
+        // than a MemNode, so read everything out of the old one first.
+        MemNode oldNode = *memNode(charPointer);
+        size_t oldSize = oldNode.size;
+        returnValue = charPointer - size + oldSize;
+        memNode(returnValue)->size = size;
+        memNode(returnValue)->prev = oldNode.prev;
+        memNode(returnValue)->owner = oldNode.owner;
+        // Copy the contents of the old block to the new one.
+        size_t ii = 0;
+        for (char *newPointer = returnValue, *oldPointer = charPointer;
+          ii < oldSize;
+          newPointer++, oldPointer++
+        ) {
+          *newPointer = *oldPointer;
+          ii++;
+        }
+        // Update memoryManagerState->mallocNext with the new last pointer.
+        memoryManagerState->mallocNext = returnValue;
+        return returnValue;
+      } else {
+        // Out of memory.  Fail the request.
+        return NULL;
+      }
+    }
+  } else if (ptr != NULL) {
+    // We're being asked to reallocate a pointer that was *NOT* allocated by
+    // this allocator.  This is not valid and we cannot do this.  Fail.
+    return NULL;
+  }
+  
+  // We're allocating new memory.
+#if MEMORY_MANAGER_FIRST_FIT
+  returnValue = (char*) localFirstFit(memoryManagerState, size, pid);
+#endif // MEMORY_MANAGER_FIRST_FIT
+  // The new block's MemNode goes below it, so that's what has to fit.
+  if ((returnValue == NULL) && (((uintptr_t) (
+      memoryManagerState->mallocNext - size - (2 * sizeof(MemNode)))
+    ) >= memoryManagerState->mallocEnd)
+  ) {
+    returnValue = memoryManagerState->mallocNext - size - sizeof(MemNode);
+    memNode(returnValue)->size = size;
+    memNode(returnValue)->owner = pid;
+    memNode(returnValue)->prev = memNode(memoryManagerState->mallocNext);
+    memoryManagerState->mallocNext -= size + sizeof(MemNode);
+  } // else we don't have enough memory left to satisfy the request.
+  
+  if ((returnValue != NULL) && (ptr != NULL)) {
+    // Because of the logic above, we're guaranteed that this means that the
+    // address of returnValue is not the same as the address of ptr.  Copy
+    // the data from the old memory to the new memory and free the old
+    // memory.
+    memcpy(returnValue, ptr, sizeOfMemory(ptr));
+    localFree(memoryManagerState, ptr);
+  }
+  
+  return returnValue;
+}
+
+/// @fn size_t localGetFreeMemory(MemoryManagerState *memoryManagerState)
+///
+/// @brief Get the amount of dynamic memory that's available to allocate.
+///
+/// @param memoryManagerState A pointer to the MemoryManagerState
+///   structure that holds the values used for memory allocation and
+///   deallocation.
+///
+/// @return Returns the number of free bytes in the unallocated space at the
+/// bottom of the heap plus the number of bytes in free blocks above it.
+size_t localGetFreeMemory(MemoryManagerState *memoryManagerState) {
+  size_t freeMemory = (uintptr_t) memoryManagerState->mallocNext
+    - memoryManagerState->mallocEnd + sizeof(void*);
+  
+#if MEMORY_MANAGER_FIRST_FIT
+  for (MemNode *cur = memNode(memoryManagerState->mallocNext);
+    (memoryManagerState->numFreeBlocks > 0) && (cur->prev != NULL);
+    cur = cur->prev
+  ) {
+    if (memNodeIsFree(cur)) {
+      freeMemory += cur->size;
+    }
+  }
+#endif // MEMORY_MANAGER_FIRST_FIT
+  
+  return freeMemory;
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
@@ -0,0 +1,109 @@
+///////////////////////////////////////////////////////////////////////////////
+///
+/// @author            James Card
+/// @date              10.16.2026
+///
+/// @file              MemoryAllocator.h
+///
+/// @brief             The heap allocator behind the memory manager.
+///
+/// @copyright
+///                   Copyright (c) 2012-2025 James Card
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a
+/// copy of this software and associated documentation files (the "Software"),
+/// to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+/// and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included
+/// in all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+/// DEALINGS IN THE SOFTWARE.
+///
+///                                James Card
+///                         http://www.jamescard.org
+///
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef MEMORY_ALLOCATOR_H
+#define MEMORY_ALLOCATOR_H
+
+// This file is also used by the host-side memory benchmark, so it must not
+// pull in the memory manager's malloc and free macros.
+#include "NanoOsTypes.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// @def MEMORY_MANAGER_FIRST_FIT
+///
+/// @brief Whether or not the allocator reuses freed blocks in the middle of the
+/// heap.  When this is 1, freed blocks are coalesced with free neighbors and
+/// new allocations are placed in the first (lowest) free block that's large
+/// enough before the unallocated space at the bottom of the heap is used.
+/// When this is 0, the allocator is a bump allocator that only reclaims memory
+/// when the most recently allocated block is freed.
+#ifndef MEMORY_MANAGER_FIRST_FIT
+#define MEMORY_MANAGER_FIRST_FIT 1
+#endif // MEMORY_MANAGER_FIRST_FIT
+
+/// @struct MemNode
+///
+/// @brief Metadata that's placed right before the memory pointer that's
+/// returned by one one of the memory allocation functions.  These nodes are
+/// used when the pointer is deallocated.
+///
+/// The heap grows down from mallocStart, so the block described by prev is
+/// always the one that's physically adjacent to this one at the next higher
+/// address.  The only node with a NULL prev is the one at the top of the
+/// heap, which is never allocated or freed.
+///
+/// @param prev A pointer to the previous MemNode.
+/// @param size The number of bytes allocated for this node.
+/// @param owner The PID of the task that owns the memory (which is not
+///   necessarily the task that allocated it).  For the first-fit allocator,
+///   TASK_ID_NOT_SET marks a free block.
+typedef struct MemNode {
+  struct MemNode *prev;
+  uint16_t        size;
+  TaskId          owner;
+} MemNode;
+
+/// @def memNode
+///
+/// @brief Get a pointer to the MemNode for a memory address.
+#define memNode(ptr) \
+  (((ptr) != NULL) ? &((MemNode*) (ptr))[-1] : NULL)
+
+/// @def sizeOfMemory
+///
+/// @brief Retrieve the size of a block of dynamic memory.  This information is
+/// stored sizeof(MemNode) bytes before the pointer.
+#define sizeOfMemory(ptr) \
+  (((ptr) != NULL) ? memNode(ptr)->size : 0)
+
+// Function prototypes
+void localInitializeHeap(MemoryManagerState *memoryManagerState,
+  char *mallocStart, uintptr_t memorySize);
+void localFree(MemoryManagerState *memoryManagerState, void *ptr);
+void localFreeTaskMemory(
+  MemoryManagerState *memoryManagerState, TaskId pid);
+void* localRealloc(MemoryManagerState *memoryManagerState,
+  void *ptr, size_t size, TaskId pid);
+size_t localGetFreeMemory(MemoryManagerState *memoryManagerState);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // MEMORY_ALLOCATOR_H
@@ -31,234 +31,20 @@
 // NanoOs includes
 #include "Console.h"
 #include "Hal.h"
+#include "MemoryAllocator.h"
 #include "MemoryManager.h"
 #include "NanoOs.h"
 #include "NanoOsOverlay.h"
+#include "Scheduler.h"
 #include "Tasks.h"
 #include "../user/NanoOsStdio.h"
 
-/****************** Begin Custom Memory Management Functions ******************/
-
-/// @struct MemNode
-///
-/// @brief Metadata that's placed right before the memory pointer that's
-/// returned by one one of the memory allocation functions.  These nodes are
-/// used when the pointer is deallocated.
-///
-/// @param prev A pointer to the previous MemNode.
-/// @param size The number of bytes allocated for this node.
-/// @param owner The PID of the task that owns the memory (which is not
-///   necessarily the task that allocated it).
-typedef struct MemNode {
-  struct MemNode *prev;
-  uint16_t        size;
-  TaskId          owner;
-} MemNode;
-
-/// @def memNode
-///
-/// @brief Get a pointer to the MemNode for a memory address.
-#define memNode(ptr) \
-  (((ptr) != NULL) ? &((MemNode*) (ptr))[-1] : NULL)
-
-/// @def sizeOfMemory
-///
-/// @brief Retrieve the size of a block of dynamic memory.  This information is
-/// stored sizeof(MemNode) bytes before the pointer.
-#define sizeOfMemory(ptr) \
-  (((ptr) != NULL) ? memNode(ptr)->size : 0)
-
-/// @def isDynamicPointer
-///
-/// @brief Determine whether or not a pointer was allocated from the allocators
-/// in this library.
-#define isDynamicPointer(ptr) \
-  ((((uintptr_t) (ptr)) <= memoryManagerState->mallocStart) \
-    && (((uintptr_t) (ptr)) >= memoryManagerState->mallocEnd))
-
-#ifdef __cplusplus
-extern "C"
-{
-#endif
-
-/// @fn void localFree(MemoryManagerState *memoryManagerState, void *ptr)
-///
-/// @brief Free a previously-allocated block of memory.
-///
-/// @param memoryManagerState A pointer to the MemoryManagerState
-///   structure that holds the values used for memory allocation and
-///   deallocation.
-/// @param ptr A pointer to the block of memory to free.
-///
-/// @return This function always succeeds and returns no value.
-void localFree(MemoryManagerState *memoryManagerState, void *ptr) {
-  char *charPointer = (char*) ptr;
-  
-  if (isDynamicPointer(ptr)) {
-    // This is memory that was previously allocated from one of our allocators.
-    
-    // Check the size of the memory in case someone tries to free the same
-    // pointer more than once.
-    if (sizeOfMemory(ptr) > 0) {
-      // Clear out the size and owner.
-      memNode(charPointer)->size = 0;
-      memNode(charPointer)->owner = TASK_ID_NOT_SET;
-      
-      if (charPointer == memoryManagerState->mallocNext) {
-        // Special case.  The value being freed is the last one that was
-        // allocated.  Do memory compaction.
-        for (MemNode *cur = memNode(ptr);
-          (cur != NULL) && (cur->size == 0);
-          cur = cur->prev
-        ) {
-          memoryManagerState->mallocNext = (char*) &cur->prev[1];
-        }
-      }
-    }
-  } // else this is not something we can free.  Ignore it.
-  
-  return;
-}
-
-/// @fn void localFreeTaskMemory(
-///   MemoryManagerState *memoryManagerState, TaskId pid)
-///
-/// @brief Free *ALL* the memory owned by a task given its task ID.
-///
-/// @param memoryManagerState A pointer to the MemoryManagerState
-///   structure that holds the values used for memory allocation and
-///   deallocation.
-/// @param pid The ID of the task to free the memory of.
-///
-/// @return This function always succeeds and returns no value.
-void localFreeTaskMemory(
-  MemoryManagerState *memoryManagerState, TaskId pid
-) {
-  void *ptr = memoryManagerState->mallocNext;
-  
-  // We have to do two passes.  First pass:  Set the size of all the pointers
-  // allocated by the task to zero and the pid to TASK_ID_NOT_SET.
-  for (MemNode *cur = memNode(ptr); cur != NULL; cur = cur->prev) {
-    if (cur->owner == pid) {
-      localFree(memoryManagerState, &cur[1]);
-    }
-  }
-  
-  // Second pass, move memoryManagerState->mallocNext back until we hit
-  // something that's allocated.
-  for (MemNode *cur = memNode(ptr); cur != NULL; cur = cur->prev) {
-    if (cur->size != 0) {
-      break;
-    }
-    memoryManagerState->mallocNext = (char*) &cur->prev[1];
-  }
-  
-  return;
-}
-
-/// @fn void* localRealloc(MemoryManagerState *memoryManagerState,
-///   void *ptr, size_t size, TaskId pid)
-///
-/// @brief Reallocate a provided pointer to a new size.
-///
-/// @param memoryManagerState A pointer to the MemoryManagerState
-///   structure that holds the values used for memory allocation and
-///   deallocation.
-/// @param ptr A pointer to the original block of dynamic memory.  If this value
-///   is NULL, new memory will be allocated.
-/// @param size The new size desired for the memory block at ptr.  If this value
-///   is 0, the provided pointer will be freed.
-/// @param pid The ID of the task making the request.
+/// @var sharedMemoryManagerState
 ///
-/// @return Returns a pointer to size-adjusted memory on success, NULL on
-/// failure or on free.
-void* localRealloc(MemoryManagerState *memoryManagerState,
-  void *ptr, size_t size, TaskId pid
-) {
-  size += 7;
-  size &= ~((size_t) 7);
-  char *charPointer = (char*) ptr;
-  char *returnValue = NULL;
-  
-  if (size == 0) {
-    // In this case, there's no point in going through any path below.  Just
-    // free it, return NULL, and be done with it.
-    localFree(memoryManagerState, ptr);
-    return NULL;
-  }
-  
-  if (isDynamicPointer(ptr)) {
-    // This pointer was allocated from our allocators.
-    if (size <= sizeOfMemory(ptr)) {
-      // We're fitting into a block that's larger than or equal to the size
-      // being requested.  *DO NOT* update the size in this case.  Just
-      // return the current pointer.
-      return ptr;
-    } else if (charPointer == memoryManagerState->mallocNext) {
-      // The pointer we're reallocating is the last one allocated.  We have
-      // an opportunity to just extend the existing block of memory instead
-      // of allocating an entirely new block.
-      if ((uintptr_t) (charPointer - size - sizeof(MemNode)
-          + memNode(charPointer)->size)
-        >= memoryManagerState->mallocEnd
-      ) {
-        size_t oldSize = memNode(ptr)->size;
-        returnValue = charPointer - size + memNode(charPointer)->size;
-        memNode(returnValue)->size = size;
-        memNode(returnValue)->prev = memNode(charPointer)->prev;
-        memNode(returnValue)->owner = memNode(charPointer)->owner;
-        // Copy the contents of the old block to the new one.
-        size_t ii = 0;
-        for (char *newPointer = returnValue, *oldPointer = charPointer;
-          ii < oldSize;
-          newPointer++, oldPointer++
-        ) {
-          *newPointer = *oldPointer;
-          ii++;
-        }
-        // Update memoryManagerState->mallocNext with the new last pointer.
-        memoryManagerState->mallocNext = returnValue;
-        return returnValue;
-      } else {
-        // Out of memory.  Fail the request.
-        return NULL;
-      }
-    }
-  } else if (ptr != NULL) {
-    // We're being asked to reallocate a pointer that was *NOT* allocated by
-    // this allocator.  This is not valid and we cannot do this.  Fail.
-    return NULL;
-  }
-  
-  // We're allocating new memory.
-  if ((((uintptr_t) (
-      memoryManagerState->mallocNext - size - sizeof(MemNode))
-    ) >= memoryManagerState->mallocEnd)
-  ) {
-    returnValue = memoryManagerState->mallocNext - size - sizeof(MemNode);
-    memNode(returnValue)->size = size;
-    memNode(returnValue)->owner = pid;
-    memNode(returnValue)->prev = memNode(memoryManagerState->mallocNext);
-    memoryManagerState->mallocNext -= size + sizeof(MemNode);
-  } // else we don't have enough memory left to satisfy the request.
-  
-  if ((returnValue != NULL) && (ptr != NULL)) {
-    // Because of the logic above, we're guaranteed that this means that the
-    // address of returnValue is not the same as the address of ptr.  Copy
-    // the data from the old memory to the new memory and free the old
-    // memory.
-    memcpy(returnValue, ptr, sizeOfMemory(ptr));
-    localFree(memoryManagerState, ptr);
-  }
-  
-  return returnValue;
-}
-
-#ifdef __cplusplus
-} // extern "C"
-#endif
-
-/******************* End Custom Memory Management Functions *******************/
+/// @brief Pointer to the MemoryManagerState maintained by the memory manager
+/// task.  Set once the heap has been initialized so that other tasks can
+/// allocate from it directly instead of sending messages.  NULL until then.
+static MemoryManagerState *sharedMemoryManagerState = NULL;
 
 /// @fn int memoryManagerReallocCommandHandler(
 ///   MemoryManagerState *memoryManagerState, TaskMessage *incoming)
@@ -363,8 +149,7 @@ int memoryManagerGetFreeMemoryCommandHandler(
   int returnValue = 0;
   
   TaskDescriptor *from = taskMessageFrom(incoming);
-  uintptr_t dynamicMemorySize = (uintptr_t) memoryManagerState->mallocNext
-    - memoryManagerState->mallocEnd + sizeof(void*);
+  uintptr_t dynamicMemorySize = localGetFreeMemory(memoryManagerState);
   
   // We need to mark waiting as true here so that taskMessageSetDone signals the
   // client side correctly.
@@ -458,19 +243,23 @@ const MemoryManagerCommandHandler memoryManagerCommandHandlers[] = {
 ///
 /// @return This function returns no value.
 void handleMemoryManagerMessages(MemoryManagerState *memoryManagerState) {
-  TaskMessage *taskMessage = taskMessageQueuePop();
-  while (taskMessage != NULL) {
-    MemoryManagerCommand messageType
-      = (MemoryManagerCommand) taskMessageType(taskMessage);
-    if (messageType >= NUM_MEMORY_MANAGER_COMMANDS) {
-      taskMessage = taskMessageQueuePop();
-      continue;
+  TaskMessage *taskMessages[MEMORY_MANAGER_MESSAGE_BATCH_SIZE];
+  int numMessages = taskMessageQueuePopBatch(
+    taskMessages, MEMORY_MANAGER_MESSAGE_BATCH_SIZE);
+  while (numMessages > 0) {
+    for (int ii = 0; ii < numMessages; ii++) {
+      MemoryManagerCommand messageType
+        = (MemoryManagerCommand) taskMessageType(taskMessages[ii]);
+      if (messageType >= NUM_MEMORY_MANAGER_COMMANDS) {
+        continue;
+      }
+      
+      memoryManagerCommandHandlers[messageType](
+        memoryManagerState, taskMessages[ii]);
     }
     
-    memoryManagerCommandHandlers[messageType](
-      memoryManagerState, taskMessage);
-    
-    taskMessage = taskMessageQueuePop();
+    numMessages = taskMessageQueuePopBatch(
+      taskMessages, MEMORY_MANAGER_MESSAGE_BATCH_SIZE);
   }
   
   return;
@@ -524,19 +313,8 @@ void initializeGlobals(MemoryManagerState *memoryManagerState,
   // least sizeof(mallocBufferStart) bytes first.  So, the true beginning of our
   // buffer is not at the address of mallocBufferStart but that address plus
   // sizeof(mallocBufferStart);
-  memoryManagerState->mallocNext
-    = ((char*) &mallocBufferStart) + sizeof(mallocBufferStart);
-  memNode(memoryManagerState->mallocNext)->prev = NULL;
-  memoryManagerState->mallocStart
-    = (uintptr_t) memoryManagerState->mallocNext;
-  
-  // The value at memNode(memoryManagerState->mallocNext)->size needs to be
-  // non-zero in order for the memory compaction algorithm in localFree to work
-  // properly.
-  memoryManagerState->mallocEnd
-    = ((uintptr_t) memoryManagerState->mallocStart) - memorySize;
-  memNode(memoryManagerState->mallocNext)->size = memorySize;
-  memNode(memoryManagerState->mallocNext)->owner = TASK_ID_NOT_SET;
+  localInitializeHeap(memoryManagerState,
+    ((char*) &mallocBufferStart) + sizeof(mallocBufferStart), memorySize);
   
   printDebugString("Leaving initializeGlobals in MemoryManager.c\n");
   longjmp(returnBuffer, (int) ((intptr_t) stack));
@@ -649,6 +427,9 @@ void* runMemoryManager(void *args) {
   printConsoleString(" bytes of dynamic memory.\n");
   releaseConsole();
   
+  // Allocations no longer need to come through us.
+  sharedMemoryManagerState = &memoryManagerState;
+  
   while (1) {
     schedulerMessage = (TaskMessage*) taskYield();
     if (schedulerMessage != NULL) {
@@ -750,23 +531,81 @@ void* memoryManagerSendReallocMessage(void *ptr, size_t size) {
 ///
 /// @brief Free previously-allocated memory.  The provided pointer may have
 /// been allocated either by the system memory functions or from our static
-/// memory pool.
+/// memory pool.  Once the memory manager has initialized the heap, the memory
+/// is freed directly in the caller's context.
 ///
 /// @param ptr A pointer to the block of memory to free.
 ///
 /// @return This function always succeeds and returns no value.
 void memoryManagerFree(void *ptr) {
-  if (ptr != NULL) {
+  if (ptr == NULL) {
+    return;
+  } else if (sharedMemoryManagerState == NULL) {
     sendNanoOsMessageToPid(
       NANO_OS_MEMORY_MANAGER_TASK_ID, MEMORY_MANAGER_FREE,
       (NanoOsMessageData) 0, (NanoOsMessageData) ((intptr_t) ptr), false);
+    return;
   }
+  
+  schedulerDisablePreemption();
+  localFree(sharedMemoryManagerState, ptr);
+  schedulerEnablePreemption();
+  
+  return;
+}
+
+/// @fn void memoryManagerFreeArray(void **ptrs, int numPtrs)
+///
+/// @brief Free an array of previously-allocated pointers.  Once the memory
+/// manager has initialized the heap, they're all freed directly in one
+/// critical section.  Before then, the free requests are sent to the memory
+/// manager in batches so that it's woken once per batch instead of once per
+/// pointer.  NULL pointers in the array are skipped.
+///
+/// @param ptrs The array of pointers to free.  The array itself is not freed.
+/// @param numPtrs The number of elements in the ptrs array.
+///
+/// @return This function always succeeds and returns no value.
+void memoryManagerFreeArray(void **ptrs, int numPtrs) {
+  if (sharedMemoryManagerState != NULL) {
+    schedulerDisablePreemption();
+    for (int ii = 0; ii < numPtrs; ii++) {
+      localFree(sharedMemoryManagerState, ptrs[ii]);
+    }
+    schedulerEnablePreemption();
+    
+    return;
+  }
+  
+  NanoOsMessageData data[MEMORY_MANAGER_MESSAGE_BATCH_SIZE];
+  int numData = 0;
+  for (int ii = 0; ii < numPtrs; ii++) {
+    if (ptrs[ii] == NULL) {
+      continue;
+    }
+
+    data[numData] = (NanoOsMessageData) ((intptr_t) ptrs[ii]);
+    numData++;
+    if (numData == MEMORY_MANAGER_MESSAGE_BATCH_SIZE) {
+      sendNanoOsMessagesToPid(NANO_OS_MEMORY_MANAGER_TASK_ID,
+        MEMORY_MANAGER_FREE, (NanoOsMessageData) 0, data, numData);
+      numData = 0;
+    }
+  }
+  if (numData > 0) {
+    sendNanoOsMessagesToPid(NANO_OS_MEMORY_MANAGER_TASK_ID,
+      MEMORY_MANAGER_FREE, (NanoOsMessageData) 0, data, numData);
+  }
+
   return;
 }
 
 /// @fn void* memoryManagerRealloc(void *ptr, size_t size)
 ///
-/// @brief Reallocate a provided pointer to a new size.
+/// @brief Reallocate a provided pointer to a new size.  Once the memory
+/// manager has initialized the heap, this runs the allocator directly in the
+/// caller's context instead of sending a message to the memory manager and
+/// waiting for its reply.
 ///
 /// @param ptr A pointer to the original block of dynamic memory.  If this value
 ///   is NULL, new memory will be allocated.
@@ -776,7 +615,18 @@ void memoryManagerFree(void *ptr) {
 /// @return Returns a pointer to size-adjusted memory on success, NULL on
 /// failure or free.
 void* memoryManagerRealloc(void *ptr, size_t size) {
-  return memoryManagerSendReallocMessage(ptr, size);
+  if (sharedMemoryManagerState == NULL) {
+    return memoryManagerSendReallocMessage(ptr, size);
+  }
+  
+  // The allocator never yields, so keeping the preemption timer from
+  // interrupting it is all that's needed to keep other tasks out of the heap.
+  schedulerDisablePreemption();
+  void *returnValue = localRealloc(sharedMemoryManagerState,
+    ptr, size, taskId(getRunningTask()));
+  schedulerEnablePreemption();
+  
+  return returnValue;
 }
 
 /// @fn void* memoryManagerMalloc(size_t size)
@@ -788,7 +638,7 @@ void* memoryManagerRealloc(void *ptr, size_t size) {
 /// @return Returns a pointer to newly-allocated memory of the specified size
 /// on success, NULL on failure.
 void* memoryManagerMalloc(size_t size) {
-  return memoryManagerSendReallocMessage(NULL, size);
+  return memoryManagerRealloc(NULL, size);
 }
 
 /// @fn void* memoryManagerCalloc(size_t nmemb, size_t size)
@@ -802,7 +652,7 @@ void* memoryManagerMalloc(size_t size) {
 /// size on success, NULL on failure.
 void* memoryManagerCalloc(size_t nmemb, size_t size) {
   size_t totalSize = nmemb * size;
-  void *returnValue = memoryManagerSendReallocMessage(NULL, totalSize);
+  void *returnValue = memoryManagerRealloc(NULL, totalSize);
   
   if (returnValue != NULL) {
     memset(returnValue, 0, totalSize);
@@ -61,6 +61,13 @@ extern "C"
 /// possible while still allowing debug prints to work.
 #define MEMORY_MANAGER_DEBUG_STACK_SIZE 768
 
+/// @def MEMORY_MANAGER_MESSAGE_BATCH_SIZE
+///
+/// @brief The maximum number of messages the memory manager pops from its
+/// queue at once and the maximum number of pointers memoryManagerFreeArray
+/// sends in one batch.
+#define MEMORY_MANAGER_MESSAGE_BATCH_SIZE 8
+
 /// @enum MemoryManagerCommandResponse
 ///
 /// @brief Commands and responses recognized by the memory manager.
@@ -84,6 +91,7 @@ void memoryManagerFree(void *ptr);
 #undef free
 #endif // free
 #define free(ptr) memoryManagerFree(ptr)
+void memoryManagerFreeArray(void **ptrs, int numPtrs);
 
 void* memoryManagerRealloc(void *ptr, size_t size);
 #ifdef realloc
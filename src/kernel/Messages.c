@@ -84,8 +84,351 @@ msg_sync_t msg_sync_array[] = {
   },
 };
 
+// Synchronization dispatch.  When THREAD_SAFE_COROUTINES is defined, a message
+// or queue may use either thread or coroutine primitives, so every operation
+// goes through the msg_sync_t of the object.  Otherwise, coroutine primitives
+// are the only possibility, so the calls are made directly and msg_t and
+// msg_q_t don't carry a msg_sync pointer at all.  The obj parameter of each of
+// these macros is a pointer to a msg_t or msg_q_t.
+#ifdef THREAD_SAFE_COROUTINES
+#define msg_sync_set(obj, msg_safety) \
+  (obj)->msg_sync = &msg_sync_array[msg_safety]
+#define msg_sync_mtx_init(obj, type) \
+  (obj)->msg_sync->mtx_init(&(obj)->lock, type)
+#define msg_sync_mtx_lock(obj) \
+  (obj)->msg_sync->mtx_lock(&(obj)->lock)
+#define msg_sync_mtx_unlock(obj) \
+  (obj)->msg_sync->mtx_unlock(&(obj)->lock)
+#define msg_sync_mtx_destroy(obj) \
+  (obj)->msg_sync->mtx_destroy(&(obj)->lock)
+#define msg_sync_mtx_timedlock(obj, ts) \
+  (obj)->msg_sync->mtx_timedlock(&(obj)->lock, ts)
+#define msg_sync_mtx_trylock(obj) \
+  (obj)->msg_sync->mtx_trylock(&(obj)->lock)
+#define msg_sync_cnd_broadcast(obj) \
+  (obj)->msg_sync->cnd_broadcast(&(obj)->condition)
+#define msg_sync_cnd_destroy(obj) \
+  (obj)->msg_sync->cnd_destroy(&(obj)->condition)
+#define msg_sync_cnd_init(obj) \
+  (obj)->msg_sync->cnd_init(&(obj)->condition)
+#define msg_sync_cnd_timedwait(obj, ts) \
+  (obj)->msg_sync->cnd_timedwait(&(obj)->condition, &(obj)->lock, ts)
+#define msg_sync_cnd_wait(obj) \
+  (obj)->msg_sync->cnd_wait(&(obj)->condition, &(obj)->lock)
+#else // THREAD_SAFE_COROUTINES not defined
+#define msg_sync_set(obj, msg_safety) \
+  (void) (msg_safety)
+#define msg_sync_mtx_init(obj, type) \
+  comutexInit(&(obj)->lock, type)
+#define msg_sync_mtx_lock(obj) \
+  comutexLock(&(obj)->lock)
+#define msg_sync_mtx_unlock(obj) \
+  comutexUnlock(&(obj)->lock)
+#define msg_sync_mtx_destroy(obj) \
+  comutexDestroy(&(obj)->lock)
+#define msg_sync_mtx_timedlock(obj, ts) \
+  comutexTimedLock(&(obj)->lock, ts)
+#define msg_sync_mtx_trylock(obj) \
+  comutexTryLock(&(obj)->lock)
+#define msg_sync_cnd_broadcast(obj) \
+  coconditionBroadcast(&(obj)->condition)
+#define msg_sync_cnd_destroy(obj) \
+  coconditionDestroy(&(obj)->condition)
+#define msg_sync_cnd_init(obj) \
+  coconditionInit(&(obj)->condition)
+#define msg_sync_cnd_timedwait(obj, ts) \
+  coconditionTimedWait(&(obj)->condition, &(obj)->lock, ts)
+#define msg_sync_cnd_wait(obj) \
+  coconditionWait(&(obj)->condition, &(obj)->lock)
+#endif // THREAD_SAFE_COROUTINES
+
+// Done signalling.  When THREAD_SAFE_COROUTINES is defined, every message
+// carries its own lock and condition.  Otherwise, all messages share the ones
+// in msg_done_sync_object.  Waiters recheck their own done flag whenever the
+// shared condition is broadcast, so the only cost of sharing is a spurious
+// wakeup of a coroutine that's waiting on a different message.
+//
+// Preemption means that the shared lock can be held by a task that isn't
+// running, for any message.  Marking a message done must never block on it
+// because the scheduler does that and the scheduler can't yield.  If the lock
+// is busy, the message is marked done without it and the broadcast is left
+// pending.  The pending broadcast is made by the next msg_done_sync_unlock or,
+// if the waiter itself was holding the lock, by msg_done_flush once the waiter
+// has released it to wait.
+#ifdef THREAD_SAFE_COROUTINES
+#define msg_done_sync(msg) (msg)
+#define msg_done_sync_destroy(msg) { \
+  msg_sync_cnd_destroy(msg); \
+  msg_sync_mtx_destroy(msg); \
+}
+#define msg_done_sync_trylock(msg) msg_sync_mtx_trylock(msg)
+#define msg_done_sync_unlock(msg) msg_sync_mtx_unlock(msg)
+#define msg_done_sync_defer(msg) ((void) (msg), false)
+#else // THREAD_SAFE_COROUTINES not defined
+
+/// @var msg_done_sync_object
+///
+/// @brief The lock and condition shared by all messages for signalling done.
+static struct {
+  msg_mtx_t lock;
+  msg_cnd_t condition;
+} msg_done_sync_object = {
+  .lock = { .type = msg_mtx_plain | msg_mtx_timed },
+};
+
+/// @var msg_done_broadcast_pending
+///
+/// @brief Whether a message was marked done while the shared lock was busy and
+/// its waiters haven't been woken yet.
+static volatile bool msg_done_broadcast_pending = false;
+
+#define msg_done_sync(msg) (&msg_done_sync_object)
+#define msg_done_sync_destroy(msg) {}
+#define msg_done_sync_trylock(msg) msg_sync_mtx_trylock(msg_done_sync(msg))
+#define msg_done_sync_unlock(msg) msg_done_sync_unlock_()
+#define msg_done_sync_defer(msg) \
+  ((void) (msg), msg_done_broadcast_pending = true, true)
+
+/// @fn static inline void msg_done_sync_unlock_(void)
+///
+/// @brief Unlock the shared done lock, making any pending broadcast first.
+///
+/// @return This function returns no value.
+static inline void msg_done_sync_unlock_(void) {
+  if (msg_done_broadcast_pending) {
+    msg_done_broadcast_pending = false;
+    msg_sync_cnd_broadcast(&msg_done_sync_object);
+  }
+  msg_sync_mtx_unlock(&msg_done_sync_object);
+}
+#endif // THREAD_SAFE_COROUTINES
+
+// Message queue helpers.  These must be called with the queue's lock held.
+
+#if MSG_Q_TYPE_INDEX_SIZE > 0
+/// @def msg_q_type_index
+///
+/// @brief Get the index of the per-type sublist that holds messages of a given
+/// type.
+#define msg_q_type_index(type) \
+  (((uint32_t) (type)) & (MSG_Q_TYPE_INDEX_SIZE - 1))
+#endif // MSG_Q_TYPE_INDEX_SIZE
+
+#if MSG_Q_TYPE_INDEX_SIZE > 0
+/// @fn static void msg_q_index_types(msg_q_t *queue)
+///
+/// @brief Build a queue's type index from the messages already in it.  Queues
+/// start out without one so that queues that are only ever popped in order
+/// don't pay to maintain it.  The index is built the first time a queue is
+/// searched by type and kept up to date from then on.
+///
+/// @param queue The queue to index.
+///
+/// @return This function returns no value.
+static void msg_q_index_types(msg_q_t *queue) {
+  memset(queue->type_head, 0, sizeof(queue->type_head));
+  memset(queue->type_tail, 0, sizeof(queue->type_tail));
+
+  msg_t *prev = NULL;
+  for (msg_t *cur = queue->head; cur != NULL; cur = cur->next) {
+    uint32_t index = msg_q_type_index(cur->type);
+    cur->prev = prev;
+    cur->next_of_type = NULL;
+    if (queue->type_tail[index] != NULL) {
+      queue->type_tail[index]->next_of_type = cur;
+    } else {
+      queue->type_head[index] = cur;
+    }
+    queue->type_tail[index] = cur;
+    prev = cur;
+  }
+
+  queue->indexed = true;
+}
+#endif // MSG_Q_TYPE_INDEX_SIZE
+
+/// @fn static msg_t* msg_q_find(msg_q_t *queue, const int64_t *type,
+///   const msg_endpoint_t *from, msg_t **prev)
+///
+/// @brief Find the first message in a queue that matches the given criteria.
+/// When a type is given and the queue has a type index, only the messages in
+/// that type's sublist are considered.  The index is built on the first
+/// search by type.
+///
+/// @param queue The queue to search.
+/// @param type A pointer to the message type to look for.  If this parameter is
+///   NULL, messages of any type will match.
+/// @param from A pointer to the endpoint the message must be from.  If this
+///   parameter is NULL, messages from any endpoint will match.
+/// @param prev A pointer to a msg_t pointer that will be set to the message
+///   before the found message in the queue, which will be NULL if the found
+///   message is the head.
+///
+/// @return Returns a pointer to the first matching message in the queue if
+/// there is one, NULL otherwise.
+static msg_t* msg_q_find(msg_q_t *queue, const int64_t *type,
+  const msg_endpoint_t *from, msg_t **prev
+) {
+  msg_t *cur = NULL;
+  *prev = NULL;
+
+#if MSG_Q_TYPE_INDEX_SIZE > 0
+  if (type != NULL) {
+    if (!queue->indexed) {
+      msg_q_index_types(queue);
+    }
+    cur = queue->type_head[msg_q_type_index(*type)];
+    while ((cur != NULL)
+      && ((cur->type != *type)
+        || ((from != NULL)
+          && (memcmp(&cur->from, from, sizeof(msg_endpoint_t)) != 0)
+        )
+      )
+    ) {
+      cur = cur->next_of_type;
+    }
+    if (cur != NULL) {
+      *prev = cur->prev;
+    }
+
+    return cur;
+  }
+#endif // MSG_Q_TYPE_INDEX_SIZE
+
+  cur = queue->head;
+  while ((cur != NULL)
+    && (((type != NULL) && (cur->type != *type))
+      || ((from != NULL)
+        && (memcmp(&cur->from, from, sizeof(msg_endpoint_t)) != 0)
+      )
+    )
+  ) {
+    *prev = cur;
+    cur = cur->next;
+  }
+
+  return cur;
+}
+
+/// @var msg_event_callback
+///
+/// @brief The function to call at each msg_event_t in a message's life.  Set
+/// with msg_set_event_callback.
+static msg_event_callback_t msg_event_callback = NULL;
+
+/// @fn static void msg_q_append(msg_q_t *queue, msg_t *msg)
+///
+/// @brief Add a message to the tail of a queue and report the push to the
+/// event callback.
+///
+/// @param queue The queue to add the message to.
+/// @param msg The message to add.
+///
+/// @return This function returns no value.
+static void msg_q_append(msg_q_t *queue, msg_t *msg) {
+  msg->next = NULL;
+  if (queue->tail != NULL) {
+    queue->tail->next = msg;
+  } else {
+    // Empty queue.  Populate both queue->head and queue->tail.
+    queue->head = msg;
+  }
+
+#if MSG_Q_TYPE_INDEX_SIZE > 0
+  if (queue->indexed) {
+    msg->prev = queue->tail;
+    msg->next_of_type = NULL;
+    uint32_t index = msg_q_type_index(msg->type);
+    if (queue->type_tail[index] != NULL) {
+      queue->type_tail[index]->next_of_type = msg;
+    } else {
+      queue->type_head[index] = msg;
+    }
+    queue->type_tail[index] = msg;
+  }
+#endif // MSG_Q_TYPE_INDEX_SIZE
+
+  queue->tail = msg;
+  queue->length++;
+
+  if (msg_event_callback != NULL) {
+    msg_event_callback(msg, queue, MSG_EVENT_PUSH);
+  }
+}
+
+/// @fn static void msg_q_remove(msg_q_t *queue, msg_t *msg, msg_t *prev)
+///
+/// @brief Remove a message from a queue and report the pop to the event
+/// callback.
+///
+/// @param queue The queue to remove the message from.
+/// @param msg The message to remove.
+/// @param prev The message before msg in the queue, as returned by msg_q_find.
+///
+/// @return This function returns no value.
+static void msg_q_remove(msg_q_t *queue, msg_t *msg, msg_t *prev) {
+  if (prev != NULL) {
+    prev->next = msg->next;
+  } else {
+    queue->head = msg->next;
+  }
+  if (queue->tail == msg) {
+    queue->tail = prev;
+  }
+
+#if MSG_Q_TYPE_INDEX_SIZE > 0
+  if (queue->indexed) {
+    if (msg->next != NULL) {
+      msg->next->prev = prev;
+    }
+
+    // msg is the first message of its type in the sublist, so the only
+    // messages ahead of it are ones whose types share the sublist.
+    uint32_t index = msg_q_type_index(msg->type);
+    msg_t *prev_of_type = NULL;
+    msg_t **link = &queue->type_head[index];
+    while (*link != msg) {
+      prev_of_type = *link;
+      link = &prev_of_type->next_of_type;
+    }
+    *link = msg->next_of_type;
+    if (queue->type_tail[index] == msg) {
+      queue->type_tail[index] = prev_of_type;
+    }
+    msg->prev = NULL;
+    msg->next_of_type = NULL;
+  }
+#endif // MSG_Q_TYPE_INDEX_SIZE
+
+  msg->next = NULL;
+  queue->length--;
+
+  if (msg_event_callback != NULL) {
+    msg_event_callback(msg, queue, MSG_EVENT_POP);
+  }
+}
+
 // Message functions
 
+/// @fn void msg_set_event_callback(msg_event_callback_t callback)
+///
+/// @brief Set the function to call whenever a message is pushed, popped, marked
+/// done, or released.  This allows the owner of a pool of messages to keep
+/// track of which ones are free without scanning them and to gather statistics
+/// about the messages that are sent.
+///
+/// MSG_EVENT_DONE and MSG_EVENT_RELEASE callbacks are made after the done flag
+/// has been set and any waiters have been signalled.  MSG_EVENT_RELEASE is
+/// only reported for messages that were in use and is not reported for
+/// dynamically-allocated messages that msg_destroy frees.
+///
+/// @param callback The function to call, or NULL to disable the callback.
+///
+/// @return This function returns no value.
+void msg_set_event_callback(msg_event_callback_t callback) {
+  msg_event_callback = callback;
+}
+
 /// @fn int msg_start_use(msg_t *msg, msg_safety_t msg_safety)
 ///
 /// @brief Set all the member elements of a msg_t to their default values so
@@ -111,17 +454,22 @@ static inline int msg_start_use(msg_t *msg, msg_safety_t msg_safety) {
       memset(&msg->from, 0, sizeof(msg->from));
       memset(&msg->to, 0, sizeof(msg->to));
       if (msg->configured == false) {
-        msg->msg_sync = &msg_sync_array[msg_safety];
-        if (msg->msg_sync->cnd_init(&msg->condition) == msg_success) {
-          if (msg->msg_sync->mtx_init(&msg->lock, msg_mtx_plain | msg_mtx_timed)
+        msg_sync_set(msg, msg_safety);
+#ifdef THREAD_SAFE_COROUTINES
+        if (msg_sync_cnd_init(msg) == msg_success) {
+          if (msg_sync_mtx_init(msg, msg_mtx_plain | msg_mtx_timed)
             == msg_success
           ) {
             msg->configured = true;
           } else {
-            msg->msg_sync->cnd_destroy(&msg->condition);
+            msg_sync_cnd_destroy(msg);
             return_value = msg_error;
           }
         }
+#else
+        // The shared lock and condition are statically initialized.
+        msg->configured = true;
+#endif // THREAD_SAFE_COROUTINES
       }
       // Don't touch msg->dynamically_allocated;
     } // Else this message is already setup
@@ -181,17 +529,17 @@ msg_t* msg_destroy(msg_t *msg) {
   // Don't touch msg->size.
   // Don't touch msg->next.
   // Don't touch msg->waiting.
+  bool was_in_use = msg->in_use;
   msg->in_use = false;
   // Don't touch from.
   if (msg->configured == true) {
-    if (msg->msg_sync->mtx_trylock(&msg->lock) == msg_success) {
+    if (msg_done_sync_trylock(msg) == msg_success) {
       msg->done = true;
     
       if (msg->waiting == false) {
         // Nothing is waiting.  Destroy the resources.
-        msg->msg_sync->mtx_unlock(&msg->lock);
-        msg->msg_sync->cnd_destroy(&msg->condition);
-        msg->msg_sync->mtx_destroy(&msg->lock);
+        msg_done_sync_unlock(msg);
+        msg_done_sync_destroy(msg);
         msg->configured = false;
         if (msg->dynamically_allocated == true) {
           free(msg); msg = NULL;
@@ -199,15 +547,19 @@ msg_t* msg_destroy(msg_t *msg) {
       } else {
         // Something is waiting.  Signal the waiters.  It will be up to them to
         // destroy this message again later.
-        msg->msg_sync->cnd_broadcast(&msg->condition);
-        msg->msg_sync->mtx_unlock(&msg->lock);
+        msg_sync_cnd_broadcast(msg_done_sync(msg));
+        msg_done_sync_unlock(msg);
       }
+    } else if (msg_done_sync_defer(msg)) {
+      // The shared lock is busy, possibly because something is about to wait
+      // on this message, so leave the message configured for it.  Its waiters
+      // will be signalled when the lock is free.
+      msg->done = true;
     } else {
       // We can't do any signalling.  Just tear down everything.
       msg->done = true;
       msg->waiting = false;
-      msg->msg_sync->cnd_destroy(&msg->condition);
-      msg->msg_sync->mtx_destroy(&msg->lock);
+      msg_done_sync_destroy(msg);
       msg->configured = false;
       if (msg->dynamically_allocated == true) {
         free(msg); msg = NULL;
@@ -218,6 +570,12 @@ msg_t* msg_destroy(msg_t *msg) {
     free(msg); msg = NULL;
   }
   
+  if ((msg != NULL) && (was_in_use == true)
+    && (msg_event_callback != NULL)
+  ) {
+    msg_event_callback(msg, NULL, MSG_EVENT_RELEASE);
+  }
+  
   return msg;
 }
 
@@ -283,18 +641,23 @@ int msg_release(msg_t *msg) {
   // Don't touch msg->size.
   // Don't touch msg->next.
   // Don't touch msg->waiting.
+  bool was_in_use = msg->in_use;
   msg->in_use = false;
   // Don't touch msg->from.
   if (msg->configured == true) {
-    if (msg->msg_sync->mtx_trylock(&msg->lock) == msg_success) {
+    if (msg_done_sync_trylock(msg) == msg_success) {
       msg->done = true;
       
       if (msg->waiting == true) {
         // Something is waiting.  Signal the waiters.  It will be up to them to
         // destroy this message again later.
-        msg->msg_sync->cnd_broadcast(&msg->condition);
+        msg_sync_cnd_broadcast(msg_done_sync(msg));
       }
-      msg->msg_sync->mtx_unlock(&msg->lock);
+      msg_done_sync_unlock(msg);
+    } else if (msg_done_sync_defer(msg)) {
+      // The shared lock is busy.  Its waiters will be signalled when it's
+      // free.
+      msg->done = true;
     } else {
       // Something is wrong here.  We're releasing a msg_t that is not owned
       // by us.  We can't do a broadcast.  Just mark it done and return an
@@ -311,6 +674,13 @@ int msg_release(msg_t *msg) {
   // Don't touch msg->configured.
   // Don't touch msg->dynamically_allocated.
   
+  // Only tell the owner about the message after the done flag is set and any
+  // waiters have been signalled so that the message can't be reused out from
+  // under them.
+  if ((was_in_use == true) && (msg_event_callback != NULL)) {
+    msg_event_callback(msg, NULL, MSG_EVENT_RELEASE);
+  }
+  
   return return_value;
 }
 
@@ -336,17 +706,27 @@ int msg_set_done(msg_t *msg) {
   // Don't touch msg->waiting.
   // Don't touch msg->in_use.
   if (msg->configured == true) {
-    msg->msg_sync->mtx_lock(&msg->lock);
-    msg->done = true;
-    
-    if (msg->waiting == true) {
-      // Something is waiting.  Signal the waiters.  It will be up to them to
-      // destroy this message again later.
-      return_value = msg->msg_sync->cnd_broadcast(&msg->condition);
-    } else {
+    int lock_status = msg_done_sync_trylock(msg);
+    if ((lock_status != msg_success) && (msg_done_sync_defer(msg))) {
+      // The shared lock is busy.  Its waiters will be signalled when it's
+      // free.
+      msg->done = true;
       return_value = msg_success;
+    } else {
+      if (lock_status != msg_success) {
+        msg_sync_mtx_lock(msg_done_sync(msg));
+      }
+      msg->done = true;
+
+      if (msg->waiting == true) {
+        // Something is waiting.  Signal the waiters.  It will be up to them to
+        // destroy this message again later.
+        return_value = msg_sync_cnd_broadcast(msg_done_sync(msg));
+      } else {
+        return_value = msg_success;
+      }
+      msg_done_sync_unlock(msg);
     }
-    msg->msg_sync->mtx_unlock(&msg->lock);
   } else {
     // Nothing we can do but set the done flag.
     msg->done = true;
@@ -358,6 +738,10 @@ int msg_set_done(msg_t *msg) {
   // Don't touch msg->configured.
   // Don't touch msg->dynamically_allocated.
   
+  if (msg_event_callback != NULL) {
+    msg_event_callback(msg, NULL, MSG_EVENT_DONE);
+  }
+  
   return return_value;
 }
 
@@ -394,9 +778,9 @@ int msg_wait_for_done(msg_t *msg, const struct timespec *ts) {
     msg->waiting = false;
   } else {
     if (ts == NULL) {
-      lock_status = msg->msg_sync->mtx_lock(&msg->lock);
+      lock_status = msg_sync_mtx_lock(msg_done_sync(msg));
     } else {
-      lock_status = msg->msg_sync->mtx_timedlock(&msg->lock, ts);
+      lock_status = msg_sync_mtx_timedlock(msg_done_sync(msg), ts);
     }
     if (lock_status != msg_success) {
       // Either we timed out or there's a problem with the lock.  Either way, we
@@ -408,10 +792,10 @@ int msg_wait_for_done(msg_t *msg, const struct timespec *ts) {
     msg->waiting = true;
     while (msg->done == false) {
       if (ts == NULL) {
-        wait_status = msg->msg_sync->cnd_wait(&msg->condition, &msg->lock);
+        wait_status = msg_sync_cnd_wait(msg_done_sync(msg));
       } else {
         wait_status
-          = msg->msg_sync->cnd_timedwait(&msg->condition, &msg->lock, ts);
+          = msg_sync_cnd_timedwait(msg_done_sync(msg), ts);
       }
       if (wait_status != msg_success) {
         // Either we timed out or there's a problem with the condition.  Again,
@@ -425,12 +809,31 @@ int msg_wait_for_done(msg_t *msg, const struct timespec *ts) {
       return_value = msg_success;
     }
 
-    msg->msg_sync->mtx_unlock(&msg->lock);
+    msg_done_sync_unlock(msg);
   }
   
   return return_value;
 }
 
+/// @fn void msg_done_flush(void)
+///
+/// @brief Signal the waiters of any messages that were marked done while the
+/// shared done lock was busy.  The holder of the lock normally does this when
+/// it unlocks, but a waiter that was preempted while holding the lock releases
+/// it by waiting instead, so something else has to try again afterwards.  The
+/// scheduler calls this between tasks.  It never blocks.
+///
+/// @return This function returns no value.
+void msg_done_flush(void) {
+#ifndef THREAD_SAFE_COROUTINES
+  if (msg_done_broadcast_pending
+    && (msg_done_sync_trylock(NULL) == msg_success)
+  ) {
+    msg_done_sync_unlock(NULL);
+  }
+#endif // THREAD_SAFE_COROUTINES
+}
+
 /// @fn msg_t* msg_wait_for_reply_with_type_(
 ///   msg_q_t *queue, msg_t *sent, bool release,
 ///   int64_t *type, const struct timespec *ts)
@@ -479,9 +882,9 @@ msg_t* msg_wait_for_reply_with_type_(
   // Recipient has processed the message.  We now need to wait for their reply.
   int lock_status = msg_success;
   if (ts == NULL) {
-    lock_status = queue->msg_sync->mtx_lock(&queue->lock);
+    lock_status = msg_sync_mtx_lock(queue);
   } else {
-    lock_status = queue->msg_sync->mtx_timedlock(&queue->lock, ts);
+    lock_status = msg_sync_mtx_timedlock(queue, ts);
   }
   if (lock_status != msg_success) {
     // Either we've timed out or there's a problem with the lock.  Either way,
@@ -492,49 +895,22 @@ msg_t* msg_wait_for_reply_with_type_(
   // mtx_timedlock will return thrd_timedout if the timeout is
   // reached, so we'll never reach this point if we've exceeded our timeout.
   msg_t *prev = NULL;
-  msg_t *cur = queue->head;
-  msg_t **prev_next = &queue->head;
-  int searchType = 0;
-  if (type != NULL) {
-    // This saves us from having to dereference the pointer in every iteration
-    // of the loop below.
-    searchType = *type;
-  }
 
   // Enter our main wait loop.
   int wait_status = msg_success;
   while (reply == NULL) {
-    while ((cur != NULL)
-      && ((memcmp(&cur->from, &recipient, sizeof(msg_endpoint_t)) != 0)
-        || ((type != NULL) && (cur->type != searchType))
-      )
-    ) {
-      prev = cur;
-      prev_next = &cur->next;
-      cur = cur->next;
-    }
+    reply = msg_q_find(queue, type, &recipient, &prev);
 
-    if (cur != NULL) {
+    if (reply != NULL) {
       // Desired reply was found.  Remove the message from the thread.
-      reply = cur;
-      *prev_next = cur->next;
-
-      if (queue->head == NULL) {
-        // Empty queue.  Set queue->tail to NULL too.
-        queue->tail = NULL;
-      }
-      if (queue->tail == cur) {
-        queue->tail = prev;
-      }
-      cur->next = NULL;
+      msg_q_remove(queue, reply, prev);
     } else {
       // Desired reply was not found.  Block until something else is pushed.
       if (ts == NULL) {
         wait_status
-          = queue->msg_sync->cnd_wait(&queue->condition, &queue->lock);
+          = msg_sync_cnd_wait(queue);
       } else {
-        wait_status = queue->msg_sync->cnd_timedwait(
-          &queue->condition, &queue->lock, ts);
+        wait_status = msg_sync_cnd_timedwait(queue, ts);
       }
       if (wait_status != msg_success) {
         // Something isn't as expected.  Bail.
@@ -543,13 +919,9 @@ msg_t* msg_wait_for_reply_with_type_(
       // cnd_timedwait will return thrd_timedout if the timeout is
       // reached, so we won't continue the loop if we've exceeded our timeout.
     }
-
-    prev = NULL;
-    cur = queue->head;
-    prev_next = &queue->head;
   }
 
-  queue->msg_sync->mtx_unlock(&queue->lock);
+  msg_sync_mtx_unlock(queue);
 
   return reply;
 }
@@ -619,7 +991,9 @@ msg_t* msg_wait_for_reply_with_type(msg_t *sent, bool release,
 /// @param msg_element The member element of the msg_t to get.
 ///
 /// @return Returns a pointer to the specified element on success, NULL on
-/// failure.
+/// failure.  The flag elements are bit fields when THREAD_SAFE_COROUTINES is
+/// not defined, so NULL is returned for them in that case; use msg_waiting,
+/// msg_done, and msg_in_use instead.
 void* msg_element(msg_t *msg, msg_element_t msg_element) {
   switch (msg_element) {
     case MSG_ELEMENT_TYPE: {
@@ -637,6 +1011,7 @@ void* msg_element(msg_t *msg, msg_element_t msg_element) {
       break;
     }
 
+#ifdef THREAD_SAFE_COROUTINES
     case MSG_ELEMENT_WAITING: {
       return &msg->waiting;
       break;
@@ -651,6 +1026,7 @@ void* msg_element(msg_t *msg, msg_element_t msg_element) {
       return &msg->in_use;
       break;
     }
+#endif // THREAD_SAFE_COROUTINES
 
     case MSG_ELEMENT_FROM: {
       return &msg->from;
@@ -700,19 +1076,23 @@ msg_q_t* msg_q_create(msg_q_t *q, msg_safety_t msg_safety) {
     return_value->dynamically_allocated = false;
   }
 
-  return_value->msg_sync = &msg_sync_array[msg_safety];
+  msg_sync_set(return_value, msg_safety);
 
   // return_value->head and return_value->tail are initialized to NULL by the
   // calloc call.
-  if (return_value->msg_sync->cnd_init(&return_value->condition)
-    != msg_success
-  ) {
+  return_value->length = 0;
+#if MSG_Q_TYPE_INDEX_SIZE > 0
+  memset(return_value->type_head, 0, sizeof(return_value->type_head));
+  memset(return_value->type_tail, 0, sizeof(return_value->type_tail));
+  return_value->indexed = false;
+#endif // MSG_Q_TYPE_INDEX_SIZE
+  if (msg_sync_cnd_init(return_value) != msg_success) {
     // Can't proceed.  Bail.
     goto cnd_init_failure;
   }
   
-  if (return_value->msg_sync->mtx_init(
-    &return_value->lock, msg_mtx_plain | msg_mtx_timed) != msg_success
+  if (msg_sync_mtx_init(return_value, msg_mtx_plain | msg_mtx_timed)
+    != msg_success
   ) {
     // Can't proceed.  Bail.
     goto mtx_init_failure;
@@ -721,7 +1101,7 @@ msg_q_t* msg_q_create(msg_q_t *q, msg_safety_t msg_safety) {
   return return_value; // valid queue
   
 mtx_init_failure:
-  return_value->msg_sync->cnd_destroy(&return_value->condition);
+  msg_sync_cnd_destroy(return_value);
 cnd_init_failure:
   if (q == NULL) {
     // No queue was provided by the user, so we dynamically allocated one.
@@ -754,9 +1134,15 @@ int msg_q_destroy(msg_q_t *queue) {
 
   queue->head = NULL;
   queue->tail = NULL;
+  queue->length = 0;
+#if MSG_Q_TYPE_INDEX_SIZE > 0
+  memset(queue->type_head, 0, sizeof(queue->type_head));
+  memset(queue->type_tail, 0, sizeof(queue->type_tail));
+  queue->indexed = false;
+#endif // MSG_Q_TYPE_INDEX_SIZE
   
-  queue->msg_sync->mtx_destroy(&queue->lock);
-  queue->msg_sync->cnd_destroy(&queue->condition);
+  msg_sync_mtx_destroy(queue);
+  msg_sync_cnd_destroy(queue);
   if (queue->dynamically_allocated == true) {
     free(queue);
   }
@@ -794,7 +1180,7 @@ msg_t* msg_q_pop(msg_q_t *queue) {
   msg_t *head = NULL;
   
   if ((queue == NULL)
-    || (queue->msg_sync->mtx_lock(&queue->lock) != msg_success)
+    || (msg_sync_mtx_lock(queue) != msg_success)
   ) {
     // Error case.
     return head; // NULL
@@ -802,20 +1188,46 @@ msg_t* msg_q_pop(msg_q_t *queue) {
   
   head = queue->head;
   if (head != NULL) {
-    queue->head = head->next;
-    head->next = NULL;
-    
-    if (queue->head == NULL) {
-      // Empty queue.  Set queue->tail to NULL too.
-      queue->tail = NULL;
-    }
+    msg_q_remove(queue, head, NULL);
   }
   
-  queue->msg_sync->mtx_unlock(&queue->lock);
+  msg_sync_mtx_unlock(queue);
   
   return head;
 }
 
+/// @fn size_t msg_q_pop_batch(msg_q_t *queue, msg_t **msgs, size_t max_msgs)
+///
+/// @brief Remove up to max_msgs messages from the head of the provided message
+/// queue while holding the queue's lock only once.
+///
+/// @param queue The queue to pop from.
+/// @param msgs The array to store the popped messages in, in queue order.
+/// @param max_msgs The maximum number of messages to pop.  msgs must have room
+///   for at least this many pointers.
+///
+/// @return Returns the number of messages popped, which may be 0.
+size_t msg_q_pop_batch(msg_q_t *queue, msg_t **msgs, size_t max_msgs) {
+  size_t num_msgs = 0;
+  
+  if ((queue == NULL) || (msgs == NULL)
+    || (msg_sync_mtx_lock(queue) != msg_success)
+  ) {
+    // Error case.
+    return num_msgs; // 0
+  }
+  
+  while ((num_msgs < max_msgs) && (queue->head != NULL)) {
+    msgs[num_msgs] = queue->head;
+    msg_q_remove(queue, queue->head, NULL);
+    num_msgs++;
+  }
+  
+  msg_sync_mtx_unlock(queue);
+  
+  return num_msgs;
+}
+
 /// @fn msg_t* msg_q_pop_type(msg_q_t *queue, int64_t type)
 ///
 /// @brief Get the first message of the specified type from the provided message
@@ -833,36 +1245,19 @@ msg_t* msg_q_pop_type(msg_q_t *queue, int64_t type) {
   }
   
   msg_t *prev = NULL;
-  msg_t *cur = queue->head;
-  msg_t **prev_next = &queue->head;
   
-  if (queue->msg_sync->mtx_lock(&queue->lock) != msg_success) {
+  if (msg_sync_mtx_lock(queue) != msg_success) {
     // Error case.
     return return_value; // NULL
   }
   
-  while ((cur != NULL) && (cur->type != type)) {
-    prev = cur;
-    prev_next = &cur->next;
-    cur = cur->next;
-  }
-  
-  if (cur != NULL) {
+  return_value = msg_q_find(queue, &type, NULL, &prev);
+  if (return_value != NULL) {
     // Desired type was found.  Remove the message from the queue.
-    return_value = cur;
-    *prev_next = cur->next;
-    
-    if (queue->head == NULL) {
-      // Empty queue.  Set queue->tail to NULL too.
-      queue->tail = NULL;
-    }
-    if (queue->tail == cur) {
-      queue->tail = prev;
-    }
-    cur->next = NULL;
+    msg_q_remove(queue, return_value, prev);
   }
   
-  queue->msg_sync->mtx_unlock(&queue->lock);
+  msg_sync_mtx_unlock(queue);
   
   return return_value;
 }
@@ -894,26 +1289,13 @@ msg_t* msg_q_wait_for_type_(msg_q_t *queue, int64_t *type,
   }
   
   msg_t *prev = NULL;
-  msg_t *cur = queue->head;
-  msg_t **prev_next = &queue->head;
   int lock_status = msg_success;
   int wait_status = msg_success;
-  int search_type = 0;
 
-  if (queue == NULL) {
-    return return_value; // NULL
-  }
-
-  if (type != NULL) {
-    // This saves us from having to dereference the pointer on each iteration
-    // of the loop below.
-    search_type = *type;
-  }
-  
   if (ts == NULL) {
-    lock_status = queue->msg_sync->mtx_lock(&queue->lock);
+    lock_status = msg_sync_mtx_lock(queue);
   } else {
-    lock_status = queue->msg_sync->mtx_timedlock(&queue->lock, ts);
+    lock_status = msg_sync_mtx_timedlock(queue, ts);
   }
   if (lock_status != msg_success) {
     // Error case.
@@ -923,33 +1305,19 @@ msg_t* msg_q_wait_for_type_(msg_q_t *queue, int64_t *type,
   // never reach this point if we've exceeded our timeout.
   
   while (return_value == NULL) {
-    while ((cur != NULL) && (type != NULL) && (cur->type != search_type)) {
-      prev = cur;
-      prev_next = &cur->next;
-      cur = cur->next;
-    }
+    return_value = msg_q_find(queue, type, NULL, &prev);
     
-    if (cur != NULL) {
+    if (return_value != NULL) {
       // Desired type was found.  Remove the message from the queue.
-      return_value = cur;
-      *prev_next = cur->next;
-      
-      if (queue->head == NULL) {
-        // Empty queue.  Set queue->tail to NULL too.
-        queue->tail = NULL;
-      }
-      if (queue->tail == cur) {
-        queue->tail = prev;
-      }
-      cur->next = NULL;
+      msg_q_remove(queue, return_value, prev);
     } else {
       // Desired type was not found.  Block until something else is pushed.
       if (ts == NULL) {
         wait_status
-          = queue->msg_sync->cnd_wait(&queue->condition, &queue->lock);
+          = msg_sync_cnd_wait(queue);
       } else {
         wait_status
-          = queue->msg_sync->cnd_timedwait(&queue->condition, &queue->lock, ts);
+          = msg_sync_cnd_timedwait(queue, ts);
       }
       if (wait_status != msg_success) {
         break;
@@ -957,13 +1325,9 @@ msg_t* msg_q_wait_for_type_(msg_q_t *queue, int64_t *type,
       // cnd_timedwait will return msg_timedout if the timeout is reached, so
       // we won't continue the loop if we've exceeded our timeout.
     }
-    
-    prev = NULL;
-    cur = queue->head;
-    prev_next = &queue->head;
   }
   
-  queue->msg_sync->mtx_unlock(&queue->lock);
+  msg_sync_mtx_unlock(queue);
   
   return return_value;
 }
@@ -1032,26 +1396,64 @@ int msg_q_push(msg_q_t *queue, msg_q_t *reply_to, msg_t *msg) {
     return return_value; // msg_error
   }
   
-  if (queue->msg_sync->mtx_lock(&queue->lock) != msg_success) {
+  if (msg_sync_mtx_lock(queue) != msg_success) {
     // Error case.
     return return_value; // msg_error
   }
   
-  msg->next = NULL;
-  if (queue->tail != NULL) {
-    queue->tail->next = msg;
-    queue->tail = msg;
-  } else {
-    // Empty queue.  Populate both queue->head and queue->tail.
-    queue->head = msg;
-    queue->tail = msg;
-  }
+  msg_q_append(queue, msg);
   msg->reply_to = reply_to;
   
   // Let all the waiters know that there's something new in the queue now.
-  return_value = queue->msg_sync->cnd_broadcast(&queue->condition);
+  return_value = msg_sync_cnd_broadcast(queue);
+  
+  msg_sync_mtx_unlock(queue);
+  
+  return return_value;
+}
+
+/// @fn int msg_q_push_batch(msg_q_t *queue, msg_q_t *reply_to,
+///   msg_t **msgs, size_t num_msgs)
+///
+/// @brief Push several messages onto a message queue while holding the queue's
+/// lock only once and waking its waiters only once.
+///
+/// @param queue The queue to push onto.
+/// @param reply_to The queue that should be replied to, if any.
+/// @param msgs The array of messages to push, in order.
+/// @param num_msgs The number of messages in the msgs array.
+///
+/// @return Returns msg_success on success, msg_error on failure.  No messages
+/// are pushed on failure.
+int msg_q_push_batch(msg_q_t *queue, msg_q_t *reply_to,
+  msg_t **msgs, size_t num_msgs
+) {
+  int return_value = msg_error;
+  
+  if ((queue == NULL) || (msgs == NULL)) {
+    // Invalid.
+    return return_value; // msg_error
+  }
+  for (size_t ii = 0; ii < num_msgs; ii++) {
+    if (msgs[ii] == NULL) {
+      return return_value; // msg_error
+    }
+  }
+  
+  if (msg_sync_mtx_lock(queue) != msg_success) {
+    // Error case.
+    return return_value; // msg_error
+  }
+  
+  for (size_t ii = 0; ii < num_msgs; ii++) {
+    msg_q_append(queue, msgs[ii]);
+    msgs[ii]->reply_to = reply_to;
+  }
+  
+  // Let all the waiters know that there's something new in the queue now.
+  return_value = msg_sync_cnd_broadcast(queue);
   
-  queue->msg_sync->mtx_unlock(&queue->lock);
+  msg_sync_mtx_unlock(queue);
   
   return return_value;
 }
@@ -65,6 +65,26 @@ extern "C"
 #define msg_mtx_recursive 1
 #define msg_mtx_timed     2
 
+/// @def MSG_Q_TYPE_INDEX_SIZE
+///
+/// @brief The number of per-type sublists kept by each message queue so that
+/// typed pops and waits don't have to walk past messages of other types.  A
+/// message of type T is on sublist T modulo MSG_Q_TYPE_INDEX_SIZE.  Must be a
+/// power of two.  0 disables the index, which saves two pointers per message
+/// and two pointers per sublist per queue.  Only builds that run as an
+/// application within another OS have the memory to spare by default.
+#ifndef MSG_Q_TYPE_INDEX_SIZE
+#if defined(__linux__) || defined(__linux) || defined(_WIN32)
+#define MSG_Q_TYPE_INDEX_SIZE 8
+#else
+#define MSG_Q_TYPE_INDEX_SIZE 0
+#endif
+#endif // MSG_Q_TYPE_INDEX_SIZE
+
+#if (MSG_Q_TYPE_INDEX_SIZE & (MSG_Q_TYPE_INDEX_SIZE - 1)) != 0
+#error "MSG_Q_TYPE_INDEX_SIZE must be a power of two"
+#endif
+
 /// @enum msg_safety_t
 ///
 /// @brief Indicator of what level of safety to employ with message operations
@@ -102,13 +122,13 @@ typedef struct msg_sync_t {
 // Array of these structures declared and instantiated in Messages.c.
 extern msg_sync_t msg_sync_array[];
 
+#ifdef THREAD_SAFE_COROUTINES
+
 /// @union msg_mtx_t
 ///
 /// Union of all possible valid mutexe types for a msg_t or msg_q_t.
 typedef union msg_mtx_t {
-#ifdef THREAD_SAFE_COROUTINES
   mtx_t thrd_mtx;
-#endif // THREAD_SAFE_COROUTINES
   coro_mtx_t coro_mtx;
 } msg_mtx_t;
 
@@ -116,12 +136,26 @@ typedef union msg_mtx_t {
 ///
 /// Union of all possible valid condition types for a msg_t or msg_q_t.
 typedef union msg_cnd_t {
-#ifdef THREAD_SAFE_COROUTINES
   cnd_t thrd_cnd;
-#endif // THREAD_SAFE_COROUTINES
   coro_cnd_t coro_cnd;
 } msg_cnd_t;
 
+#else // THREAD_SAFE_COROUTINES not defined
+
+/// @typedef msg_mtx_t
+///
+/// Coroutine mutexes are the only possible mutex type for a msg_t or msg_q_t
+/// without thread support, so no union is needed.
+typedef coro_mtx_t msg_mtx_t;
+
+/// @typedef msg_cnd_t
+///
+/// Coroutine conditions are the only possible condition type for a msg_t or
+/// msg_q_t without thread support, so no union is needed.
+typedef coro_cnd_t msg_cnd_t;
+
+#endif // THREAD_SAFE_COROUTINES
+
 /// @union msg_endpoint_t
 ///
 /// @brief Union of all possible valid endpoints for a msg_t to be sent to (or
@@ -142,6 +176,10 @@ typedef union msg_endpoint_t {
 /// @param data A pointer to the data of the message.
 /// @param size The number of bytes pointed to by the data pointer.
 /// @param next A pointer to the next msg_t in a message queue.
+/// @param prev A pointer to the previous msg_t in a message queue.  Only
+///   present when MSG_Q_TYPE_INDEX_SIZE is non-zero.
+/// @param next_of_type A pointer to the next msg_t in the same per-type sublist
+///   of a message queue.  Only present when MSG_Q_TYPE_INDEX_SIZE is non-zero.
 /// @param waiting A Boolean flag to indicate whether or not the sender is
 ///   waiting on a response message from the recipient of the message.
 /// @param done A Boolean flag to indicate whether or not the receiving entity
@@ -151,8 +189,9 @@ typedef union msg_endpoint_t {
 /// @param from A msg_endpoint_t union that represents the sending entity.
 /// @param to A msg_endpoint_t union that represents the receiveing entity.
 /// @param condition A msg_cnd_t union that will allow for signalling between
-///   the endpoints.
-/// @param lock A msg_mtx_t union to guard the condition.
+///   the endpoints.  Only present when THREAD_SAFE_COROUTINES is defined.
+/// @param lock A msg_mtx_t union to guard the condition.  Only present when
+///   THREAD_SAFE_COROUTINES is defined.
 /// @param configured Whether or not the members of the message that require
 ///   initialization have been configured yet.
 /// @param dynamically_allocated Whether or not the message was dynamically
@@ -161,12 +200,18 @@ typedef union msg_endpoint_t {
 ///   custom way.
 /// @param msg_sync A pointer to the msg_sync_t that defines the synchronization
 ///   primitive functions to use with the conditions and mutexes in this object.
+///   Only present when THREAD_SAFE_COROUTINES is defined.
 /// @param reply_to A pointer to the msg_q_t to reply to.
+#ifdef THREAD_SAFE_COROUTINES
 typedef struct msg_t {
   int64_t type;
   void *data;
   size_t size;
   struct msg_t *next;
+#if MSG_Q_TYPE_INDEX_SIZE > 0
+  struct msg_t *prev;
+  struct msg_t *next_of_type;
+#endif // MSG_Q_TYPE_INDEX_SIZE
   bool waiting;
   bool done;
   bool in_use;
@@ -179,6 +224,31 @@ typedef struct msg_t {
   msg_sync_t *msg_sync;
   msg_q_t *reply_to;
 } msg_t;
+#else // THREAD_SAFE_COROUTINES not defined
+// Without thread support, every message waits for done on the same coroutine
+// mutex and condition in Messages.c, so a message is nothing but its payload,
+// its endpoints, and a few flag bits.  This keeps the static message pool
+// small enough to hold more than twice as many messages in the same memory.
+// Message types are small enumeration values, so 32 bits is plenty.
+typedef struct msg_t {
+  struct msg_t *next;
+#if MSG_Q_TYPE_INDEX_SIZE > 0
+  struct msg_t *prev;
+  struct msg_t *next_of_type;
+#endif // MSG_Q_TYPE_INDEX_SIZE
+  void *data;
+  size_t size;
+  msg_endpoint_t from;
+  msg_endpoint_t to;
+  msg_q_t *reply_to;
+  int32_t type;
+  bool waiting : 1;
+  bool done : 1;
+  bool in_use : 1;
+  bool configured : 1;
+  bool dynamically_allocated : 1;
+} msg_t;
+#endif // THREAD_SAFE_COROUTINES
 
 /// @struct msg_q_t
 ///
@@ -188,6 +258,15 @@ typedef struct msg_t {
 ///   this pointer.
 /// @param tail The tail of the message queue.  Messages will be added to this
 ///   pointer.
+/// @param length The number of messages currently in the queue.
+/// @param type_head The heads of the per-type sublists of the queue.  Only
+///   present when MSG_Q_TYPE_INDEX_SIZE is non-zero.
+/// @param type_tail The tails of the per-type sublists of the queue.  Only
+///   present when MSG_Q_TYPE_INDEX_SIZE is non-zero.
+/// @param indexed Whether the per-type sublists, and the prev pointers of the
+///   messages in the queue, are being kept up to date.  Set the first time the
+///   queue is searched by type.  Only present when MSG_Q_TYPE_INDEX_SIZE is
+///   non-zero.
 /// @param condition A msg_cnd_t union that will allow for signalling between
 ///   the endpoints.
 /// @param lock A msg_mtx_t union to guard the condition.
@@ -197,15 +276,44 @@ typedef struct msg_t {
 ///   a custom way.
 /// @param msg_sync A pointer to the msg_sync_t that defines the synchronization
 ///   primitive functions to use with the conditions and mutexes in this object.
+///   Only present when THREAD_SAFE_COROUTINES is defined.
 typedef struct msg_q_t {
   msg_t *head;
   msg_t *tail;
+  size_t length;
+#if MSG_Q_TYPE_INDEX_SIZE > 0
+  msg_t *type_head[MSG_Q_TYPE_INDEX_SIZE];
+  msg_t *type_tail[MSG_Q_TYPE_INDEX_SIZE];
+  bool indexed;
+#endif // MSG_Q_TYPE_INDEX_SIZE
   msg_cnd_t condition;
   msg_mtx_t lock;
   bool dynamically_allocated;
+#ifdef THREAD_SAFE_COROUTINES
   msg_sync_t *msg_sync;
+#endif // THREAD_SAFE_COROUTINES
 } msg_q_t;
 
+/// @enum msg_event_t
+///
+/// @brief The points in a message's life that are reported to the function set
+/// by msg_set_event_callback.
+typedef enum msg_event_t {
+  MSG_EVENT_PUSH,    ///< The message was added to a queue.
+  MSG_EVENT_POP,     ///< The message was removed from a queue.
+  MSG_EVENT_DONE,    ///< The receiver marked the message done.
+  MSG_EVENT_RELEASE, ///< The message stopped being in use.
+} msg_event_t;
+
+/// @typedef msg_event_callback_t
+///
+/// @brief Function that's called at each msg_event_t in a message's life.  The
+/// queue is the one the message was pushed onto or popped from for
+/// MSG_EVENT_PUSH and MSG_EVENT_POP and NULL otherwise.  Calls for
+/// MSG_EVENT_PUSH and MSG_EVENT_POP are made with the queue's lock held.
+typedef void (*msg_event_callback_t)(
+  msg_t *msg, msg_q_t *queue, msg_event_t event);
+
 /// @enum msg_element_t
 ///
 /// @brief Enumeration of member elements of msg_t that are user-accessible.
@@ -233,6 +341,8 @@ msg_t* msg_wait_for_reply(msg_t *sent,
   bool release, const struct timespec *ts);
 msg_t* msg_wait_for_reply_with_type(msg_t *sent,
   bool release, int64_t type, const struct timespec *ts);
+void msg_set_event_callback(msg_event_callback_t callback);
+void msg_done_flush(void);
 
 // Message element accessors
 void* msg_element(msg_t *msg, msg_element_t msg_element);
@@ -242,12 +352,14 @@ void* msg_element(msg_t *msg, msg_element_t msg_element);
   (*((void**) msg_element((msg_ptr), MSG_ELEMENT_DATA)))
 #define msg_size(msg_ptr) \
   (*((size_t*) msg_element((msg_ptr), MSG_ELEMENT_SIZE)))
+// The flags may be bit fields, which can't be addressed, so they're accessed
+// directly rather than through msg_element.
 #define msg_waiting(msg_ptr) \
-  (*((bool*) msg_element((msg_ptr), MSG_ELEMENT_WAITING)))
+  ((bool) (msg_ptr)->waiting)
 #define msg_done(msg_ptr) \
-  (*((bool*) msg_element((msg_ptr), MSG_ELEMENT_DONE)))
+  ((bool) (msg_ptr)->done)
 #define msg_in_use(msg_ptr) \
-  (*((bool*) msg_element((msg_ptr), MSG_ELEMENT_IN_USE)))
+  ((bool) (msg_ptr)->in_use)
 #define msg_from(msg_ptr) \
   (*((msg_endpoint_t*) msg_element((msg_ptr), MSG_ELEMENT_FROM)))
 #define msg_to(msg_ptr) \
@@ -258,11 +370,14 @@ msg_q_t* msg_q_create(msg_q_t *q, msg_safety_t msg_safety);
 int msg_q_destroy(msg_q_t *queue);
 msg_t* msg_q_peek(msg_q_t *queue);
 msg_t* msg_q_pop(msg_q_t *queue);
+size_t msg_q_pop_batch(msg_q_t *queue, msg_t **msgs, size_t max_msgs);
 msg_t* msg_q_pop_type(msg_q_t *queue, int64_t type);
 msg_t* msg_q_wait(msg_q_t *queue, const struct timespec *ts);
 msg_t* msg_q_wait_for_type(msg_q_t *queue, int64_t type,
   const struct timespec *ts);
 int msg_q_push(msg_q_t *queue, msg_q_t *reply_to, msg_t *msg);
+int msg_q_push_batch(msg_q_t *queue, msg_q_t *reply_to,
+  msg_t **msgs, size_t num_msgs);
 
 #ifdef __cplusplus
 }
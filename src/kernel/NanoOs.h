@@ -52,7 +52,7 @@ extern "C"
 ///
 /// @brief The total number of inter-task messages that will be available
 /// for use by tasks.
-#define NANO_OS_NUM_MESSAGES                              6
+#define NANO_OS_NUM_MESSAGES                             15
 
 /// @def NANO_OS_SCHEDULER_TASK_ID
 ///
@@ -0,0 +1,159 @@
+///////////////////////////////////////////////////////////////////////////////
+///
+/// @author            James Card
+/// @date              10.15.2026
+///
+/// @file              NanoOsStats.h
+///
+/// @brief             Statistics that the kernel exports to user space.
+///
+/// @copyright
+///                   Copyright (c) 2012-2025 James Card
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a
+/// copy of this software and associated documentation files (the "Software"),
+/// to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+/// and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included
+/// in all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+/// DEALINGS IN THE SOFTWARE.
+///
+///                                James Card
+///                         http://www.jamescard.org
+///
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef NANO_OS_STATS_H
+#define NANO_OS_STATS_H
+
+// This file is included by both the kernel and the overlays, so it must not
+// depend on anything other than the standard integer types.
+#include "stdint.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// @struct TaskStatsElement
+///
+/// @brief CPU accounting for a running task that is exportable to a user task.
+/// Times are in milliseconds because overlays are linked without a runtime
+/// library and can't do 64-bit arithmetic on all targets.
+///
+/// @param pid The numerical ID of the task.
+/// @param name The name of the task.
+/// @param runTimeMs The cumulative number of milliseconds the task has spent
+///   running.
+/// @param waitTimeMs The cumulative number of milliseconds the task has spent
+///   on a ready queue waiting to run.
+/// @param numResumes The number of times the scheduler has resumed the task.
+/// @param numYields The number of times the task gave up the CPU on its own
+///   (yielding, blocking, or exiting).
+/// @param numPreemptions The number of times the task was forced to yield by
+///   the preemption timer.
+typedef struct TaskStatsElement {
+  int pid;
+  const char *name;
+  uint32_t runTimeMs;
+  uint32_t waitTimeMs;
+  uint32_t numResumes;
+  uint32_t numYields;
+  uint32_t numPreemptions;
+} TaskStatsElement;
+
+/// @struct TaskStatsInfo
+///
+/// @brief The object that's populated and returned by a getTaskStats call.
+///
+/// @param timestampMs The time, in milliseconds, when the statistics were
+///   collected.  Only meaningful relative to other timestamps.
+/// @param numTasks The number of elements in the tasks array.
+/// @param tasks The array of TaskStatsElements that describe the tasks.
+typedef struct TaskStatsInfo {
+  uint32_t timestampMs;
+  uint8_t numTasks;
+  TaskStatsElement tasks[1];
+} TaskStatsInfo;
+
+/// @def IPC_STATS_NUM_BUCKETS
+///
+/// @brief The number of buckets in each IPC latency histogram.  Bucket 0 counts
+/// latencies of less than one microsecond and bucket N counts latencies from
+/// 2^(N-1) up to 2^N microseconds.  The last bucket also counts everything
+/// longer than that.
+#define IPC_STATS_NUM_BUCKETS 16
+
+/// @struct IpcStatsElement
+///
+/// @brief Statistics for one message type sent to one task that are
+/// exportable to a user task.
+///
+/// @param pid The numerical ID of the task the messages were sent to.
+/// @param maxQueueDepth The largest number of messages that were in the
+///   task's queue right after a message of this type was pushed, saturated at
+///   255.
+/// @param type The message type.
+/// @param count The number of messages of this type that were pushed.
+/// @param queueLatency Histogram of the time messages spent in the queue
+///   between being pushed and being popped.
+/// @param serviceLatency Histogram of the time between a message being popped
+///   and it being marked done or released.
+typedef struct IpcStatsElement {
+  uint8_t  pid;
+  uint8_t  maxQueueDepth;
+  uint16_t type;
+  uint32_t count;
+  uint32_t queueLatency[IPC_STATS_NUM_BUCKETS];
+  uint32_t serviceLatency[IPC_STATS_NUM_BUCKETS];
+} IpcStatsElement;
+
+/// @struct IpcStatsInfo
+///
+/// @brief The object that's populated and returned by a getIpcStats call.
+///
+/// @param numDropped The number of messages that weren't counted because the
+///   kernel's table of message types was full.
+/// @param numEntries The number of elements in the entries array.
+/// @param entries The array of IpcStatsElements, one per destination task and
+///   message type seen.
+typedef struct IpcStatsInfo {
+  uint32_t numDropped;
+  uint8_t numEntries;
+  IpcStatsElement entries[1];
+} IpcStatsInfo;
+
+/// @struct BlockCacheStatsInfo
+///
+/// @brief The object that's populated by a getBlockCacheStats call.
+///
+/// @param numHits The number of single-block reads and writes that were
+///   satisfied without going to the storage device.
+/// @param numMisses The number of blocks that had to be read from the storage
+///   device.
+/// @param numWriteBacks The number of dirty blocks that were written to the
+///   storage device on eviction or flush.
+/// @param numBlocks The number of blocks the cache can hold.
+typedef struct BlockCacheStatsInfo {
+  uint32_t numHits;
+  uint32_t numMisses;
+  uint32_t numWriteBacks;
+  uint8_t  numBlocks;
+} BlockCacheStatsInfo;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NANO_OS_STATS_H
+
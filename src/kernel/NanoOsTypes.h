@@ -38,6 +38,8 @@
 
 // Custom includes
 #include "Coroutines.h"
+#include "NanoOsStats.h"
+#include "SchedulerTrace.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -52,12 +54,44 @@ extern "C"
 /// including the scheduler.
 ///
 /// @note If this value is increased beyond 15, the number of bits used to store
-/// the owner in a MemNode in MemoryManager.cpp must be extended and the value
+/// the owner in a MemNode in MemoryAllocator.h must be extended and the value
 /// of TASK_ID_NOT_SET must be changed in Tasks.h.  If this value is
 /// increased beyond 255, then the type defined by TaskId below m ust also
 /// be extended.
 #define NANO_OS_NUM_TASKS                             9
 
+/// @def NANO_OS_IPC_STATS_NUM_ENTRIES
+///
+/// @brief The number of distinct destination task and message type pairs that
+/// the scheduler keeps IPC statistics for.  Must be a power of two.  0
+/// disables IPC statistics entirely.  Only builds that run as an application
+/// within another OS have the memory to spare by default.
+#ifndef NANO_OS_IPC_STATS_NUM_ENTRIES
+#if defined(__linux__) || defined(__linux) || defined(_WIN32)
+#define NANO_OS_IPC_STATS_NUM_ENTRIES 32
+#else
+#define NANO_OS_IPC_STATS_NUM_ENTRIES 0
+#endif
+#endif // NANO_OS_IPC_STATS_NUM_ENTRIES
+
+#if (NANO_OS_IPC_STATS_NUM_ENTRIES & (NANO_OS_IPC_STATS_NUM_ENTRIES - 1)) != 0
+#error "NANO_OS_IPC_STATS_NUM_ENTRIES must be a power of two"
+#endif
+
+/// @def SCHEDULER_TASK_STATS
+///
+/// @brief Whether or not the scheduler keeps per-task CPU accounting for
+/// getTaskStats and the top command.  0 disables the accounting entirely.
+/// Only builds that run as an application within another OS have the memory
+/// and time to spare by default.
+#ifndef SCHEDULER_TASK_STATS
+#if defined(__linux__) || defined(__linux) || defined(_WIN32)
+#define SCHEDULER_TASK_STATS 1
+#else
+#define SCHEDULER_TASK_STATS 0
+#endif
+#endif // SCHEDULER_TASK_STATS
+
 /// @def SCHEDULER_NUM_TASKS
 ///
 /// @brief The number of tasks managed by the scheduler.  This is one fewer
@@ -169,6 +203,43 @@ typedef struct FileDescriptor {
   IoPipe outputPipe;
 } FileDescriptor;
 
+/// @struct TaskStats
+///
+/// @brief CPU accounting for a single task as maintained by the scheduler.
+///
+/// @param runTime The cumulative number of nanoseconds the task has spent
+///   running.
+/// @param waitTime The cumulative number of nanoseconds the task has spent on
+///   a ready queue waiting to run.
+/// @param numResumes The number of times the scheduler has resumed the task.
+/// @param numYields The number of times the task gave up the CPU on its own
+///   (yielding, blocking, or exiting).
+/// @param numPreemptions The number of times the task was forced to yield by
+///   the preemption timer.
+typedef struct TaskStats {
+  int64_t  runTime;
+  int64_t  waitTime;
+  uint32_t numResumes;
+  uint32_t numYields;
+  uint32_t numPreemptions;
+} TaskStats;
+
+/// @struct IpcStats
+///
+/// @brief The table of IPC statistics maintained by the scheduler.  Entries are
+/// found by hashing the destination task ID and message type and probing
+/// linearly.  An entry with a pid of 0 is unused.
+///
+/// @param entries The statistics for each destination task and message type.
+/// @param numDropped The number of messages that weren't counted because the
+///   table was full.
+typedef struct IpcStats {
+#if NANO_OS_IPC_STATS_NUM_ENTRIES > 0
+  IpcStatsElement entries[NANO_OS_IPC_STATS_NUM_ENTRIES];
+#endif // NANO_OS_IPC_STATS_NUM_ENTRIES
+  uint32_t numDropped;
+} IpcStats;
+
 // Forward declaration.  Definition below.
 typedef struct TaskQueue TaskQueue;
 
@@ -191,6 +262,25 @@ typedef struct TaskQueue TaskQueue;
 ///   used (minus the ".overaly" extension).
 /// @param envp A pointer to the array of NULL-terminated environment variable
 ///   strings.
+/// @param taskQueue A pointer to the TaskQueue the task is currently in, if
+///   any.
+/// @param prev A pointer to the previous TaskDescriptor in taskQueue, if any.
+/// @param next A pointer to the next TaskDescriptor in taskQueue, if any.
+/// @param timeoutTime The time, in nanoseconds, when the task's timed wait
+///   expires.  Only valid while the task is in the scheduler's timeout heap.
+/// @param timeoutIndex One more than the index of the task within the
+///   scheduler's timeout heap or 0 if it is not in the heap.
+/// @param priority The current scheduling priority of a user task relative to
+///   SCHEDULER_FIRST_USER_PRIORITY.  0 is the highest.  Ignored for kernel
+///   tasks, which always run at SCHEDULER_KERNEL_PRIORITY.
+/// @param basePriority The priority a user task is reset to and the highest
+///   priority it can be promoted to (its niceness).
+/// @param preempted Whether or not the task was forced to yield by the
+///   preemption timer the last time it ran.
+/// @param readyTime The time, in nanoseconds, when the task was last put on a
+///   ready queue.  Only present when SCHEDULER_TASK_STATS is non-zero.
+/// @param stats The CPU accounting for the task.  Only present when
+///   SCHEDULER_TASK_STATS is non-zero.
 typedef struct TaskDescriptor {
   const char      *name;
   TaskHandle       taskHandle;
@@ -202,6 +292,17 @@ typedef struct TaskDescriptor {
   const char      *overlay;
   char           **envp;
   TaskQueue       *taskQueue;
+  struct TaskDescriptor *prev;
+  struct TaskDescriptor *next;
+  int64_t          timeoutTime;
+  uint8_t          timeoutIndex;
+  uint8_t          priority;
+  uint8_t          basePriority;
+  volatile bool    preempted;
+#if SCHEDULER_TASK_STATS
+  int64_t          readyTime;
+  TaskStats        stats;
+#endif // SCHEDULER_TASK_STATS
 } TaskDescriptor;
 
 /// @struct TaskInfoElement
@@ -232,31 +333,65 @@ typedef struct TaskInfo {
 
 /// @struct TaskQueue
 ///
-/// @brief Structure to manage an individual task queue
+/// @brief Structure to manage an individual task queue.  The queue is an
+/// intrusive doubly-linked list threaded through the prev and next members of
+/// the TaskDescriptors in the allTasks array.
 ///
 /// @param name The string name of the queue for use in error messages.
-/// @param tasks The array of pointers to TaskDescriptors from the
-///   allTasks array.
-/// @param head The index of the head of the queue.
-/// @param tail The index of the tail of the queue.
+/// @param head A pointer to the TaskDescriptor at the head of the queue.
+/// @param tail A pointer to the TaskDescriptor at the tail of the queue.
 /// @param numElements The number of elements currently in the queue.
 typedef struct TaskQueue {
   const char *name;
-  TaskDescriptor *tasks[SCHEDULER_NUM_TASKS];
-  uint8_t head:4;
-  uint8_t tail:4;
-  uint8_t numElements:4;
+  TaskDescriptor *head;
+  TaskDescriptor *tail;
+  uint8_t numElements;
 } TaskQueue;
 
+/// @struct TimeoutHeap
+///
+/// @brief Binary min-heap of the tasks in the timedWaiting queue ordered by
+/// the time their waits expire.
+///
+/// @param tasks The array of pointers to TaskDescriptors from the allTasks
+///   array.  tasks[0] is always the task with the earliest deadline.
+/// @param numElements The number of elements currently in the heap.
+typedef struct TimeoutHeap {
+  TaskDescriptor *tasks[SCHEDULER_NUM_TASKS];
+  uint8_t numElements;
+} TimeoutHeap;
+
+/// @def SCHEDULER_KERNEL_PRIORITY
+///
+/// @brief The fixed priority that all kernel tasks run at.  This is the index
+/// of their ready queue.
+#define SCHEDULER_KERNEL_PRIORITY 0
+
+/// @def SCHEDULER_FIRST_USER_PRIORITY
+///
+/// @brief The index of the highest-priority ready queue for user tasks.
+#define SCHEDULER_FIRST_USER_PRIORITY 1
+
+/// @def SCHEDULER_NUM_USER_PRIORITIES
+///
+/// @brief The number of priority levels available to user tasks.
+#define SCHEDULER_NUM_USER_PRIORITIES 3
+
+/// @def SCHEDULER_NUM_PRIORITIES
+///
+/// @brief The total number of ready queues maintained by the scheduler.
+#define SCHEDULER_NUM_PRIORITIES \
+  (SCHEDULER_FIRST_USER_PRIORITY + SCHEDULER_NUM_USER_PRIORITIES)
+
 /// @struct SchedulerState
 ///
 /// @brief State data used by the scheduler.
 ///
 /// @param allTasks Array that will hold the metadata for every task,
 ///   including the scheduler.
-/// @param ready Queue of tasks that are allocated and not waiting on
-///   anything but not currently running.  This queue never includes the
-///   scheduler task.
+/// @param ready Queues of tasks that are allocated and not waiting on
+///   anything but not currently running, one per priority level.  These queues
+///   never include the scheduler task.
 /// @param waiting Queue of tasks that are waiting on a mutex or condition
 ///   with an infinite timeout.  This queue never includes the scheduler
 ///   task.
@@ -265,20 +400,42 @@ typedef struct TaskQueue {
 ///   task.
 /// @param free Queue of tasks that are free within the allTasks
 ///   array.
+/// @param timeouts Heap of the tasks in the timedWaiting queue ordered by when
+///   their waits expire.
 /// @param hostname The contents of the /etc/hostname file read at startup.
 /// @param numShells The number of shell tasks that the scheduler is
 ///   running.
 /// @param preemptionTimer The index of the timer used for preemptive
 ///   multitasking.  If this is < 0 then the tasks run in cooperative mode.
+/// @param runKernelTask Whether the next task run should come from the kernel
+///   ready queue.  The scheduler alternates between kernel and user tasks.
+/// @param lastPriorityBoost The time, in nanoseconds, that all user tasks were
+///   last reset to their base priorities.
+/// @param numHandoffs The number of consecutive tasks that have been run via a
+///   direct handoff instead of from the ready queues.
+/// @param trace Ring buffer of the most recent scheduling events.  Only present
+///   when SCHEDULER_TRACE_NUM_EVENTS is non-zero.
+/// @param ipcStats Counts and latencies of the messages sent between tasks.
+///   Only present when NANO_OS_IPC_STATS_NUM_ENTRIES is non-zero.
 typedef struct SchedulerState {
   TaskDescriptor allTasks[NANO_OS_NUM_TASKS];
-  TaskQueue ready;
+  TaskQueue ready[SCHEDULER_NUM_PRIORITIES];
   TaskQueue waiting;
   TaskQueue timedWaiting;
   TaskQueue free;
+  TimeoutHeap timeouts;
   char *hostname;
   uint8_t numShells;
   int preemptionTimer;
+  bool runKernelTask;
+  int64_t lastPriorityBoost;
+  uint8_t numHandoffs;
+#if SCHEDULER_TRACE_NUM_EVENTS > 0
+  TraceBuffer trace;
+#endif // SCHEDULER_TRACE_NUM_EVENTS
+#if NANO_OS_IPC_STATS_NUM_ENTRIES > 0
+  IpcStats ipcStats;
+#endif // NANO_OS_IPC_STATS_NUM_ENTRIES
 } SchedulerState;
 
 /// @struct CommandDescriptor
@@ -434,10 +591,13 @@ typedef struct ReallocMessage {
 ///   allocate memory from.
 /// @param mallocEnd The numeric value of the last address available to allocate
 ///   memory from.
+/// @param numFreeBlocks The number of free blocks between mallocNext and
+///   mallocStart.  Always 0 unless MEMORY_MANAGER_FIRST_FIT is enabled.
 typedef struct MemoryManagerState {
   char *mallocNext;
   uintptr_t mallocStart;
   uintptr_t mallocEnd;
+  uint16_t numFreeBlocks;
 } MemoryManagerState;
 
 /// @struct User
@@ -479,6 +639,9 @@ typedef struct NanoOsMessage {
 ///   blocks to physical blocks.
 /// @param partitionNumber The one-based partition index that is to be used by
 ///   a filesystem.
+/// @param flush Function pointer for the function to write any blocks the
+///   device is holding in memory to the storage.  NULL if the device writes
+///   everything immediately.
 typedef struct BlockStorageDevice {
   void *context;
   int (*readBlocks)(void *context, uint32_t startBlock,
@@ -488,6 +651,7 @@ typedef struct BlockStorageDevice {
   uint16_t blockSize;
   uint8_t blockBitShift;
   uint8_t partitionNumber;
+  int (*flush)(void *context);
 } BlockStorageDevice;
 
 /// @struct ExecArgs
@@ -73,6 +73,20 @@ void runScheduler(SchedulerState *schedulerState);
 /// FileDescriptor object that maps to the task's stderr FILE stream.
 #define STDERR_FILE_DESCRIPTOR_INDEX 2
 
+/// @def SCHEDULER_PRIORITY_BOOST_PERIOD
+///
+/// @brief The minimum number of nanoseconds between resets of all user tasks
+/// back to their base priorities.  Bounds how long a demoted task can be
+/// starved by higher-priority ones.
+#define SCHEDULER_PRIORITY_BOOST_PERIOD 1000000000LL
+
+/// @def SCHEDULER_MAX_HANDOFFS
+///
+/// @brief The maximum number of consecutive tasks that may be run via a direct
+/// handoff before the scheduler goes back to its ready queues.  Keeps two tasks
+/// that exchange messages with each other from starving everything else.
+#define SCHEDULER_MAX_HANDOFFS 8
+
 /// @var schedulerTaskHandle
 ///
 /// @brief Pointer to the main task handle that's allocated before the
@@ -89,6 +103,27 @@ static TaskDescriptor *schedulerTask = NULL;
 /// @brief Pointer to the task that is currently executing.
 static TaskDescriptor *currentTask = NULL;
 
+/// @var handoffTask
+///
+/// @brief Pointer to the task that should be run next, regardless of its
+/// position in the ready queues.  Set when the running task sends a message it
+/// will wait on or wakes up a task that was blocked.  NULL if there is no
+/// pending handoff.
+static TaskDescriptor *handoffTask = NULL;
+
+/// @var preemptionDisableDepth
+///
+/// @brief The number of nested schedulerDisablePreemption calls the running
+/// task has made without matching schedulerEnablePreemption calls.  While this
+/// is non-zero, the preemption timer doesn't force the task to yield.
+static volatile uint8_t preemptionDisableDepth = 0;
+
+/// @var preemptionPending
+///
+/// @brief Whether or not the preemption timer fired while preemption was
+/// disabled.  If so, the task yields as soon as preemption is enabled again.
+static volatile bool preemptionPending = false;
+
 /// @var allTasks
 ///
 /// @brief Pointer to the allTasks array that is part of the
@@ -199,33 +234,77 @@ static const char* const shellNames[NANO_OS_MAX_NUM_SHELLS] = {
   "shell 1",
 };
 
+/// @fn int taskQueueRemove(
+///   TaskQueue *taskQueue, TaskDescriptor *taskDescriptor)
+///
+/// @brief Remove a pointer to a TaskDescriptor from a TaskQueue.
+///
+/// @param taskQueue A pointer to a TaskQueue to remove the pointer from.
+/// @param taskDescriptor A pointer to a TaskDescriptor to remove from the
+///   queue.
+///
+/// @return Returns 0 on success, EINVAL if the task is not in the queue.
+int taskQueueRemove(
+  TaskQueue *taskQueue, TaskDescriptor *taskDescriptor
+) {
+  if ((taskQueue == NULL) || (taskDescriptor->taskQueue != taskQueue)) {
+    // Nothing to do.
+    return EINVAL;
+  }
+
+  if (taskDescriptor->prev != NULL) {
+    taskDescriptor->prev->next = taskDescriptor->next;
+  } else {
+    taskQueue->head = taskDescriptor->next;
+  }
+  if (taskDescriptor->next != NULL) {
+    taskDescriptor->next->prev = taskDescriptor->prev;
+  } else {
+    taskQueue->tail = taskDescriptor->prev;
+  }
+  taskQueue->numElements--;
+
+  taskDescriptor->prev = NULL;
+  taskDescriptor->next = NULL;
+  taskDescriptor->taskQueue = NULL;
+
+  return ENOERR;
+}
+
 /// @fn int taskQueuePush(
 ///   TaskQueue *taskQueue, TaskDescriptor *taskDescriptor)
 ///
-/// @brief Push a pointer to a TaskDescriptor onto a TaskQueue.
+/// @brief Push a pointer to a TaskDescriptor onto a TaskQueue.  If the task is
+/// already in a queue, it is removed from that queue first.
 ///
 /// @param taskQueue A pointer to a TaskQueue to push the pointer to.
 /// @param taskDescriptor A pointer to a TaskDescriptor to push onto the
 ///   queue.
 ///
-/// @return Returns 0 on success, ENOMEM on failure.
+/// @return Returns 0 on success, EINVAL on failure.
 int taskQueuePush(
   TaskQueue *taskQueue, TaskDescriptor *taskDescriptor
 ) {
-  if ((taskQueue == NULL)
-    || (taskQueue->numElements >= SCHEDULER_NUM_TASKS)
-  ) {
+  if (taskQueue == NULL) {
     printString("ERROR: Could not push task ");
     printInt(taskDescriptor->taskId);
-    printString(" onto ");
-    printString(taskQueue->name);
-    printString(" queue:\n");
-    return ENOMEM;
+    printString(" onto NULL queue\n");
+    return EINVAL;
   }
 
-  taskQueue->tasks[taskQueue->tail] = taskDescriptor;
-  taskQueue->tail++;
-  taskQueue->tail %= SCHEDULER_NUM_TASKS;
+  if (taskDescriptor->taskQueue != NULL) {
+    // A task can only be in one queue at a time.
+    taskQueueRemove(taskDescriptor->taskQueue, taskDescriptor);
+  }
+
+  taskDescriptor->prev = taskQueue->tail;
+  taskDescriptor->next = NULL;
+  if (taskQueue->tail != NULL) {
+    taskQueue->tail->next = taskDescriptor;
+  } else {
+    taskQueue->head = taskDescriptor;
+  }
+  taskQueue->tail = taskDescriptor;
   taskQueue->numElements++;
   taskDescriptor->taskQueue = taskQueue;
 
@@ -242,51 +321,362 @@ int taskQueuePush(
 /// failure.
 TaskDescriptor* taskQueuePop(TaskQueue *taskQueue) {
   TaskDescriptor *taskDescriptor = NULL;
-  if ((taskQueue == NULL) || (taskQueue->numElements == 0)) {
+  if ((taskQueue == NULL) || (taskQueue->head == NULL)) {
     return taskDescriptor; // NULL
   }
 
-  taskDescriptor = taskQueue->tasks[taskQueue->head];
-  taskQueue->head++;
-  taskQueue->head %= SCHEDULER_NUM_TASKS;
-  taskQueue->numElements--;
-  taskDescriptor->taskQueue = NULL;
+  taskDescriptor = taskQueue->head;
+  taskQueueRemove(taskQueue, taskDescriptor);
 
   return taskDescriptor;
 }
 
-/// @fn int taskQueueRemove(
-///   TaskQueue *taskQueue, TaskDescriptor *taskDescriptor)
+/// @fn static inline void timeoutHeapSet(
+///   TimeoutHeap *timeoutHeap, uint8_t index, TaskDescriptor *taskDescriptor)
 ///
-/// @brief Remove a pointer to a TaskDescriptor from a TaskQueue.
+/// @brief Place a TaskDescriptor at a position in a TimeoutHeap and record the
+/// position in the descriptor.
 ///
-/// @param taskQueue A pointer to a TaskQueue to remove the pointer from.
-/// @param taskDescriptor A pointer to a TaskDescriptor to remove from the
-///   queue.
+/// @param timeoutHeap A pointer to the TimeoutHeap to modify.
+/// @param index The zero-based index within the heap to place the task at.
+/// @param taskDescriptor A pointer to the TaskDescriptor to place.
+///
+/// @return This function returns no value.
+static inline void timeoutHeapSet(
+  TimeoutHeap *timeoutHeap, uint8_t index, TaskDescriptor *taskDescriptor
+) {
+  timeoutHeap->tasks[index] = taskDescriptor;
+  taskDescriptor->timeoutIndex = index + 1;
+}
+
+/// @fn static void timeoutHeapSiftUp(TimeoutHeap *timeoutHeap, uint8_t index)
+///
+/// @brief Move the element at the specified index up the heap until its parent
+/// expires no later than it does.
+///
+/// @param timeoutHeap A pointer to the TimeoutHeap to modify.
+/// @param index The zero-based index of the element to move.
+///
+/// @return This function returns no value.
+static void timeoutHeapSiftUp(TimeoutHeap *timeoutHeap, uint8_t index) {
+  TaskDescriptor *taskDescriptor = timeoutHeap->tasks[index];
+
+  while (index > 0) {
+    uint8_t parent = (index - 1) >> 1;
+    if (timeoutHeap->tasks[parent]->timeoutTime
+      <= taskDescriptor->timeoutTime
+    ) {
+      break;
+    }
+    timeoutHeapSet(timeoutHeap, index, timeoutHeap->tasks[parent]);
+    index = parent;
+  }
+  timeoutHeapSet(timeoutHeap, index, taskDescriptor);
+}
+
+/// @fn static void timeoutHeapSiftDown(TimeoutHeap *timeoutHeap, uint8_t index)
+///
+/// @brief Move the element at the specified index down the heap until neither
+/// of its children expires before it does.
+///
+/// @param timeoutHeap A pointer to the TimeoutHeap to modify.
+/// @param index The zero-based index of the element to move.
+///
+/// @return This function returns no value.
+static void timeoutHeapSiftDown(TimeoutHeap *timeoutHeap, uint8_t index) {
+  TaskDescriptor *taskDescriptor = timeoutHeap->tasks[index];
+  uint8_t numElements = timeoutHeap->numElements;
+
+  while (1) {
+    uint8_t child = (index << 1) + 1;
+    if (child >= numElements) {
+      break;
+    }
+    if ((child + 1 < numElements)
+      && (timeoutHeap->tasks[child + 1]->timeoutTime
+        < timeoutHeap->tasks[child]->timeoutTime)
+    ) {
+      child++;
+    }
+    if (taskDescriptor->timeoutTime <= timeoutHeap->tasks[child]->timeoutTime) {
+      break;
+    }
+    timeoutHeapSet(timeoutHeap, index, timeoutHeap->tasks[child]);
+    index = child;
+  }
+  timeoutHeapSet(timeoutHeap, index, taskDescriptor);
+}
+
+/// @fn int timeoutHeapPush(
+///   TimeoutHeap *timeoutHeap, TaskDescriptor *taskDescriptor)
+///
+/// @brief Add a TaskDescriptor to a TimeoutHeap.  The task's timeoutTime must
+/// already be set.
+///
+/// @param timeoutHeap A pointer to the TimeoutHeap to add to.
+/// @param taskDescriptor A pointer to the TaskDescriptor to add.
 ///
 /// @return Returns 0 on success, ENOMEM on failure.
-int taskQueueRemove(
-  TaskQueue *taskQueue, TaskDescriptor *taskDescriptor
+int timeoutHeapPush(TimeoutHeap *timeoutHeap, TaskDescriptor *taskDescriptor) {
+  if (timeoutHeap->numElements >= SCHEDULER_NUM_TASKS) {
+    printString("ERROR: Could not push task ");
+    printInt(taskDescriptor->taskId);
+    printString(" onto timeout heap\n");
+    return ENOMEM;
+  }
+
+  timeoutHeap->tasks[timeoutHeap->numElements] = taskDescriptor;
+  timeoutHeap->numElements++;
+  timeoutHeapSiftUp(timeoutHeap, timeoutHeap->numElements - 1);
+
+  return 0;
+}
+
+/// @fn int timeoutHeapRemove(
+///   TimeoutHeap *timeoutHeap, TaskDescriptor *taskDescriptor)
+///
+/// @brief Remove a TaskDescriptor from a TimeoutHeap.
+///
+/// @param timeoutHeap A pointer to the TimeoutHeap to remove from.
+/// @param taskDescriptor A pointer to the TaskDescriptor to remove.
+///
+/// @return Returns 0 on success, EINVAL if the task was not in the heap.
+int timeoutHeapRemove(
+  TimeoutHeap *timeoutHeap, TaskDescriptor *taskDescriptor
 ) {
-  int returnValue = EINVAL;
-  if ((taskQueue == NULL) || (taskQueue->numElements == 0)) {
-    // Nothing to do.
-    return returnValue; // EINVAL
+  if (taskDescriptor->timeoutIndex == 0) {
+    // Not in the heap.  Nothing to do.
+    return EINVAL;
+  }
+
+  uint8_t index = taskDescriptor->timeoutIndex - 1;
+  taskDescriptor->timeoutIndex = 0;
+  timeoutHeap->numElements--;
+  if (index == timeoutHeap->numElements) {
+    // This was the last element.  No reordering needed.
+    return 0;
+  }
+
+  // Move the last element into the vacated slot and restore the heap
+  // property in whichever direction it's violated.
+  TaskDescriptor *last = timeoutHeap->tasks[timeoutHeap->numElements];
+  timeoutHeapSet(timeoutHeap, index, last);
+  if ((index > 0)
+    && (last->timeoutTime
+      < timeoutHeap->tasks[(index - 1) >> 1]->timeoutTime)
+  ) {
+    timeoutHeapSiftUp(timeoutHeap, index);
+  } else {
+    timeoutHeapSiftDown(timeoutHeap, index);
+  }
+
+  return 0;
+}
+
+/// @fn static inline TaskQueue* readyQueueForTask(
+///   SchedulerState *schedulerState, TaskDescriptor *taskDescriptor)
+///
+/// @brief Get the ready queue that a task belongs on.  Kernel tasks always go
+/// on the kernel queue.  User tasks go on the queue for their current
+/// priority.
+///
+/// @param schedulerState A pointer to the SchedulerState maintained by the
+///   scheduler task.
+/// @param taskDescriptor A pointer to the TaskDescriptor of the task.
+///
+/// @return Returns a pointer to the appropriate ready TaskQueue.
+static inline TaskQueue* readyQueueForTask(
+  SchedulerState *schedulerState, TaskDescriptor *taskDescriptor
+) {
+  if (taskDescriptor->taskId < NANO_OS_FIRST_USER_TASK_ID) {
+    return &schedulerState->ready[SCHEDULER_KERNEL_PRIORITY];
+  }
+
+  return &schedulerState->ready[
+    SCHEDULER_FIRST_USER_PRIORITY + taskDescriptor->priority];
+}
+
+/// @fn static inline bool taskIsReady(
+///   SchedulerState *schedulerState, TaskDescriptor *taskDescriptor)
+///
+/// @brief Determine whether or not a task is on any of the ready queues.
+///
+/// @param schedulerState A pointer to the SchedulerState maintained by the
+///   scheduler task.
+/// @param taskDescriptor A pointer to the TaskDescriptor of the task.
+///
+/// @return Returns true if the task is on a ready queue, false otherwise.
+static inline bool taskIsReady(
+  SchedulerState *schedulerState, TaskDescriptor *taskDescriptor
+) {
+  return (taskDescriptor->taskQueue >= &schedulerState->ready[0])
+    && (taskDescriptor->taskQueue
+      < &schedulerState->ready[SCHEDULER_NUM_PRIORITIES]);
+}
+
+/// @fn int readyQueuePush(
+///   SchedulerState *schedulerState, TaskDescriptor *taskDescriptor)
+///
+/// @brief Push a task onto the ready queue for its current priority.  If the
+/// task is already on another queue (including a different ready queue), it
+/// is removed from that queue first.  Records when the task became ready for
+/// the task's wait time accounting.
+///
+/// @param schedulerState A pointer to the SchedulerState maintained by the
+///   scheduler task.
+/// @param taskDescriptor A pointer to the TaskDescriptor to push.
+///
+/// @return Returns 0 on success, EINVAL on failure.
+int readyQueuePush(
+  SchedulerState *schedulerState, TaskDescriptor *taskDescriptor
+) {
+#if SCHEDULER_TASK_STATS
+  if (taskIsReady(schedulerState, taskDescriptor) == false) {
+    // Moving between ready queues doesn't restart the wait.
+    taskDescriptor->readyTime = HAL->getElapsedNanoseconds(0);
   }
+#endif // SCHEDULER_TASK_STATS
+
+  return taskQueuePush(
+    readyQueueForTask(schedulerState, taskDescriptor), taskDescriptor);
+}
 
-  TaskDescriptor *poppedDescriptor = NULL;
-  for (uint8_t ii = 0; ii < taskQueue->numElements; ii++) {
-    poppedDescriptor = taskQueuePop(taskQueue);
-    if (poppedDescriptor == taskDescriptor) {
-      returnValue = ENOERR;
-      taskDescriptor->taskQueue = NULL;
+/// @fn static inline int highestReadyUserPriority(
+///   SchedulerState *schedulerState)
+///
+/// @brief Find the index of the highest-priority non-empty user ready queue.
+///
+/// @param schedulerState A pointer to the SchedulerState maintained by the
+///   scheduler task.
+///
+/// @return Returns the index into schedulerState->ready of the queue found or
+/// SCHEDULER_NUM_PRIORITIES if no user tasks are ready.
+static inline int highestReadyUserPriority(SchedulerState *schedulerState) {
+  int priority = SCHEDULER_FIRST_USER_PRIORITY;
+  for (; priority < SCHEDULER_NUM_PRIORITIES; priority++) {
+    if (schedulerState->ready[priority].head != NULL) {
       break;
     }
-    // This is not what we're looking for.  Put it back.
-    taskQueuePush(taskQueue, poppedDescriptor);
   }
 
-  return returnValue;
+  return priority;
+}
+
+/// @fn void boostUserPriorities(SchedulerState *schedulerState, int64_t now)
+///
+/// @brief Return all user tasks to their base priorities and move any ready
+/// ones to the matching ready queue.  This keeps demoted tasks from being
+/// starved indefinitely by higher-priority ones.
+///
+/// @param schedulerState A pointer to the SchedulerState maintained by the
+///   scheduler task.
+/// @param now The current time, in nanoseconds.
+///
+/// @return This function returns no value.
+void boostUserPriorities(SchedulerState *schedulerState, int64_t now) {
+  for (int ii = NANO_OS_FIRST_USER_TASK_ID; ii <= NANO_OS_NUM_TASKS; ii++) {
+    TaskDescriptor *taskDescriptor = &schedulerState->allTasks[ii - 1];
+    if (taskDescriptor->priority == taskDescriptor->basePriority) {
+      continue;
+    }
+
+    taskDescriptor->priority = taskDescriptor->basePriority;
+    if (taskIsReady(schedulerState, taskDescriptor)) {
+      readyQueuePush(schedulerState, taskDescriptor);
+    }
+  }
+
+  schedulerState->lastPriorityBoost = now;
+}
+
+/// @fn TaskDescriptor* readyQueuePop(SchedulerState *schedulerState)
+///
+/// @brief Pop the next task to run from the ready queues.
+///
+/// @details
+/// Kernel tasks poll for work and are therefore always ready, so a strict
+/// priority ordering between kernel and user tasks would starve one class or
+/// the other.  Instead, the scheduler alternates between the kernel queue and
+/// the highest-priority non-empty user queue, falling back to the other class
+/// when one has nothing ready.
+///
+/// A pending handoff from the last task that ran takes precedence over both,
+/// up to SCHEDULER_MAX_HANDOFFS times in a row.
+///
+/// @param schedulerState A pointer to the SchedulerState maintained by the
+///   scheduler task.
+///
+/// @return Returns a pointer to the TaskDescriptor popped on success, NULL if
+/// no tasks are ready.
+TaskDescriptor* readyQueuePop(SchedulerState *schedulerState) {
+  TaskDescriptor *taskDescriptor = handoffTask;
+  handoffTask = NULL;
+  if ((taskDescriptor != NULL)
+    && (schedulerState->numHandoffs < SCHEDULER_MAX_HANDOFFS)
+    && (taskIsReady(schedulerState, taskDescriptor))
+  ) {
+    schedulerState->numHandoffs++;
+    taskQueueRemove(taskDescriptor->taskQueue, taskDescriptor);
+    return taskDescriptor;
+  }
+  schedulerState->numHandoffs = 0;
+
+  TaskQueue *ready = schedulerState->ready;
+  bool runKernelTask = schedulerState->runKernelTask;
+  schedulerState->runKernelTask = !runKernelTask;
+
+  if ((runKernelTask)
+    && (ready[SCHEDULER_KERNEL_PRIORITY].head != NULL)
+  ) {
+    return taskQueuePop(&ready[SCHEDULER_KERNEL_PRIORITY]);
+  }
+
+  int priority = highestReadyUserPriority(schedulerState);
+  if (priority == SCHEDULER_NUM_PRIORITIES) {
+    // No user tasks are ready.
+    return taskQueuePop(&ready[SCHEDULER_KERNEL_PRIORITY]);
+  }
+
+  // If anything at a lower priority is waiting, make sure it hasn't been
+  // waiting too long.
+  for (int ii = priority + 1; ii < SCHEDULER_NUM_PRIORITIES; ii++) {
+    if (ready[ii].head != NULL) {
+      int64_t now = coroutineGetNanoseconds(NULL);
+      if (now - schedulerState->lastPriorityBoost
+        >= SCHEDULER_PRIORITY_BOOST_PERIOD
+      ) {
+        boostUserPriorities(schedulerState, now);
+        priority = highestReadyUserPriority(schedulerState);
+      }
+      break;
+    }
+  }
+
+  return taskQueuePop(&ready[priority]);
+}
+
+/// @fn static inline void updateTaskPriority(TaskDescriptor *taskDescriptor)
+///
+/// @brief Adjust a user task's priority based on how it gave up the CPU.  A
+/// task that was preempted used its entire time slice and is demoted one
+/// level.  A task that blocked waiting on a message is promoted one level,
+/// but never above its base priority.
+///
+/// @param taskDescriptor A pointer to the TaskDescriptor of the task that just
+///   yielded.
+///
+/// @return This function returns no value.
+static inline void updateTaskPriority(TaskDescriptor *taskDescriptor) {
+  if (taskDescriptor->preempted) {
+    taskDescriptor->preempted = false;
+    if (taskDescriptor->priority < (SCHEDULER_NUM_USER_PRIORITIES - 1)) {
+      taskDescriptor->priority++;
+    }
+  } else if ((taskDescriptor->taskHandle->blockingCocondition != NULL)
+    && (taskDescriptor->priority > taskDescriptor->basePriority)
+  ) {
+    taskDescriptor->priority--;
+  }
 }
 
 // Coroutine callbacks.  ***DO NOT** do parameter validation.  These callbacks
@@ -339,7 +729,8 @@ void comutexUnlockCallback(void *stateData, Comutex *comutex) {
     return;
   }
   taskQueueRemove(taskDescriptor->taskQueue, taskDescriptor);
-  taskQueuePush(&schedulerState->ready, taskDescriptor);
+  timeoutHeapRemove(&schedulerState->timeouts, taskDescriptor);
+  readyQueuePush(schedulerState, taskDescriptor);
 
   return;
 }
@@ -357,10 +748,18 @@ void comutexUnlockCallback(void *stateData, Comutex *comutex) {
 ///
 /// @return This function returns no value, but if the head of the Cocondition's
 /// signal queue is found in one of the waiting queues, it is removed from the
-/// waiting queue and pushed onto the ready queue.
+/// waiting queue and pushed onto the ready queue.  If only one task is
+/// signalled, it's handed the CPU next so that a task waiting on an event runs
+/// as soon as the event happens.  A broadcast that wakes several tasks doesn't
+/// say which of them the event was for.  In particular, all messages share one
+/// done condition, so the sender of a message that's been marked done is
+/// handed the CPU by schedulerMessageDone instead.
 void coconditionSignalCallback(void *stateData, Cocondition *cocondition) {
   SchedulerState *schedulerState = *((SchedulerState**) stateData);
   TaskHandle cur = cocondition->head;
+  if ((cur != NULL) && (cocondition->numSignals == 1)) {
+    handoffTask = coroutineContext(cur);
+  }
 
   for (int ii = 0; (ii < cocondition->numSignals) && (cur != NULL); ii++) {
     TaskDescriptor *taskDescriptor = coroutineContext(cur);
@@ -368,7 +767,8 @@ void coconditionSignalCallback(void *stateData, Cocondition *cocondition) {
     // loop if cocondition->numSignals > 0, so there MUST be something waiting
     // on this condition.
     taskQueueRemove(taskDescriptor->taskQueue, taskDescriptor);
-    taskQueuePush(&schedulerState->ready, taskDescriptor);
+    timeoutHeapRemove(&schedulerState->timeouts, taskDescriptor);
+    readyQueuePush(schedulerState, taskDescriptor);
     cur = cur->nextToSignal;
   }
 
@@ -395,6 +795,359 @@ TaskDescriptor* schedulerGetTaskByPid(unsigned int pid) {
   return taskDescriptor;
 }
 
+#if SCHEDULER_TRACE_NUM_EVENTS > 0
+
+/// @var traceBuffer
+///
+/// @brief Pointer to the trace member of the SchedulerState object maintained
+/// by the scheduler task.  NULL until the scheduler has started.
+static TraceBuffer *traceBuffer = NULL;
+
+/// @fn static inline void schedulerTraceAt(int64_t timestamp,
+///   TraceEventType type, TaskId taskId, TaskId peerId, int64_t arg)
+///
+/// @brief Record an event with a known timestamp in the trace buffer.
+///
+/// @param timestamp The time, in nanoseconds, when the event occurred.
+/// @param type The TraceEventType of the event.
+/// @param taskId The ID of the task the event is about.
+/// @param peerId The ID of the other task involved in the event, if any.
+/// @param arg The event-specific argument.
+///
+/// @return This function returns no value.
+static inline void schedulerTraceAt(int64_t timestamp,
+  TraceEventType type, TaskId taskId, TaskId peerId, int64_t arg
+) {
+  if (traceBuffer == NULL) {
+    return;
+  }
+
+  TraceEvent *event = &traceBuffer->events[
+    traceBuffer->numEvents & (SCHEDULER_TRACE_NUM_EVENTS - 1)];
+  event->timestamp = timestamp;
+  event->arg = (uint16_t) arg;
+  event->taskId = taskId;
+  event->peerId = peerId;
+  event->type = type;
+  traceBuffer->numEvents++;
+}
+
+/// @fn void schedulerTrace(
+///   TraceEventType type, TaskId taskId, TaskId peerId, int64_t arg)
+///
+/// @brief Record an event that's happening now in the trace buffer.
+///
+/// @param type The TraceEventType of the event.
+/// @param taskId The ID of the task the event is about.
+/// @param peerId The ID of the other task involved in the event, if any.
+/// @param arg The event-specific argument.
+///
+/// @return This function returns no value.
+void schedulerTrace(
+  TraceEventType type, TaskId taskId, TaskId peerId, int64_t arg
+) {
+  schedulerTraceAt(HAL->getElapsedNanoseconds(0), type, taskId, peerId, arg);
+}
+
+/// @fn TaskMessage* schedulerTraceMessagePop(TaskMessage *taskMessage)
+///
+/// @brief Record that the running task received a message in the trace
+/// buffer.  This wraps the message queue pop and wait functions when tracing is
+/// enabled.
+///
+/// @param taskMessage A pointer to the TaskMessage that was received, if any.
+///
+/// @return Returns the taskMessage parameter.
+TaskMessage* schedulerTraceMessagePop(TaskMessage *taskMessage) {
+  if ((currentTask != NULL) && (taskMessage != NULL)) {
+    schedulerTrace(TRACE_MESSAGE_POP, currentTask->taskId,
+      0, taskMessage->type);
+  }
+
+  return taskMessage;
+}
+
+/// @fn const TraceBuffer* schedulerGetTrace(void)
+///
+/// @brief Get the scheduler's trace buffer so that it can be written out.
+///
+/// @return Returns a pointer to the trace buffer once the scheduler has
+/// started, NULL before then.
+const TraceBuffer* schedulerGetTrace(void) {
+  return traceBuffer;
+}
+
+#else // SCHEDULER_TRACE_NUM_EVENTS == 0
+
+#define schedulerTraceAt(timestamp, type, taskId, peerId, arg)
+#define schedulerTrace(type, taskId, peerId, arg)
+
+#endif // SCHEDULER_TRACE_NUM_EVENTS
+
+#if NANO_OS_IPC_STATS_NUM_ENTRIES > 0
+
+/// @var ipcStats
+///
+/// @brief Pointer to the ipcStats member of the SchedulerState object
+/// maintained by the scheduler.  NULL until the scheduler has started.
+static IpcStats *ipcStats = NULL;
+
+/// @var ipcPushTime
+///
+/// @brief The time, in nanoseconds, that each entry in the messages array was
+/// last pushed onto a queue.
+static int64_t ipcPushTime[NANO_OS_NUM_MESSAGES];
+
+/// @var ipcPopTime
+///
+/// @brief The time, in nanoseconds, that each entry in the messages array was
+/// last popped from a queue.
+static int64_t ipcPopTime[NANO_OS_NUM_MESSAGES];
+
+/// @var ipcPopEntry
+///
+/// @brief The index into ipcStats->entries that each entry in the messages
+/// array was counted under when it was last popped, or -1 if it has been
+/// marked done or released since then.  The index is saved at the pop because
+/// handlers reuse the message for their reply before marking it done.
+static int8_t ipcPopEntry[NANO_OS_NUM_MESSAGES];
+
+/// @fn static inline uint8_t ipcStatsBucket(int64_t nanoseconds)
+///
+/// @brief Get the index of the latency histogram bucket that a duration falls
+/// into.
+///
+/// @param nanoseconds The duration, in nanoseconds.
+///
+/// @return Returns the log2 bucket of the duration in microseconds.
+static inline uint8_t ipcStatsBucket(int64_t nanoseconds) {
+  if (nanoseconds < 1000) {
+    return 0;
+  }
+
+  int64_t microseconds = nanoseconds / 1000;
+  if (microseconds >= (((int64_t) 1) << (IPC_STATS_NUM_BUCKETS - 1))) {
+    return IPC_STATS_NUM_BUCKETS - 1;
+  }
+
+  return (uint8_t) (32 - __builtin_clz((uint32_t) microseconds));
+}
+
+/// @fn static int ipcStatsFind(TaskId taskId, uint16_t type, bool create)
+///
+/// @brief Find the entry in the IPC statistics table for a destination task
+/// and message type.
+///
+/// @param taskId The ID of the task the message was sent to.
+/// @param type The type of the message.
+/// @param create Whether or not to claim an unused entry if there isn't one
+///   for the pair yet.
+///
+/// @return Returns the index of the entry on success, -1 if there is no entry
+/// for the pair and one could not be created.
+static int ipcStatsFind(TaskId taskId, uint16_t type, bool create) {
+  uint32_t start = (((uint32_t) taskId) * 31) + type;
+  for (uint32_t ii = 0; ii < NANO_OS_IPC_STATS_NUM_ENTRIES; ii++) {
+    int index = (int) ((start + ii) & (NANO_OS_IPC_STATS_NUM_ENTRIES - 1));
+    IpcStatsElement *entry = &ipcStats->entries[index];
+    if ((entry->pid == taskId) && (entry->type == type)) {
+      return index;
+    } else if (entry->pid == 0) {
+      if (create == false) {
+        break;
+      }
+      entry->pid = taskId;
+      entry->type = type;
+      return index;
+    }
+  }
+
+  return -1;
+}
+
+/// @fn void schedulerRecordIpcEvent(
+///   TaskMessage *taskMessage, msg_q_t *queue, msg_event_t event)
+///
+/// @brief Update the IPC statistics for an event in the life of a message.
+/// Called from the messages library's event callback.  Only messages from the
+/// messages array are counted.
+///
+/// @param taskMessage A pointer to the TaskMessage the event is about.
+/// @param queue The queue the message was pushed onto or popped from, NULL for
+///   other events.
+/// @param event The msg_event_t that occurred.
+///
+/// @return This function returns no value.
+void schedulerRecordIpcEvent(
+  TaskMessage *taskMessage, msg_q_t *queue, msg_event_t event
+) {
+  if ((ipcStats == NULL) || (taskMessage < messages)
+    || (taskMessage >= &messages[NANO_OS_NUM_MESSAGES])
+  ) {
+    return;
+  }
+  int index = (int) (taskMessage - messages);
+  int64_t now = HAL->getElapsedNanoseconds(0);
+
+  if ((event == MSG_EVENT_DONE) || (event == MSG_EVENT_RELEASE)) {
+    if (ipcPopEntry[index] >= 0) {
+      ipcStats->entries[ipcPopEntry[index]].serviceLatency[
+        ipcStatsBucket(now - ipcPopTime[index])]++;
+      ipcPopEntry[index] = -1;
+    }
+    return;
+  }
+
+  TaskDescriptor *taskDescriptor
+    = (TaskDescriptor*) coroutineContext(taskMessage->to.coro);
+  if (taskDescriptor == NULL) {
+    return;
+  }
+  int entryIndex = ipcStatsFind(taskDescriptor->taskId,
+    (uint16_t) taskMessage->type, event == MSG_EVENT_PUSH);
+
+  if (event == MSG_EVENT_PUSH) {
+    ipcPushTime[index] = now;
+    if (entryIndex < 0) {
+      ipcStats->numDropped++;
+      return;
+    }
+
+    IpcStatsElement *entry = &ipcStats->entries[entryIndex];
+    entry->count++;
+    uint8_t depth = (queue->length < UINT8_MAX)
+      ? (uint8_t) queue->length : UINT8_MAX;
+    if (depth > entry->maxQueueDepth) {
+      entry->maxQueueDepth = depth;
+    }
+  } else { // MSG_EVENT_POP
+    ipcPopTime[index] = now;
+    ipcPopEntry[index] = (int8_t) entryIndex;
+    if (entryIndex >= 0) {
+      ipcStats->entries[entryIndex].queueLatency[
+        ipcStatsBucket(now - ipcPushTime[index])]++;
+    }
+  }
+}
+
+#endif // NANO_OS_IPC_STATS_NUM_ENTRIES
+
+/// @fn void schedulerMessageDone(TaskMessage *taskMessage)
+///
+/// @brief Hand the CPU to the sender of a message that's just been marked done
+/// if the sender is waiting on it.  Called from the messages library's event
+/// callback, after the waiters have been signalled.
+///
+/// @param taskMessage A pointer to the TaskMessage that was marked done.
+///
+/// @return This function returns no value.
+void schedulerMessageDone(TaskMessage *taskMessage) {
+  if (!taskMessageWaiting(taskMessage)) {
+    return;
+  }
+
+  TaskDescriptor *from = taskMessageFrom(taskMessage);
+  if ((from != NULL) && (from != currentTask) && (from != schedulerTask)) {
+    handoffTask = from;
+  }
+}
+
+/// @fn int schedulerMessageQueuePush(
+///   TaskDescriptor *taskDescriptor, TaskMessage *taskMessage)
+///
+/// @brief Push a message onto a task's message queue.  This is what
+/// taskMessageQueuePush expands to.  If the sender is going to wait on the
+/// message, the destination task is handed the CPU next so that the sender
+/// doesn't have to wait for every other ready task to run before its message
+/// is handled.  The push is also recorded in the trace buffer if tracing is
+/// enabled.
+///
+/// @param taskDescriptor A pointer to the TaskDescriptor of the destination
+///   task.
+/// @param taskMessage A pointer to the TaskMessage to push.
+///
+/// @return Returns the value returned by comessageQueuePush.
+int schedulerMessageQueuePush(
+  TaskDescriptor *taskDescriptor, TaskMessage *taskMessage
+) {
+  if ((currentTask != NULL) && (taskMessage != NULL)) {
+    schedulerTrace(TRACE_MESSAGE_PUSH, currentTask->taskId,
+      taskDescriptor->taskId, taskMessage->type);
+  }
+
+  int returnValue
+    = comessageQueuePush(taskDescriptor->taskHandle, taskMessage);
+  if ((returnValue == coroutineSuccess)
+    && (taskMessage->waiting)
+    && (currentTask != schedulerTask)
+  ) {
+    handoffTask = taskDescriptor;
+  }
+
+  return returnValue;
+}
+
+/// @fn int schedulerMessageQueuePushBatch(TaskDescriptor *taskDescriptor,
+///   TaskMessage **taskMessages, int numMessages)
+///
+/// @brief Push several messages onto a task's message queue at once.  This is
+/// what taskMessageQueuePushBatch expands to.  The destination task is woken
+/// only once for the whole batch.  If the sender is going to wait on any of
+/// the messages, the destination task is handed the CPU next, the same as for
+/// schedulerMessageQueuePush.
+///
+/// @param taskDescriptor A pointer to the TaskDescriptor of the destination
+///   task.
+/// @param taskMessages The array of TaskMessages to push, in order.
+/// @param numMessages The number of elements in the taskMessages array.
+///
+/// @return Returns the value returned by comessageQueuePushBatch.
+int schedulerMessageQueuePushBatch(TaskDescriptor *taskDescriptor,
+  TaskMessage **taskMessages, int numMessages
+) {
+  int returnValue = comessageQueuePushBatch(
+    taskDescriptor->taskHandle, taskMessages, numMessages);
+  if (returnValue != coroutineSuccess) {
+    return returnValue;
+  }
+
+  for (int ii = 0; ii < numMessages; ii++) {
+    if (currentTask != NULL) {
+      schedulerTrace(TRACE_MESSAGE_PUSH, currentTask->taskId,
+        taskDescriptor->taskId, taskMessages[ii]->type);
+    }
+    if ((taskMessages[ii]->waiting) && (currentTask != schedulerTask)) {
+      handoffTask = taskDescriptor;
+    }
+  }
+
+  return returnValue;
+}
+
+/// @fn int schedulerMessageQueuePopBatch(
+///   TaskMessage **taskMessages, int maxMessages)
+///
+/// @brief Pop up to maxMessages messages from the running task's message queue
+/// at once.  This is what taskMessageQueuePopBatch expands to.  Each message is
+/// recorded in the trace buffer if tracing is enabled.
+///
+/// @param taskMessages The array to store the popped TaskMessages in.
+/// @param maxMessages The maximum number of messages to pop.
+///
+/// @return Returns the number of messages popped, which may be 0.
+int schedulerMessageQueuePopBatch(
+  TaskMessage **taskMessages, int maxMessages
+) {
+  int numMessages = comessageQueuePopBatch(taskMessages, maxMessages);
+#if SCHEDULER_TRACE_NUM_EVENTS > 0
+  for (int ii = 0; ii < numMessages; ii++) {
+    schedulerTraceMessagePop(taskMessages[ii]);
+  }
+#endif // SCHEDULER_TRACE_NUM_EVENTS
+
+  return numMessages;
+}
+
 /// @fn void* dummyTask(void *args)
 ///
 /// @brief Dummy task that's loaded at startup to prepopulate the task
@@ -443,9 +1196,11 @@ int schedulerSendTaskMessageToTask(
   // the message came from the scheduler will fail.
   msg_from(taskMessage).coro = schedulerTaskHandle;
 
+#ifdef THREAD_SAFE_COROUTINES
   // Have to set the endpoint type manually since we're not using
   // comessageQueuePush.
   taskMessage->msg_sync = &msg_sync_array[MSG_CORO_SAFE];
+#endif // THREAD_SAFE_COROUTINES
 
   if (coroutineCorrupted(taskDescriptor->taskHandle)) {
     printString("ERROR: Called task is corrupted:\n");
@@ -880,138 +1635,280 @@ int schedulerWaitForTaskComplete(void) {
 ///
 /// @brief Get the number of running tasks from the scheduler.
 ///
-/// @param timeout A pointer to a struct timespec with the end time for the
-///   timeout.
+/// @param timeout A pointer to a struct timespec with the end time for the
+///   timeout.
+///
+/// @return Returns the number of running tasks on success, 0 on failure.
+/// There is no way for the number of running tasks to exceed the maximum
+/// value of a TaskId type, so it's used here as the return type.
+TaskId schedulerGetNumRunningTasks(struct timespec *timeout) {
+  TaskMessage *taskMessage = NULL;
+  int waitStatus = taskSuccess;
+  TaskId numTaskDescriptors = 0;
+
+  taskMessage = sendNanoOsMessageToPid(
+    NANO_OS_SCHEDULER_TASK_ID, SCHEDULER_GET_NUM_RUNNING_TASKS,
+    (NanoOsMessageData) 0, (NanoOsMessageData) 0, true);
+  if (taskMessage == NULL) {
+    printf("ERROR: Could not communicate with scheduler.\n");
+    goto exit;
+  }
+
+  waitStatus = taskMessageWaitForDone(taskMessage, timeout);
+  if (waitStatus != taskSuccess) {
+    if (waitStatus == taskTimedout) {
+      printf("Command to get the number of running tasks timed out.\n");
+    } else {
+      printf("Command to get the number of running tasks failed.\n");
+    }
+
+    // Without knowing how many tasks there are, we can't continue.  Bail.
+    goto releaseMessage;
+  }
+
+  numTaskDescriptors = nanoOsMessageDataValue(taskMessage, TaskId);
+  if (numTaskDescriptors == 0) {
+    printf("ERROR: Number of running tasks returned from the "
+      "scheduler is 0.\n");
+    goto releaseMessage;
+  }
+
+releaseMessage:
+  if (taskMessageRelease(taskMessage) != taskSuccess) {
+    printf("ERROR: Could not release message sent to scheduler for "
+      "getting the number of running tasks.\n");
+  }
+
+exit:
+  return numTaskDescriptors;
+}
+
+/// @fn TaskInfo* schedulerGetTaskInfo(void)
+///
+/// @brief Get information about all tasks running in the system from the
+/// scheduler.
+///
+/// @return Returns a populated, dynamically-allocated TaskInfo object on
+/// success, NULL on failure.
+TaskInfo* schedulerGetTaskInfo(void) {
+  TaskMessage *taskMessage = NULL;
+  int waitStatus = taskSuccess;
+
+  // We don't know where our messages to the scheduler will be in its queue, so
+  // we can't assume they will be processed immediately, but we can't wait
+  // forever either.  Set a 100 ms timeout.
+  struct timespec timeout = {0};
+  timespec_get(&timeout, TIME_UTC);
+  timeout.tv_nsec += 100000000;
+
+  // Because the scheduler runs on the main coroutine, it doesn't have the
+  // ability to yield.  That means it can't do anything that requires a
+  // synchronus message exchange, i.e. allocating memory.  So, we need to
+  // allocate memory from the current task and then pass that back to the
+  // scheduler to populate.  That means we first need to know how many tasks
+  // are running so that we know how much space to allocate.  So, get that
+  // first.
+  TaskId numTaskDescriptors = schedulerGetNumRunningTasks(&timeout);
+
+  // We need numTaskDescriptors rows.
+  TaskInfo *taskInfo = (TaskInfo*) malloc(sizeof(TaskInfo)
+    + ((numTaskDescriptors - 1) * sizeof(TaskInfoElement)));
+  if (taskInfo == NULL) {
+    printf(
+      "ERROR: Could not allocate memory for taskInfo in getTaskInfo.\n");
+    goto exit;
+  }
+
+  // It is possible, although unlikely, that an additional task is started
+  // between the time we made the call above and the time that our message gets
+  // handled below.  We allocated our return value based upon the size that was
+  // returned above and, if we're not careful, it will be possible to overflow
+  // the array.  Initialize taskInfo->numTasks so that
+  // schedulerGetTaskInfoCommandHandler knows the maximum number of
+  // TaskInfoElements it can populated.
+  taskInfo->numTasks = numTaskDescriptors;
+
+  taskMessage
+    = sendNanoOsMessageToPid(NANO_OS_SCHEDULER_TASK_ID,
+    SCHEDULER_GET_TASK_INFO, /* func= */ 0, (intptr_t) taskInfo, true);
+
+  if (taskMessage == NULL) {
+    printf("ERROR: Could not send scheduler message to get task info.\n");
+    goto freeMemory;
+  }
+
+  waitStatus = taskMessageWaitForDone(taskMessage, &timeout);
+  if (waitStatus != taskSuccess) {
+    if (waitStatus == taskTimedout) {
+      printf("Command to get task information timed out.\n");
+    } else {
+      printf("Command to get task information failed.\n");
+    }
+
+    // Without knowing the data for the tasks, we can't display them.  Bail.
+    goto releaseMessage;
+  }
+
+  if (taskMessageRelease(taskMessage) != taskSuccess) {
+    printf("ERROR: Could not release message sent to scheduler for "
+      "getting the number of running tasks.\n");
+  }
+
+  return taskInfo;
+
+releaseMessage:
+  if (taskMessageRelease(taskMessage) != taskSuccess) {
+    printf("ERROR: Could not release message sent to scheduler for "
+      "getting the number of running tasks.\n");
+  }
+
+freeMemory:
+  free(taskInfo); taskInfo = NULL;
+
+exit:
+  return taskInfo;
+}
+
+/// @fn TaskStatsInfo* schedulerGetTaskStats(void)
+///
+/// @brief Get the CPU accounting for all tasks running in the system from the
+/// scheduler.
 ///
-/// @return Returns the number of running tasks on success, 0 on failure.
-/// There is no way for the number of running tasks to exceed the maximum
-/// value of a TaskId type, so it's used here as the return type.
-TaskId schedulerGetNumRunningTasks(struct timespec *timeout) {
+/// @return Returns a populated, dynamically-allocated TaskStatsInfo object on
+/// success, NULL on failure.  errno is set to ENOTSUP if the accounting was
+/// compiled out (SCHEDULER_TASK_STATS is 0).
+TaskStatsInfo* schedulerGetTaskStats(void) {
+#if !SCHEDULER_TASK_STATS
+  errno = ENOTSUP;
+  return NULL;
+#else
   TaskMessage *taskMessage = NULL;
   int waitStatus = taskSuccess;
-  TaskId numTaskDescriptors = 0;
 
-  taskMessage = sendNanoOsMessageToPid(
-    NANO_OS_SCHEDULER_TASK_ID, SCHEDULER_GET_NUM_RUNNING_TASKS,
-    (NanoOsMessageData) 0, (NanoOsMessageData) 0, true);
-  if (taskMessage == NULL) {
-    printf("ERROR: Could not communicate with scheduler.\n");
+  // Set a 100 ms timeout for the same reason as in schedulerGetTaskInfo.
+  struct timespec timeout = {0};
+  timespec_get(&timeout, TIME_UTC);
+  timeout.tv_nsec += 100000000;
+
+  // The scheduler can't allocate memory, so allocate space for the maximum
+  // number of tasks here and let the scheduler fill in what it has.
+  TaskId numTaskDescriptors = schedulerGetNumRunningTasks(&timeout);
+  TaskStatsInfo *taskStatsInfo = (TaskStatsInfo*) malloc(sizeof(TaskStatsInfo)
+    + ((numTaskDescriptors - 1) * sizeof(TaskStatsElement)));
+  if (taskStatsInfo == NULL) {
+    printf(
+      "ERROR: Could not allocate memory for taskStatsInfo in getTaskStats.\n");
     goto exit;
   }
+  taskStatsInfo->numTasks = numTaskDescriptors;
 
-  waitStatus = taskMessageWaitForDone(taskMessage, timeout);
+  taskMessage
+    = sendNanoOsMessageToPid(NANO_OS_SCHEDULER_TASK_ID,
+    SCHEDULER_GET_TASK_STATS, /* func= */ 0, (intptr_t) taskStatsInfo, true);
+  if (taskMessage == NULL) {
+    printf("ERROR: Could not send scheduler message to get task stats.\n");
+    goto freeMemory;
+  }
+
+  waitStatus = taskMessageWaitForDone(taskMessage, &timeout);
   if (waitStatus != taskSuccess) {
     if (waitStatus == taskTimedout) {
-      printf("Command to get the number of running tasks timed out.\n");
+      printf("Command to get task statistics timed out.\n");
     } else {
-      printf("Command to get the number of running tasks failed.\n");
+      printf("Command to get task statistics failed.\n");
     }
 
-    // Without knowing how many tasks there are, we can't continue.  Bail.
     goto releaseMessage;
   }
 
-  numTaskDescriptors = nanoOsMessageDataValue(taskMessage, TaskId);
-  if (numTaskDescriptors == 0) {
-    printf("ERROR: Number of running tasks returned from the "
-      "scheduler is 0.\n");
-    goto releaseMessage;
+  if (taskMessageRelease(taskMessage) != taskSuccess) {
+    printf("ERROR: Could not release message sent to scheduler for "
+      "getting task statistics.\n");
   }
 
+  return taskStatsInfo;
+
 releaseMessage:
   if (taskMessageRelease(taskMessage) != taskSuccess) {
     printf("ERROR: Could not release message sent to scheduler for "
-      "getting the number of running tasks.\n");
+      "getting task statistics.\n");
   }
 
+freeMemory:
+  free(taskStatsInfo); taskStatsInfo = NULL;
+
 exit:
-  return numTaskDescriptors;
+  return taskStatsInfo;
+#endif // SCHEDULER_TASK_STATS
 }
 
-/// @fn TaskInfo* schedulerGetTaskInfo(void)
+/// @fn IpcStatsInfo* schedulerGetIpcStats(void)
 ///
-/// @brief Get information about all tasks running in the system from the
-/// scheduler.
+/// @brief Get the counts, latency histograms, and queue depths of the messages
+/// sent between tasks from the scheduler.
 ///
-/// @return Returns a populated, dynamically-allocated TaskInfo object on
+/// @return Returns a populated, dynamically-allocated IpcStatsInfo object on
 /// success, NULL on failure.
-TaskInfo* schedulerGetTaskInfo(void) {
+IpcStatsInfo* schedulerGetIpcStats(void) {
   TaskMessage *taskMessage = NULL;
   int waitStatus = taskSuccess;
 
-  // We don't know where our messages to the scheduler will be in its queue, so
-  // we can't assume they will be processed immediately, but we can't wait
-  // forever either.  Set a 100 ms timeout.
+  // Set a 100 ms timeout for the same reason as in schedulerGetTaskInfo.
   struct timespec timeout = {0};
   timespec_get(&timeout, TIME_UTC);
   timeout.tv_nsec += 100000000;
 
-  // Because the scheduler runs on the main coroutine, it doesn't have the
-  // ability to yield.  That means it can't do anything that requires a
-  // synchronus message exchange, i.e. allocating memory.  So, we need to
-  // allocate memory from the current task and then pass that back to the
-  // scheduler to populate.  That means we first need to know how many tasks
-  // are running so that we know how much space to allocate.  So, get that
-  // first.
-  TaskId numTaskDescriptors = schedulerGetNumRunningTasks(&timeout);
-
-  // We need numTaskDescriptors rows.
-  TaskInfo *taskInfo = (TaskInfo*) malloc(sizeof(TaskInfo)
-    + ((numTaskDescriptors - 1) * sizeof(TaskInfoElement)));
-  if (taskInfo == NULL) {
+  // The scheduler can't allocate memory, so allocate space for the whole
+  // table here and let the scheduler fill in the entries that are in use.
+  int maxEntries = (NANO_OS_IPC_STATS_NUM_ENTRIES > 0)
+    ? NANO_OS_IPC_STATS_NUM_ENTRIES : 1;
+  IpcStatsInfo *ipcStatsInfo = (IpcStatsInfo*) malloc(sizeof(IpcStatsInfo)
+    + ((maxEntries - 1) * sizeof(IpcStatsElement)));
+  if (ipcStatsInfo == NULL) {
     printf(
-      "ERROR: Could not allocate memory for taskInfo in getTaskInfo.\n");
+      "ERROR: Could not allocate memory for ipcStatsInfo in getIpcStats.\n");
     goto exit;
   }
-
-  // It is possible, although unlikely, that an additional task is started
-  // between the time we made the call above and the time that our message gets
-  // handled below.  We allocated our return value based upon the size that was
-  // returned above and, if we're not careful, it will be possible to overflow
-  // the array.  Initialize taskInfo->numTasks so that
-  // schedulerGetTaskInfoCommandHandler knows the maximum number of
-  // TaskInfoElements it can populated.
-  taskInfo->numTasks = numTaskDescriptors;
+  ipcStatsInfo->numEntries = 0;
+  ipcStatsInfo->numDropped = 0;
 
   taskMessage
     = sendNanoOsMessageToPid(NANO_OS_SCHEDULER_TASK_ID,
-    SCHEDULER_GET_TASK_INFO, /* func= */ 0, (intptr_t) taskInfo, true);
-
+    SCHEDULER_GET_IPC_STATS, /* func= */ 0, (intptr_t) ipcStatsInfo, true);
   if (taskMessage == NULL) {
-    printf("ERROR: Could not send scheduler message to get task info.\n");
+    printf("ERROR: Could not send scheduler message to get IPC stats.\n");
     goto freeMemory;
   }
 
   waitStatus = taskMessageWaitForDone(taskMessage, &timeout);
   if (waitStatus != taskSuccess) {
     if (waitStatus == taskTimedout) {
-      printf("Command to get task information timed out.\n");
+      printf("Command to get IPC statistics timed out.\n");
     } else {
-      printf("Command to get task information failed.\n");
+      printf("Command to get IPC statistics failed.\n");
     }
 
-    // Without knowing the data for the tasks, we can't display them.  Bail.
     goto releaseMessage;
   }
 
   if (taskMessageRelease(taskMessage) != taskSuccess) {
     printf("ERROR: Could not release message sent to scheduler for "
-      "getting the number of running tasks.\n");
+      "getting IPC statistics.\n");
   }
 
-  return taskInfo;
+  return ipcStatsInfo;
 
 releaseMessage:
   if (taskMessageRelease(taskMessage) != taskSuccess) {
     printf("ERROR: Could not release message sent to scheduler for "
-      "getting the number of running tasks.\n");
+      "getting IPC statistics.\n");
   }
 
 freeMemory:
-  free(taskInfo); taskInfo = NULL;
+  free(ipcStatsInfo); ipcStatsInfo = NULL;
 
 exit:
-  return taskInfo;
+  return ipcStatsInfo;
 }
 
 /// @fn int schedulerKillTask(TaskId taskId)
@@ -1169,6 +2066,32 @@ int schedulerSetTaskUser(UserId userId) {
   return returnValue;
 }
 
+/// @fn int schedulerSetTaskPriority(TaskId taskId, int priority)
+///
+/// @brief Set the base priority of a user task.
+///
+/// @param taskId The ID of the task to set the priority of.
+/// @param priority The new base priority of the task.  0 is the highest
+///   priority and SCHEDULER_NUM_USER_PRIORITIES - 1 is the lowest.
+///
+/// @return Returns 0 on success, an errno value on failure.
+int schedulerSetTaskPriority(TaskId taskId, int priority) {
+  int returnValue = EIO;
+  TaskMessage *taskMessage = sendNanoOsMessageToPid(
+    NANO_OS_SCHEDULER_TASK_ID, SCHEDULER_SET_TASK_PRIORITY,
+    /* func= */ priority, /* data= */ taskId, true);
+  if (taskMessage == NULL) {
+    printString("ERROR: Could not communicate with scheduler.\n");
+    return returnValue; // EIO
+  }
+
+  taskMessageWaitForDone(taskMessage, NULL);
+  returnValue = nanoOsMessageDataValue(taskMessage, int);
+  taskMessageRelease(taskMessage);
+
+  return returnValue;
+}
+
 /// @fn FileDescriptor* schedulerGetFileDescriptor(FILE *stream)
 ///
 /// @brief Get the IoPipe object for a task given a pointer to the FILE
@@ -1416,6 +2339,13 @@ static inline TaskDescriptor* launchTask(SchedulerState *schedulerState,
     taskDescriptor->numFileDescriptors = NUM_STANDARD_FILE_DESCRIPTORS;
     taskDescriptor->fileDescriptors
       = (FileDescriptor*) standardUserFileDescriptors;
+    taskDescriptor->priority = 0;
+    taskDescriptor->basePriority = 0;
+    taskDescriptor->preempted = false;
+#if SCHEDULER_TASK_STATS
+    memset(&taskDescriptor->stats, 0, sizeof(taskDescriptor->stats));
+#endif // SCHEDULER_TASK_STATS
+    schedulerTrace(TRACE_TASK_CREATE, taskDescriptor->taskId, 0, 0);
 
     if (taskCreate(taskDescriptor,
       startCommand, taskMessage) == taskError
@@ -1452,7 +2382,7 @@ static inline TaskDescriptor* launchTask(SchedulerState *schedulerState,
     taskResume(taskDescriptor, NULL);
 
     // Put the task on the ready queue.
-    taskQueuePush(&schedulerState->ready, taskDescriptor);
+    readyQueuePush(schedulerState, taskDescriptor);
   } else {
     returnValue = NULL;
   }
@@ -1489,9 +2419,11 @@ static inline TaskDescriptor* launchForegroundTask(
     if (taskQueueRemove(
       &schedulerState->timedWaiting, taskDescriptor) != 0
     ) {
-      taskQueueRemove(&schedulerState->ready, taskDescriptor);
+      taskQueueRemove(
+        readyQueueForTask(schedulerState, taskDescriptor), taskDescriptor);
     }
   }
+  timeoutHeapRemove(&schedulerState->timeouts, taskDescriptor);
 
   // Protect the relevant memory from deletion below.
   if (assignMemory(commandDescriptor->consoleInput,
@@ -2174,11 +3106,14 @@ int schedulerKillTaskCommandHandler(
       // long timeout.  So, attempt to remove from the queues in that order.
       if (taskQueueRemove(&schedulerState->waiting, taskDescriptor) != 0
       ) {
-        if (taskQueueRemove(&schedulerState->ready, taskDescriptor) != 0
+        if (taskQueueRemove(
+          readyQueueForTask(schedulerState, taskDescriptor), taskDescriptor)
+          != 0
         ) {
           taskQueueRemove(&schedulerState->timedWaiting, taskDescriptor);
         }
       }
+      timeoutHeapRemove(&schedulerState->timeouts, taskDescriptor);
 
       // Tell the console to release the port for us.  We will forward it
       // the message we acquired above, which it will use to send to the
@@ -2222,7 +3157,7 @@ int schedulerKillTaskCommandHandler(
           // However, the scheduler only ever pops anything from the ready
           // queue.  So, push this back onto the ready queue instead of the free
           // queue this time.
-          taskQueuePush(&schedulerState->ready, taskDescriptor);
+          readyQueuePush(schedulerState, taskDescriptor);
         }
       } else {
         // Tell the caller that we've failed.
@@ -2347,6 +3282,103 @@ int schedulerGetTaskInfoCommandHandler(
   return returnValue;
 }
 
+/// @fn int schedulerGetTaskStatsCommandHandler(
+///   SchedulerState *schedulerState, TaskMessage *taskMessage)
+///
+/// @brief Fill in a provided array with the CPU accounting for the
+/// currently-running tasks.
+///
+/// @param schedulerState A pointer to the SchedulerState maintained by the
+///   scheduler task.
+/// @param taskMessage A pointer to the TaskMessage that was received.  This will be
+///   reused for the reply.
+///
+/// @return Returns 0 on success, non-zero error code on failure.
+int schedulerGetTaskStatsCommandHandler(
+  SchedulerState *schedulerState, TaskMessage *taskMessage
+) {
+  int returnValue = 0;
+
+  TaskStatsInfo *taskStatsInfo
+    = nanoOsMessageDataPointer(taskMessage, TaskStatsInfo*);
+  int maxTasks = taskStatsInfo->numTasks;
+  TaskStatsElement *tasks = taskStatsInfo->tasks;
+  int idx = 0;
+#if SCHEDULER_TASK_STATS
+  for (int ii = 1; (ii <= NANO_OS_NUM_TASKS) && (idx < maxTasks); ii++) {
+    TaskDescriptor *taskDescriptor = &schedulerState->allTasks[ii - 1];
+    if (taskRunning(taskDescriptor)) {
+      tasks[idx].pid = (int) taskDescriptor->taskId;
+      tasks[idx].name = taskDescriptor->name;
+      tasks[idx].runTimeMs
+        = (uint32_t) (taskDescriptor->stats.runTime / 1000000);
+      tasks[idx].waitTimeMs
+        = (uint32_t) (taskDescriptor->stats.waitTime / 1000000);
+      tasks[idx].numResumes = taskDescriptor->stats.numResumes;
+      tasks[idx].numYields = taskDescriptor->stats.numYields;
+      tasks[idx].numPreemptions = taskDescriptor->stats.numPreemptions;
+      idx++;
+    }
+  }
+#else
+  (void) schedulerState;
+  (void) maxTasks;
+  (void) tasks;
+#endif // SCHEDULER_TASK_STATS
+
+  // As with the task info, a task may have completed since the array was
+  // allocated.
+  taskStatsInfo->numTasks = idx;
+  taskStatsInfo->timestampMs = (uint32_t) HAL->getElapsedMilliseconds(0);
+
+  taskMessageSetDone(taskMessage);
+
+  // DO NOT release the message since the caller is waiting on the response.
+
+  return returnValue;
+}
+
+/// @fn int schedulerGetIpcStatsCommandHandler(
+///   SchedulerState *schedulerState, TaskMessage *taskMessage)
+///
+/// @brief Fill in a provided array with the IPC statistics for each
+/// destination task and message type seen so far.
+///
+/// @param schedulerState A pointer to the SchedulerState maintained by the
+///   scheduler task.
+/// @param taskMessage A pointer to the TaskMessage that was received.  This will be
+///   reused for the reply.
+///
+/// @return Returns 0 on success, non-zero error code on failure.
+int schedulerGetIpcStatsCommandHandler(
+  SchedulerState *schedulerState, TaskMessage *taskMessage
+) {
+  int returnValue = 0;
+
+  IpcStatsInfo *ipcStatsInfo
+    = nanoOsMessageDataPointer(taskMessage, IpcStatsInfo*);
+  int idx = 0;
+#if NANO_OS_IPC_STATS_NUM_ENTRIES > 0
+  for (int ii = 0; ii < NANO_OS_IPC_STATS_NUM_ENTRIES; ii++) {
+    if (schedulerState->ipcStats.entries[ii].pid != 0) {
+      ipcStatsInfo->entries[idx] = schedulerState->ipcStats.entries[ii];
+      idx++;
+    }
+  }
+  ipcStatsInfo->numDropped = schedulerState->ipcStats.numDropped;
+#else
+  (void) schedulerState;
+  ipcStatsInfo->numDropped = 0;
+#endif // NANO_OS_IPC_STATS_NUM_ENTRIES
+  ipcStatsInfo->numEntries = idx;
+
+  taskMessageSetDone(taskMessage);
+
+  // DO NOT release the message since the caller is waiting on the response.
+
+  return returnValue;
+}
+
 /// @fn int schedulerGetTaskUserCommandHandler(
 ///   SchedulerState *schedulerState, TaskMessage *taskMessage)
 ///
@@ -2415,6 +3447,60 @@ int schedulerSetTaskUserCommandHandler(
   return returnValue;
 }
 
+/// @fn int schedulerSetTaskPriorityCommandHandler(
+///   SchedulerState *schedulerState, TaskMessage *taskMessage)
+///
+/// @brief Set the base priority of a user task.  The task's current priority
+/// is reset to the new base priority.
+///
+/// @param schedulerState A pointer to the SchedulerState maintained by the
+///   scheduler task.
+/// @param taskMessage A pointer to the TaskMessage that was received.  The
+///   data value holds the task ID and the func value holds the priority.
+///   This will be reused for the reply.
+///
+/// @return Returns 0 on success, non-zero error code on failure.
+int schedulerSetTaskPriorityCommandHandler(
+  SchedulerState *schedulerState, TaskMessage *taskMessage
+) {
+  int returnValue = 0;
+  UserId callingUserId
+    = allTasks[taskId(taskMessageFrom(taskMessage)) - 1].userId;
+  TaskId taskId = nanoOsMessageDataValue(taskMessage, TaskId);
+  int priority = nanoOsMessageFuncValue(taskMessage, int);
+  int taskIndex = taskId - 1;
+  NanoOsMessage *nanoOsMessage = (NanoOsMessage*) taskMessageData(taskMessage);
+  nanoOsMessage->data = EINVAL;
+
+  if ((taskId >= NANO_OS_FIRST_USER_TASK_ID)
+    && (taskId <= NANO_OS_NUM_TASKS)
+    && (taskRunning(&allTasks[taskIndex]))
+    && (priority >= 0)
+    && (priority < SCHEDULER_NUM_USER_PRIORITIES)
+  ) {
+    if ((allTasks[taskIndex].userId == callingUserId)
+      || (callingUserId == ROOT_USER_ID)
+    ) {
+      TaskDescriptor *taskDescriptor = &allTasks[taskIndex];
+      taskDescriptor->basePriority = priority;
+      taskDescriptor->priority = priority;
+      if (taskIsReady(schedulerState, taskDescriptor)) {
+        // Move the task to the queue for its new priority.
+        readyQueuePush(schedulerState, taskDescriptor);
+      }
+      nanoOsMessage->data = 0;
+    } else {
+      nanoOsMessage->data = EACCES;
+    }
+  }
+
+  taskMessageSetDone(taskMessage);
+
+  // DO NOT release the message since the caller is waiting on the response.
+
+  return returnValue;
+}
+
 /// @fn int schedulerCloseAllFileDescriptorsCommandHandler(
 ///   SchedulerState *schedulerState, TaskMessage *taskMessage)
 ///
@@ -2564,9 +3650,11 @@ int schedulerExecveCommandHandler(
     if (taskQueueRemove(&schedulerState->timedWaiting, taskDescriptor)
       != 0
     ) {
-      taskQueueRemove(&schedulerState->ready, taskDescriptor);
+      taskQueueRemove(
+        readyQueueForTask(schedulerState, taskDescriptor), taskDescriptor);
     }
   }
+  timeoutHeapRemove(&schedulerState->timeouts, taskDescriptor);
 
   // Kill and clear out the calling task.
   taskTerminate(taskDescriptor);
@@ -2659,7 +3747,7 @@ int schedulerExecveCommandHandler(
   taskResume(taskDescriptor, NULL);
 
   // Put the task on the ready queue.
-  taskQueuePush(&schedulerState->ready, taskDescriptor);
+  readyQueuePush(schedulerState, taskDescriptor);
 
   taskMessageRelease(taskMessage);
 
@@ -2687,6 +3775,10 @@ const SchedulerCommandHandler schedulerCommandHandlers[] = {
   schedulerCloseAllFileDescriptorsCommandHandler,
   schedulerGetHostnameCommandHandler,       // SCHEDULER_GET_HOSTNAME
   schedulerExecveCommandHandler,            // SCHEDULER_EXECVE
+  // SCHEDULER_SET_TASK_PRIORITY:
+  schedulerSetTaskPriorityCommandHandler,
+  schedulerGetTaskStatsCommandHandler,      // SCHEDULER_GET_TASK_STATS
+  schedulerGetIpcStatsCommandHandler,       // SCHEDULER_GET_IPC_STATS
 };
 
 /// @fn void handleSchedulerMessage(SchedulerState *schedulerState)
@@ -2735,50 +3827,128 @@ void handleSchedulerMessage(SchedulerState *schedulerState) {
 
 /// @fn void checkForTimeouts(SchedulerState *schedulerState)
 ///
-/// @brief Check for anything that's timed out on the timedWaiting queue.
+/// @brief Check for anything that's timed out on the timedWaiting queue.  Only
+/// the head of the timeout heap needs to be examined unless it has expired.
 ///
 /// @param schedulerState A pointer to the SchedulerState object maintained by
 ///   the scheduler task.
 ///
 /// @return This function returns no value.
 void checkForTimeouts(SchedulerState *schedulerState) {
-  TaskQueue *timedWaiting = &schedulerState->timedWaiting;
-  uint8_t numElements = timedWaiting->numElements;
+  TimeoutHeap *timeouts = &schedulerState->timeouts;
+  if (timeouts->numElements == 0) {
+    return;
+  }
+
   int64_t now = coroutineGetNanoseconds(NULL);
+  while ((timeouts->numElements > 0)
+    && (now >= timeouts->tasks[0]->timeoutTime)
+  ) {
+    TaskDescriptor *expiredDescriptor = timeouts->tasks[0];
+    timeoutHeapRemove(timeouts, expiredDescriptor);
+    taskQueueRemove(&schedulerState->timedWaiting, expiredDescriptor);
+    readyQueuePush(schedulerState, expiredDescriptor);
+  }
 
-  for (uint8_t ii = 0; ii < numElements; ii++) {
-    TaskDescriptor *poppedDescriptor = taskQueuePop(timedWaiting);
-    Comutex *blockingComutex
-      = poppedDescriptor->taskHandle->blockingComutex;
-    Cocondition *blockingCocondition
-      = poppedDescriptor->taskHandle->blockingCocondition;
+  return;
+}
 
-    if ((blockingComutex != NULL) && (now >= blockingComutex->timeoutTime)) {
-      taskQueuePush(&schedulerState->ready, poppedDescriptor);
-      continue;
-    } else if ((blockingCocondition != NULL)
-      && (now >= blockingCocondition->timeoutTime)
-    ) {
-      taskQueuePush(&schedulerState->ready, poppedDescriptor);
-      continue;
+/// @fn void waitForEvent(SchedulerState *schedulerState)
+///
+/// @brief Sleep until the next timed wait expires or until the HAL reports an
+/// external event if there's nothing for any task to do.  That's the case when
+/// the scheduler's message queue is empty, no user tasks are ready, and the
+/// ready kernel tasks all have empty message queues.  The kernel tasks only do work in
+/// response to messages and serial input, so cycling through them in that
+/// state accomplishes nothing but burning power.
+///
+/// @param schedulerState A pointer to the SchedulerState object maintained by
+///   the scheduler task.
+///
+/// @return This function returns no value.
+void waitForEvent(SchedulerState *schedulerState) {
+  if (msg_q_peek(&schedulerTask->taskHandle->messageQueue) != NULL) {
+    return;
+  }
+
+  if (highestReadyUserPriority(schedulerState) != SCHEDULER_NUM_PRIORITIES) {
+    // A user task is ready to run.
+    return;
+  }
+
+  for (TaskDescriptor *taskDescriptor
+      = schedulerState->ready[SCHEDULER_KERNEL_PRIORITY].head;
+    taskDescriptor != NULL;
+    taskDescriptor = taskDescriptor->next
+  ) {
+    if (msg_q_peek(&taskDescriptor->taskHandle->messageQueue) != NULL) {
+      return;
     }
+  }
 
-    taskQueuePush(timedWaiting, poppedDescriptor);
+  // The head of the timeout heap is the earliest deadline of anything that's
+  // in a timed wait.
+  int64_t timeout = -1;
+  if ((schedulerState->timeouts.numElements > 0)
+    && (schedulerState->timeouts.tasks[0]->timeoutTime != INT64_MAX)
+  ) {
+    timeout = schedulerState->timeouts.tasks[0]->timeoutTime
+      - coroutineGetNanoseconds(NULL);
+    if (timeout <= 0) {
+      // Something's already due.  Let checkForTimeouts handle it.
+      return;
+    }
   }
 
+  HAL->waitForEvent(timeout);
+
   return;
 }
 
 /// @fn void forceYield(void)
 ///
-/// @brief Callback that's invoked when the preemption timer fires.  Wrapper
-///   for taskYield.  Does nothing else.
+/// @brief Callback that's invoked when the preemption timer fires.  Marks the
+///   current task as preempted so that the scheduler will demote it and then
+///   calls taskYield.
 ///
 /// @return This function returns no value.
 void forceYield(void) {
+  if (preemptionDisableDepth > 0) {
+    // The task is in a critical section.  It will yield when it leaves.
+    preemptionPending = true;
+    return;
+  }
+
+  currentTask->preempted = true;
   taskYield();
 }
 
+/// @fn void schedulerDisablePreemption(void)
+///
+/// @brief Keep the preemption timer from forcing the running task to yield
+/// until schedulerEnablePreemption is called.  This makes a short section of
+/// code that doesn't yield on its own atomic with respect to all other tasks
+/// without the cost of a comutex.  Calls may be nested.
+///
+/// @return This function returns no value.
+void schedulerDisablePreemption(void) {
+  preemptionDisableDepth++;
+}
+
+/// @fn void schedulerEnablePreemption(void)
+///
+/// @brief Undo one call to schedulerDisablePreemption.  If the preemption timer
+/// fired while preemption was disabled, the running task yields now.
+///
+/// @return This function returns no value.
+void schedulerEnablePreemption(void) {
+  preemptionDisableDepth--;
+  if ((preemptionDisableDepth == 0) && (preemptionPending)) {
+    preemptionPending = false;
+    forceYield();
+  }
+}
+
 void removeTask(SchedulerState *schedulerState, TaskDescriptor *taskDescriptor,
   const char *errorMessage
 ) {
@@ -3012,6 +4182,29 @@ int schedulerRunOverlayCommand(
 ////   NULL,
 //// };
 
+/// @fn static inline TraceEventType traceYieldReason(
+///   TaskDescriptor *taskDescriptor)
+///
+/// @brief Determine why a task that was just resumed gave control back to the
+/// scheduler.  Must be called before the task's preempted flag is cleared.
+///
+/// @param taskDescriptor A pointer to the TaskDescriptor of the task.
+///
+/// @return Returns the TraceEventType that describes how the task stopped.
+static inline TraceEventType traceYieldReason(TaskDescriptor *taskDescriptor) {
+  if (taskRunning(taskDescriptor) == false) {
+    return TRACE_TASK_EXIT;
+  } else if (taskDescriptor->preempted) {
+    return TRACE_TASK_PREEMPT;
+  } else if (taskDescriptor->taskHandle->blockingComutex != NULL) {
+    return TRACE_TASK_BLOCK_COMUTEX;
+  } else if (taskDescriptor->taskHandle->blockingCocondition != NULL) {
+    return TRACE_TASK_BLOCK_COCONDITION;
+  }
+
+  return TRACE_TASK_YIELD;
+}
+
 /// @fn void runScheduler(SchedulerState *schedulerState)
 ///
 /// @brief Run one (1) iteration of the main scheduler loop.
@@ -3021,8 +4214,11 @@ int schedulerRunOverlayCommand(
 ///
 /// @return This function returns no value.
 void runScheduler(SchedulerState *schedulerState) {
-  TaskDescriptor *taskDescriptor
-    = taskQueuePop(&schedulerState->ready);
+  // Wake anything whose message was marked done while the task that last ran
+  // held the shared done lock.
+  msg_done_flush();
+
+  TaskDescriptor *taskDescriptor = readyQueuePop(schedulerState);
 
   if (coroutineCorrupted(taskDescriptor->taskHandle)) {
     removeTask(schedulerState, taskDescriptor, "Task corruption detected");
@@ -3044,7 +4240,34 @@ void runScheduler(SchedulerState *schedulerState) {
     HAL->configOneShotTimer(
       schedulerState->preemptionTimer, 10000000, forceYield);
   }
+#if SCHEDULER_TASK_STATS || (SCHEDULER_TRACE_NUM_EVENTS > 0)
+  // The timestamps are only needed for accounting and tracing, so boards
+  // without either don't pay for reading the clock twice per resume.
+  int64_t runStartTime = HAL->getElapsedNanoseconds(0);
+#endif // SCHEDULER_TASK_STATS || SCHEDULER_TRACE_NUM_EVENTS
+#if SCHEDULER_TASK_STATS
+  taskDescriptor->stats.waitTime += runStartTime - taskDescriptor->readyTime;
+#endif // SCHEDULER_TASK_STATS
+  schedulerTraceAt(runStartTime,
+    TRACE_TASK_RESUME, taskDescriptor->taskId, 0, 0);
   taskResume(taskDescriptor, NULL);
+#if SCHEDULER_TASK_STATS || (SCHEDULER_TRACE_NUM_EVENTS > 0)
+  int64_t runEndTime = HAL->getElapsedNanoseconds(0);
+#endif // SCHEDULER_TASK_STATS || SCHEDULER_TRACE_NUM_EVENTS
+#if SCHEDULER_TASK_STATS
+  taskDescriptor->stats.runTime += runEndTime - runStartTime;
+  taskDescriptor->stats.numResumes++;
+  if (taskDescriptor->preempted) {
+    taskDescriptor->stats.numPreemptions++;
+  } else {
+    taskDescriptor->stats.numYields++;
+  }
+#endif // SCHEDULER_TASK_STATS
+  schedulerTraceAt(runEndTime, traceYieldReason(taskDescriptor),
+    taskDescriptor->taskId, 0, 0);
+  if (taskDescriptor->taskId >= NANO_OS_FIRST_USER_TASK_ID) {
+    updateTaskPriority(taskDescriptor);
+  }
 
   if (taskRunning(taskDescriptor) == false) {
     schedulerSendNanoOsMessageToPid(schedulerState,
@@ -3063,7 +4286,7 @@ void runScheduler(SchedulerState *schedulerState) {
     ) {
       // We're not done initializing yet.  Put the task back on the ready
       // queue and try again later.
-      taskQueuePush(&schedulerState->ready, taskDescriptor);
+      readyQueuePush(schedulerState, taskDescriptor);
       return;
     }
 
@@ -3090,6 +4313,13 @@ void runScheduler(SchedulerState *schedulerState) {
       = (FileDescriptor*) standardUserFileDescriptors;
     taskDescriptor->name
       = shellNames[taskDescriptor->taskId - NANO_OS_FIRST_SHELL_PID];
+    taskDescriptor->priority = 0;
+    taskDescriptor->basePriority = 0;
+    taskDescriptor->preempted = false;
+#if SCHEDULER_TASK_STATS
+    memset(&taskDescriptor->stats, 0, sizeof(taskDescriptor->stats));
+#endif // SCHEDULER_TASK_STATS
+    schedulerTrace(TRACE_TASK_CREATE, taskDescriptor->taskId, 0, 0);
     if (taskCreate(taskDescriptor, runShell, schedulerState->hostname
       ) == taskError
     ) {
@@ -3108,14 +4338,28 @@ void runScheduler(SchedulerState *schedulerState) {
     == COROUTINE_STATE_TIMEDWAIT
   ) {
     taskQueuePush(&schedulerState->timedWaiting, taskDescriptor);
+    Comutex *blockingComutex
+      = taskDescriptor->taskHandle->blockingComutex;
+    Cocondition *blockingCocondition
+      = taskDescriptor->taskHandle->blockingCocondition;
+    if (blockingComutex != NULL) {
+      taskDescriptor->timeoutTime = blockingComutex->timeoutTime;
+    } else if (blockingCocondition != NULL) {
+      taskDescriptor->timeoutTime = blockingCocondition->timeoutTime;
+    } else {
+      // Nothing to time out on.  The task will stay put until it's signalled.
+      taskDescriptor->timeoutTime = INT64_MAX;
+    }
+    timeoutHeapPush(&schedulerState->timeouts, taskDescriptor);
   } else if (taskFinished(taskDescriptor)) {
     taskQueuePush(&schedulerState->free, taskDescriptor);
   } else { // Task is still running.
-    taskQueuePush(&schedulerState->ready, taskDescriptor);
+    readyQueuePush(schedulerState, taskDescriptor);
   }
 
   checkForTimeouts(schedulerState);
   handleSchedulerMessage(schedulerState);
+  waitForEvent(schedulerState);
 
   return;
 }
@@ -3133,7 +4377,9 @@ __attribute__((noinline)) void startScheduler(
   // Initialize the scheduler's state.
   SchedulerState schedulerState = {0};
   schedulerState.hostname = NULL;
-  schedulerState.ready.name = "ready";
+  for (int ii = 0; ii < SCHEDULER_NUM_PRIORITIES; ii++) {
+    schedulerState.ready[ii].name = "ready";
+  }
   schedulerState.waiting.name = "waiting";
   schedulerState.timedWaiting.name = "timed waiting";
   schedulerState.free.name = "free";
@@ -3146,13 +4392,13 @@ __attribute__((noinline)) void startScheduler(
 
   // Initialize the static TaskMessage storage.
   TaskMessage messagesStorage[NANO_OS_NUM_MESSAGES] = {0};
-  extern TaskMessage *messages;
   messages = messagesStorage;
 
   // Initialize the static NanoOsMessage storage.
   NanoOsMessage nanoOsMessagesStorage[NANO_OS_NUM_MESSAGES] = {0};
   extern NanoOsMessage *nanoOsMessages;
   nanoOsMessages = nanoOsMessagesStorage;
+  initializeMessagePool();
   printDebugString("Allocated messages storage.\n");
 
   // Initialize the allTasks pointer.  The tasks are all zeroed because
@@ -3170,6 +4416,13 @@ __attribute__((noinline)) void startScheduler(
 
   // We are not officially running the first task, so make it current.
   currentTask = schedulerTask;
+#if SCHEDULER_TRACE_NUM_EVENTS > 0
+  traceBuffer = &schedulerState.trace;
+#endif // SCHEDULER_TRACE_NUM_EVENTS
+#if NANO_OS_IPC_STATS_NUM_ENTRIES > 0
+  memset(ipcPopEntry, -1, sizeof(ipcPopEntry));
+  ipcStats = &schedulerState.ipcStats;
+#endif // NANO_OS_IPC_STATS_NUM_ENTRIES
   printDebugString("Configured scheduler task.\n");
 
   // Initialize all the kernel task file descriptors.
@@ -3333,13 +4586,13 @@ __attribute__((noinline)) void startScheduler(
   }
   printDebugString("Set shells for ports.\n");
 
-  taskQueuePush(&schedulerState.ready,
+  readyQueuePush(&schedulerState,
     &allTasks[NANO_OS_MEMORY_MANAGER_TASK_ID - 1]);
-  taskQueuePush(&schedulerState.ready,
+  readyQueuePush(&schedulerState,
     &allTasks[NANO_OS_FILESYSTEM_TASK_ID - 1]);
-  taskQueuePush(&schedulerState.ready,
+  readyQueuePush(&schedulerState,
     &allTasks[NANO_OS_SD_CARD_TASK_ID - 1]);
-  taskQueuePush(&schedulerState.ready,
+  readyQueuePush(&schedulerState,
     &allTasks[NANO_OS_CONSOLE_TASK_ID - 1]);
   // The scheduler will take care of cleaning up the dummy tasks in the
   // ready queue.
@@ -3347,7 +4600,7 @@ __attribute__((noinline)) void startScheduler(
     ii <= NANO_OS_NUM_TASKS;
     ii++
   ) {
-    taskQueuePush(&schedulerState.ready, &allTasks[ii - 1]);
+    readyQueuePush(&schedulerState, &allTasks[ii - 1]);
   }
   printDebugString("Populated ready queue.\n");
 
@@ -37,6 +37,7 @@
 #define SCHEDULER_H
 
 // Custom includes
+#include "NanoOsStats.h"
 #include "NanoOsTypes.h"
 
 #ifdef __cplusplus
@@ -67,6 +68,9 @@ typedef enum SchedulerCommandResponse {
   SCHEDULER_CLOSE_ALL_FILE_DESCRIPTORS,
   SCHEDULER_GET_HOSTNAME,
   SCHEDULER_EXECVE,
+  SCHEDULER_SET_TASK_PRIORITY,
+  SCHEDULER_GET_TASK_STATS,
+  SCHEDULER_GET_IPC_STATS,
   NUM_SCHEDULER_COMMANDS,
   // Responses:
   SCHEDULER_TASK_COMPLETE,
@@ -79,6 +83,8 @@ int schedulerNotifyTaskComplete(TaskId taskId);
 int schedulerWaitForTaskComplete(void);
 TaskId schedulerGetNumRunningTasks(struct timespec *timeout);
 TaskInfo* schedulerGetTaskInfo(void);
+TaskStatsInfo* schedulerGetTaskStats(void);
+IpcStatsInfo* schedulerGetIpcStats(void);
 int schedulerKillTask(TaskId taskId);
 int schedulerRunTask(
   const CommandEntry *commandEntry, char *consoleInput, int consolePort);
@@ -89,6 +95,18 @@ int schedulerCloseAllFileDescriptors(void);
 const char* schedulerGetHostname(void);
 int schedulerExecve(const char *pathname,
   char *const argv[], char *const envp[]);
+int schedulerSetTaskPriority(TaskId taskId, int priority);
+void schedulerDisablePreemption(void);
+void schedulerEnablePreemption(void);
+void schedulerMessageDone(TaskMessage *taskMessage);
+
+#if NANO_OS_IPC_STATS_NUM_ENTRIES > 0
+void schedulerRecordIpcEvent(
+  TaskMessage *taskMessage, msg_q_t *queue, msg_event_t event);
+#else
+#define schedulerRecordIpcEvent(taskMessage, queue, event) \
+  ((void) (taskMessage), (void) (queue), (void) (event))
+#endif // NANO_OS_IPC_STATS_NUM_ENTRIES
 
 // Coroutine setup functions used in the loader.
 void coroutineYieldCallback(void *stateData, Coroutine *coroutine);
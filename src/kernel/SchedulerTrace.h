@@ -0,0 +1,166 @@
+///////////////////////////////////////////////////////////////////////////////
+///
+/// @author            James Card
+/// @date              10.15.2026
+///
+/// @file              SchedulerTrace.h
+///
+/// @brief             Definitions for the scheduler's event trace.
+///
+/// @copyright
+///                   Copyright (c) 2012-2025 James Card
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a
+/// copy of this software and associated documentation files (the "Software"),
+/// to deal in the Software without restriction, including without limitation
+/// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+/// and/or sell copies of the Software, and to permit persons to whom the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included
+/// in all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+/// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+/// DEALINGS IN THE SOFTWARE.
+///
+///                                James Card
+///                         http://www.jamescard.org
+///
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef SCHEDULER_TRACE_H
+#define SCHEDULER_TRACE_H
+
+// This file is also used by the host-side trace decoder, so it must not
+// depend on anything other than the standard integer types.
+#include "stdint.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/// @def SCHEDULER_TRACE_NUM_EVENTS
+///
+/// @brief The number of events held in the scheduler's trace ring buffer.
+/// Must be a power of two.  0 disables tracing entirely.  Only builds that run
+/// as an application within another OS have the memory to spare by default.
+#ifndef SCHEDULER_TRACE_NUM_EVENTS
+#if defined(__linux__) || defined(__linux) || defined(_WIN32)
+#define SCHEDULER_TRACE_NUM_EVENTS 4096
+#else
+#define SCHEDULER_TRACE_NUM_EVENTS 0
+#endif
+#endif // SCHEDULER_TRACE_NUM_EVENTS
+
+#if (SCHEDULER_TRACE_NUM_EVENTS & (SCHEDULER_TRACE_NUM_EVENTS - 1)) != 0
+#error "SCHEDULER_TRACE_NUM_EVENTS must be a power of two"
+#endif
+
+/// @enum TraceEventType
+///
+/// @brief The kinds of events recorded in the scheduler's trace.
+typedef enum TraceEventType {
+  TRACE_TASK_RESUME,            ///< The scheduler resumed the task.
+  TRACE_TASK_YIELD,             ///< The task yielded voluntarily.
+  TRACE_TASK_PREEMPT,           ///< The preemption timer forced a yield.
+  TRACE_TASK_BLOCK_COMUTEX,     ///< The task blocked on a Comutex.
+  TRACE_TASK_BLOCK_COCONDITION, ///< The task blocked on a Cocondition.
+  TRACE_MESSAGE_PUSH,           ///< The task pushed a message to peerId.
+  TRACE_MESSAGE_POP,            ///< The task popped a message from its queue.
+  TRACE_TASK_CREATE,            ///< The scheduler started the task.
+  TRACE_TASK_EXIT,              ///< The task ran to completion.
+  NUM_TRACE_EVENT_TYPES
+} TraceEventType;
+
+/// @struct TraceEvent
+///
+/// @brief A single event in the scheduler's trace.
+///
+/// @param timestamp The time, in nanoseconds, when the event occurred.
+/// @param arg The message type for message events, 0 otherwise.
+/// @param taskId The ID of the task the event is about.
+/// @param peerId The ID of the destination task for TRACE_MESSAGE_PUSH events,
+///   0 otherwise.
+/// @param type The TraceEventType of the event.
+typedef struct TraceEvent {
+  int64_t  timestamp;
+  uint16_t arg;
+  uint8_t  taskId;
+  uint8_t  peerId;
+  uint8_t  type;
+} TraceEvent;
+
+/// @struct TraceBuffer
+///
+/// @brief Ring buffer of the most recent scheduler events.
+///
+/// @param events The storage for the events.
+/// @param numEvents The total number of events ever recorded.  The next event
+///   is written at numEvents modulo SCHEDULER_TRACE_NUM_EVENTS.
+typedef struct TraceBuffer {
+#if SCHEDULER_TRACE_NUM_EVENTS > 0
+  TraceEvent events[SCHEDULER_TRACE_NUM_EVENTS];
+#endif // SCHEDULER_TRACE_NUM_EVENTS
+  uint32_t numEvents;
+} TraceBuffer;
+
+/// @def TRACE_FILE_MAGIC
+///
+/// @brief The first eight bytes of a trace file.
+#define TRACE_FILE_MAGIC "NOSTRACE"
+
+/// @def TRACE_FILE_VERSION
+///
+/// @brief The version of the trace file layout described below.
+#define TRACE_FILE_VERSION 1
+
+/// @def TRACE_TASK_NAME_LENGTH
+///
+/// @brief The number of bytes reserved for each task name in a trace file,
+/// including the NULL terminator.
+#define TRACE_TASK_NAME_LENGTH 16
+
+/// @struct TraceFileHeader
+///
+/// @brief The header of a trace file.  It is followed by numTasks
+/// TraceTaskName records and then numEvents TraceEvents in chronological
+/// order.  Trace files are only meant to be read on the host that wrote them,
+/// so everything is in native byte order and layout.
+///
+/// @param magic TRACE_FILE_MAGIC, without a NULL terminator.
+/// @param version TRACE_FILE_VERSION.
+/// @param numTasks The number of TraceTaskName records that follow.
+/// @param numEvents The number of TraceEvents that follow the names.
+/// @param numDropped The number of events that were overwritten before the
+///   trace was written.
+typedef struct TraceFileHeader {
+  char     magic[8];
+  uint32_t version;
+  uint32_t numTasks;
+  uint32_t numEvents;
+  uint32_t numDropped;
+} TraceFileHeader;
+
+/// @struct TraceTaskName
+///
+/// @brief The name of a task at the time a trace file was written.
+///
+/// @param taskId The ID of the task.
+/// @param name The NULL-terminated name of the task.
+typedef struct TraceTaskName {
+  uint8_t taskId;
+  char    name[TRACE_TASK_NAME_LENGTH];
+} TraceTaskName;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCHEDULER_TRACE_H
+
@@ -51,6 +51,37 @@ TaskMessage *messages = NULL;
 /// scheduler function's stack.
 NanoOsMessage *nanoOsMessages = NULL;
 
+#if NANO_OS_NUM_MESSAGES > 32
+#error "NANO_OS_NUM_MESSAGES must fit in the freeMessages bitmap"
+#endif
+
+/// @def MESSAGE_POOL_RECHECK_NS
+///
+/// @brief The longest time, in nanoseconds, that a task waiting for a free
+/// message sleeps before it checks the pool again on its own.  A message can
+/// be released while a waiter holds messagePoolLock but isn't on the condition
+/// yet.  The release can't block on the lock because the scheduler releases
+/// messages, so the waiter has to be able to find the message without being
+/// signalled.
+#define MESSAGE_POOL_RECHECK_NS 10000000
+
+/// @var freeMessages
+///
+/// @brief Bitmap of the entries in the messages array that are available for
+/// use.  Bit N is set when messages[N] is free.  Only updated with preemption
+/// disabled because both the scheduler and preemptible tasks update it.
+static uint32_t freeMessages = 0;
+
+/// @var messagePoolLock
+///
+/// @brief The mutex that guards messageAvailable.
+static Comutex messagePoolLock;
+
+/// @var messageAvailable
+///
+/// @brief The condition that tasks waiting for a free message block on.
+static Cocondition messageAvailable;
+
 /// @fn ExecArgs* execArgsDestroy(ExecArgs *execArgs)
 ///
 /// @brief Free all of an ExecArgs structure.
@@ -64,17 +95,17 @@ ExecArgs* execArgsDestroy(ExecArgs *execArgs) {
   char **argv = execArgs->argv;
   // argv *SHOULD* never be NULL, but check just in case.
   if (argv != NULL) {
-    for (int ii = 0; argv[ii] != NULL; ii++) {
-      free(argv[ii]);
-    }
+    int argc = 0;
+    for (; argv[argc] != NULL; argc++);
+    memoryManagerFreeArray((void**) argv, argc);
     free(argv);
   }
 
   char **envp = execArgs->envp;
   if (envp != NULL) {
-    for (int ii = 0; envp[ii] != NULL; ii++) {
-      free(envp[ii]);
-    }
+    int envc = 0;
+    for (; envp[envc] != NULL; envc++);
+    memoryManagerFreeArray((void**) envp, envc);
     free(envp);
   }
 
@@ -425,6 +456,64 @@ int sendTaskMessageToPid(unsigned int pid, TaskMessage *taskMessage) {
   return sendTaskMessageToTask(taskDescriptor, taskMessage);
 }
 
+/// @fn void messageEventCallback(
+///   msg_t *msg, msg_q_t *queue, msg_event_t event)
+///
+/// @brief Callback that's invoked by the messages library at each event in a
+/// message's life.  Whenever a message stops being in use, marks the message
+/// free if it's one of ours and wakes a task that's waiting for a free
+/// message, if any.  A message that's marked done hands the CPU to its sender.
+/// All events are passed on to the scheduler's IPC statistics.
+///
+/// @param msg A pointer to the message the event is about.
+/// @param queue The queue the message was pushed onto or popped from, NULL for
+///   other events.
+/// @param event The msg_event_t that occurred.
+///
+/// @return This function returns no value.
+static void messageEventCallback(
+  msg_t *msg, msg_q_t *queue, msg_event_t event
+) {
+  schedulerRecordIpcEvent(msg, queue, event);
+  if (event == MSG_EVENT_DONE) {
+    schedulerMessageDone(msg);
+  }
+
+  if ((event != MSG_EVENT_RELEASE)
+    || (msg < messages) || (msg >= &messages[NANO_OS_NUM_MESSAGES])
+  ) {
+    // Not a release of one of the messages in the pool.
+    return;
+  }
+
+  schedulerDisablePreemption();
+  freeMessages |= ((uint32_t) 1) << (msg - messages);
+  schedulerEnablePreemption();
+
+  // Signal under the lock when we can get it so that a waiter that's about to
+  // wait can't miss the signal.  If we can't get it, the waiter will recheck
+  // the pool on its own within MESSAGE_POOL_RECHECK_NS.
+  bool locked = (comutexTryLock(&messagePoolLock) == coroutineSuccess);
+  coconditionSignal(&messageAvailable);
+  if (locked) {
+    comutexUnlock(&messagePoolLock);
+  }
+}
+
+/// @fn void initializeMessagePool(void)
+///
+/// @brief Mark all the entries in the messages array as free and initialize the
+/// mechanism to wait for one.  Must be called by the scheduler after the
+/// messages and nanoOsMessages arrays have been set.
+///
+/// @return This function returns no value.
+void initializeMessagePool(void) {
+  freeMessages = (uint32_t) ((((uint64_t) 1) << NANO_OS_NUM_MESSAGES) - 1);
+  comutexInit(&messagePoolLock, comutexPlain);
+  coconditionInit(&messageAvailable);
+  msg_set_event_callback(messageEventCallback);
+}
+
 /// TaskMessage* getAvailableMessage(void)
 ///
 /// @brief Get a message from the messages array that is not in use.
@@ -433,14 +522,64 @@ int sendTaskMessageToPid(unsigned int pid, TaskMessage *taskMessage) {
 /// was no available message in the array.
 TaskMessage* getAvailableMessage(void) {
   TaskMessage *availableMessage = NULL;
-
-  for (int ii = 0; ii < NANO_OS_NUM_MESSAGES; ii++) {
+  int ii = 0;
+
+  // Claiming a bit is a read-modify-write that a release in another task must
+  // not interleave with.
+  schedulerDisablePreemption();
+  while (freeMessages != 0) {
+    ii = __builtin_ffsl((long) freeMessages) - 1;
+    freeMessages &= ~(((uint32_t) 1) << ii);
     if (msg_in_use(&messages[ii]) == false) {
       availableMessage = &messages[ii];
-      taskMessageInit(availableMessage, 0,
-        &nanoOsMessages[ii], sizeof(nanoOsMessages[ii]), false);
       break;
     }
+    // Else the message was put back into use without going through us.  Its
+    // bit will be set again when it's released.
+  }
+  schedulerEnablePreemption();
+
+  if (availableMessage != NULL) {
+    taskMessageInit(availableMessage, 0,
+      &nanoOsMessages[ii], sizeof(nanoOsMessages[ii]), false);
+  }
+
+  return availableMessage;
+}
+
+/// @fn TaskMessage* waitForAvailableMessage(void)
+///
+/// @brief Get a message from the messages array that is not in use, blocking
+/// until one is released if none are available.  Must not be called by the
+/// scheduler, which can't block.
+///
+/// @return Returns a pointer to the available message on success, NULL if the
+/// wait failed.
+TaskMessage* waitForAvailableMessage(void) {
+  TaskMessage *availableMessage = getAvailableMessage();
+  if (availableMessage != NULL) {
+    return availableMessage;
+  }
+
+  comutexLock(&messagePoolLock);
+  while ((availableMessage = getAvailableMessage()) == NULL) {
+    struct timespec recheckTime = {0};
+    timespec_get(&recheckTime, TIME_UTC);
+    recheckTime.tv_nsec += MESSAGE_POOL_RECHECK_NS;
+    int waitStatus = coconditionTimedWait(
+      &messageAvailable, &messagePoolLock, &recheckTime);
+    if ((waitStatus != coroutineSuccess)
+      && (waitStatus != coroutineTimedout)
+    ) {
+      break;
+    }
+  }
+  comutexUnlock(&messagePoolLock);
+
+  if (availableMessage != NULL) {
+    // There may be more free messages than the one we just took.  Let the next
+    // waiter check.
+    coconditionSignal(&messageAvailable);
   }
 
   return availableMessage;
@@ -486,10 +625,9 @@ TaskMessage* sendNanoOsMessageToTask(
     return taskMessage; // NULL
   }
 
-  taskMessage = getAvailableMessage();
-  while (taskMessage == NULL) {
-    taskYield();
-    taskMessage = getAvailableMessage();
+  taskMessage = waitForAvailableMessage();
+  if (taskMessage == NULL) {
+    return taskMessage; // NULL
   }
 
   NanoOsMessage *nanoOsMessage
@@ -553,6 +691,81 @@ TaskMessage* sendNanoOsMessageToPid(int pid, int type,
   return taskMessage;
 }
 
+/// @fn int sendNanoOsMessagesToPid(int pid, int type,
+///   NanoOsMessageData func, const NanoOsMessageData *data, int numMessages)
+///
+/// @brief Send a batch of NanoOsMessages that the sender will not wait on to
+/// another task identified by its PID.  The messages are pushed onto the
+/// destination task's queue as few times as the message pool allows, so the
+/// destination is woken once per batch instead of once per message.
+///
+/// @param pid The task ID of the destination task.
+/// @param type The type of all the messages to send to the destination task.
+/// @param func The function information to send in every message, cast to a
+///   NanoOsMessageData.
+/// @param data The array of data values to send, one per message.
+/// @param numMessages The number of elements in the data array.
+///
+/// @return Returns the number of messages sent, which is numMessages on
+/// success and less than that on failure.
+int sendNanoOsMessagesToPid(int pid, int type,
+  NanoOsMessageData func, const NanoOsMessageData *data, int numMessages
+) {
+  int numSent = 0;
+  TaskDescriptor *taskDescriptor = NULL;
+  if ((pid < NANO_OS_NUM_TASKS) && (data != NULL)) {
+    taskDescriptor = schedulerGetTaskByPid(pid);
+  }
+  if ((taskDescriptor == NULL) || (!taskRunning(taskDescriptor))) {
+    printString("ERROR: Could not send NanoOs messages to task ");
+    printInt(pid);
+    printString("\n");
+    return numSent; // 0
+  }
+
+  TaskMessage *batch[NANO_OS_NUM_MESSAGES];
+  while (numSent < numMessages) {
+    // Block for the first message of the batch, then take whatever else is
+    // free without waiting.  The batch can't be bigger than the pool.
+    int numRemaining = numMessages - numSent;
+    int batchSize = 0;
+    TaskMessage *taskMessage = waitForAvailableMessage();
+    while (taskMessage != NULL) {
+      NanoOsMessage *nanoOsMessage
+        = (NanoOsMessage*) taskMessageData(taskMessage);
+      nanoOsMessage->func = func;
+      nanoOsMessage->data = data[numSent + batchSize];
+      taskMessageInit(taskMessage, type,
+        nanoOsMessage, sizeof(*nanoOsMessage), false);
+      batch[batchSize] = taskMessage;
+      batchSize++;
+
+      taskMessage = NULL;
+      if (batchSize < numRemaining) {
+        taskMessage = getAvailableMessage();
+      }
+    }
+    if (batchSize == 0) {
+      break;
+    }
+
+    if (taskMessageQueuePushBatch(taskDescriptor, batch, batchSize)
+      != coroutineSuccess
+    ) {
+      for (int ii = 0; ii < batchSize; ii++) {
+        taskMessageRelease(batch[ii]);
+      }
+      printString("ERROR: Could not push NanoOs messages to task ");
+      printInt(pid);
+      printString("\n");
+      break;
+    }
+    numSent += batchSize;
+  }
+
+  return numSent;
+}
+
 /// @fn void* waitForDataMessage(
 ///   TaskMessage *sent, int type, const struct timespec *ts)
 ///
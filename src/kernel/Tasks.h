@@ -139,26 +139,82 @@ extern "C"
 #define taskMessageWaitForReplyWithType(sent, releaseAfterDone, type, ts) \
   msg_wait_for_reply_with_type(sent, releaseAfterDone, type, ts)
 
+// Defined in Scheduler.c.
+int schedulerMessageQueuePush(
+  TaskDescriptor *taskDescriptor, TaskMessage *taskMessage);
+
+/// @def taskMessageQueuePush
+///
+/// @brief Function macro to push a task message on to a task's message
+/// queue.  Pushing a message the sender will wait on hands the CPU to the
+/// destination task.
+#define taskMessageQueuePush(taskDescriptor, message) \
+  schedulerMessageQueuePush(taskDescriptor, message)
+
+// Defined in Scheduler.c.
+int schedulerMessageQueuePushBatch(TaskDescriptor *taskDescriptor,
+  TaskMessage **taskMessages, int numMessages);
+int schedulerMessageQueuePopBatch(
+  TaskMessage **taskMessages, int maxMessages);
+
+/// @def taskMessageQueuePushBatch
+///
+/// @brief Function macro to push an array of task messages on to a task's
+/// message queue with a single wakeup of the destination task.
+#define taskMessageQueuePushBatch(taskDescriptor, messages, numMessages) \
+  schedulerMessageQueuePushBatch(taskDescriptor, messages, numMessages)
+
+/// @def taskMessageQueuePopBatch
+///
+/// @brief Function macro to pop up to maxMessages task messages from the
+/// running task's message queue at once.
+#define taskMessageQueuePopBatch(messages, maxMessages) \
+  schedulerMessageQueuePopBatch(messages, maxMessages)
+
+#if SCHEDULER_TRACE_NUM_EVENTS > 0
+
+// Scheduler trace hooks.  Defined in Scheduler.c.
+void schedulerTrace(
+  TraceEventType type, TaskId taskId, TaskId peerId, int64_t arg);
+TaskMessage* schedulerTraceMessagePop(TaskMessage *taskMessage);
+const TraceBuffer* schedulerGetTrace(void);
+
 /// @def taskMessageQueueWaitForType
 ///
 /// @brief Function macro to wait for a message of a specific type to be pushed
 /// onto the running task's message queue.
 #define taskMessageQueueWaitForType(type, ts) \
-  comessageQueueWaitForType(type, ts)
+  schedulerTraceMessagePop(comessageQueueWaitForType(type, ts))
 
 /// @def taskMessageQueueWait
 ///
 /// @brief Function macro to wait for a message to be pushed onto the running
 /// task's message queue.
 #define taskMessageQueueWait(ts) \
-  comessageQueueWait(ts)
+  schedulerTraceMessagePop(comessageQueueWait(ts))
 
-/// @def taskMessageQueuePush
+/// @def taskMessageQueuePop
 ///
-/// @brief Function macro to push a task message on to a task's message
-/// queue.
-#define taskMessageQueuePush(taskDescriptor, message) \
-  comessageQueuePush((taskDescriptor)->taskHandle, message)
+/// @brief Function macro to pop a task message from the running task's
+/// message queue.
+#define taskMessageQueuePop() \
+  schedulerTraceMessagePop(comessageQueuePop())
+
+#else // SCHEDULER_TRACE_NUM_EVENTS == 0
+
+/// @def taskMessageQueueWaitForType
+///
+/// @brief Function macro to wait for a message of a specific type to be pushed
+/// onto the running task's message queue.
+#define taskMessageQueueWaitForType(type, ts) \
+  comessageQueueWaitForType(type, ts)
+
+/// @def taskMessageQueueWait
+///
+/// @brief Function macro to wait for a message to be pushed onto the running
+/// task's message queue.
+#define taskMessageQueueWait(ts) \
+  comessageQueueWait(ts)
 
 /// @def taskMessageQueuePop
 ///
@@ -167,6 +223,8 @@ extern "C"
 #define taskMessageQueuePop() \
   comessageQueuePop()
 
+#endif // SCHEDULER_TRACE_NUM_EVENTS
+
 /// @def getRunningTaskId
 ///
 /// @brief Get the task ID for the currently-running task.
@@ -239,9 +297,18 @@ void* execCommand(void *args);
 int sendTaskMessageToTask(
   TaskDescriptor *taskDescriptor, TaskMessage *taskMessage);
 int sendTaskMessageToPid(unsigned int pid, TaskMessage *taskMessage);
+void initializeMessagePool(void);
 TaskMessage* getAvailableMessage(void);
+TaskMessage* waitForAvailableMessage(void);
+
+// Pool of NANO_OS_NUM_MESSAGES task messages defined in Tasks.c.  The storage
+// lives on the scheduler's stack.
+extern TaskMessage *messages;
+
 TaskMessage* sendNanoOsMessageToPid(int pid, int type,
   NanoOsMessageData func, NanoOsMessageData data, bool waiting);
+int sendNanoOsMessagesToPid(int pid, int type,
+  NanoOsMessageData func, const NanoOsMessageData *data, int numMessages);
 void* waitForDataMessage(TaskMessage *sent, int type, const struct timespec *ts);
 ExecArgs* execArgsDestroy(ExecArgs *execArgs);
 
@@ -148,5 +148,9 @@ NanoOsApi nanoOsApi = {
   
   // NanoOs-specific functionality
   .callOverlayFunction = NULL,
+  .getTaskStats = schedulerGetTaskStats,
+  .getIpcStats = schedulerGetIpcStats,
+  .fposix_fallocate = filesystemFAllocate,
+  .getBlockCacheStats = filesystemGetBlockCacheStats,
 };
 
@@ -54,6 +54,7 @@ typedef struct NanoOsFile NanoOsFile;
 #define FILE NanoOsFile
 
 #include "NanoOsSys.h"
+#include "../kernel/NanoOsStats.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -147,6 +148,10 @@ typedef struct NanoOsApi {
   
   // NanoOs-specific functionality
   void* (*callOverlayFunction)(void*);
+  TaskStatsInfo* (*getTaskStats)(void);
+  IpcStatsInfo* (*getIpcStats)(void);
+  int (*fposix_fallocate)(FILE *stream, long offset, long length);
+  int (*getBlockCacheStats)(BlockCacheStatsInfo *blockCacheStatsInfo);
 } NanoOsApi;
 
 extern NanoOsApi nanoOsApi;
@@ -51,6 +51,13 @@ extern "C"
 /// implementation.
 extern NanoOsOverlayMap overlayMap;
 
+#define getTaskStats() \
+  overlayMap.header.osApi->getTaskStats()
+#define getIpcStats() \
+  overlayMap.header.osApi->getIpcStats()
+#define getBlockCacheStats(blockCacheStatsInfo) \
+  overlayMap.header.osApi->getBlockCacheStats(blockCacheStatsInfo)
+
 #ifdef __cplusplus
 }
 #endif
@@ -58,6 +58,9 @@
   overlayMap.header.osApi->fseek(stream, offset, whence)
 #define fileno(stream) \
   overlayMap.header.osApi->fileno(stream)
+// posix_fallocate semantics, but on a FILE instead of a file descriptor.
+#define fposix_fallocate(stream, offset, length) \
+  overlayMap.header.osApi->fposix_fallocate(stream, offset, length)
 
 // Formatted I/O:
 #define vsscanf(buffer, format, args) \
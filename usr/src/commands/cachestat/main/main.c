@@ -0,0 +1,90 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                     Copyright (c) 2012-2025 James Card                     //
+//                                                                            //
+// Permission is hereby granted, free of charge, to any person obtaining a    //
+// copy of this software and associated documentation files (the "Software"), //
+// to deal in the Software without restriction, including without limitation  //
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,   //
+// and/or sell copies of the Software, and to permit persons to whom the      //
+// Software is furnished to do so, subject to the following conditions:       //
+//                                                                            //
+// The above copyright notice and this permission notice shall be included    //
+// in all copies or substantial portions of the Software.                     //
+//                                                                            //
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR //
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   //
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    //
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER //
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING    //
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER        //
+// DEALINGS IN THE SOFTWARE.                                                  //
+//                                                                            //
+//                                 James Card                                 //
+//                          http://www.jamescard.org                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Doxygen marker
+/// @file
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+/// @fn static unsigned int percentOf(uint32_t part, uint32_t whole)
+///
+/// @brief Compute one value as a percentage of another.  Overlays are linked
+/// without a runtime library and the Cortex-M0 has no divide instruction, so
+/// this is done by repeated subtraction.  The result never exceeds 100.
+///
+/// @param part The numerator.
+/// @param whole The denominator.
+///
+/// @return Returns the integer percentage of whole that part represents.
+static unsigned int percentOf(uint32_t part, uint32_t whole) {
+  unsigned int percent = 0;
+  if (whole == 0) {
+    return percent; // 0
+  }
+
+  // Scale down first so that part * 100 can't overflow.
+  while (part > (UINT32_MAX / 100)) {
+    part >>= 1;
+    whole >>= 1;
+  }
+
+  uint32_t scaled = part * 100;
+  while ((scaled >= whole) && (percent < 100)) {
+    scaled -= whole;
+    percent++;
+  }
+
+  return percent;
+}
+
+int main(int argc, char **argv) {
+  (void) argc;
+  (void) argv;
+
+  BlockCacheStatsInfo blockCacheStatsInfo;
+  if (getBlockCacheStats(&blockCacheStatsInfo) != 0) {
+    // ENOTSUP means the filesystem has no block cache.
+    fprintf(stderr, "ERROR: Could not get block cache statistics: %s\n",
+      strerror(errno));
+    return 1;
+  }
+
+  uint32_t numAccesses
+    = blockCacheStatsInfo.numHits + blockCacheStatsInfo.numMisses;
+  printf("Blocks:      %u\n", (unsigned int) blockCacheStatsInfo.numBlocks);
+  printf("Hits:        %lu\n", (unsigned long) blockCacheStatsInfo.numHits);
+  printf("Misses:      %lu\n", (unsigned long) blockCacheStatsInfo.numMisses);
+  printf("Write-backs: %lu\n",
+    (unsigned long) blockCacheStatsInfo.numWriteBacks);
+  printf("Hit rate:    %u%%\n",
+    percentOf(blockCacheStatsInfo.numHits, numAccesses));
+
+  return 0;
+}
+
@@ -0,0 +1,4 @@
+SOURCES := \
+    ../../../start.c \
+
+include ../../overlay.mk
@@ -0,0 +1 @@
+include ../command_overlay.mk
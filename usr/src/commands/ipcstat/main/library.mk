@@ -0,0 +1 @@
+include ../../library.mk
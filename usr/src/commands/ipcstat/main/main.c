@@ -0,0 +1,149 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                     Copyright (c) 2012-2025 James Card                     //
+//                                                                            //
+// Permission is hereby granted, free of charge, to any person obtaining a    //
+// copy of this software and associated documentation files (the "Software"), //
+// to deal in the Software without restriction, including without limitation  //
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,   //
+// and/or sell copies of the Software, and to permit persons to whom the      //
+// Software is furnished to do so, subject to the following conditions:       //
+//                                                                            //
+// The above copyright notice and this permission notice shall be included    //
+// in all copies or substantial portions of the Software.                     //
+//                                                                            //
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR //
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   //
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    //
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER //
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING    //
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER        //
+// DEALINGS IN THE SOFTWARE.                                                  //
+//                                                                            //
+//                                 James Card                                 //
+//                          http://www.jamescard.org                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Doxygen marker
+/// @file
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// @fn static uint32_t histogramTotal(const uint32_t *histogram)
+///
+/// @brief Get the number of samples in a latency histogram.
+///
+/// @param histogram The IPC_STATS_NUM_BUCKETS buckets of the histogram.
+///
+/// @return Returns the sum of all the buckets.
+static uint32_t histogramTotal(const uint32_t *histogram) {
+  uint32_t total = 0;
+  for (int ii = 0; ii < IPC_STATS_NUM_BUCKETS; ii++) {
+    total += histogram[ii];
+  }
+
+  return total;
+}
+
+/// @fn static void printPercentile(const uint32_t *histogram, uint32_t percent)
+///
+/// @brief Print the upper bound, in microseconds, of the histogram bucket that
+/// contains the given percentile.  Overlays are linked without a runtime
+/// library and the Cortex-M0 has no divide instruction, so the percentile is
+/// found by comparing cross products instead of dividing.
+///
+/// @param histogram The IPC_STATS_NUM_BUCKETS buckets of the histogram.
+/// @param percent The percentile to print, from 1 to 100.
+///
+/// @return This function returns no value.
+static void printPercentile(const uint32_t *histogram, uint32_t percent) {
+  uint32_t total = histogramTotal(histogram);
+  if (total == 0) {
+    printf(" %7s", "-");
+    return;
+  }
+
+  uint32_t cumulative = 0;
+  int bucket = 0;
+  for (; bucket < IPC_STATS_NUM_BUCKETS - 1; bucket++) {
+    cumulative += histogram[bucket];
+    if ((cumulative * 100) >= (total * percent)) {
+      break;
+    }
+  }
+
+  if (bucket == IPC_STATS_NUM_BUCKETS - 1) {
+    // The last bucket has no upper bound.
+    printf(" %6lu+",
+      (unsigned long) (((uint32_t) 1) << (IPC_STATS_NUM_BUCKETS - 2)));
+  } else {
+    printf(" %7lu", (unsigned long) (((uint32_t) 1) << bucket));
+  }
+}
+
+/// @fn static void printHistogram(const char *name, const uint32_t *histogram)
+///
+/// @brief Print every non-empty bucket of a latency histogram on one line.
+///
+/// @param name The name of the histogram.
+/// @param histogram The IPC_STATS_NUM_BUCKETS buckets of the histogram.
+///
+/// @return This function returns no value.
+static void printHistogram(const char *name, const uint32_t *histogram) {
+  printf("    %s:", name);
+  for (int ii = 0; ii < IPC_STATS_NUM_BUCKETS; ii++) {
+    if (histogram[ii] == 0) {
+      continue;
+    } else if (ii == IPC_STATS_NUM_BUCKETS - 1) {
+      printf(" >=%lu:%lu", (unsigned long) (((uint32_t) 1) << (ii - 1)),
+        (unsigned long) histogram[ii]);
+    } else {
+      printf(" <%lu:%lu", (unsigned long) (((uint32_t) 1) << ii),
+        (unsigned long) histogram[ii]);
+    }
+  }
+  printf("\n");
+}
+
+int main(int argc, char **argv) {
+  int verbose = ((argc > 1) && (strcmp(argv[1], "-v") == 0));
+
+  IpcStatsInfo *ipcStatsInfo = getIpcStats();
+  if (ipcStatsInfo == NULL) {
+    fputs("ERROR: Could not get IPC statistics.\n", stderr);
+    return 1;
+  } else if (ipcStatsInfo->numEntries == 0) {
+    fputs("No IPC statistics recorded.\n", stdout);
+    free(ipcStatsInfo);
+    return 0;
+  }
+
+  // Latencies are the upper bounds of their histogram buckets in
+  // microseconds.
+  printf("PID  TYPE     COUNT MAXQ   Q p50   Q p99 SVC p50 SVC p99\n");
+  for (uint8_t ii = 0; ii < ipcStatsInfo->numEntries; ii++) {
+    IpcStatsElement *entry = &ipcStatsInfo->entries[ii];
+    printf("%-4u %4u %9lu %4u", entry->pid, entry->type,
+      (unsigned long) entry->count, entry->maxQueueDepth);
+    printPercentile(entry->queueLatency, 50);
+    printPercentile(entry->queueLatency, 99);
+    printPercentile(entry->serviceLatency, 50);
+    printPercentile(entry->serviceLatency, 99);
+    printf("\n");
+
+    if (verbose) {
+      printHistogram("queue us", entry->queueLatency);
+      printHistogram("service us", entry->serviceLatency);
+    }
+  }
+  if (ipcStatsInfo->numDropped != 0) {
+    printf("%lu messages were not counted because the table was full.\n",
+      (unsigned long) ipcStatsInfo->numDropped);
+  }
+
+  free(ipcStatsInfo);
+  return 0;
+}
@@ -0,0 +1,141 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//                     Copyright (c) 2012-2025 James Card                     //
+//                                                                            //
+// Permission is hereby granted, free of charge, to any person obtaining a    //
+// copy of this software and associated documentation files (the "Software"), //
+// to deal in the Software without restriction, including without limitation  //
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,   //
+// and/or sell copies of the Software, and to permit persons to whom the      //
+// Software is furnished to do so, subject to the following conditions:       //
+//                                                                            //
+// The above copyright notice and this permission notice shall be included    //
+// in all copies or substantial portions of the Software.                     //
+//                                                                            //
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR //
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   //
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    //
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER //
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING    //
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER        //
+// DEALINGS IN THE SOFTWARE.                                                  //
+//                                                                            //
+//                                 James Card                                 //
+//                          http://www.jamescard.org                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// Doxygen marker
+/// @file
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// @fn static unsigned int percentOf(uint32_t part, uint32_t whole)
+///
+/// @brief Compute one value as a percentage of another.  Overlays are linked
+/// without a runtime library and the Cortex-M0 has no divide instruction, so
+/// this is done by repeated subtraction.  The result never exceeds 100.
+///
+/// @param part The numerator.
+/// @param whole The denominator.
+///
+/// @return Returns the integer percentage of whole that part represents.
+static unsigned int percentOf(uint32_t part, uint32_t whole) {
+  unsigned int percent = 0;
+  if (whole == 0) {
+    return percent; // 0
+  }
+
+  uint32_t scaled = part * 100;
+  while ((scaled >= whole) && (percent < 100)) {
+    scaled -= whole;
+    percent++;
+  }
+
+  return percent;
+}
+
+/// @fn static void printTaskStats(
+///   TaskStatsInfo *current, TaskStatsInfo *previous)
+///
+/// @brief Print one table of task statistics.  The CPU usage column is
+/// computed from the run time accumulated since the previous snapshot, so it
+/// is only shown once there is one.
+///
+/// @param current The most recent snapshot of task statistics.
+/// @param previous The snapshot taken before current, if any.
+///
+/// @return This function returns no value.
+static void printTaskStats(TaskStatsInfo *current, TaskStatsInfo *previous) {
+  uint32_t elapsedMs = 0;
+  if (previous != NULL) {
+    elapsedMs = current->timestampMs - previous->timestampMs;
+  }
+
+  printf("PID  NAME             %%CPU   RUN ms  WAIT ms  RESUMES   YIELDS"
+    "  PREEMPT\n");
+  for (uint8_t ii = 0; ii < current->numTasks; ii++) {
+    TaskStatsElement *task = &current->tasks[ii];
+
+    // Find the same task in the previous snapshot.  A task that restarted
+    // with the same PID will have less run time than before, so don't match
+    // it.
+    TaskStatsElement *before = NULL;
+    for (uint8_t jj = 0; (previous != NULL) && (jj < previous->numTasks);
+      jj++
+    ) {
+      if ((previous->tasks[jj].pid == task->pid)
+        && (previous->tasks[jj].runTimeMs <= task->runTimeMs)
+      ) {
+        before = &previous->tasks[jj];
+        break;
+      }
+    }
+
+    printf("%-4d %-16s ", task->pid,
+      (task->name != NULL) ? task->name : "-");
+    if (before != NULL) {
+      printf("%4u ",
+        percentOf(task->runTimeMs - before->runTimeMs, elapsedMs));
+    } else {
+      printf("   - ");
+    }
+    printf("%8lu %8lu %8lu %8lu %8lu\n",
+      (unsigned long) task->runTimeMs,
+      (unsigned long) task->waitTimeMs,
+      (unsigned long) task->numResumes,
+      (unsigned long) task->numYields,
+      (unsigned long) task->numPreemptions);
+  }
+}
+
+int main(int argc, char **argv) {
+  (void) argc;
+  (void) argv;
+
+  TaskStatsInfo *previous = NULL;
+  char buffer[16];
+  do {
+    TaskStatsInfo *current = getTaskStats();
+    if (current == NULL) {
+      // ENOTSUP means the kernel was built without task accounting.
+      fprintf(stderr, "ERROR: Could not get task statistics: %s\n",
+        strerror(errno));
+      free(previous);
+      return 1;
+    }
+
+    printTaskStats(current, previous);
+    free(previous);
+    previous = current;
+
+    fputs("Press Enter to refresh or q and Enter to quit.\n", stdout);
+  } while ((fgets(buffer, sizeof(buffer), stdin) != NULL)
+    && (buffer[0] != 'q'));
+
+  free(previous);
+  return 0;
+}